@@ -13,6 +13,8 @@
 #include "qemu/osdep.h"
 #include "cpu.h"
 #include "exec/exec-all.h"
+#include "qapi/error.h"
+#include "qapi/qapi-commands-machine.h"
 
 void tb_flush(CPUState *cpu)
 {
@@ -38,3 +40,9 @@ void QEMU_NORETURN cpu_loop_exit_restore(CPUState *cpu, uintptr_t pc)
 {
     g_assert_not_reached();
 }
+
+TlbStatsInfoList *qmp_query_tlb_stats(Error **errp)
+{
+    error_setg(errp, "TLB statistics are only available with TCG");
+    return NULL;
+}
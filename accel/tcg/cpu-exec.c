@@ -34,6 +34,7 @@
 #include "exec/tb-lookup.h"
 #include "exec/log.h"
 #include "exec/log_instr.h"
+#include "cheri_tagmem.h"
 #include "qemu/main-loop.h"
 #if defined(TARGET_I386) && !defined(CONFIG_USER_ONLY)
 #include "hw/i386/apic.h"
@@ -285,6 +286,9 @@ void cpu_exec_step_atomic(CPUState *cpu)
         if (qemu_mutex_iothread_locked()) {
             qemu_mutex_unlock_iothread();
         }
+#ifdef TARGET_CHERI
+        cheri_tag_unlock();
+#endif
         assert_no_pages_locked();
         qemu_plugin_disable_mem_helpers(cpu);
     }
@@ -361,7 +365,8 @@ TranslationBlock *tb_htable_lookup(CPUState *cpu, target_ulong pc,
         return NULL;
     }
     desc.phys_page1 = phys_pc & TARGET_PAGE_MASK;
-    h = tb_hash_func(phys_pc, pc, flags, cflags, *cpu->trace_dstate);
+    h = tb_hash_func(phys_pc, pc, cs_base, cs_top, cheri_flags, flags, cflags,
+                     *cpu->trace_dstate);
     return qht_lookup_custom(&tb_ctx.htable, &desc, h, tb_lookup_cmp);
 }
 
@@ -437,7 +442,9 @@ static inline TranslationBlock *tb_find(CPUState *cpu,
         tb = tb_gen_code(cpu, pc, cs_base, cs_top, cheri_flags, flags, cflags);
         mmap_unlock();
         /* We add the TB in the virtual pc hash table for the fast lookup */
-        qatomic_set(&cpu->tb_jmp_cache[tb_jmp_cache_hash_func(pc)], tb);
+        tb_jmp_cache_insert(
+            &cpu->tb_jmp_cache[tb_jmp_cache_hash_func(pc, cs_base, cs_top)],
+            tb);
     }
 #ifndef CONFIG_USER_ONLY
     /* We don't take care of direct jumps when address mapping changes in
@@ -777,6 +784,10 @@ int cpu_exec(CPUState *cpu)
         if (qemu_mutex_iothread_locked()) {
             qemu_mutex_unlock_iothread();
         }
+#ifdef TARGET_CHERI
+        /* A helper may have longjmp'd out while holding a tag lock. */
+        cheri_tag_unlock();
+#endif
         qemu_plugin_disable_mem_helpers(cpu);
 
         assert_no_pages_locked();
@@ -826,6 +837,7 @@ void tcg_exec_realizefn(CPUState *cpu, Error **errp)
         qemu_log_printf_create_globals();
         tcg_target_initialized = true;
     }
+    cpu->tb_jmp_cache = g_new0(CPUJumpCacheSet, TB_JMP_CACHE_SIZE);
     tlb_init(cpu);
     qemu_plugin_vcpu_init_hook(cpu);
 
@@ -843,6 +855,8 @@ void tcg_exec_unrealizefn(CPUState *cpu)
 
     qemu_plugin_vcpu_exit_hook(cpu);
     tlb_destroy(cpu);
+    g_free(cpu->tb_jmp_cache);
+    cpu->tb_jmp_cache = NULL;
 }
 
 #ifndef CONFIG_USER_ONLY
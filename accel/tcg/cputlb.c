@@ -40,6 +40,9 @@
 #include "trace/mem.h"
 #include "cheri_tagmem.h"
 #include "internal.h"
+#include "qapi/error.h"
+#include "qapi/qapi-commands-machine.h"
+#include "sysemu/tcg.h"
 #ifdef CONFIG_PLUGIN
 #include "qemu/plugin-memory.h"
 #endif
@@ -84,6 +87,12 @@ QEMU_BUILD_BUG_ON(sizeof(target_ulong) > sizeof(run_on_cpu_data));
 QEMU_BUILD_BUG_ON(NB_MMU_MODES > 16);
 #define ALL_MMUIDX_BITS ((1 << NB_MMU_MODES) - 1)
 
+#define tlb_stat_inc(desc, field) \
+    qatomic_set(&(desc)->stats.field, (desc)->stats.field + 1)
+
+/* Length of the window over which tlb_mmu_resize_locked looks at the use rate */
+uint32_t tlb_resize_window_ms = TLB_RESIZE_WINDOW_MS_DEFAULT;
+
 static inline size_t tlb_n_entries(CPUTLBDescFast *fast)
 {
     return (fast->mask >> CPU_TLB_ENTRY_BITS) + 1;
@@ -103,11 +112,16 @@ static void tlb_window_reset(CPUTLBDesc *desc, int64_t ns,
 
 static void tb_jmp_cache_clear_page(CPUState *cpu, target_ulong page_addr)
 {
-    unsigned int i, i0 = tb_jmp_cache_hash_page(page_addr);
+    unsigned int i, way, i0 = tb_jmp_cache_hash_page(page_addr);
 
+    /* The indirect branch target cache is not indexed by page */
+    cpu_tb_ibtc_clear(cpu);
     for (i = 0; i < TB_JMP_PAGE_SIZE; i++) {
-        qatomic_set(&cpu->tb_jmp_cache[i0 + i], NULL);
+        for (way = 0; way < TB_JMP_CACHE_WAYS; way++) {
+            qatomic_set(&cpu->tb_jmp_cache[i0 + i].tb[way], NULL);
+        }
     }
+    qatomic_set(&cpu->tb_jmp_cache_flushes, cpu->tb_jmp_cache_flushes + 1);
 }
 
 static void tb_flush_jmp_cache(CPUState *cpu, target_ulong addr)
@@ -164,7 +178,7 @@ static void tlb_mmu_resize_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast,
     size_t old_size = tlb_n_entries(fast);
     size_t rate;
     size_t new_size = old_size;
-    int64_t window_len_ms = 100;
+    int64_t window_len_ms = qatomic_read(&tlb_resize_window_ms);
     int64_t window_len_ns = window_len_ms * 1000 * 1000;
     bool window_expired = now > desc->window_begin_ns + window_len_ns;
 
@@ -202,6 +216,12 @@ static void tlb_mmu_resize_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast,
         return;
     }
 
+    if (new_size > old_size) {
+        tlb_stat_inc(desc, grows);
+    } else {
+        tlb_stat_inc(desc, shrinks);
+    }
+
     g_free(fast->table);
     g_free(desc->iotlb);
 
@@ -239,8 +259,10 @@ static void tlb_mmu_flush_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast)
     desc->large_page_addr = -1;
     desc->large_page_mask = -1;
     desc->vindex = 0;
+    desc->lindex = 0;
     memset(fast->table, -1, sizeof_tlb(fast));
     memset(desc->vtable, -1, sizeof(desc->vtable));
+    memset(desc->ltable, -1, sizeof(desc->ltable));
 }
 
 static void tlb_flush_one_mmuidx_locked(CPUArchState *env, int mmu_idx,
@@ -275,6 +297,43 @@ static inline void tlb_n_used_entries_dec(CPUArchState *env, uintptr_t mmu_idx)
     env_tlb(env)->d[mmu_idx].n_used_entries--;
 }
 
+/* Called with tlb_c.lock held */
+static void tlb_drop_asid_slot_locked(CPUTLBASIDSlot *slot, uint16_t idxmap)
+{
+    int mmu_idx;
+
+    for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
+        CPUTLBSavedTable *t = &slot->t[mmu_idx];
+
+        if ((idxmap >> mmu_idx) & 1) {
+            g_free(t->table);
+            g_free(t->iotlb);
+            t->table = NULL;
+            t->iotlb = NULL;
+        }
+    }
+}
+
+/*
+ * Forget the tlbs kept for inactive ASIDs, for the MMU indexes in @idxmap.
+ * They are only a cache, so any flush that is not scoped to an ASID drops
+ * them rather than flushing them too.
+ *
+ * Called with tlb_c.lock held.
+ */
+static void tlb_drop_saved_asids_locked(CPUArchState *env, uint16_t idxmap)
+{
+    int i;
+
+    for (i = 0; i < CPU_TLB_ASID_SLOTS; i++) {
+        CPUTLBASIDSlot *slot = &env_tlb(env)->c.asid_slots[i];
+
+        if (slot->valid) {
+            tlb_drop_asid_slot_locked(slot, idxmap);
+        }
+    }
+}
+
 void tlb_init(CPUState *cpu)
 {
     CPUArchState *env = cpu->env_ptr;
@@ -304,6 +363,7 @@ void tlb_destroy(CPUState *cpu)
         g_free(fast->table);
         g_free(desc->iotlb);
     }
+    tlb_drop_saved_asids_locked(env, ALL_MMUIDX_BITS);
 }
 
 /* flush_all_helper: run fn across all cpus
@@ -342,6 +402,49 @@ void tlb_flush_counts(size_t *pfull, size_t *ppart, size_t *pelide)
     *pelide = elide;
 }
 
+TlbStatsInfoList *qmp_query_tlb_stats(Error **errp)
+{
+    TlbStatsInfoList *head = NULL, **tail = &head;
+    CPUState *cpu;
+
+    if (!tcg_enabled()) {
+        error_setg(errp, "TLB statistics are only available with TCG");
+        return NULL;
+    }
+
+    CPU_FOREACH(cpu) {
+        CPUArchState *env = cpu->env_ptr;
+        int mmu_idx;
+
+        for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
+            CPUTLBDesc *desc = &env_tlb(env)->d[mmu_idx];
+            CPUTLBDescFast *fast = &env_tlb(env)->f[mmu_idx];
+            TlbStatsInfo *value = g_new0(TlbStatsInfo, 1);
+
+            value->cpu_index = cpu->cpu_index;
+            value->mmu_index = mmu_idx;
+            value->entries = (qatomic_read(&fast->mask) >>
+                              CPU_TLB_ENTRY_BITS) + 1;
+            value->used_entries = qatomic_read(&desc->n_used_entries);
+            value->misses = qatomic_read(&desc->stats.misses);
+            value->victim_hits = qatomic_read(&desc->stats.victim_hits);
+            value->large_page_hits =
+                qatomic_read(&desc->stats.large_page_hits);
+            value->fills = qatomic_read(&desc->stats.fills);
+            value->flushes = qatomic_read(&desc->stats.flushes);
+            value->large_page_flushes =
+                qatomic_read(&desc->stats.large_page_flushes);
+            value->range_flushes = qatomic_read(&desc->stats.range_flushes);
+            value->page_flushes = qatomic_read(&desc->stats.page_flushes);
+            value->grows = qatomic_read(&desc->stats.grows);
+            value->shrinks = qatomic_read(&desc->stats.shrinks);
+            QAPI_LIST_APPEND(tail, value);
+        }
+    }
+
+    return head;
+}
+
 static void tlb_flush_by_mmuidx_async_work(CPUState *cpu, run_on_cpu_data data)
 {
     CPUArchState *env = cpu->env_ptr;
@@ -363,7 +466,9 @@ static void tlb_flush_by_mmuidx_async_work(CPUState *cpu, run_on_cpu_data data)
     for (work = to_clean; work != 0; work &= work - 1) {
         int mmu_idx = ctz32(work);
         tlb_flush_one_mmuidx_locked(env, mmu_idx, now);
+        tlb_stat_inc(&env_tlb(env)->d[mmu_idx], flushes);
     }
+    tlb_drop_saved_asids_locked(env, asked);
 
     qemu_spin_unlock(&env_tlb(env)->c.lock);
 
@@ -508,7 +613,9 @@ static void tlb_flush_page_locked(CPUArchState *env, int midx,
                   TARGET_FMT_lx "/" TARGET_FMT_lx ")\n",
                   midx, lp_addr, lp_mask);
         tlb_flush_one_mmuidx_locked(env, midx, get_clock_realtime());
+        tlb_stat_inc(&env_tlb(env)->d[midx], large_page_flushes);
     } else {
+        tlb_stat_inc(&env_tlb(env)->d[midx], page_flushes);
         if (tlb_flush_entry_locked(tlb_entry(env, midx, page), page)) {
             tlb_n_used_entries_dec(env, midx);
         }
@@ -542,6 +649,7 @@ static void tlb_flush_page_by_mmuidx_async_0(CPUState *cpu,
             tlb_flush_page_locked(env, mmu_idx, addr);
         }
     }
+    tlb_drop_saved_asids_locked(env, idxmap);
     qemu_spin_unlock(&env_tlb(env)->c.lock);
 
     tb_flush_jmp_cache(cpu, addr);
@@ -730,6 +838,7 @@ static void tlb_flush_page_bits_locked(CPUArchState *env, int midx,
                   TARGET_FMT_lx "/" TARGET_FMT_lx ")\n",
                   midx, page, mask);
         tlb_flush_one_mmuidx_locked(env, midx, get_clock_realtime());
+        tlb_stat_inc(d, range_flushes);
         return;
     }
 
@@ -739,9 +848,11 @@ static void tlb_flush_page_bits_locked(CPUArchState *env, int midx,
                   TARGET_FMT_lx "/" TARGET_FMT_lx ")\n",
                   midx, d->large_page_addr, d->large_page_mask);
         tlb_flush_one_mmuidx_locked(env, midx, get_clock_realtime());
+        tlb_stat_inc(d, large_page_flushes);
         return;
     }
 
+    tlb_stat_inc(d, page_flushes);
     if (tlb_flush_entry_mask_locked(tlb_entry(env, midx, page), page, mask)) {
         tlb_n_used_entries_dec(env, midx);
     }
@@ -772,6 +883,7 @@ tlb_flush_page_bits_by_mmuidx_async_0(CPUState *cpu,
             tlb_flush_page_bits_locked(env, mmu_idx, d.addr, d.bits);
         }
     }
+    tlb_drop_saved_asids_locked(env, d.idxmap);
     qemu_spin_unlock(&env_tlb(env)->c.lock);
 
     tb_flush_jmp_cache(cpu, d.addr);
@@ -944,6 +1056,182 @@ void tlb_flush_page_bits_by_mmuidx_all_cpus_synced(CPUState *src_cpu,
     }
 }
 
+/*
+ * ASID switching.
+ *
+ * Guests that tag their translations with an address space identifier
+ * switch ASIDs on every context switch, which used to flush the whole
+ * TLB. Instead, the tables of the outgoing ASID are moved aside into one
+ * of CPU_TLB_ASID_SLOTS slots, and the tables kept for the incoming ASID,
+ * if any, are moved back in. The inline fast path keeps comparing only
+ * the page address, since only the current ASID's entries are ever in
+ * f[].table.
+ */
+
+static CPUTLBASIDSlot *tlb_find_asid_slot(CPUArchState *env, uint32_t asid)
+{
+    int i;
+
+    for (i = 0; i < CPU_TLB_ASID_SLOTS; i++) {
+        CPUTLBASIDSlot *slot = &env_tlb(env)->c.asid_slots[i];
+
+        if (slot->valid && slot->asid == asid) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+void tlb_set_asid(CPUState *cpu, uint32_t asid)
+{
+    CPUArchState *env = cpu->env_ptr;
+    CPUTLB *tlb = env_tlb(env);
+    CPUTLBASIDSlot *slot;
+    int64_t now = get_clock_realtime();
+    int mmu_idx;
+
+    assert_cpu_is_self(cpu);
+
+    if (asid == tlb->c.asid) {
+        return;
+    }
+
+    qemu_spin_lock(&tlb->c.lock);
+
+    slot = tlb_find_asid_slot(env, asid);
+    if (slot == NULL) {
+        slot = &tlb->c.asid_slots[tlb->c.asid_next++ % CPU_TLB_ASID_SLOTS];
+        tlb_drop_asid_slot_locked(slot, ALL_MMUIDX_BITS);
+    }
+
+    /* Swap the current tables with the ones kept in slot, if any. */
+    for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
+        CPUTLBDesc *desc = &tlb->d[mmu_idx];
+        CPUTLBDescFast *fast = &tlb->f[mmu_idx];
+        CPUTLBSavedTable *t = &slot->t[mmu_idx];
+        CPUTLBSavedTable in = *t;
+
+        if (tlb_n_entries(fast) <= (1 << CPU_TLB_ASID_MAX_BITS)) {
+            t->table = fast->table;
+            t->iotlb = desc->iotlb;
+            t->mask = fast->mask;
+            t->n_used_entries = desc->n_used_entries;
+            t->large_page_addr = desc->large_page_addr;
+            t->large_page_mask = desc->large_page_mask;
+        } else {
+            g_free(fast->table);
+            g_free(desc->iotlb);
+            t->table = NULL;
+            t->iotlb = NULL;
+        }
+
+        if (in.table == NULL) {
+            tlb_mmu_init(desc, fast, now);
+            continue;
+        }
+        fast->table = in.table;
+        fast->mask = in.mask;
+        desc->iotlb = in.iotlb;
+        desc->n_used_entries = in.n_used_entries;
+        desc->large_page_addr = in.large_page_addr;
+        desc->large_page_mask = in.large_page_mask;
+        tlb_window_reset(desc, now, in.n_used_entries);
+        /* The victim and large page tables were not kept */
+        desc->vindex = 0;
+        desc->lindex = 0;
+        memset(desc->vtable, -1, sizeof(desc->vtable));
+        memset(desc->ltable, -1, sizeof(desc->ltable));
+    }
+
+    slot->asid = tlb->c.asid;
+    slot->valid = true;
+    tlb->c.asid = asid;
+    tlb->c.dirty = ALL_MMUIDX_BITS;
+
+    qemu_spin_unlock(&tlb->c.lock);
+
+    /* The jump cache is indexed by virtual address too. */
+    cpu_tb_jmp_cache_clear(cpu);
+}
+
+void tlb_reset_asid(CPUState *cpu, uint32_t asid)
+{
+    CPUArchState *env = cpu->env_ptr;
+    CPUTLB *tlb = env_tlb(env);
+    int64_t now = get_clock_realtime();
+    int mmu_idx, i;
+
+    qemu_spin_lock(&tlb->c.lock);
+    for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
+        tlb_flush_one_mmuidx_locked(env, mmu_idx, now);
+    }
+    tlb_drop_saved_asids_locked(env, ALL_MMUIDX_BITS);
+    for (i = 0; i < CPU_TLB_ASID_SLOTS; i++) {
+        tlb->c.asid_slots[i].valid = false;
+    }
+    tlb->c.asid = asid;
+    tlb->c.dirty = 0;
+    qemu_spin_unlock(&tlb->c.lock);
+
+    cpu_tb_jmp_cache_clear(cpu);
+}
+
+void tlb_flush_asid(CPUState *cpu, uint32_t asid)
+{
+    CPUArchState *env = cpu->env_ptr;
+    CPUTLB *tlb = env_tlb(env);
+    CPUTLBASIDSlot *slot;
+
+    assert_cpu_is_self(cpu);
+
+    if (asid == tlb->c.asid) {
+        int64_t now = get_clock_realtime();
+        int mmu_idx;
+
+        qemu_spin_lock(&tlb->c.lock);
+        for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
+            tlb_flush_one_mmuidx_locked(env, mmu_idx, now);
+            tlb_stat_inc(&tlb->d[mmu_idx], flushes);
+        }
+        tlb->c.dirty = 0;
+        qemu_spin_unlock(&tlb->c.lock);
+
+        cpu_tb_jmp_cache_clear(cpu);
+        return;
+    }
+
+    qemu_spin_lock(&tlb->c.lock);
+    slot = tlb_find_asid_slot(env, asid);
+    if (slot) {
+        tlb_drop_asid_slot_locked(slot, ALL_MMUIDX_BITS);
+        slot->valid = false;
+    }
+    qemu_spin_unlock(&tlb->c.lock);
+}
+
+void tlb_flush_page_asid(CPUState *cpu, target_ulong addr, uint32_t asid)
+{
+    CPUArchState *env = cpu->env_ptr;
+    CPUTLB *tlb = env_tlb(env);
+    int mmu_idx;
+
+    assert_cpu_is_self(cpu);
+
+    if (asid != tlb->c.asid) {
+        tlb_flush_asid(cpu, asid);
+        return;
+    }
+
+    addr &= TARGET_PAGE_MASK;
+    qemu_spin_lock(&tlb->c.lock);
+    for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
+        tlb_flush_page_locked(env, mmu_idx, addr);
+    }
+    qemu_spin_unlock(&tlb->c.lock);
+
+    tb_flush_jmp_cache(cpu, addr);
+}
+
 /* update the TLBs so that writes to code in the virtual page 'addr'
    can be detected */
 void tlb_protect_code(ram_addr_t ram_addr)
@@ -1014,7 +1302,7 @@ void tlb_reset_dirty(CPUState *cpu, ram_addr_t start1, ram_addr_t length)
 {
     CPUArchState *env;
 
-    int mmu_idx;
+    int mmu_idx, k;
 
     env = cpu->env_ptr;
     qemu_spin_lock(&env_tlb(env)->c.lock);
@@ -1032,6 +1320,24 @@ void tlb_reset_dirty(CPUState *cpu, ram_addr_t start1, ram_addr_t length)
                                          start1, length);
         }
     }
+    for (k = 0; k < CPU_TLB_ASID_SLOTS; k++) {
+        CPUTLBASIDSlot *slot = &env_tlb(env)->c.asid_slots[k];
+
+        if (!slot->valid) {
+            continue;
+        }
+        for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
+            CPUTLBSavedTable *t = &slot->t[mmu_idx];
+            size_t i, n = (t->mask >> CPU_TLB_ENTRY_BITS) + 1;
+
+            if (t->table == NULL) {
+                continue;
+            }
+            for (i = 0; i < n; i++) {
+                tlb_reset_dirty_range_locked(&t->table[i], start1, length);
+            }
+        }
+    }
     qemu_spin_unlock(&env_tlb(env)->c.lock);
 }
 
@@ -1092,6 +1398,36 @@ static void tlb_add_large_page(CPUArchState *env, int mmu_idx,
     env_tlb(env)->d[mmu_idx].large_page_mask = lp_mask;
 }
 
+/*
+ * Remember the translation of a large page, so that the TLB entries for
+ * its other pages can be filled without asking the target to walk its
+ * page tables again; see tlb_fill_large_page(). Since the page is within
+ * large_page_addr/mask, flushing any part of it flushes the whole table.
+ */
+static void tlb_add_large_entry_locked(CPUTLBDesc *desc, target_ulong vaddr,
+                                       hwaddr paddr, MemTxAttrs attrs,
+                                       int prot, target_ulong size)
+{
+    CPUTLBLargeEntry *le = NULL;
+    size_t i;
+
+    vaddr &= ~(size - 1);
+    for (i = 0; i < CPU_LTLB_SIZE; i++) {
+        if (desc->ltable[i].vaddr == vaddr && desc->ltable[i].size == size) {
+            le = &desc->ltable[i];
+            break;
+        }
+    }
+    if (le == NULL) {
+        le = &desc->ltable[desc->lindex++ % CPU_LTLB_SIZE];
+    }
+    le->vaddr = vaddr;
+    le->paddr = paddr & ~(hwaddr)(size - 1);
+    le->size = size;
+    le->attrs = attrs;
+    le->prot = prot;
+}
+
 /* Add a new TLB entry. At most one entry for a given virtual address
  * is permitted. Only a single TARGET_PAGE_SIZE region is mapped, the
  * supplied size is only used by tlb_flush_page.
@@ -1116,6 +1452,7 @@ void tlb_set_page_with_attrs(CPUState *cpu, target_ulong vaddr,
     target_ulong vaddr_page;
     int asidx = cpu_asidx_from_attrs(cpu, attrs);
     int wp_flags;
+    int page_prot = prot;
     bool is_ram, is_romd;
 
     assert_cpu_is_self(cpu);
@@ -1144,7 +1481,8 @@ void tlb_set_page_with_attrs(CPUState *cpu, target_ulong vaddr,
      * any other entries are modified.
      */
     uintptr_t tagmem = (uintptr_t)cheri_tagmem_for_addr(
-        env, vaddr, section->mr->ram_block, xlat, size, &prot, tag_setting);
+        env, vaddr, section->mr->ram_block, xlat, TARGET_PAGE_SIZE, &prot,
+        tag_setting);
     assert((tagmem & TLBENTRYCAP_MASK) == 0);
 #endif
 
@@ -1214,6 +1552,10 @@ void tlb_set_page_with_attrs(CPUState *cpu, target_ulong vaddr,
     /* Note that the tlb is no longer clean.  */
     tlb->c.dirty |= 1 << mmu_idx;
 
+    if (size > TARGET_PAGE_SIZE) {
+        tlb_add_large_entry_locked(desc, vaddr, paddr, attrs, page_prot, size);
+    }
+
     /* Make sure there's no cached translation for the new page.  */
     tlb_flush_vtlb_page_locked(env, mmu_idx, vaddr_page);
 
@@ -1328,6 +1670,61 @@ static inline ram_addr_t qemu_ram_addr_from_host_nofail(void *ptr)
     return ram_addr;
 }
 
+/*
+ * Fill the TLB entry for @addr from a large page translation that was
+ * previously installed with tlb_set_page_with_attrs(). Returns false if
+ * there is none, or if it does not allow @access_type, in which case the
+ * target's tlb_fill must be called (e.g. to set a dirty bit).
+ *
+ * Capability stores always go to the target: they may have to set a
+ * capability-dirty bit in the page table entry or trap, which the cached
+ * protection bits do not record.
+ */
+static bool tlb_fill_large_page(CPUState *cpu, target_ulong addr,
+                                MMUAccessType access_type, int mmu_idx)
+{
+    CPUTLBDesc *desc = &env_tlb((CPUArchState *)cpu->env_ptr)->d[mmu_idx];
+    CPUTLBLargeEntry le;
+    target_ulong page;
+    int need;
+    size_t i;
+
+    switch (access_type) {
+    case MMU_DATA_LOAD:
+    case MMU_DATA_CAP_LOAD:
+        need = PAGE_READ;
+        break;
+    case MMU_DATA_STORE:
+        need = PAGE_WRITE;
+        break;
+    case MMU_INST_FETCH:
+        need = PAGE_EXEC;
+        break;
+    default:
+        return false;
+    }
+
+    for (i = 0; i < CPU_LTLB_SIZE; i++) {
+        le = desc->ltable[i];
+        if (le.vaddr != (target_ulong)-1 &&
+            ((addr ^ le.vaddr) & ~(le.size - 1)) == 0) {
+            break;
+        }
+    }
+    if (i == CPU_LTLB_SIZE || (le.prot & need) != need) {
+        return false;
+    }
+
+#ifdef TARGET_CHERI
+    le.attrs.tag_setting = false;
+#endif
+    tlb_stat_inc(desc, large_page_hits);
+    page = addr & TARGET_PAGE_MASK;
+    tlb_set_page_with_attrs(cpu, page, le.paddr + (page - le.vaddr), le.attrs,
+                            le.prot, mmu_idx, le.size);
+    return true;
+}
+
 /*
  * Note: tlb_fill() can trigger a resize of the TLB. This means that all of the
  * caller's prior references to the TLB table (e.g. CPUTLBEntry pointers) must
@@ -1339,6 +1736,11 @@ static void tlb_fill(CPUState *cpu, target_ulong addr, int size,
     CPUClass *cc = CPU_GET_CLASS(cpu);
     bool ok;
 
+    if (tlb_fill_large_page(cpu, addr, access_type, mmu_idx)) {
+        return;
+    }
+    tlb_stat_inc(&env_tlb((CPUArchState *)cpu->env_ptr)->d[mmu_idx], fills);
+
     /*
      * This is not a probe, so only valid return is success; failure
      * should result in exception + longjmp to the cpu loop.
@@ -1374,6 +1776,183 @@ static inline void cpu_transaction_failed(CPUState *cpu, hwaddr physaddr,
     }
 }
 
+/*
+ * Slow path profile, enabled with "-accel tcg,slow-path-profile=on".
+ *
+ * The inline TLB lookup that TCG emits for guest loads and stores always
+ * fails for MMIO and for accesses that span two pages, after which the slow
+ * path looks up the TLB again. Count these accesses by guest instruction.
+ * The counts decay with the number of slow path accesses made overall, so
+ * only an instruction that misses often within a short time crosses the
+ * threshold. Its TB is then invalidated at the next safe point, and when
+ * it is translated again its loads and stores call
+ * helper_qemu_ld_direct/helper_qemu_st_direct instead, see
+ * tlb_slow_path_preferred().
+ *
+ * The direct helpers keep counting how many of their accesses would have
+ * missed the inline lookup. Once fewer than half of a window do, the
+ * instruction is retranslated with the inline lookup again.
+ *
+ * The table is shared by all vCPUs and updated without locking: a lost
+ * update only delays or repeats a retranslation.
+ */
+#define SLOW_PATH_PROFILE_BITS 12
+#define SLOW_PATH_PROFILE_SIZE (1 << SLOW_PATH_PROFILE_BITS)
+#define SLOW_PATH_PROFILE_THRESHOLD 32
+/* Miss counts halve every 2^SLOW_PATH_PROFILE_DECAY_BITS slow path accesses */
+#define SLOW_PATH_PROFILE_DECAY_BITS 14
+/* Number of direct accesses after which an instruction is reviewed */
+#define SLOW_PATH_PROFILE_WINDOW 256
+
+typedef struct SlowPathProfileEntry {
+    uint32_t tag;
+    uint32_t epoch;
+    uint32_t count;
+    uint16_t direct_execs;
+    uint16_t direct_misses;
+} SlowPathProfileEntry;
+
+typedef struct SlowPathRetranslate {
+    uintptr_t retaddr;
+    target_ulong pc;
+} SlowPathRetranslate;
+
+bool tcg_slow_path_profile;
+static SlowPathProfileEntry slow_path_profile[SLOW_PATH_PROFILE_SIZE];
+static uint32_t slow_path_clock;
+/*
+ * Return address of the current helper_qemu_ld_direct/helper_qemu_st_direct
+ * call. It is compared rather than cleared on return, as the access can
+ * raise a guest exception and never return.
+ */
+static __thread uintptr_t slow_path_direct_ra;
+/* Set if the current direct access took the MMIO or page-crossing path */
+static __thread bool slow_path_direct_missed;
+
+static SlowPathProfileEntry *slow_path_profile_entry(target_ulong pc,
+                                                     uint32_t *tag)
+{
+    *tag = (pc >> 1) | 1;
+    return &slow_path_profile[(pc >> 1) & (SLOW_PATH_PROFILE_SIZE - 1)];
+}
+
+static void do_slow_path_retranslate(CPUState *cpu, run_on_cpu_data data)
+{
+    SlowPathRetranslate *r = data.host_ptr;
+    TranslationBlock *tb = tcg_tb_lookup(r->retaddr);
+    target_ulong pc;
+
+    /* The code buffer may have been flushed and reused in the meantime */
+    if (tb && tb_insn_pc_from_host(tb, r->retaddr, &pc) && pc == r->pc) {
+        tb_phys_invalidate(tb, -1);
+    }
+    g_free(r);
+}
+
+/*
+ * Invalidate the TB containing the instruction at @pc once all vCPUs are
+ * stopped, rather than from within a helper that this TB is executing.
+ */
+static void slow_path_queue_retranslate(CPUState *cpu, uintptr_t retaddr,
+                                        target_ulong pc)
+{
+    SlowPathRetranslate *r = g_new(SlowPathRetranslate, 1);
+
+    r->retaddr = retaddr;
+    r->pc = pc;
+    async_safe_run_on_cpu(cpu, do_slow_path_retranslate,
+                          RUN_ON_CPU_HOST_PTR(r));
+}
+
+static void slow_path_profile_hit(CPUArchState *env, uintptr_t retaddr)
+{
+    SlowPathProfileEntry *e;
+    TranslationBlock *tb;
+    target_ulong pc;
+    uint32_t tag, count, clock, epoch, age;
+
+    if (likely(!tcg_slow_path_profile) || retaddr == 0) {
+        return;
+    }
+    if (retaddr == slow_path_direct_ra) {
+        slow_path_direct_missed = true;
+        return;
+    }
+    tb = tcg_tb_lookup(retaddr);
+    if (tb == NULL || !tb_insn_pc_from_host(tb, retaddr, &pc)) {
+        return;
+    }
+
+    clock = qatomic_read(&slow_path_clock) + 1;
+    qatomic_set(&slow_path_clock, clock);
+    epoch = clock >> SLOW_PATH_PROFILE_DECAY_BITS;
+
+    e = slow_path_profile_entry(pc, &tag);
+    if (qatomic_read(&e->tag) != tag) {
+        qatomic_set(&e->tag, tag);
+        qatomic_set(&e->direct_execs, 0);
+        qatomic_set(&e->direct_misses, 0);
+        count = 0;
+    } else {
+        count = qatomic_read(&e->count);
+        age = epoch - qatomic_read(&e->epoch);
+        count = age < 32 ? count >> age : 0;
+    }
+    qatomic_set(&e->epoch, epoch);
+    qatomic_set(&e->count, ++count);
+    if (count == SLOW_PATH_PROFILE_THRESHOLD) {
+        slow_path_queue_retranslate(env_cpu(env), retaddr, pc);
+    }
+}
+
+/*
+ * Account one access made by helper_qemu_ld_direct/helper_qemu_st_direct
+ * for the instruction at @pc.
+ */
+static void slow_path_direct_done(CPUArchState *env, target_ulong pc,
+                                  uintptr_t retaddr)
+{
+    SlowPathProfileEntry *e;
+    uint32_t tag;
+    unsigned execs, misses;
+
+    e = slow_path_profile_entry(pc, &tag);
+    if (qatomic_read(&e->tag) != tag) {
+        /* Another instruction took the entry; this one is translated direct */
+        qatomic_set(&e->tag, tag);
+        qatomic_set(&e->count, SLOW_PATH_PROFILE_THRESHOLD);
+        execs = misses = 0;
+    } else {
+        execs = qatomic_read(&e->direct_execs);
+        misses = qatomic_read(&e->direct_misses);
+    }
+    execs++;
+    misses += slow_path_direct_missed;
+    if (execs == SLOW_PATH_PROFILE_WINDOW) {
+        if (misses < SLOW_PATH_PROFILE_WINDOW / 2) {
+            /* Mostly TLB hits now: go back to the inline lookup */
+            qatomic_set(&e->count, 0);
+            slow_path_queue_retranslate(env_cpu(env), retaddr, pc);
+        }
+        execs = misses = 0;
+    }
+    qatomic_set(&e->direct_execs, execs);
+    qatomic_set(&e->direct_misses, misses);
+}
+
+bool tlb_slow_path_preferred(target_ulong pc)
+{
+    SlowPathProfileEntry *e;
+    uint32_t tag;
+
+    if (!tcg_slow_path_profile) {
+        return false;
+    }
+    e = slow_path_profile_entry(pc, &tag);
+    return qatomic_read(&e->tag) == tag &&
+           qatomic_read(&e->count) >= SLOW_PATH_PROFILE_THRESHOLD;
+}
+
 static uint64_t io_readx(CPUArchState *env, CPUIOTLBEntry *iotlbentry,
                          int mmu_idx, target_ulong addr, uintptr_t retaddr,
                          MMUAccessType access_type, MemOp op)
@@ -1393,6 +1972,9 @@ static uint64_t io_readx(CPUArchState *env, CPUIOTLBEntry *iotlbentry,
     if (!cpu->can_do_io) {
         cpu_io_recompile(cpu, retaddr);
     }
+    if (access_type != MMU_INST_FETCH) {
+        slow_path_profile_hit(env, retaddr);
+    }
 
     if (!qemu_mutex_iothread_locked()) {
         qemu_mutex_lock_iothread();
@@ -1448,6 +2030,7 @@ static void io_writex(CPUArchState *env, CPUIOTLBEntry *iotlbentry,
         cpu_io_recompile(cpu, retaddr);
     }
     cpu->mem_io_pc = retaddr;
+    slow_path_profile_hit(env, retaddr);
 
     /*
      * The memory_region_dispatch may trigger a flush/resize
@@ -1492,6 +2075,7 @@ static bool victim_tlb_hit(CPUArchState *env, size_t mmu_idx, size_t index,
     size_t vidx;
 
     assert_cpu_is_self(env_cpu(env));
+    tlb_stat_inc(&env_tlb(env)->d[mmu_idx], misses);
     for (vidx = 0; vidx < CPU_VTLB_SIZE; ++vidx) {
         CPUTLBEntry *vtlb = &env_tlb(env)->d[mmu_idx].vtable[vidx];
         target_ulong cmp;
@@ -1524,6 +2108,7 @@ static bool victim_tlb_hit(CPUArchState *env, size_t mmu_idx, size_t index,
             CPUIOTLBEntry tmpio, *io = &env_tlb(env)->d[mmu_idx].iotlb[index];
             CPUIOTLBEntry *vio = &env_tlb(env)->d[mmu_idx].viotlb[vidx];
             tmpio = *io; *io = *vio; *vio = tmpio;
+            tlb_stat_inc(&env_tlb(env)->d[mmu_idx], victim_hits);
             return true;
         }
     }
@@ -1668,11 +2253,14 @@ probe_access_internal(CPUArchState *env, target_ulong addr, int fault_size,
             CPUState *cs = env_cpu(env);
             CPUClass *cc = CPU_GET_CLASS(cs);
 
-            if (!cc->tcg_ops->tlb_fill(cs, addr, fault_size, access_type,
-                                       mmu_idx, nonfault, retaddr)) {
-                /* Non-faulting page table read failed.  */
-                *phost = NULL;
-                return TLB_INVALID_MASK;
+            if (!tlb_fill_large_page(cs, addr, access_type, mmu_idx)) {
+                tlb_stat_inc(&env_tlb(env)->d[mmu_idx], fills);
+                if (!cc->tcg_ops->tlb_fill(cs, addr, fault_size, access_type,
+                                           mmu_idx, nonfault, retaddr)) {
+                    /* Non-faulting page table read failed.  */
+                    *phost = NULL;
+                    return TLB_INVALID_MASK;
+                }
             }
 
             /* TLB resize via tlb_fill may have moved the entry.  */
@@ -2051,6 +2639,9 @@ load_helper(CPUArchState *env, target_ulong addr, TCGMemOpIdx oi,
         uint64_t r1, r2;
         unsigned shift;
     do_unaligned_access:
+        if (!code_read) {
+            slow_path_profile_hit(env, retaddr);
+        }
         addr1 = addr & ~((target_ulong)size - 1);
         addr2 = addr1 + size;
 #ifdef TARGET_CHERI
@@ -2230,10 +2821,15 @@ tcg_target_ulong helper_be_ldsl_mmu(CPUArchState *env, target_ulong addr,
 #define log_instr_load_int(env, addr, val, op) ((void)0)
 #endif
 
+/*
+ * With @plugin_cb false the access is not reported to plugins either; the
+ * caller reports it as part of a larger access.
+ */
 static inline uint64_t cpu_load_helper_no_log(CPUArchState *env, abi_ptr addr,
                                               int mmu_idx, uintptr_t retaddr,
                                               MemOp op,
-                                              FullLoadHelper *full_load)
+                                              FullLoadHelper *full_load,
+                                              bool plugin_cb)
 {
     uint16_t meminfo;
     TCGMemOpIdx oi;
@@ -2246,7 +2842,9 @@ static inline uint64_t cpu_load_helper_no_log(CPUArchState *env, abi_ptr addr,
     oi = make_memop_idx(op, mmu_idx);
     ret = full_load(env, addr, oi, retaddr);
 
-    qemu_plugin_vcpu_mem_cb(env_cpu(env), addr, meminfo);
+    if (plugin_cb) {
+        qemu_plugin_vcpu_mem_cb(env_cpu(env), addr, meminfo);
+    }
 
     return ret;
 }
@@ -2256,7 +2854,8 @@ static inline uint64_t cpu_load_helper(CPUArchState *env, abi_ptr addr,
                                        FullLoadHelper *full_load)
 {
     uint64_t ret =
-        cpu_load_helper_no_log(env, addr, mmu_idx, retaddr, op, full_load);
+        cpu_load_helper_no_log(env, addr, mmu_idx, retaddr, op, full_load,
+                               true);
     log_instr_load_int(env, addr, ret, op);
     return ret;
 }
@@ -2384,7 +2983,8 @@ uint64_t cpu_ldq_le_data_ra(CPUArchState *env, target_ulong ptr,
 #ifdef TARGET_CHERI
 /*
  * TODO(am2419): Ugly hack to avoid logging memory accesses that load capability
- * components as normal memory accesses. The caller is responsible for logging.
+ * components as normal memory accesses. The caller is responsible for logging
+ * and for reporting the access to plugins.
  */
 target_ulong cpu_ld_cap_word_ra(CPUArchState *env, target_ulong ptr,
                                 uintptr_t retaddr)
@@ -2402,7 +3002,7 @@ target_ulong cpu_ld_cap_word_ra(CPUArchState *env, target_ulong ptr,
 #endif
     return cpu_load_helper_no_log(
         env, ptr, cpu_mmu_index(env, false), retaddr, MO_TEQ,
-        MO_TE == MO_LE ? helper_le_ldq_mmu : helper_be_ldq_mmu);
+        MO_TE == MO_LE ? helper_le_ldq_mmu : helper_be_ldq_mmu, false);
 }
 #endif
 
@@ -2661,6 +3261,7 @@ store_helper(CPUArchState *env, target_ulong addr, uint64_t val,
         && unlikely((addr & ~TARGET_PAGE_MASK) + size - 1
                      >= TARGET_PAGE_SIZE)) {
     do_unaligned_access:
+        slow_path_profile_hit(env, retaddr);
         store_helper_unaligned(env, addr, val, retaddr, size,
                                mmu_idx, memop_big_endian(op));
         return;
@@ -2717,6 +3318,98 @@ void helper_be_stq_mmu(CPUArchState *env, target_ulong addr, uint64_t val,
  * Store Helpers for cpu_ldst.h
  */
 
+/*
+ * Loads and stores of instructions that mostly take the slow path, see
+ * slow_path_profile_hit(). These take the same paths as the out of line
+ * part of qemu_ld/qemu_st, but skip the inline TLB lookup.
+ */
+uint64_t HELPER(qemu_ld_direct)(CPUArchState *env, target_ulong addr,
+                                uint32_t oi, target_ulong pc)
+{
+    uintptr_t ra = GETPC();
+    uint64_t ret;
+
+    slow_path_direct_ra = ra;
+    slow_path_direct_missed = false;
+    switch (get_memop(oi) & (MO_BSWAP | MO_SSIZE)) {
+    case MO_UB:
+        ret = helper_ret_ldub_mmu(env, addr, oi, ra);
+        break;
+    case MO_SB:
+        ret = (tcg_target_long)helper_ret_ldsb_mmu(env, addr, oi, ra);
+        break;
+    case MO_LEUW:
+        ret = helper_le_lduw_mmu(env, addr, oi, ra);
+        break;
+    case MO_LESW:
+        ret = (tcg_target_long)helper_le_ldsw_mmu(env, addr, oi, ra);
+        break;
+    case MO_LEUL:
+        ret = helper_le_ldul_mmu(env, addr, oi, ra);
+        break;
+    case MO_LESL:
+        ret = (tcg_target_long)helper_le_ldsl_mmu(env, addr, oi, ra);
+        break;
+    case MO_LEQ:
+        ret = helper_le_ldq_mmu(env, addr, oi, ra);
+        break;
+    case MO_BEUW:
+        ret = helper_be_lduw_mmu(env, addr, oi, ra);
+        break;
+    case MO_BESW:
+        ret = (tcg_target_long)helper_be_ldsw_mmu(env, addr, oi, ra);
+        break;
+    case MO_BEUL:
+        ret = helper_be_ldul_mmu(env, addr, oi, ra);
+        break;
+    case MO_BESL:
+        ret = (tcg_target_long)helper_be_ldsl_mmu(env, addr, oi, ra);
+        break;
+    case MO_BEQ:
+        ret = helper_be_ldq_mmu(env, addr, oi, ra);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+    slow_path_direct_done(env, pc, ra);
+    return ret;
+}
+
+void HELPER(qemu_st_direct)(CPUArchState *env, target_ulong addr,
+                            uint64_t val, uint32_t oi, target_ulong pc)
+{
+    uintptr_t ra = GETPC();
+
+    slow_path_direct_ra = ra;
+    slow_path_direct_missed = false;
+    switch (get_memop(oi) & (MO_BSWAP | MO_SIZE)) {
+    case MO_8:
+        helper_ret_stb_mmu(env, addr, val, oi, ra);
+        break;
+    case MO_LEUW:
+        helper_le_stw_mmu(env, addr, val, oi, ra);
+        break;
+    case MO_LEUL:
+        helper_le_stl_mmu(env, addr, val, oi, ra);
+        break;
+    case MO_LEQ:
+        helper_le_stq_mmu(env, addr, val, oi, ra);
+        break;
+    case MO_BEUW:
+        helper_be_stw_mmu(env, addr, val, oi, ra);
+        break;
+    case MO_BEUL:
+        helper_be_stl_mmu(env, addr, val, oi, ra);
+        break;
+    case MO_BEQ:
+        helper_be_stq_mmu(env, addr, val, oi, ra);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+    slow_path_direct_done(env, pc, ra);
+}
+
 #ifdef CONFIG_TCG_LOG_INSTR
 /*
  * Log a target memory store via cpu_ldst.
@@ -2729,7 +3422,8 @@ void helper_be_stq_mmu(CPUArchState *env, target_ulong addr, uint64_t val,
 
 static inline void QEMU_ALWAYS_INLINE
 cpu_store_helper_no_log(CPUArchState *env, target_ulong addr, uint64_t val,
-                        int mmu_idx, uintptr_t retaddr, MemOp op)
+                        int mmu_idx, uintptr_t retaddr, MemOp op,
+                        bool plugin_cb)
 {
     TCGMemOpIdx oi;
     uint16_t meminfo;
@@ -2740,14 +3434,16 @@ cpu_store_helper_no_log(CPUArchState *env, target_ulong addr, uint64_t val,
     oi = make_memop_idx(op, mmu_idx);
     store_helper(env, addr, val, oi, retaddr, op);
 
-    qemu_plugin_vcpu_mem_cb(env_cpu(env), addr, meminfo);
+    if (plugin_cb) {
+        qemu_plugin_vcpu_mem_cb(env_cpu(env), addr, meminfo);
+    }
 }
 
 static inline void QEMU_ALWAYS_INLINE
 cpu_store_helper(CPUArchState *env, target_ulong addr, uint64_t val,
                  int mmu_idx, uintptr_t retaddr, MemOp op)
 {
-    cpu_store_helper_no_log(env, addr, val, mmu_idx, retaddr, op);
+    cpu_store_helper_no_log(env, addr, val, mmu_idx, retaddr, op, true);
     log_instr_store_int(env, addr, val, op);
 }
 
@@ -2838,7 +3534,8 @@ void cpu_stq_le_data_ra(CPUArchState *env, target_ulong ptr,
 #ifdef TARGET_CHERI
 /*
  * TODO(am2419): Ugly hack to avoid logging memory accesses that store capability
- * components as normal memory accesses. The caller is responsible for logging.
+ * components as normal memory accesses. The caller is responsible for logging
+ * and for reporting the access to plugins.
  */
 void cpu_st_cap_word_ra(CPUArchState *env, target_ulong ptr,
                         target_ulong val, uintptr_t retaddr)
@@ -2851,7 +3548,8 @@ void cpu_st_cap_word_ra(CPUArchState *env, target_ulong ptr,
 #else
 #error "Unhandled target long width"
 #endif
-    cpu_store_helper_no_log(env, ptr, val, cpu_mmu_index(env, false), retaddr, op);
+    cpu_store_helper_no_log(env, ptr, val, cpu_mmu_index(env, false), retaddr,
+                            op, false);
 }
 #endif
 
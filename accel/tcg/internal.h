@@ -16,5 +16,7 @@ TranslationBlock *tb_gen_code(CPUState *cpu, target_ulong pc,
                               uint32_t cheri_flags, uint32_t flags, int cflags);
 
 void QEMU_NORETURN cpu_io_recompile(CPUState *cpu, uintptr_t retaddr);
+bool tb_insn_pc_from_host(TranslationBlock *tb, uintptr_t searched_pc,
+                          target_ulong *pc);
 
 #endif /* ACCEL_TCG_INTERNAL_H */
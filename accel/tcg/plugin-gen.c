@@ -75,7 +75,9 @@ enum plugin_gen_from {
 enum plugin_gen_cb {
     PLUGIN_GEN_CB_UDATA,
     PLUGIN_GEN_CB_INLINE,
+    PLUGIN_GEN_CB_COND,
     PLUGIN_GEN_CB_MEM,
+    PLUGIN_GEN_CB_MEM_BUFFER,
     PLUGIN_GEN_ENABLE_MEM_HELPER,
     PLUGIN_GEN_DISABLE_MEM_HELPER,
     PLUGIN_GEN_N_CBS,
@@ -131,15 +133,63 @@ static void gen_empty_udata_cb(void)
  */
 static void gen_empty_inline_cb(void)
 {
+    TCGv_i32 cpu_index = tcg_temp_new_i32();
+    TCGv_ptr cpu_offset = tcg_temp_new_ptr();
     TCGv_i64 val = tcg_temp_new_i64();
     TCGv_ptr ptr = tcg_const_ptr(NULL); /* overwritten later */
 
+    /* per-vCPU ops: skipped when the value is shared by all vCPUs */
+    tcg_gen_ld_i32(cpu_index, cpu_env,
+                   -offsetof(ArchCPU, env) + offsetof(CPUState, cpu_index));
+    /* the stride is overwritten later */
+    tcg_gen_mul_i32(cpu_index, cpu_index, tcg_constant_i32(0xdeadface));
+    tcg_gen_ext_i32_ptr(cpu_offset, cpu_index);
+    tcg_gen_add_ptr(ptr, ptr, cpu_offset);
+
     tcg_gen_ld_i64(val, ptr, 0);
     /* pass an immediate != 0 so that it doesn't get optimized away */
     tcg_gen_addi_i64(val, val, 0xdeadface);
     tcg_gen_st_i64(val, ptr, 0);
     tcg_temp_free_ptr(ptr);
     tcg_temp_free_i64(val);
+    tcg_temp_free_ptr(cpu_offset);
+    tcg_temp_free_i32(cpu_index);
+}
+
+/*
+ * Branching ends the basic block, so the callback's arguments are only
+ * set up after the test.
+ */
+static void gen_empty_cond_cb(void)
+{
+    TCGv_i32 cpu_index = tcg_temp_new_i32();
+    TCGv_ptr cpu_offset = tcg_temp_new_ptr();
+    TCGv_i64 val = tcg_temp_new_i64();
+    TCGv_ptr ptr = tcg_const_ptr(NULL); /* overwritten later */
+    TCGv_ptr udata;
+    TCGLabel *skip = gen_new_label(); /* a new one is used for each copy */
+
+    tcg_gen_ld_i32(cpu_index, cpu_env,
+                   -offsetof(ArchCPU, env) + offsetof(CPUState, cpu_index));
+    /* the stride is overwritten later */
+    tcg_gen_mul_i32(cpu_index, cpu_index, tcg_constant_i32(0xdeadface));
+    tcg_gen_ext_i32_ptr(cpu_offset, cpu_index);
+    tcg_gen_add_ptr(ptr, ptr, cpu_offset);
+    tcg_gen_ld_i64(val, ptr, 0);
+    /* the condition and the immediate are overwritten later */
+    tcg_gen_brcondi_i64(TCG_COND_EQ, val, 0xdeadface, skip);
+
+    udata = tcg_const_ptr(NULL); /* overwritten later */
+    tcg_gen_ld_i32(cpu_index, cpu_env,
+                   -offsetof(ArchCPU, env) + offsetof(CPUState, cpu_index));
+    gen_helper_plugin_vcpu_udata_cb(cpu_index, udata);
+    gen_set_label(skip);
+
+    tcg_temp_free_ptr(udata);
+    tcg_temp_free_ptr(ptr);
+    tcg_temp_free_i64(val);
+    tcg_temp_free_ptr(cpu_offset);
+    tcg_temp_free_i32(cpu_index);
 }
 
 static void gen_empty_mem_cb(TCGv addr, uint32_t info)
@@ -147,6 +197,67 @@ static void gen_empty_mem_cb(TCGv addr, uint32_t info)
     do_gen_mem_cb(addr, info);
 }
 
+/*
+ * Append an event to the vCPU's ring of a memory event buffer. The ring
+ * is not tested for space: the events are delivered at the start of a
+ * block once enough of them are pending, see plugins/core.c.
+ */
+static void gen_empty_mem_buffer_cb(TCGv addr, uint32_t info)
+{
+    TCGv_i32 cpu_index = tcg_temp_new_i32();
+    TCGv_ptr cpu_offset = tcg_temp_new_ptr();
+    TCGv_i64 head = tcg_temp_new_i64();
+    TCGv_i32 slot = tcg_temp_new_i32();
+    TCGv_ptr event = tcg_temp_new_ptr();
+    TCGv_i64 vaddr64 = tcg_temp_new_i64();
+    TCGv_ptr ring = tcg_const_ptr(NULL); /* overwritten later */
+    TCGv_ptr udata;
+    TCGv_i32 meminfo;
+
+    tcg_gen_ld_i32(cpu_index, cpu_env,
+                   -offsetof(ArchCPU, env) + offsetof(CPUState, cpu_index));
+    /* the stride is overwritten later */
+    tcg_gen_mul_i32(cpu_index, cpu_index, tcg_constant_i32(0xdeadface));
+    tcg_gen_ext_i32_ptr(cpu_offset, cpu_index);
+    tcg_gen_add_ptr(ring, ring, cpu_offset);
+
+    tcg_gen_ld_i64(head, ring, offsetof(struct plugin_mem_buffer_ring, head));
+    tcg_gen_extrl_i64_i32(slot, head);
+    /* the mask is overwritten later */
+    tcg_gen_and_i32(slot, slot, tcg_constant_i32(0xdeadface));
+    /* not muli, which would turn into a shift for some event sizes */
+    tcg_gen_mul_i32(slot, slot,
+                    tcg_constant_i32(sizeof(struct qemu_plugin_mem_event)));
+    tcg_gen_ext_i32_ptr(event, slot);
+    tcg_gen_add_ptr(event, event, ring);
+
+    tcg_gen_extu_tl_i64(vaddr64, addr);
+    tcg_gen_st_i64(vaddr64, event,
+                   offsetof(struct plugin_mem_buffer_ring, events) +
+                   offsetof(struct qemu_plugin_mem_event, vaddr));
+    udata = tcg_const_ptr(NULL); /* overwritten later */
+    tcg_gen_st_ptr(udata, event,
+                   offsetof(struct plugin_mem_buffer_ring, events) +
+                   offsetof(struct qemu_plugin_mem_event, userdata));
+    meminfo = tcg_const_i32(info);
+    tcg_gen_st_i32(meminfo, event,
+                   offsetof(struct plugin_mem_buffer_ring, events) +
+                   offsetof(struct qemu_plugin_mem_event, info));
+
+    tcg_gen_addi_i64(head, head, 1);
+    tcg_gen_st_i64(head, ring, offsetof(struct plugin_mem_buffer_ring, head));
+
+    tcg_temp_free_i32(meminfo);
+    tcg_temp_free_ptr(udata);
+    tcg_temp_free_ptr(ring);
+    tcg_temp_free_i64(vaddr64);
+    tcg_temp_free_ptr(event);
+    tcg_temp_free_i32(slot);
+    tcg_temp_free_i64(head);
+    tcg_temp_free_ptr(cpu_offset);
+    tcg_temp_free_i32(cpu_index);
+}
+
 /*
  * Share the same function for enable/disable. When enabling, the NULL
  * pointer will be overwritten later.
@@ -198,6 +309,8 @@ static inline void plugin_gen_empty_callback(enum plugin_gen_from from)
     case PLUGIN_GEN_FROM_TB:
         gen_wrapped(from, PLUGIN_GEN_CB_UDATA, gen_empty_udata_cb);
         gen_wrapped(from, PLUGIN_GEN_CB_INLINE, gen_empty_inline_cb);
+        /* after the inline ops, so that tests see their updates */
+        gen_wrapped(from, PLUGIN_GEN_CB_COND, gen_empty_cond_cb);
         break;
     default:
         g_assert_not_reached();
@@ -231,6 +344,9 @@ void plugin_gen_empty_mem_callback(TCGv addr, uint32_t info)
     fn.mem_fn = gen_empty_mem_cb;
     gen_mem_wrapped(PLUGIN_GEN_CB_MEM, &fn, addr, info, true);
 
+    fn.mem_fn = gen_empty_mem_buffer_cb;
+    gen_mem_wrapped(PLUGIN_GEN_CB_MEM_BUFFER, &fn, addr, info, true);
+
     fn.inline_fn = gen_empty_inline_cb;
     gen_mem_wrapped(PLUGIN_GEN_CB_INLINE, &fn, 0, info, false);
 }
@@ -279,6 +395,12 @@ static TCGOp *copy_op(TCGOp **begin_op, TCGOp *op, TCGOpcode opc)
     return op;
 }
 
+static void skip_op(TCGOp **begin_op, TCGOpcode opc)
+{
+    *begin_op = QTAILQ_NEXT(*begin_op, link);
+    tcg_debug_assert(*begin_op && (*begin_op)->opc == opc);
+}
+
 static TCGOp *copy_extu_i32_i64(TCGOp **begin_op, TCGOp *op)
 {
     if (TCG_TARGET_REG_BITS == 32) {
@@ -320,6 +442,56 @@ static TCGOp *copy_const_ptr(TCGOp **begin_op, TCGOp *op, void *ptr)
     return op;
 }
 
+static TCGOp *copy_mul_i32(TCGOp **begin_op, TCGOp *op, uint32_t v)
+{
+    op = copy_op(begin_op, op, INDEX_op_mul_i32);
+    op->args[2] = tcgv_i32_arg(tcg_constant_i32(v));
+    return op;
+}
+
+static TCGOp *copy_and_i32(TCGOp **begin_op, TCGOp *op, uint32_t v)
+{
+    op = copy_op(begin_op, op, INDEX_op_and_i32);
+    op->args[2] = tcgv_i32_arg(tcg_constant_i32(v));
+    return op;
+}
+
+static TCGOp *copy_extrl_i64_i32(TCGOp **begin_op, TCGOp *op)
+{
+    if (TCG_TARGET_REG_BITS == 64 && TCG_TARGET_HAS_extrl_i64_i32) {
+        /* extrl_i64_i32 */
+        op = copy_op(begin_op, op, INDEX_op_extrl_i64_i32);
+    } else {
+        /* mov_i32 */
+        op = copy_op(begin_op, op, INDEX_op_mov_i32);
+    }
+    return op;
+}
+
+static TCGOp *copy_ext_i32_ptr(TCGOp **begin_op, TCGOp *op)
+{
+    if (UINTPTR_MAX == UINT32_MAX) {
+        /* mov_i32 */
+        op = copy_op(begin_op, op, INDEX_op_mov_i32);
+    } else {
+        /* ext_i32_i64 */
+        op = copy_op(begin_op, op, INDEX_op_ext_i32_i64);
+    }
+    return op;
+}
+
+static TCGOp *copy_add_ptr(TCGOp **begin_op, TCGOp *op)
+{
+    if (UINTPTR_MAX == UINT32_MAX) {
+        /* add_i32 */
+        op = copy_op(begin_op, op, INDEX_op_add_i32);
+    } else {
+        /* add_i64 */
+        op = copy_op(begin_op, op, INDEX_op_add_i64);
+    }
+    return op;
+}
+
 static TCGOp *copy_extu_tl_i64(TCGOp **begin_op, TCGOp *op)
 {
     if (TARGET_LONG_BITS == 32) {
@@ -373,6 +545,33 @@ static TCGOp *copy_add_i64(TCGOp **begin_op, TCGOp *op, uint64_t v)
     return op;
 }
 
+static TCGOp *copy_brcondi_i64(TCGOp **begin_op, TCGOp *op, TCGCond cond,
+                               uint64_t v, TCGLabel *l)
+{
+    l->refs++;
+    if (TCG_TARGET_REG_BITS == 32) {
+        op = copy_op(begin_op, op, INDEX_op_brcond2_i32);
+        op->args[2] = tcgv_i32_arg(tcg_constant_i32(v));
+        op->args[3] = tcgv_i32_arg(tcg_constant_i32(v >> 32));
+        op->args[4] = cond;
+        op->args[5] = label_arg(l);
+    } else {
+        op = copy_op(begin_op, op, INDEX_op_brcond_i64);
+        op->args[1] = tcgv_i64_arg(tcg_constant_i64(v));
+        op->args[2] = cond;
+        op->args[3] = label_arg(l);
+    }
+    return op;
+}
+
+static TCGOp *copy_set_label(TCGOp **begin_op, TCGOp *op, TCGLabel *l)
+{
+    op = copy_op(begin_op, op, INDEX_op_set_label);
+    op->args[0] = label_arg(l);
+    l->present = 1;
+    return op;
+}
+
 static TCGOp *copy_st_ptr(TCGOp **begin_op, TCGOp *op)
 {
     if (UINTPTR_MAX == UINT32_MAX) {
@@ -452,6 +651,21 @@ static TCGOp *append_inline_cb(const struct qemu_plugin_dyn_cb *cb,
     /* const_ptr */
     op = copy_const_ptr(&begin_op, op, cb->userp);
 
+    if (cb->inline_insn.stride) {
+        /* ld_i32 of cpu_index, mul_i32 by the stride, ext and add_ptr */
+        op = copy_op(&begin_op, op, INDEX_op_ld_i32);
+        op = copy_mul_i32(&begin_op, op, cb->inline_insn.stride);
+        op = copy_ext_i32_ptr(&begin_op, op);
+        op = copy_add_ptr(&begin_op, op);
+    } else {
+        skip_op(&begin_op, INDEX_op_ld_i32);
+        skip_op(&begin_op, INDEX_op_mul_i32);
+        skip_op(&begin_op, UINTPTR_MAX == UINT32_MAX ?
+                INDEX_op_mov_i32 : INDEX_op_ext_i32_i64);
+        skip_op(&begin_op, UINTPTR_MAX == UINT32_MAX ?
+                INDEX_op_add_i32 : INDEX_op_add_i64);
+    }
+
     /* ld_i64 */
     op = copy_ld_i64(&begin_op, op);
 
@@ -464,6 +678,61 @@ static TCGOp *append_inline_cb(const struct qemu_plugin_dyn_cb *cb,
     return op;
 }
 
+static TCGCond plugin_cond_to_tcg(enum qemu_plugin_cond cond)
+{
+    switch (cond) {
+    case QEMU_PLUGIN_COND_EQ:
+        return TCG_COND_EQ;
+    case QEMU_PLUGIN_COND_NE:
+        return TCG_COND_NE;
+    case QEMU_PLUGIN_COND_LT:
+        return TCG_COND_LTU;
+    case QEMU_PLUGIN_COND_LE:
+        return TCG_COND_LEU;
+    case QEMU_PLUGIN_COND_GT:
+        return TCG_COND_GTU;
+    case QEMU_PLUGIN_COND_GE:
+        return TCG_COND_GEU;
+    default:
+        /* NEVER and ALWAYS are dealt with at registration time */
+        g_assert_not_reached();
+    }
+}
+
+static TCGOp *append_cond_cb(const struct qemu_plugin_dyn_cb *cb,
+                             TCGOp *begin_op, TCGOp *op, int *cb_idx)
+{
+    TCGLabel *skip = gen_new_label();
+    TCGCond cond = tcg_invert_cond(plugin_cond_to_tcg(cb->cond.cond));
+
+    /* const_ptr */
+    op = copy_const_ptr(&begin_op, op, cb->cond.ptr);
+
+    /* ld_i32 of cpu_index, mul_i32 by the stride, ext and add_ptr */
+    op = copy_op(&begin_op, op, INDEX_op_ld_i32);
+    op = copy_mul_i32(&begin_op, op, cb->cond.stride);
+    op = copy_ext_i32_ptr(&begin_op, op);
+    op = copy_add_ptr(&begin_op, op);
+
+    /* ld_i64 */
+    op = copy_ld_i64(&begin_op, op);
+
+    /* skip the call unless the condition holds */
+    op = copy_brcondi_i64(&begin_op, op, cond, cb->cond.imm, skip);
+
+    /* const_ptr */
+    op = copy_const_ptr(&begin_op, op, cb->userp);
+
+    /* ld_i32 and call; cpu_index is not live across the branch */
+    op = copy_call(&begin_op, op, HELPER(plugin_vcpu_udata_cb),
+                   cb->f.vcpu_udata, cb->tcg_flags, cb_idx);
+
+    /* set_label */
+    op = copy_set_label(&begin_op, op, skip);
+
+    return op;
+}
+
 static TCGOp *append_mem_cb(const struct qemu_plugin_dyn_cb *cb,
                             TCGOp *begin_op, TCGOp *op, int *cb_idx)
 {
@@ -497,6 +766,47 @@ static TCGOp *append_mem_cb(const struct qemu_plugin_dyn_cb *cb,
     return op;
 }
 
+static TCGOp *append_mem_buffer_cb(const struct qemu_plugin_dyn_cb *cb,
+                                   TCGOp *begin_op, TCGOp *op, int *unused)
+{
+    /* const_ptr */
+    op = copy_const_ptr(&begin_op, op, cb->mem_buffer.ptr);
+
+    /* ld_i32 of cpu_index, mul_i32 by the stride, ext and add_ptr */
+    op = copy_op(&begin_op, op, INDEX_op_ld_i32);
+    op = copy_mul_i32(&begin_op, op, cb->mem_buffer.stride);
+    op = copy_ext_i32_ptr(&begin_op, op);
+    op = copy_add_ptr(&begin_op, op);
+
+    /* ld_i64 of the head, extrl and and_i32 by the mask */
+    op = copy_ld_i64(&begin_op, op);
+    op = copy_extrl_i64_i32(&begin_op, op);
+    op = copy_and_i32(&begin_op, op, cb->mem_buffer.mask);
+
+    /* mul_i32 by the event size, ext and add_ptr */
+    op = copy_op(&begin_op, op, INDEX_op_mul_i32);
+    op = copy_ext_i32_ptr(&begin_op, op);
+    op = copy_add_ptr(&begin_op, op);
+
+    /* extu_tl_i64 and st_i64 of the address */
+    op = copy_extu_tl_i64(&begin_op, op);
+    op = copy_st_i64(&begin_op, op);
+
+    /* const_ptr and st_ptr of the userdata */
+    op = copy_const_ptr(&begin_op, op, cb->userp);
+    op = copy_st_ptr(&begin_op, op);
+
+    /* const_i32 == mov_i32 ("info", so it remains as is) and st_i32 */
+    op = copy_op(&begin_op, op, INDEX_op_mov_i32);
+    op = copy_op(&begin_op, op, INDEX_op_st_i32);
+
+    /* add_i64 and st_i64 of the head */
+    op = copy_add_i64(&begin_op, op, 1);
+    op = copy_st_i64(&begin_op, op);
+
+    return op;
+}
+
 typedef TCGOp *(*inject_fn)(const struct qemu_plugin_dyn_cb *cb,
                             TCGOp *begin_op, TCGOp *op, int *intp);
 typedef bool (*op_ok_fn)(const TCGOp *op, const struct qemu_plugin_dyn_cb *cb);
@@ -510,6 +820,10 @@ static bool op_rw(const TCGOp *op, const struct qemu_plugin_dyn_cb *cb)
 {
     int w;
 
+    /* capability accesses are only reported from helpers */
+    if (cb->rw & QEMU_PLUGIN_MEM_CAP_ONLY) {
+        return false;
+    }
     w = op->args[2];
     return !!(cb->rw & (w + 1));
 }
@@ -556,12 +870,24 @@ inject_inline_cb(const GArray *cbs, TCGOp *begin_op, op_ok_fn ok)
     inject_cb_type(cbs, begin_op, append_inline_cb, ok);
 }
 
+static void
+inject_cond_cb(const GArray *cbs, TCGOp *begin_op)
+{
+    inject_cb_type(cbs, begin_op, append_cond_cb, op_ok);
+}
+
 static void
 inject_mem_cb(const GArray *cbs, TCGOp *begin_op)
 {
     inject_cb_type(cbs, begin_op, append_mem_cb, op_rw);
 }
 
+static void
+inject_mem_buffer_cb(const GArray *cbs, TCGOp *begin_op)
+{
+    inject_cb_type(cbs, begin_op, append_mem_buffer_cb, op_rw);
+}
+
 /* we could change the ops in place, but we can reuse more code by copying */
 static void inject_mem_helper(TCGOp *begin_op, GArray *arr)
 {
@@ -596,12 +922,13 @@ static void inject_mem_helper(TCGOp *begin_op, GArray *arr)
 static void inject_mem_enable_helper(struct qemu_plugin_insn *plugin_insn,
                                      TCGOp *begin_op)
 {
-    GArray *cbs[2];
+    GArray *cbs[3];
     GArray *arr;
     size_t n_cbs, i;
 
     cbs[0] = plugin_insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_REGULAR];
     cbs[1] = plugin_insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_INLINE];
+    cbs[2] = plugin_insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_BUFFERED];
 
     n_cbs = 0;
     for (i = 0; i < ARRAY_SIZE(cbs); i++) {
@@ -663,6 +990,12 @@ static void plugin_gen_tb_inline(const struct qemu_plugin_tb *ptb,
     inject_inline_cb(ptb->cbs[PLUGIN_CB_INLINE], begin_op, op_ok);
 }
 
+static void plugin_gen_tb_cond(const struct qemu_plugin_tb *ptb,
+                               TCGOp *begin_op)
+{
+    inject_cond_cb(ptb->cbs[PLUGIN_CB_COND], begin_op);
+}
+
 static void plugin_gen_insn_udata(const struct qemu_plugin_tb *ptb,
                                   TCGOp *begin_op, int insn_idx)
 {
@@ -679,6 +1012,14 @@ static void plugin_gen_insn_inline(const struct qemu_plugin_tb *ptb,
                      begin_op, op_ok);
 }
 
+static void plugin_gen_insn_cond(const struct qemu_plugin_tb *ptb,
+                                 TCGOp *begin_op, int insn_idx)
+{
+    struct qemu_plugin_insn *insn = g_ptr_array_index(ptb->insns, insn_idx);
+
+    inject_cond_cb(insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_COND], begin_op);
+}
+
 static void plugin_gen_mem_regular(const struct qemu_plugin_tb *ptb,
                                    TCGOp *begin_op, int insn_idx)
 {
@@ -696,6 +1037,15 @@ static void plugin_gen_mem_inline(const struct qemu_plugin_tb *ptb,
     inject_inline_cb(cbs, begin_op, op_rw);
 }
 
+static void plugin_gen_mem_buffered(const struct qemu_plugin_tb *ptb,
+                                    TCGOp *begin_op, int insn_idx)
+{
+    struct qemu_plugin_insn *insn = g_ptr_array_index(ptb->insns, insn_idx);
+
+    inject_mem_buffer_cb(insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_BUFFERED],
+                         begin_op);
+}
+
 static void plugin_gen_enable_mem_helper(const struct qemu_plugin_tb *ptb,
                                          TCGOp *begin_op, int insn_idx)
 {
@@ -725,6 +1075,9 @@ static void plugin_inject_cb(const struct qemu_plugin_tb *ptb, TCGOp *begin_op,
         case PLUGIN_GEN_CB_INLINE:
             plugin_gen_tb_inline(ptb, begin_op);
             return;
+        case PLUGIN_GEN_CB_COND:
+            plugin_gen_tb_cond(ptb, begin_op);
+            return;
         default:
             g_assert_not_reached();
         }
@@ -736,6 +1089,9 @@ static void plugin_inject_cb(const struct qemu_plugin_tb *ptb, TCGOp *begin_op,
         case PLUGIN_GEN_CB_INLINE:
             plugin_gen_insn_inline(ptb, begin_op, insn_idx);
             return;
+        case PLUGIN_GEN_CB_COND:
+            plugin_gen_insn_cond(ptb, begin_op, insn_idx);
+            return;
         case PLUGIN_GEN_ENABLE_MEM_HELPER:
             plugin_gen_enable_mem_helper(ptb, begin_op, insn_idx);
             return;
@@ -747,6 +1103,9 @@ static void plugin_inject_cb(const struct qemu_plugin_tb *ptb, TCGOp *begin_op,
         case PLUGIN_GEN_CB_MEM:
             plugin_gen_mem_regular(ptb, begin_op, insn_idx);
             return;
+        case PLUGIN_GEN_CB_MEM_BUFFER:
+            plugin_gen_mem_buffered(ptb, begin_op, insn_idx);
+            return;
         case PLUGIN_GEN_CB_INLINE:
             plugin_gen_mem_inline(ptb, begin_op, insn_idx);
             return;
@@ -801,9 +1160,15 @@ static void pr_ops(void)
             case PLUGIN_GEN_CB_INLINE:
                 type = "inline";
                 break;
+            case PLUGIN_GEN_CB_COND:
+                type = "cond";
+                break;
             case PLUGIN_GEN_CB_MEM:
                 type = "mem";
                 break;
+            case PLUGIN_GEN_CB_MEM_BUFFER:
+                type = "mem buffer";
+                break;
             case PLUGIN_GEN_ENABLE_MEM_HELPER:
                 type = "enable mem helper";
                 break;
@@ -32,6 +32,8 @@
 #include "qemu/error-report.h"
 #include "qemu/accel.h"
 #include "qapi/qapi-builtin-visit.h"
+#include "hw/core/cpu.h"
+#include "exec/exec-all.h"
 
 struct TCGState {
     AccelState parent_obj;
@@ -39,6 +41,9 @@ struct TCGState {
     bool mttcg_enabled;
     int splitwx_enabled;
     unsigned long tb_size;
+    uint32_t jmp_cache_bits;
+    bool slow_path_profile;
+    uint32_t tlb_resize_window;
 };
 typedef struct TCGState TCGState;
 
@@ -100,6 +105,10 @@ static void tcg_accel_instance_init(Object *obj)
     s->splitwx_enabled = -1;
 #else
     s->splitwx_enabled = 0;
+#endif
+    s->jmp_cache_bits = TB_JMP_CACHE_BITS_DEFAULT;
+#ifndef CONFIG_USER_ONLY
+    s->tlb_resize_window = TLB_RESIZE_WINDOW_MS_DEFAULT;
 #endif
 }
 
@@ -111,6 +120,11 @@ static int tcg_init(MachineState *ms)
 
     tcg_exec_init(s->tb_size * 1024 * 1024, s->splitwx_enabled);
     mttcg_enabled = s->mttcg_enabled;
+    tb_jmp_cache_bits = s->jmp_cache_bits;
+#ifndef CONFIG_USER_ONLY
+    tcg_slow_path_profile = s->slow_path_profile;
+    tlb_resize_window_ms = s->tlb_resize_window;
+#endif
 
     /*
      * Initialize TCG regions only for softmmu.
@@ -184,6 +198,77 @@ static void tcg_set_tb_size(Object *obj, Visitor *v,
     s->tb_size = value;
 }
 
+static void tcg_get_jmp_cache_bits(Object *obj, Visitor *v,
+                                   const char *name, void *opaque,
+                                   Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value = s->jmp_cache_bits;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_jmp_cache_bits(Object *obj, Visitor *v,
+                                   const char *name, void *opaque,
+                                   Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+    if (value < TB_JMP_CACHE_BITS_MIN || value > TB_JMP_CACHE_BITS_MAX) {
+        error_setg(errp, "jmp-cache-bits must be between %d and %d",
+                   TB_JMP_CACHE_BITS_MIN, TB_JMP_CACHE_BITS_MAX);
+        return;
+    }
+
+    s->jmp_cache_bits = value;
+}
+
+#ifndef CONFIG_USER_ONLY
+static bool tcg_get_slow_path_profile(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    return s->slow_path_profile;
+}
+
+static void tcg_set_slow_path_profile(Object *obj, bool value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    s->slow_path_profile = value;
+}
+
+static void tcg_get_tlb_resize_window(Object *obj, Visitor *v,
+                                      const char *name, void *opaque,
+                                      Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value = s->tlb_resize_window;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_tlb_resize_window(Object *obj, Visitor *v,
+                                      const char *name, void *opaque,
+                                      Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+    if (value == 0) {
+        error_setg(errp, "tlb-resize-window must be at least 1 ms");
+        return;
+    }
+
+    s->tlb_resize_window = value;
+}
+#endif
+
 static bool tcg_get_splitwx(Object *obj, Error **errp)
 {
     TCGState *s = TCG_STATE(obj);
@@ -213,10 +298,31 @@ static void tcg_accel_class_init(ObjectClass *oc, void *data)
     object_class_property_set_description(oc, "tb-size",
         "TCG translation block cache size");
 
+    object_class_property_add(oc, "jmp-cache-bits", "int",
+        tcg_get_jmp_cache_bits, tcg_set_jmp_cache_bits,
+        NULL, NULL);
+    object_class_property_set_description(oc, "jmp-cache-bits",
+        "log2 of the number of sets in each vCPU's TB jump cache");
+
     object_class_property_add_bool(oc, "split-wx",
         tcg_get_splitwx, tcg_set_splitwx);
     object_class_property_set_description(oc, "split-wx",
         "Map jit pages into separate RW and RX regions");
+
+#ifndef CONFIG_USER_ONLY
+    object_class_property_add_bool(oc, "slow-path-profile",
+        tcg_get_slow_path_profile, tcg_set_slow_path_profile);
+    object_class_property_set_description(oc, "slow-path-profile",
+        "Call the softmmu helpers directly for loads and stores "
+        "that mostly miss the inline TLB lookup");
+
+    object_class_property_add(oc, "tlb-resize-window", "int",
+        tcg_get_tlb_resize_window, tcg_set_tlb_resize_window,
+        NULL, NULL);
+    object_class_property_set_description(oc, "tlb-resize-window",
+        "Time window (in ms) over which the use rate of the TLB is "
+        "sampled before it is shrunk");
+#endif
 }
 
 static const TypeInfo tcg_accel_type = {
@@ -150,7 +150,7 @@ uint64_t HELPER(ctpop_i64)(uint64_t arg)
     return ctpop64(arg);
 }
 
-const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
+static TranslationBlock *lookup_tb(CPUArchState *env)
 {
     CPUState *cpu = env_cpu(env);
     TranslationBlock *tb;
@@ -162,13 +162,37 @@ const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
 
     tb = tb_lookup(cpu, pc, cs_base, cs_top, cheri_flags, flags, curr_cflags(cpu));
     if (tb == NULL) {
-        return tcg_code_gen_epilogue;
+        return NULL;
     }
     qemu_log_mask_and_addr(CPU_LOG_EXEC, pc,
                            "Chain %d: %p [" TARGET_FMT_lx "/" TARGET_FMT_lx
                            "/" TARGET_FMT_lx "/%#x/%#x] %s\n",
                            cpu->cpu_index, tb->tc.ptr, cs_base, pc, cs_top,
                            cheri_flags, flags, lookup_symbol(pc));
+    return tb;
+}
+
+const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
+{
+    TranslationBlock *tb = lookup_tb(env);
+
+    return tb ? tb->tc.ptr : tcg_code_gen_epilogue;
+}
+
+/* Slow path of tcg_gen_lookup_and_goto_ptr_pred() */
+const void *HELPER(lookup_tb_ptr_pred)(CPUArchState *env, uint32_t idx,
+                                       uint64_t site, uint64_t aux)
+{
+    TranslationBlock *tb = lookup_tb(env);
+    CPUIBTCEntry *entry;
+
+    if (tb == NULL) {
+        return tcg_code_gen_epilogue;
+    }
+    entry = &env_cpu(env)->tb_ibtc[idx & (TB_IBTC_SIZE - 1)];
+    entry->site = site;
+    entry->aux = aux;
+    entry->tb = tb;
     return tb->tc.ptr;
 }
 
@@ -25,6 +25,7 @@ DEF_HELPER_FLAGS_1(ctpop_i32, TCG_CALL_NO_RWG_SE, i32, i32)
 DEF_HELPER_FLAGS_1(ctpop_i64, TCG_CALL_NO_RWG_SE, i64, i64)
 
 DEF_HELPER_FLAGS_1(lookup_tb_ptr, TCG_CALL_NO_WG_SE, cptr, env)
+DEF_HELPER_FLAGS_4(lookup_tb_ptr_pred, TCG_CALL_NO_WG_SE, cptr, env, i32, i64, i64)
 
 DEF_HELPER_FLAGS_1(exit_atomic, TCG_CALL_NO_WG, noreturn, env)
 
@@ -41,6 +42,9 @@ DEF_HELPER_FLAGS_3(memset, TCG_CALL_NO_RWG, ptr, ptr, int, ptr)
 
 #ifdef CONFIG_SOFTMMU
 
+DEF_HELPER_FLAGS_4(qemu_ld_direct, TCG_CALL_NO_WG, i64, env, tl, i32, tl)
+DEF_HELPER_FLAGS_5(qemu_st_direct, TCG_CALL_NO_WG, void, env, tl, i64, i32, tl)
+
 DEF_HELPER_FLAGS_5(atomic_cmpxchgb, TCG_CALL_NO_WG,
                    i32, env, tl, i32, i32, i32)
 DEF_HELPER_FLAGS_5(atomic_cmpxchgw_be, TCG_CALL_NO_WG,
@@ -169,6 +173,12 @@ DEF_HELPER_3(cheri_invalidate_tags, void, env, cap_checked_ptr, memop_idx)
 /* Clear tags due to a store, last argument is whether the store succeeded. */
 DEF_HELPER_4(cheri_invalidate_tags_condition, void, env, cap_checked_ptr,
              memop_idx, i32)
+/*
+ * Stores in a CF_PARALLEL TB: lock the capability granule(s) before the store
+ * and clear the tags (if the last argument is non-zero) and unlock after it.
+ */
+DEF_HELPER_3(cheri_store_begin, void, env, cap_checked_ptr, memop_idx)
+DEF_HELPER_4(cheri_store_end, void, env, cap_checked_ptr, memop_idx, i32)
 
 #endif
 
@@ -55,6 +55,7 @@
 #include "qemu/qemu-print.h"
 #include "qemu/timer.h"
 #include "qemu/main-loop.h"
+#include "qemu/rcu.h"
 #include "exec/log.h"
 #include "sysemu/cpus.h"
 #include "sysemu/cpu-timers.h"
@@ -115,13 +116,25 @@ typedef struct PageDesc {
     unsigned int code_write_count;
 #else
     unsigned long flags;
-    void *target_data;
+    struct PageTargetData *target_data;
 #endif
 #ifndef CONFIG_USER_ONLY
     QemuSpin lock;
 #endif
 } PageDesc;
 
+#ifdef CONFIG_USER_ONLY
+/*
+ * Out-of-band data of a guest page, see page_alloc_target_data(). vCPU
+ * threads access it without the mmap_lock, so it is only freed after an
+ * RCU grace period once the page is unmapped.
+ */
+typedef struct PageTargetData {
+    struct rcu_head rcu;
+    uint64_t data[];
+} PageTargetData;
+#endif
+
 /**
  * struct page_entry - page descriptor entry
  * @pd:     pointer to the &struct PageDesc of the page this entry represents
@@ -335,22 +348,20 @@ static int encode_search(TranslationBlock *tb, uint8_t *block)
     return p - block;
 }
 
-/* The cpu state corresponding to 'searched_pc' is restored.
- * When reset_icount is true, current TB will be interrupted and
- * icount should be recalculated.
+/*
+ * Reconstruct the insn_start data of the instruction in @tb that the host
+ * code at @searched_pc belongs to into @data.  Return the index of that
+ * instruction, or -1 if @searched_pc is not within @tb.
  */
-static int cpu_restore_state_from_tb(CPUState *cpu, TranslationBlock *tb,
-                                     uintptr_t searched_pc, bool reset_icount)
+static int cpu_unwind_data_from_tb(TranslationBlock *tb, uintptr_t searched_pc,
+                                   target_ulong *data)
 {
-    target_ulong data[TARGET_INSN_START_WORDS] = { tb->pc };
     uintptr_t host_pc = (uintptr_t)tb->tc.ptr;
-    CPUArchState *env = cpu->env_ptr;
     const uint8_t *p = tb->tc.ptr + tb->tc.size;
     int i, j, num_insns = tb->icount;
-#ifdef CONFIG_PROFILER
-    TCGProfile *prof = &tcg_ctx->prof;
-    int64_t ti = profile_getclock();
-#endif
+
+    memset(data, 0, sizeof(target_ulong) * TARGET_INSN_START_WORDS);
+    data[0] = tb->pc;
 
     searched_pc -= GETPC_ADJ;
 
@@ -366,17 +377,37 @@ static int cpu_restore_state_from_tb(CPUState *cpu, TranslationBlock *tb,
         }
         host_pc += decode_sleb128(&p);
         if (host_pc > searched_pc) {
-            goto found;
+            return i;
         }
     }
     return -1;
+}
+
+/* The cpu state corresponding to 'searched_pc' is restored.
+ * When reset_icount is true, current TB will be interrupted and
+ * icount should be recalculated.
+ */
+static int cpu_restore_state_from_tb(CPUState *cpu, TranslationBlock *tb,
+                                     uintptr_t searched_pc, bool reset_icount)
+{
+    target_ulong data[TARGET_INSN_START_WORDS];
+    CPUArchState *env = cpu->env_ptr;
+    int insn;
+#ifdef CONFIG_PROFILER
+    TCGProfile *prof = &tcg_ctx->prof;
+    int64_t ti = profile_getclock();
+#endif
+
+    insn = cpu_unwind_data_from_tb(tb, searched_pc, data);
+    if (insn < 0) {
+        return -1;
+    }
 
- found:
     if (reset_icount && (tb_cflags(tb) & CF_USE_ICOUNT)) {
         assert(icount_enabled());
         /* Reset the cycle counter to the start of the block
            and shift if to the number of actually executed instructions */
-        cpu_neg(cpu)->icount_decr.u16.low += num_insns - i;
+        cpu_neg(cpu)->icount_decr.u16.low += tb->icount - insn;
     }
     restore_state_to_opc(env, tb, data);
 
@@ -388,6 +419,22 @@ static int cpu_restore_state_from_tb(CPUState *cpu, TranslationBlock *tb,
     return 0;
 }
 
+/*
+ * Find the guest pc of the instruction in @tb that the host code at
+ * @searched_pc belongs to, without restoring any CPU state.
+ */
+bool tb_insn_pc_from_host(TranslationBlock *tb, uintptr_t searched_pc,
+                          target_ulong *pc)
+{
+    target_ulong data[TARGET_INSN_START_WORDS];
+
+    if (cpu_unwind_data_from_tb(tb, searched_pc, data) < 0) {
+        return false;
+    }
+    *pc = data[0];
+    return true;
+}
+
 void tb_destroy(TranslationBlock *tb)
 {
     qemu_spin_destroy(&tb->jmp_lock);
@@ -1459,6 +1506,68 @@ void tb_flush(CPUState *cpu)
     }
 }
 
+static gboolean tb_evict_iter(gpointer key, gpointer value, gpointer data)
+{
+    TranslationBlock *tb = value;
+
+    tb_phys_invalidate(tb, -1);
+    return false;
+}
+
+/*
+ * Make room in a full code buffer. Only the oldest regions are reclaimed
+ * (see tcg_region_evict()); we fall back to a full flush if that is not
+ * possible, e.g. because there is only one region.
+ */
+static void do_tb_reclaim(CPUState *cpu, run_on_cpu_data tb_flush_count)
+{
+    CPUState *other;
+    int evicted;
+
+    mmap_lock();
+    /* A full flush requested by another CPU has already made room */
+    if (tb_ctx.tb_flush_count != tb_flush_count.host_int) {
+        mmap_unlock();
+        return;
+    }
+    qemu_thread_jit_write();
+    evicted = tcg_region_evict(tb_evict_iter, NULL);
+    qemu_thread_jit_execute();
+    if (evicted > 0) {
+        /*
+         * A TB that was already invalid when it was evicted may still be in
+         * a jump cache (tb_lookup() can race with its invalidation), and its
+         * memory is about to be reused.
+         */
+        CPU_FOREACH(other) {
+            cpu_tb_jmp_cache_clear(other);
+        }
+        qatomic_set(&tb_ctx.tb_evict_count, tb_ctx.tb_evict_count + 1);
+        qatomic_set(&tb_ctx.tb_evict_regions,
+                    tb_ctx.tb_evict_regions + evicted);
+    }
+    mmap_unlock();
+
+    if (evicted < 0) {
+        do_tb_flush(cpu, tb_flush_count);
+    } else if (evicted > 0) {
+        /* The evicted TBs' memory is about to be reused */
+        qemu_plugin_flush_cb();
+    }
+}
+
+static void tb_reclaim(CPUState *cpu)
+{
+    unsigned tb_flush_count = qatomic_mb_read(&tb_ctx.tb_flush_count);
+
+    if (cpu_in_exclusive_context(cpu)) {
+        do_tb_reclaim(cpu, RUN_ON_CPU_HOST_INT(tb_flush_count));
+    } else {
+        async_safe_run_on_cpu(cpu, do_tb_reclaim,
+                              RUN_ON_CPU_HOST_INT(tb_flush_count));
+    }
+}
+
 /*
  * Formerly ifdef DEBUG_TB_CHECK. These debug functions are user-mode-only,
  * so in order to prevent bit rot we compile them unconditionally in user-mode,
@@ -1628,7 +1737,8 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
 
     /* remove the TB from the hash list */
     phys_pc = tb->page_addr[0] + (tb->pc & ~TARGET_PAGE_MASK);
-    h = tb_hash_func(phys_pc, tb->pc, tb->flags, orig_cflags,
+    h = tb_hash_func(phys_pc, tb->pc, tb->cs_base, tb->cs_top,
+                     tb->cheri_flags, tb->flags, orig_cflags,
                      tb->trace_vcpu_dstate);
     if (!qht_remove(&tb_ctx.htable, tb, h)) {
         return;
@@ -1647,10 +1757,12 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
     }
 
     /* remove the TB from the hash list */
-    h = tb_jmp_cache_hash_func(tb->pc);
+    h = tb_jmp_cache_hash_func(tb->pc, tb->cs_base, tb->cs_top);
     CPU_FOREACH(cpu) {
-        if (qatomic_read(&cpu->tb_jmp_cache[h]) == tb) {
-            qatomic_set(&cpu->tb_jmp_cache[h], NULL);
+        for (int way = 0; way < TB_JMP_CACHE_WAYS; way++) {
+            if (qatomic_read(&cpu->tb_jmp_cache[h].tb[way]) == tb) {
+                qatomic_set(&cpu->tb_jmp_cache[h].tb[way], NULL);
+            }
         }
     }
 
@@ -1814,7 +1926,8 @@ tb_link_page(TranslationBlock *tb, tb_page_addr_t phys_pc,
     }
 
     /* add in the hash table */
-    h = tb_hash_func(phys_pc, tb->pc, tb->flags, tb->cflags,
+    h = tb_hash_func(phys_pc, tb->pc, tb->cs_base, tb->cs_top,
+                     tb->cheri_flags, tb->flags, tb->cflags,
                      tb->trace_vcpu_dstate);
     qht_insert(&tb_ctx.htable, tb, h, &existing_tb);
 
@@ -1842,6 +1955,211 @@ tb_link_page(TranslationBlock *tb, tb_page_addr_t phys_pc,
     return tb;
 }
 
+#ifdef CONFIG_USER_ONLY
+/*
+ * Speculative translation workers.
+ *
+ * A burst of new code, e.g. right after exec or dlopen, stalls the vCPU on
+ * every TB that it has not seen before. With "-tb-workers N", each TB that a
+ * vCPU translates queues a request to translate the code that follows it,
+ * which worker threads service while the vCPU runs. Their TBs are linked in
+ * like any other, so the vCPU finds them in the hash table if it gets there.
+ *
+ * Workers never touch a running vCPU: translation reads (and the translator
+ * may write) CPUState and env, so each request carries a private snapshot of
+ * the CPU, taken on the thread that queued it, and the worker translates with
+ * that. Snapshots are unrealized instances of the vCPU's type, filled in by
+ * the target's snapshot_for_translation hook; targets without one run
+ * without workers. Workers serialize with the vCPUs on mmap_lock, and only
+ * read code from pages that are mapped readable and executable: a fault
+ * while translating can only be handled on a vCPU thread.
+ */
+#define TB_SPEC_QUEUE_SIZE 64
+/* How many TBs ahead of the vCPU the workers translate */
+#define TB_SPEC_DEPTH 4
+
+typedef struct TBSpecRequest {
+    CPUState *snap;
+    target_ulong pc;
+    target_ulong cs_base;
+    target_ulong cs_top;
+    uint32_t cheri_flags;
+    uint32_t flags;
+    uint32_t cflags;
+    int depth;
+} TBSpecRequest;
+
+static struct {
+    QemuMutex lock;
+    QemuCond cond;
+    TBSpecRequest queue[TB_SPEC_QUEUE_SIZE];
+    unsigned int head;
+    unsigned int count;
+    bool enabled;
+} tb_spec;
+
+static __thread bool tb_spec_worker;
+
+static CPUState *tb_spec_snapshot_new(CPUState *cpu)
+{
+    return CPU(object_new(object_get_typename(OBJECT(cpu))));
+}
+
+/*
+ * Copy what translation uses from @cpu into @snap: the CPUState fields that
+ * the translator and tb_gen_code() read, and whatever the target's hook
+ * copies. Must run on the thread that owns @cpu, or on a worker for a
+ * snapshot that it owns.
+ */
+static void tb_spec_snapshot(CPUState *snap, CPUState *cpu)
+{
+    snap->cpu_index = cpu->cpu_index;
+    snap->singlestep_enabled = cpu->singlestep_enabled;
+    bitmap_copy(snap->trace_dstate, cpu->trace_dstate,
+                CPU_TRACE_DSTATE_MAX_EVENTS);
+    bitmap_copy(snap->plugin_mask, cpu->plugin_mask, QEMU_PLUGIN_EV_MAX);
+    CPU_GET_CLASS(cpu)->tcg_ops->snapshot_for_translation(snap, cpu);
+}
+
+/* Called with mmap_lock held */
+static void tb_spec_request(CPUState *cpu, const TranslationBlock *tb,
+                            int depth)
+{
+    if (!qatomic_read(&tb_spec.enabled) || depth == 0 ||
+        cpu->singlestep_enabled || singlestep ||
+        (tb_cflags(tb) & (CF_COUNT_MASK | CF_LAST_IO | CF_LOG_INSTR))) {
+        return;
+    }
+    /* Breakpoint checks are translated in, and the snapshot has none */
+    if (!QTAILQ_EMPTY(&cpu->breakpoints)) {
+        return;
+    }
+#ifdef CONFIG_PLUGIN
+    /* Plugins expect translation callbacks from the vCPU thread */
+    if (test_bit(QEMU_PLUGIN_EV_VCPU_TB_TRANS, cpu->plugin_mask)) {
+        return;
+    }
+#endif
+
+    qemu_mutex_lock(&tb_spec.lock);
+    /* Drop the request if the workers are behind */
+    if (tb_spec.count < TB_SPEC_QUEUE_SIZE) {
+        TBSpecRequest *req = &tb_spec.queue[(tb_spec.head + tb_spec.count) %
+                                            TB_SPEC_QUEUE_SIZE];
+
+        tb_spec_snapshot(req->snap, cpu);
+        req->pc = tb->pc + tb->size;
+        req->cs_base = tb->cs_base;
+        req->cs_top = tb->cs_top;
+        req->cheri_flags = tb->cheri_flags;
+        req->flags = tb->flags;
+        req->cflags = tb_cflags(tb);
+        req->depth = depth;
+        tb_spec.count++;
+        qemu_cond_signal(&tb_spec.cond);
+    }
+    qemu_mutex_unlock(&tb_spec.lock);
+}
+
+static void tb_spec_translate(const TBSpecRequest *req)
+{
+    target_ulong page = req->pc & TARGET_PAGE_MASK;
+    CPUState *cpu = req->snap;
+    TranslationBlock *tb;
+
+    mmap_lock();
+    /* An instruction may straddle the end of the page */
+    if ((page_get_flags(page) & PAGE_EXEC) &&
+        page_check_range(page, 2 * TARGET_PAGE_SIZE, PAGE_READ) == 0 &&
+        !tb_htable_lookup(cpu, req->pc, req->cs_base, req->cs_top,
+                          req->cheri_flags, req->flags, req->cflags)) {
+        tb = tb_gen_code(cpu, req->pc, req->cs_base, req->cs_top,
+                         req->cheri_flags, req->flags, req->cflags);
+        /* tb_gen_code() left this thread with JIT code writable */
+        qemu_thread_jit_execute();
+        if (tb) {
+            tb_spec_request(cpu, tb, req->depth - 1);
+        }
+    }
+    mmap_unlock();
+}
+
+static void *tb_spec_thread(void *arg)
+{
+    CPUState *snap = arg;
+    TBSpecRequest req;
+
+    rcu_register_thread();
+    tcg_register_thread();
+    tb_spec_worker = true;
+
+    for (;;) {
+        qemu_mutex_lock(&tb_spec.lock);
+        while (tb_spec.count == 0) {
+            qemu_cond_wait(&tb_spec.cond, &tb_spec.lock);
+        }
+        /* Take the request's snapshot and leave ours for the next one */
+        req = tb_spec.queue[tb_spec.head];
+        tb_spec.queue[tb_spec.head].snap = snap;
+        snap = req.snap;
+        tb_spec.head = (tb_spec.head + 1) % TB_SPEC_QUEUE_SIZE;
+        tb_spec.count--;
+        qemu_mutex_unlock(&tb_spec.lock);
+
+        tb_spec_translate(&req);
+    }
+    return NULL;
+}
+
+void tb_spec_init(CPUState *cpu, unsigned int n_workers)
+{
+    QemuThread thread;
+    unsigned int i;
+
+    if (n_workers == 0) {
+        return;
+    }
+    if (!CPU_GET_CLASS(cpu)->tcg_ops->snapshot_for_translation) {
+        warn_report("-tb-workers is not supported for this target, ignoring");
+        return;
+    }
+    qemu_mutex_init(&tb_spec.lock);
+    qemu_cond_init(&tb_spec.cond);
+    for (i = 0; i < TB_SPEC_QUEUE_SIZE; i++) {
+        tb_spec.queue[i].snap = tb_spec_snapshot_new(cpu);
+    }
+    /* Each worker owns one snapshot more than the queue holds */
+    for (i = 0; i < n_workers; i++) {
+        qemu_thread_create(&thread, "tb-spec", tb_spec_thread,
+                           tb_spec_snapshot_new(cpu), QEMU_THREAD_DETACHED);
+    }
+    qatomic_set(&tb_spec.enabled, true);
+}
+
+void tb_spec_fork_start(void)
+{
+    if (tb_spec.enabled) {
+        qemu_mutex_lock(&tb_spec.lock);
+    }
+}
+
+void tb_spec_fork_end(int child)
+{
+    if (!tb_spec.enabled) {
+        return;
+    }
+    if (child) {
+        /* The workers did not survive the fork */
+        qemu_mutex_init(&tb_spec.lock);
+        qemu_cond_init(&tb_spec.cond);
+        tb_spec.count = 0;
+        tb_spec.enabled = false;
+    } else {
+        qemu_mutex_unlock(&tb_spec.lock);
+    }
+}
+#endif /* CONFIG_USER_ONLY */
+
 /* Called with mmap_lock held for user mode emulation.  */
 TranslationBlock *tb_gen_code(CPUState *cpu, target_ulong pc,
                               target_ulong cs_base, target_ulong cs_top,
@@ -1882,8 +2200,15 @@ TranslationBlock *tb_gen_code(CPUState *cpu, target_ulong pc,
  buffer_overflow:
     tb = tcg_tb_alloc(tcg_ctx);
     if (unlikely(!tb)) {
-        /* flush must be done */
-        tb_flush(cpu);
+#ifdef CONFIG_USER_ONLY
+        /* Leave it to the vCPU to make room */
+        if (tb_spec_worker) {
+            qemu_thread_jit_execute();
+            return NULL;
+        }
+#endif
+        /* evict old code or flush */
+        tb_reclaim(cpu);
         mmap_unlock();
         /* Make the execution loop process the flush as soon as possible.  */
         cpu->exception_index = EXCP_INTERRUPT;
@@ -2109,6 +2434,11 @@ TranslationBlock *tb_gen_code(CPUState *cpu, target_ulong pc,
         return existing_tb;
     }
     tcg_tb_insert(tb);
+#ifdef CONFIG_USER_ONLY
+    if (!tb_spec_worker) {
+        tb_spec_request(cpu, tb, TB_SPEC_DEPTH);
+    }
+#endif
     return tb;
 }
 
@@ -2532,6 +2862,7 @@ void dump_exec_info(void)
     struct tb_tree_stats tst = {};
     struct qht_stats hst;
     size_t nb_tbs, flush_full, flush_part, flush_elide;
+    CPUState *cpu;
 
     tcg_tb_foreach(tb_tree_stats_iter, &tst);
     nb_tbs = tst.nb_tbs;
@@ -2566,9 +2897,19 @@ void dump_exec_info(void)
     qemu_printf("\nStatistics:\n");
     qemu_printf("TB flush count      %u\n",
                 qatomic_read(&tb_ctx.tb_flush_count));
+    qemu_printf("TB flushes avoided  %u (%zu regions evicted)\n",
+                qatomic_read(&tb_ctx.tb_evict_count),
+                qatomic_read(&tb_ctx.tb_evict_regions));
     qemu_printf("TB invalidate count %zu\n",
                 tcg_tb_phys_invalidate_count());
 
+    CPU_FOREACH(cpu) {
+        qemu_printf("CPU %-3d jump cache  %zu hits, %zu misses, %zu flushes\n",
+                    cpu->cpu_index, qatomic_read(&cpu->tb_jmp_cache_hits),
+                    qatomic_read(&cpu->tb_jmp_cache_misses),
+                    qatomic_read(&cpu->tb_jmp_cache_flushes));
+    }
+
     tlb_flush_counts(&flush_full, &flush_part, &flush_elide);
     qemu_printf("TLB full flushes    %zu\n", flush_full);
     qemu_printf("TLB partial flushes %zu\n", flush_part);
@@ -2752,8 +3093,11 @@ void page_set_flags(target_ulong start, target_ulong end, int flags)
             tb_invalidate_phys_page(addr, 0);
         }
         if (reset_target_data) {
-            g_free(p->target_data);
-            p->target_data = NULL;
+            PageTargetData *old = qatomic_xchg(&p->target_data, NULL);
+
+            if (old) {
+                g_free_rcu(old, rcu);
+            }
             p->flags = flags;
         } else {
             /* Using mprotect on a page does not change MAP_ANON. */
@@ -2765,21 +3109,34 @@ void page_set_flags(target_ulong start, target_ulong end, int flags)
 void *page_get_target_data(target_ulong address)
 {
     PageDesc *p = page_find(address >> TARGET_PAGE_BITS);
-    return p ? p->target_data : NULL;
+    PageTargetData *td = p ? qatomic_rcu_read(&p->target_data) : NULL;
+
+    return td ? td->data : NULL;
 }
 
 void *page_alloc_target_data(target_ulong address, size_t size)
 {
     PageDesc *p = page_find(address >> TARGET_PAGE_BITS);
-    void *ret = NULL;
+    PageTargetData *td, *new;
 
-    if (p->flags & PAGE_VALID) {
-        ret = p->target_data;
-        if (!ret) {
-            p->target_data = ret = g_malloc0(size);
+    if (!p || !(p->flags & PAGE_VALID)) {
+        return NULL;
+    }
+    td = qatomic_rcu_read(&p->target_data);
+    if (!td) {
+        /*
+         * Other vCPU threads can allocate for the same page without holding
+         * the mmap_lock; publish with cmpxchg and drop the losing allocation.
+         */
+        new = g_malloc0(sizeof(PageTargetData) + size);
+        td = qatomic_cmpxchg(&p->target_data, NULL, new);
+        if (td) {
+            g_free(new);
+        } else {
+            td = new;
         }
     }
-    return ret;
+    return td->data;
 }
 
 int page_check_range(target_ulong start, target_ulong len, int flags)
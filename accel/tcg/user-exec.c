@@ -201,9 +201,15 @@ probe_access_internal(CPUArchState *env, target_ulong addr, int fault_size,
 
     switch (access_type) {
     case MMU_DATA_STORE:
+#ifdef TARGET_CHERI
+    case MMU_DATA_CAP_STORE:
+#endif
         flags = PAGE_WRITE;
         break;
     case MMU_DATA_LOAD:
+#ifdef TARGET_CHERI
+    case MMU_DATA_CAP_LOAD:
+#endif
         flags = PAGE_READ;
         break;
     case MMU_INST_FETCH:
@@ -1169,6 +1175,40 @@ void cpu_stq_le_data_ra(CPUArchState *env, abi_ptr ptr,
     clear_helper_retaddr();
 }
 
+#ifdef TARGET_CHERI
+/*
+ * Capability words in target endianness, without tracing: as in the softmmu
+ * versions, the caller is responsible for logging and for reporting the
+ * access to plugins.
+ */
+target_ulong cpu_ld_cap_word_ra(CPUArchState *env, target_ulong ptr,
+                                uintptr_t retaddr)
+{
+    target_ulong ret;
+
+    set_helper_retaddr(retaddr);
+#if TARGET_LONG_BITS == 32
+    ret = ldl_p(g2h(env_cpu(env), ptr));
+#else
+    ret = ldq_p(g2h(env_cpu(env), ptr));
+#endif
+    clear_helper_retaddr();
+    return ret;
+}
+
+void cpu_st_cap_word_ra(CPUArchState *env, target_ulong ptr,
+                        target_ulong val, uintptr_t retaddr)
+{
+    set_helper_retaddr(retaddr);
+#if TARGET_LONG_BITS == 32
+    stl_p(g2h(env_cpu(env), ptr), val);
+#else
+    stq_p(g2h(env_cpu(env), ptr), val);
+#endif
+    clear_helper_retaddr();
+}
+#endif
+
 uint32_t cpu_ldub_code(CPUArchState *env, abi_ptr ptr)
 {
     uint32_t ret;
@@ -0,0 +1,144 @@
+/*
+ * Cap Stat - count CHERI capability loads and stores, capability
+ * register writes and capability exceptions.
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ */
+#include <inttypes.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <glib.h>
+
+#include <qemu-plugin.h>
+
+QEMU_PLUGIN_EXPORT int qemu_plugin_version = QEMU_PLUGIN_VERSION;
+
+#define MAX_CAUSES 64
+
+static uint64_t cap_loads, cap_stores;
+static uint64_t tagged_loads, tagged_stores;
+static uint64_t reg_writes, tagged_reg_writes;
+static uint64_t exceptions[MAX_CAUSES];
+static bool do_inline;
+static bool track_regs;
+
+static void plugin_exit(qemu_plugin_id_t id, void *p)
+{
+    g_autoptr(GString) report = g_string_new("");
+    int i;
+
+    g_string_append_printf(report, "cap loads:  %" PRIu64, cap_loads);
+    if (!do_inline) {
+        g_string_append_printf(report, " (%" PRIu64 " tagged)", tagged_loads);
+    }
+    g_string_append_printf(report, "\ncap stores: %" PRIu64, cap_stores);
+    if (!do_inline) {
+        g_string_append_printf(report, " (%" PRIu64 " tagged)",
+                               tagged_stores);
+    }
+    g_string_append_c(report, '\n');
+    if (track_regs) {
+        g_string_append_printf(report, "capreg writes: %" PRIu64
+                               " (%" PRIu64 " tagged)\n",
+                               reg_writes, tagged_reg_writes);
+    }
+    for (i = 0; i < MAX_CAUSES; i++) {
+        if (exceptions[i]) {
+            g_string_append_printf(report, "exceptions, cause 0x%02x: %"
+                                   PRIu64 "\n", i, exceptions[i]);
+        }
+    }
+    qemu_plugin_outs(report->str);
+}
+
+static void vcpu_cap_access(unsigned int cpu_index, qemu_plugin_meminfo_t info,
+                            uint64_t vaddr, void *udata)
+{
+    struct qemu_plugin_cap cap;
+
+    if (!qemu_plugin_mem_get_cap(info, &cap)) {
+        return;
+    }
+    if (qemu_plugin_mem_is_store(info)) {
+        __atomic_add_fetch(&cap_stores, 1, __ATOMIC_RELAXED);
+        if (cap.tag) {
+            __atomic_add_fetch(&tagged_stores, 1, __ATOMIC_RELAXED);
+        }
+    } else {
+        __atomic_add_fetch(&cap_loads, 1, __ATOMIC_RELAXED);
+        if (cap.tag) {
+            __atomic_add_fetch(&tagged_loads, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static void vcpu_cap_reg_write(qemu_plugin_id_t id, unsigned int cpu_index,
+                               unsigned int regnum,
+                               const struct qemu_plugin_cap *cap)
+{
+    __atomic_add_fetch(&reg_writes, 1, __ATOMIC_RELAXED);
+    if (cap->tag) {
+        __atomic_add_fetch(&tagged_reg_writes, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void vcpu_cheri_exception(qemu_plugin_id_t id, unsigned int cpu_index,
+                                 unsigned int cause, unsigned int regnum,
+                                 uint64_t vaddr)
+{
+    __atomic_add_fetch(&exceptions[cause % MAX_CAUSES], 1, __ATOMIC_RELAXED);
+}
+
+static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
+{
+    size_t n = qemu_plugin_tb_n_insns(tb);
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        struct qemu_plugin_insn *insn = qemu_plugin_tb_get_insn(tb, i);
+
+        if (do_inline) {
+            qemu_plugin_register_vcpu_mem_inline(insn, QEMU_PLUGIN_MEM_CAP_R,
+                                                 QEMU_PLUGIN_INLINE_ADD_U64,
+                                                 &cap_loads, 1);
+            qemu_plugin_register_vcpu_mem_inline(insn, QEMU_PLUGIN_MEM_CAP_W,
+                                                 QEMU_PLUGIN_INLINE_ADD_U64,
+                                                 &cap_stores, 1);
+        } else {
+            qemu_plugin_register_vcpu_mem_cb(insn, vcpu_cap_access,
+                                             QEMU_PLUGIN_CB_NO_REGS,
+                                             QEMU_PLUGIN_MEM_CAP_RW, NULL);
+        }
+    }
+}
+
+QEMU_PLUGIN_EXPORT int qemu_plugin_install(qemu_plugin_id_t id,
+                                           const qemu_info_t *info,
+                                           int argc, char **argv)
+{
+    int i;
+
+    for (i = 0; i < argc; i++) {
+        char *opt = argv[i];
+        if (g_strcmp0(opt, "inline") == 0) {
+            do_inline = true;
+        } else if (g_strcmp0(opt, "regs") == 0) {
+            track_regs = true;
+        } else {
+            fprintf(stderr, "option parsing failed: %s\n", opt);
+            return -1;
+        }
+    }
+
+    qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
+    if (track_regs) {
+        qemu_plugin_register_vcpu_cap_reg_write_cb(id, vcpu_cap_reg_write);
+    }
+    qemu_plugin_register_vcpu_cheri_exception_cb(id, vcpu_cheri_exception);
+    qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
+    return 0;
+}
@@ -18,6 +18,9 @@
 QEMU_PLUGIN_EXPORT int qemu_plugin_version = QEMU_PLUGIN_VERSION;
 
 static bool do_inline;
+/* with sampling, only call back once every sample_period blocks */
+static uint64_t sample_period;
+static struct qemu_plugin_scoreboard *since_sample;
 
 /* Plugins need to take care of their own locking */
 static GMutex lock;
@@ -31,10 +34,15 @@ static guint64 limit = 20;
  * get the starting PC for each block. We cheat this slightly by
  * xor'ing the number of instructions to the hash to help
  * differentiate.
+ *
+ * Executions are counted per vCPU so that neither the inline ops nor
+ * the callbacks need to synchronise; exec_total is only computed at
+ * exit.
  */
 typedef struct {
     uint64_t start_addr;
-    uint64_t exec_count;
+    struct qemu_plugin_scoreboard *exec_count;
+    uint64_t exec_total;
     int      trans_count;
     unsigned long insns;
 } ExecCount;
@@ -43,7 +51,7 @@ static gint cmp_exec_count(gconstpointer a, gconstpointer b)
 {
     ExecCount *ea = (ExecCount *) a;
     ExecCount *eb = (ExecCount *) b;
-    return ea->exec_count > eb->exec_count ? -1 : 1;
+    return ea->exec_total > eb->exec_total ? -1 : 1;
 }
 
 static void plugin_exit(qemu_plugin_id_t id, void *p)
@@ -56,6 +64,15 @@ static void plugin_exit(qemu_plugin_id_t id, void *p)
     g_string_append_printf(report, "%d entries in the hash table\n",
                            g_hash_table_size(hotblocks));
     counts = g_hash_table_get_values(hotblocks);
+    for (it = counts; it; it = it->next) {
+        ExecCount *rec = (ExecCount *) it->data;
+        rec->exec_total =
+            qemu_plugin_u64_sum(qemu_plugin_scoreboard_u64(rec->exec_count));
+        if (sample_period) {
+            /* estimate from the number of samples */
+            rec->exec_total *= sample_period;
+        }
+    }
     it = g_list_sort(counts, cmp_exec_count);
 
     if (it) {
@@ -65,7 +82,7 @@ static void plugin_exit(qemu_plugin_id_t id, void *p)
             ExecCount *rec = (ExecCount *) it->data;
             g_string_append_printf(report, "0x%016"PRIx64", %d, %ld, %"PRId64"\n",
                                    rec->start_addr, rec->trans_count,
-                                   rec->insns, rec->exec_count);
+                                   rec->insns, rec->exec_total);
         }
 
         g_list_free(it);
@@ -82,21 +99,25 @@ static void plugin_init(void)
 
 static void vcpu_tb_exec(unsigned int cpu_index, void *udata)
 {
-    ExecCount *cnt;
-    uint64_t hash = (uint64_t) udata;
+    ExecCount *cnt = (ExecCount *) udata;
 
-    g_mutex_lock(&lock);
-    cnt = (ExecCount *) g_hash_table_lookup(hotblocks, (gconstpointer) hash);
-    /* should always succeed */
-    g_assert(cnt);
-    cnt->exec_count++;
-    g_mutex_unlock(&lock);
+    qemu_plugin_u64_add(qemu_plugin_scoreboard_u64(cnt->exec_count),
+                        cpu_index, 1);
+}
+
+static void vcpu_tb_sample(unsigned int cpu_index, void *udata)
+{
+    vcpu_tb_exec(cpu_index, udata);
+    qemu_plugin_u64_set(qemu_plugin_scoreboard_u64(since_sample),
+                        cpu_index, 0);
 }
 
 /*
  * When do_inline we ask the plugin to increment the counter for us.
- * Otherwise a helper is inserted which calls the vcpu_tb_exec
- * callback.
+ * When sampling, an inline op counts the blocks executed since the last
+ * sample and vcpu_tb_sample is only called once the count reaches
+ * sample_period. Otherwise a helper is inserted which calls the
+ * vcpu_tb_exec callback.
  */
 static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
 {
@@ -114,18 +135,28 @@ static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
         cnt->start_addr = pc;
         cnt->trans_count = 1;
         cnt->insns = insns;
+        cnt->exec_count = qemu_plugin_scoreboard_new(sizeof(uint64_t));
         g_hash_table_insert(hotblocks, (gpointer) hash, (gpointer) cnt);
     }
 
     g_mutex_unlock(&lock);
 
-    if (do_inline) {
-        qemu_plugin_register_vcpu_tb_exec_inline(tb, QEMU_PLUGIN_INLINE_ADD_U64,
-                                                 &cnt->exec_count, 1);
+    if (sample_period) {
+        qemu_plugin_u64 since = qemu_plugin_scoreboard_u64(since_sample);
+
+        qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+            tb, QEMU_PLUGIN_INLINE_ADD_U64, since, 1);
+        qemu_plugin_register_vcpu_tb_exec_cond_cb(
+            tb, vcpu_tb_sample, QEMU_PLUGIN_CB_NO_REGS, QEMU_PLUGIN_COND_GE,
+            since, sample_period, (void *)cnt);
+    } else if (do_inline) {
+        qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+            tb, QEMU_PLUGIN_INLINE_ADD_U64,
+            qemu_plugin_scoreboard_u64(cnt->exec_count), 1);
     } else {
         qemu_plugin_register_vcpu_tb_exec_cb(tb, vcpu_tb_exec,
                                              QEMU_PLUGIN_CB_NO_REGS,
-                                             (void *)hash);
+                                             (void *)cnt);
     }
 }
 
@@ -133,11 +164,24 @@ QEMU_PLUGIN_EXPORT
 int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
                         int argc, char **argv)
 {
-    if (argc && strcmp(argv[0], "inline") == 0) {
-        do_inline = true;
+    int i;
+
+    for (i = 0; i < argc; i++) {
+        char *opt = argv[i];
+        if (g_strcmp0(opt, "inline") == 0) {
+            do_inline = true;
+        } else if (g_str_has_prefix(opt, "sample=")) {
+            sample_period = g_ascii_strtoull(opt + 7, NULL, 10);
+        } else {
+            fprintf(stderr, "option parsing failed: %s\n", opt);
+            return -1;
+        }
     }
 
     plugin_init();
+    if (sample_period) {
+        since_sample = qemu_plugin_scoreboard_new(sizeof(uint64_t));
+    }
 
     qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
     qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
@@ -0,0 +1,8 @@
+# XXX: Keyval does not support includes so we use a custom key as a workaround
+INCLUDE_WORKAROUND=riscv64-linux-user.mak
+#
+# CHERI-specific settings:
+#
+# Same as riscv64-linux-user.mak but with the extra riscv-64bit-cheri.xml
+TARGET_XML_FILES= gdb-xml/riscv-64bit-cpu.xml gdb-xml/riscv-32bit-fpu.xml gdb-xml/riscv-64bit-fpu.xml gdb-xml/riscv-64bit-virtual.xml gdb-xml/riscv-64bit-cheri.xml
+TARGET_CHERI=y
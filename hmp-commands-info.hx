@@ -298,6 +298,21 @@ SRST
     Show dynamic compiler opcode counters
 ERST
 
+#if defined(CONFIG_TCG)
+    {
+        .name       = "tlb-stats",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show software TLB statistics",
+        .cmd        = hmp_info_tlb_stats,
+    },
+#endif
+
+SRST
+  ``info tlb-stats``
+    Show software TLB statistics of each vCPU and MMU index.
+ERST
+
     {
         .name       = "sync-profile",
         .args_type  = "mean:-m,no_coalesce:-n,max:i?",
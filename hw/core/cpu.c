@@ -342,6 +342,8 @@ static void cpu_common_unrealizefn(DeviceState *dev)
     cpu_exec_unrealizefn(cpu);
 }
 
+unsigned int tb_jmp_cache_bits = TB_JMP_CACHE_BITS_DEFAULT;
+
 static void cpu_common_initfn(Object *obj)
 {
     CPUState *cpu = CPU(obj);
@@ -306,7 +306,10 @@ int page_check_range(target_ulong start, target_ulong len, int flags);
  * no new memory will be allocated.
  *
  * The memory will be freed when the guest page is deallocated,
- * e.g. with the munmap system call.
+ * e.g. with the munmap system call.  Other threads may do that at any
+ * time, so the caller must be in an RCU read-side critical section for
+ * as long as it uses the returned pointer; it is freed after a grace
+ * period.
  */
 void *page_alloc_target_data(target_ulong address, size_t size);
 
@@ -315,7 +318,8 @@ void *page_alloc_target_data(target_ulong address, size_t size);
  * @address: guest virtual address
  *
  * Return any out-of-bound memory assocated with the guest page
- * at @address, as per page_alloc_target_data.
+ * at @address, as per page_alloc_target_data.  The same RCU rules
+ * apply to the returned pointer.
  */
 void *page_get_target_data(target_ulong address);
 #endif
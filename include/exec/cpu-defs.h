@@ -78,6 +78,12 @@ typedef uint64_t target_ulong;
 
 /* use a fully associative victim tlb of 8 entries */
 #define CPU_VTLB_SIZE 8
+/* and a fully associative tlb of 8 entries for pages larger than 4K */
+#define CPU_LTLB_SIZE 8
+/* keep the tlbs of up to 4 inactive ASIDs, see tlb_set_asid() */
+#define CPU_TLB_ASID_SLOTS 4
+/* but don't keep tlbs larger than this */
+#define CPU_TLB_ASID_MAX_BITS 14
 
 #if HOST_LONG_BITS == 32 && TARGET_LONG_BITS == 32
 #define CPU_TLB_ENTRY_BITS 4
@@ -186,6 +192,47 @@ typedef struct CPUIOTLBEntry {
     })
 #define IOTLB_GET_TAGMEM_FLAGS(iotlbentry, rw)                                 \
     ((uintptr_t)iotlbentry->tagmem_##rw & TLBENTRYCAP_MASK);
+/*
+ * A translation for a page larger than TARGET_PAGE_SIZE, as passed to
+ * tlb_set_page_with_attrs(). Used to refill CPUTLBEntries for the other
+ * TARGET_PAGE_SIZE pages of the large page without calling tlb_fill.
+ */
+typedef struct CPUTLBLargeEntry {
+    /* Virtual and physical base of the large page, -1 if unused */
+    target_ulong vaddr;
+    hwaddr paddr;
+    target_ulong size;
+    MemTxAttrs attrs;
+    int prot;
+} CPUTLBLargeEntry;
+
+/*
+ * Per MMU mode statistics, reported by query-tlb-stats. These are only
+ * written by the vCPU owning the TLB, and are read and written atomically
+ * so that the monitor can print a snapshot at any time.
+ */
+typedef struct CPUTLBStats {
+    /* Lookups that missed the direct mapped table */
+    size_t misses;
+    /* ... and then hit the victim tlb */
+    size_t victim_hits;
+    /* ... or were refilled from a large page translation */
+    size_t large_page_hits;
+    /* ... or had to call the target's tlb_fill */
+    size_t fills;
+    /* Full flushes requested by the target or by tlb_flush */
+    size_t flushes;
+    /* Full flushes forced by a page flush within a large page */
+    size_t large_page_flushes;
+    /* Full flushes forced by a page flush with too few address bits */
+    size_t range_flushes;
+    /* Single page flushes */
+    size_t page_flushes;
+    /* Times the table was resized by tlb_mmu_resize_locked */
+    size_t grows;
+    size_t shrinks;
+} CPUTLBStats;
+
 /*
  * Data elements that are per MMU mode, minus the bits accessed by
  * the TCG fast path.
@@ -209,8 +256,16 @@ typedef struct CPUTLBDesc {
     /* The tlb victim table, in two parts.  */
     CPUTLBEntry vtable[CPU_VTLB_SIZE];
     CPUIOTLBEntry viotlb[CPU_VTLB_SIZE];
+    /* The next index to use in the large page table.  */
+    size_t lindex;
+    /*
+     * Translations of the large pages within large_page_addr/mask, so
+     * flushing any of them flushes the whole table.
+     */
+    CPUTLBLargeEntry ltable[CPU_LTLB_SIZE];
     /* The iotlb.  */
     CPUIOTLBEntry *iotlb;
+    CPUTLBStats stats;
 } CPUTLBDesc;
 
 /*
@@ -224,6 +279,25 @@ typedef struct CPUTLBDescFast {
     CPUTLBEntry *table;
 } CPUTLBDescFast QEMU_ALIGNED(2 * sizeof(void *));
 
+/*
+ * The tlb of one MMU mode while its ASID is not the current one.
+ * table is NULL if none was kept.
+ */
+typedef struct CPUTLBSavedTable {
+    CPUTLBEntry *table;
+    CPUIOTLBEntry *iotlb;
+    uintptr_t mask;
+    size_t n_used_entries;
+    target_ulong large_page_addr;
+    target_ulong large_page_mask;
+} CPUTLBSavedTable;
+
+typedef struct CPUTLBASIDSlot {
+    uint32_t asid;
+    bool valid;
+    CPUTLBSavedTable t[NB_MMU_MODES];
+} CPUTLBASIDSlot;
+
 /*
  * Data elements that are shared between all MMU modes.
  */
@@ -244,6 +318,15 @@ typedef struct CPUTLBCommon {
     size_t full_flush_count;
     size_t part_flush_count;
     size_t elide_flush_count;
+    /* The current address space, see tlb_set_asid(). */
+    uint32_t asid;
+    /* The next slot to reuse in asid_slots.  */
+    unsigned int asid_next;
+    /*
+     * The tlbs of recently used inactive ASIDs. Protected by tlb_c.lock,
+     * since tlb_reset_dirty() updates them from other threads.
+     */
+    CPUTLBASIDSlot asid_slots[CPU_TLB_ASID_SLOTS];
 } CPUTLBCommon;
 
 /*
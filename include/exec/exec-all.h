@@ -262,6 +262,50 @@ void tlb_flush_page_bits_by_mmuidx_all_cpus(CPUState *cpu, target_ulong addr,
 void tlb_flush_page_bits_by_mmuidx_all_cpus_synced
     (CPUState *cpu, target_ulong addr, uint16_t idxmap, unsigned bits);
 
+/**
+ * tlb_set_asid:
+ * @cpu: CPU whose TLB should be switched
+ * @asid: address space identifier of the new translations
+ *
+ * Switch all MMU indexes of @cpu to the address space @asid. Instead of
+ * being flushed, the TLB of the previous ASID is kept, and is reused when
+ * switching back to it, until an ASID-scoped flush of that ASID or any
+ * other TLB flush. Must be called from @cpu's own thread.
+ */
+void tlb_set_asid(CPUState *cpu, uint32_t asid);
+/**
+ * tlb_reset_asid:
+ * @cpu: CPU whose TLB should be reset
+ * @asid: the current address space identifier of @cpu
+ *
+ * Flush all of @cpu's TLB, including what was kept for inactive ASIDs,
+ * and record @asid as the current ASID. For use while @cpu is stopped,
+ * when its ASID was changed behind the TLB's back, e.g. by loading a
+ * snapshot.
+ */
+void tlb_reset_asid(CPUState *cpu, uint32_t asid);
+/**
+ * tlb_flush_asid:
+ * @cpu: CPU whose TLB should be flushed
+ * @asid: address space identifier to flush
+ *
+ * Flush all translations of @asid from @cpu's TLB. This flushes the
+ * current TLB only if @asid is the current ASID, and otherwise just drops
+ * the TLB kept for @asid. Must be called from @cpu's own thread.
+ */
+void tlb_flush_asid(CPUState *cpu, uint32_t asid);
+/**
+ * tlb_flush_page_asid:
+ * @cpu: CPU whose TLB should be flushed
+ * @addr: virtual address of page to be flushed
+ * @asid: address space identifier to flush
+ *
+ * Like tlb_flush_asid(), but only the page at @addr needs to be flushed.
+ * This is exact for the current ASID; the TLBs of other ASIDs are dropped
+ * entirely.
+ */
+void tlb_flush_page_asid(CPUState *cpu, target_ulong addr, uint32_t asid);
+
 /**
  * tlb_set_page_with_attrs:
  * @cpu: CPU to add this TLB entry for
@@ -296,6 +340,20 @@ void tlb_set_page_with_attrs(CPUState *cpu, target_ulong vaddr,
 void tlb_set_page(CPUState *cpu, target_ulong vaddr,
                   hwaddr paddr, int prot,
                   int mmu_idx, target_ulong size);
+
+#define TLB_RESIZE_WINDOW_MS_DEFAULT 100
+extern uint32_t tlb_resize_window_ms;
+
+extern bool tcg_slow_path_profile;
+/**
+ * tlb_slow_path_preferred:
+ * @pc: guest virtual address of a load or store instruction
+ *
+ * Return true if the loads and stores of the instruction at @pc have
+ * mostly missed the inline TLB lookup so far, in which case the
+ * translator should call the softmmu helpers for them directly.
+ */
+bool tlb_slow_path_preferred(target_ulong pc);
 #else
 static inline void tlb_init(CPUState *cpu)
 {
@@ -365,6 +423,19 @@ tlb_flush_page_bits_by_mmuidx_all_cpus_synced(CPUState *cpu, target_ulong addr,
                                               uint16_t idxmap, unsigned bits)
 {
 }
+static inline void tlb_set_asid(CPUState *cpu, uint32_t asid)
+{
+}
+static inline void tlb_reset_asid(CPUState *cpu, uint32_t asid)
+{
+}
+static inline void tlb_flush_asid(CPUState *cpu, uint32_t asid)
+{
+}
+static inline void tlb_flush_page_asid(CPUState *cpu, target_ulong addr,
+                                       uint32_t asid)
+{
+}
 #endif
 /**
  * probe_access:
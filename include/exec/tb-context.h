@@ -34,6 +34,8 @@ struct TBContext {
 
     /* statistics */
     unsigned tb_flush_count;
+    unsigned tb_evict_count;    /* overflows handled without a full flush */
+    size_t tb_evict_regions;    /* regions reclaimed by those */
 };
 
 extern TBContext tb_ctx;
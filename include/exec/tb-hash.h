@@ -24,6 +24,24 @@
 #include "exec/exec-all.h"
 #include "qemu/xxhash.h"
 
+#ifdef TARGET_CHERI
+/*
+ * Returns @bits bits derived from the PCC bounds of a TB. The same pc is
+ * commonly executed with different PCC bounds (e.g. by several compartments),
+ * which needs separate TBs, so spread those over the jump cache as well.
+ */
+static inline unsigned int tb_jmp_cache_hash_bounds(target_ulong cs_base,
+                                                    target_ulong cs_top,
+                                                    unsigned int bits)
+{
+    uint64_t x = (uint64_t)cs_base ^ ((uint64_t)cs_top << 1);
+
+    return (x * 0x9e3779b97f4a7c15ull) >> (64 - bits);
+}
+#else
+#define tb_jmp_cache_hash_bounds(cs_base, cs_top, bits) 0
+#endif
+
 #ifdef CONFIG_SOFTMMU
 
 /* Only the bottom TB_JMP_PAGE_BITS of the jump cache hash bits vary for
@@ -41,10 +59,17 @@ static inline unsigned int tb_jmp_cache_hash_page(target_ulong pc)
     return (tmp >> (TARGET_PAGE_BITS - TB_JMP_PAGE_BITS)) & TB_JMP_PAGE_MASK;
 }
 
-static inline unsigned int tb_jmp_cache_hash_func(target_ulong pc)
+/*
+ * The PCC bounds are only mixed into the bits that vary within a page so
+ * that tb_jmp_cache_hash_page() still finds all entries for a page.
+ */
+static inline unsigned int tb_jmp_cache_hash_func(target_ulong pc,
+                                                  target_ulong cs_base,
+                                                  target_ulong cs_top)
 {
     target_ulong tmp;
     tmp = pc ^ (pc >> (TARGET_PAGE_BITS - TB_JMP_PAGE_BITS));
+    tmp ^= tb_jmp_cache_hash_bounds(cs_base, cs_top, TB_JMP_PAGE_BITS);
     return (((tmp >> (TARGET_PAGE_BITS - TB_JMP_PAGE_BITS)) & TB_JMP_PAGE_MASK)
            | (tmp & TB_JMP_ADDR_MASK));
 }
@@ -52,18 +77,30 @@ static inline unsigned int tb_jmp_cache_hash_func(target_ulong pc)
 #else
 
 /* In user-mode we can get better hashing because we do not have a TLB */
-static inline unsigned int tb_jmp_cache_hash_func(target_ulong pc)
+static inline unsigned int tb_jmp_cache_hash_func(target_ulong pc,
+                                                  target_ulong cs_base,
+                                                  target_ulong cs_top)
 {
-    return (pc ^ (pc >> TB_JMP_CACHE_BITS)) & (TB_JMP_CACHE_SIZE - 1);
+    return (pc ^ (pc >> TB_JMP_CACHE_BITS) ^
+            tb_jmp_cache_hash_bounds(cs_base, cs_top, TB_JMP_CACHE_BITS)) &
+           (TB_JMP_CACHE_SIZE - 1);
 }
 
 #endif /* CONFIG_SOFTMMU */
 
 static inline
-uint32_t tb_hash_func(tb_page_addr_t phys_pc, target_ulong pc, uint32_t flags,
-                      uint32_t cf_mask, uint32_t trace_vcpu_dstate)
+uint32_t tb_hash_func(tb_page_addr_t phys_pc, target_ulong pc,
+                      target_ulong cs_base, target_ulong cs_top,
+                      uint32_t cheri_flags, uint32_t flags, uint32_t cf_mask,
+                      uint32_t trace_vcpu_dstate)
 {
+#ifdef TARGET_CHERI
+    /* Hash the complete key compared by tb_lookup_cmp() */
+    return qemu_xxhash12(phys_pc, pc, cs_base, cs_top, cheri_flags, flags,
+                         cf_mask, trace_vcpu_dstate);
+#else
     return qemu_xxhash7(phys_pc, pc, flags, cf_mask, trace_vcpu_dstate);
+#endif
 }
 
 #endif
@@ -16,6 +16,18 @@
 #include "exec/exec-all.h"
 #include "exec/tb-hash.h"
 
+/* Insert @tb as the most recently used entry of @set */
+static inline void tb_jmp_cache_insert(CPUJumpCacheSet *set,
+                                       TranslationBlock *tb)
+{
+    int way;
+
+    for (way = TB_JMP_CACHE_WAYS - 1; way > 0; way--) {
+        qatomic_set(&set->tb[way], qatomic_read(&set->tb[way - 1]));
+    }
+    qatomic_set(&set->tb[0], tb);
+}
+
 /* Might cause an exception, so have a longjmp destination ready */
 static inline TranslationBlock *tb_lookup(CPUState *cpu, target_ulong pc,
                                           target_ulong cs_base,
@@ -23,31 +35,44 @@ static inline TranslationBlock *tb_lookup(CPUState *cpu, target_ulong pc,
                                           uint32_t cheri_flags,
                                           uint32_t flags, uint32_t cflags)
 {
+    CPUJumpCacheSet *set;
     TranslationBlock *tb;
     uint32_t hash;
+    int way;
 
     /* we should never be trying to look up an INVALID tb */
     tcg_debug_assert(!(cflags & CF_INVALID));
 
-    hash = tb_jmp_cache_hash_func(pc);
-    tb = qatomic_rcu_read(&cpu->tb_jmp_cache[hash]);
-
-    if (likely(tb &&
-               tb->pc == pc &&
-               tb->cs_base == cs_base &&
-               tb->cs_top == cs_top &&
-               tb->cheri_flags == cheri_flags &&
-               tb->flags == flags &&
-               tb->trace_vcpu_dstate == *cpu->trace_dstate &&
-               tb_cflags(tb) == cflags)) {
-        return tb;
+    hash = tb_jmp_cache_hash_func(pc, cs_base, cs_top);
+    set = &cpu->tb_jmp_cache[hash];
+
+    for (way = 0; way < TB_JMP_CACHE_WAYS; way++) {
+        tb = qatomic_rcu_read(&set->tb[way]);
+        if (likely(tb &&
+                   tb->pc == pc &&
+                   tb->cs_base == cs_base &&
+                   tb->cs_top == cs_top &&
+                   tb->cheri_flags == cheri_flags &&
+                   tb->flags == flags &&
+                   tb->trace_vcpu_dstate == *cpu->trace_dstate &&
+                   tb_cflags(tb) == cflags)) {
+            if (way != 0) {
+                /* Swap with the MRU entry so that we evict the other one */
+                qatomic_set(&set->tb[way], qatomic_read(&set->tb[0]));
+                qatomic_set(&set->tb[0], tb);
+            }
+            qatomic_set(&cpu->tb_jmp_cache_hits, cpu->tb_jmp_cache_hits + 1);
+            return tb;
+        }
     }
+    qatomic_set(&cpu->tb_jmp_cache_misses, cpu->tb_jmp_cache_misses + 1);
+
     tb = tb_htable_lookup(cpu, pc, cs_base, cs_top, cheri_flags, flags, cflags);
 
     if (tb == NULL) {
         return NULL;
     }
-    qatomic_set(&cpu->tb_jmp_cache[hash], tb);
+    tb_jmp_cache_insert(set, tb);
     return tb;
 }
 
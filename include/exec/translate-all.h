@@ -34,6 +34,9 @@ void tb_check_watchpoint(CPUState *cpu, uintptr_t retaddr);
 
 #ifdef CONFIG_USER_ONLY
 int page_unprotect(target_ulong address, uintptr_t pc);
+void tb_spec_init(CPUState *cpu, unsigned int n_workers);
+void tb_spec_fork_start(void);
+void tb_spec_fork_end(int child);
 #endif
 
 #endif /* TRANSLATE_ALL_H */
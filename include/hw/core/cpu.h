@@ -138,6 +138,17 @@ struct AccelCPUClass;
  * @disas_set_info: Setup architecture specific components of disassembly info
  * @adjust_watchpoint_address: Perform a target-specific adjustment to an
  * address before attempting to match it against watchpoints.
+ * @plugin_reg_lookup: Resolve a register name for plugins to a register
+ * number >= 0, setting *is_cap for capability registers. Returns -1 for
+ * unknown names.
+ * @plugin_reg_read: Read the integer value of a register looked up with
+ * @plugin_reg_lookup. Returns false if it cannot be read.
+ * @plugin_reg_write: Write the integer value of a register looked up with
+ * @plugin_reg_lookup. Returns false if it cannot be written; registers that
+ * affect translation or privilege must not be writable, as callbacks run
+ * in the middle of a TB.
+ * @plugin_cap_reg_read: Read a capability register looked up with
+ * @plugin_reg_lookup, without decompressing it.
  * @deprecation_note: If this CPUClass is deprecated, this field provides
  *                    related information.
  *
@@ -187,6 +198,12 @@ struct CPUClass {
 
     void (*disas_set_info)(CPUState *cpu, disassemble_info *info);
 
+    int (*plugin_reg_lookup)(CPUState *cpu, const char *name, bool *is_cap);
+    bool (*plugin_reg_read)(CPUState *cpu, int reg, uint64_t *val);
+    bool (*plugin_reg_write)(CPUState *cpu, int reg, uint64_t val);
+    bool (*plugin_cap_reg_read)(CPUState *cpu, int reg,
+                                struct qemu_plugin_cap *cap);
+
     const char *deprecation_note;
     /* Keep non-pointer data at the end to minimize holes.  */
     int gdb_num_core_regs;
@@ -249,8 +266,38 @@ struct kvm_run;
 
 struct hax_vcpu_state;
 
-#define TB_JMP_CACHE_BITS 12
-#define TB_JMP_CACHE_SIZE (1 << TB_JMP_CACHE_BITS)
+/*
+ * The jump cache is set associative with TB_JMP_CACHE_SIZE sets of
+ * TB_JMP_CACHE_WAYS entries each. The number of sets can be changed with
+ * "-accel tcg,jmp-cache-bits=N" before any CPU is created.
+ */
+extern unsigned int tb_jmp_cache_bits;
+#define TB_JMP_CACHE_BITS_DEFAULT 12
+#define TB_JMP_CACHE_BITS_MIN 8
+#define TB_JMP_CACHE_BITS_MAX 16
+#define TB_JMP_CACHE_BITS tb_jmp_cache_bits
+#define TB_JMP_CACHE_SIZE (1u << TB_JMP_CACHE_BITS)
+#define TB_JMP_CACHE_WAYS 2
+
+/* Entries are kept in most recently used order */
+typedef struct CPUJumpCacheSet {
+    TranslationBlock *tb[TB_JMP_CACHE_WAYS];
+} CPUJumpCacheSet;
+
+/*
+ * Indirect branch target cache, filled by helper_lookup_tb_ptr_pred() and
+ * read by the code emitted by tcg_gen_lookup_and_goto_ptr_pred(). Entries
+ * are tagged with the jump site and indexed by site and target pc. Only the
+ * vCPU thread accesses it, or another thread while the vCPU is stopped.
+ */
+#define TB_IBTC_BITS 6
+#define TB_IBTC_SIZE (1 << TB_IBTC_BITS)
+
+typedef struct CPUIBTCEntry {
+    uint64_t site;          /* 0 if unused */
+    uint64_t aux;           /* target state changed by the jump, besides pc */
+    TranslationBlock *tb;
+} CPUIBTCEntry;
 
 /* work queue */
 
@@ -379,7 +426,12 @@ struct CPUState {
     IcountDecr *icount_decr_ptr;
 
     /* Accessed in parallel; all accesses must be atomic */
-    TranslationBlock *tb_jmp_cache[TB_JMP_CACHE_SIZE];
+    CPUJumpCacheSet *tb_jmp_cache;
+    /* Jump cache statistics, see dump_exec_info() */
+    size_t tb_jmp_cache_hits;
+    size_t tb_jmp_cache_misses;
+    size_t tb_jmp_cache_flushes;
+    CPUIBTCEntry tb_ibtc[TB_IBTC_SIZE];
 
     struct GDBRegisterState *gdb_regs;
     int gdb_num_regs;
@@ -456,13 +508,28 @@ extern CPUTailQ cpus;
 
 extern __thread CPUState *current_cpu;
 
-static inline void cpu_tb_jmp_cache_clear(CPUState *cpu)
+static inline void cpu_tb_ibtc_clear(CPUState *cpu)
 {
     unsigned int i;
 
+    for (i = 0; i < TB_IBTC_SIZE; i++) {
+        cpu->tb_ibtc[i].site = 0;
+        cpu->tb_ibtc[i].tb = NULL;
+    }
+}
+
+static inline void cpu_tb_jmp_cache_clear(CPUState *cpu)
+{
+    unsigned int i, way;
+
+    cpu_tb_ibtc_clear(cpu);
+
     for (i = 0; i < TB_JMP_CACHE_SIZE; i++) {
-        qatomic_set(&cpu->tb_jmp_cache[i], NULL);
+        for (way = 0; way < TB_JMP_CACHE_WAYS; way++) {
+            qatomic_set(&cpu->tb_jmp_cache[i].tb[way], NULL);
+        }
     }
+    qatomic_set(&cpu->tb_jmp_cache_flushes, cpu->tb_jmp_cache_flushes + 1);
 }
 
 /**
@@ -59,6 +59,16 @@ struct TCGCPUOps {
                      bool probe, uintptr_t retaddr);
     /** @debug_excp_handler: Callback for handling debug exceptions */
     void (*debug_excp_handler)(CPUState *cpu);
+    /**
+     * @snapshot_for_translation: Copy translation state for another thread
+     *
+     * Copy into @dst, an initialized but unrealized instance of the same CPU
+     * type as @src, the state that the translator reads from @src: anything
+     * that is not in the TB flags but changes the code generated. Called on
+     * the thread that owns @src. Targets that do not implement this cannot
+     * use speculative translation workers (user-only "-tb-workers").
+     */
+    void (*snapshot_for_translation)(CPUState *dst, const CPUState *src);
 
 #ifdef NEED_CPU_H
 #ifdef CONFIG_SOFTMMU
@@ -48,6 +48,15 @@
 #ifndef bit_AVX512F
 #define bit_AVX512F        (1 << 16)
 #endif
+#ifndef bit_AVX512DQ
+#define bit_AVX512DQ    (1 << 17)
+#endif
+#ifndef bit_AVX512BW
+#define bit_AVX512BW    (1 << 30)
+#endif
+#ifndef bit_AVX512VL
+#define bit_AVX512VL    (1u << 31)
+#endif
 #ifndef bit_BMI2
 #define bit_BMI2        (1 << 8)
 #endif
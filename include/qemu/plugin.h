@@ -24,6 +24,8 @@ enum qemu_plugin_event {
     QEMU_PLUGIN_EV_VCPU_RESUME,
     QEMU_PLUGIN_EV_VCPU_SYSCALL,
     QEMU_PLUGIN_EV_VCPU_SYSCALL_RET,
+    QEMU_PLUGIN_EV_VCPU_CAP_REG_WRITE,
+    QEMU_PLUGIN_EV_VCPU_CHERI_EXCP,
     QEMU_PLUGIN_EV_FLUSH,
     QEMU_PLUGIN_EV_ATEXIT,
     QEMU_PLUGIN_EV_MAX, /* total number of plugin events we support */
@@ -56,6 +58,8 @@ union qemu_plugin_cb_sig {
     qemu_plugin_vcpu_mem_cb_t        vcpu_mem;
     qemu_plugin_vcpu_syscall_cb_t    vcpu_syscall;
     qemu_plugin_vcpu_syscall_ret_cb_t vcpu_syscall_ret;
+    qemu_plugin_vcpu_cap_reg_cb_t    vcpu_cap_reg;
+    qemu_plugin_vcpu_cheri_excp_cb_t vcpu_cheri_excp;
     void *generic;
 };
 
@@ -68,9 +72,23 @@ enum plugin_dyn_cb_type {
 enum plugin_dyn_cb_subtype {
     PLUGIN_CB_REGULAR,
     PLUGIN_CB_INLINE,
+    PLUGIN_CB_COND,
+    PLUGIN_CB_BUFFERED,
     PLUGIN_N_CB_SUBTYPES,
 };
 
+/*
+ * Per-vCPU ring of a memory event buffer, an element of its scoreboard.
+ * Generated code appends to it, see plugin-gen.c.
+ */
+struct plugin_mem_buffer_ring {
+    /* events added since the last delivery; may exceed the ring size */
+    uint64_t head;
+    struct qemu_plugin_mem_event events[];
+};
+
+#define QEMU_PLUGIN_MEM_CAP_ONLY (QEMU_PLUGIN_MEM_CAP_R & ~QEMU_PLUGIN_MEM_R)
+
 /*
  * A dynamic callback has an insertion point that is determined at run-time.
  * Usually the insertion point is somewhere in the code cache; think for
@@ -81,14 +99,39 @@ struct qemu_plugin_dyn_cb {
     void *userp;
     unsigned tcg_flags;
     enum plugin_dyn_cb_subtype type;
-    /* @rw applies to mem callbacks only (both regular and inline) */
+    /*
+     * @rw applies to mem callbacks only (regular, inline and buffered).
+     * Callbacks with QEMU_PLUGIN_MEM_CAP_ONLY set only match capability
+     * accesses.
+     */
     enum qemu_plugin_mem_rw rw;
     /* fields specific to each dyn_cb type go here */
     union {
         struct {
             enum qemu_plugin_op op;
             uint64_t imm;
+            /*
+             * For per-vCPU ops, distance between the values of two
+             * consecutive vCPUs; 0 if all vCPUs share the value at @userp.
+             */
+            uint32_t stride;
         } inline_insn;
+        /* @f and @userp are those of the callback */
+        struct {
+            enum qemu_plugin_cond cond;
+            uint64_t imm;
+            void *ptr;
+            uint32_t stride;
+        } cond;
+        /* @userp is stored in the events */
+        struct {
+            struct qemu_plugin_mem_buffer *buf;
+            /* the ring of vCPU 0 and the distance between two rings */
+            void *ptr;
+            uint32_t stride;
+            /* number of events in a ring, minus one */
+            uint32_t mask;
+        } mem_buffer;
     };
 };
 
@@ -182,6 +225,14 @@ qemu_plugin_vcpu_syscall(CPUState *cpu, int64_t num, uint64_t a1,
 void qemu_plugin_vcpu_syscall_ret(CPUState *cpu, int64_t num, int64_t ret);
 
 void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr, uint32_t meminfo);
+void qemu_plugin_vcpu_cap_mem_cb(CPUState *cpu, uint64_t vaddr,
+                                 uint32_t meminfo, uint64_t pesbt, bool tag,
+                                 uint64_t cursor,
+                                 const struct qemu_plugin_cap *auth);
+void qemu_plugin_vcpu_cap_reg_write(CPUState *cpu, unsigned int regnum,
+                                    uint64_t pesbt, bool tag, uint64_t cursor);
+void qemu_plugin_vcpu_cheri_exception(CPUState *cpu, unsigned int cause,
+                                      unsigned int regnum, uint64_t vaddr);
 
 void qemu_plugin_flush_cb(void);
 
@@ -238,6 +289,24 @@ static inline void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr,
                                            uint32_t meminfo)
 { }
 
+static inline void
+qemu_plugin_vcpu_cap_mem_cb(CPUState *cpu, uint64_t vaddr, uint32_t meminfo,
+                            uint64_t pesbt, bool tag, uint64_t cursor,
+                            const struct qemu_plugin_cap *auth)
+{ }
+
+static inline void qemu_plugin_vcpu_cap_reg_write(CPUState *cpu,
+                                                  unsigned int regnum,
+                                                  uint64_t pesbt, bool tag,
+                                                  uint64_t cursor)
+{ }
+
+static inline void qemu_plugin_vcpu_cheri_exception(CPUState *cpu,
+                                                    unsigned int cause,
+                                                    unsigned int regnum,
+                                                    uint64_t vaddr)
+{ }
+
 static inline void qemu_plugin_flush_cb(void)
 { }
 
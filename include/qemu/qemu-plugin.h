@@ -50,7 +50,7 @@ typedef uint64_t qemu_plugin_id_t;
 
 extern QEMU_PLUGIN_EXPORT int qemu_plugin_version;
 
-#define QEMU_PLUGIN_VERSION 1
+#define QEMU_PLUGIN_VERSION 2
 
 /**
  * struct qemu_info_t - system information for plugins
@@ -226,10 +226,27 @@ enum qemu_plugin_cb_flags {
     QEMU_PLUGIN_CB_RW_REGS,
 };
 
+/**
+ * enum qemu_plugin_mem_rw - type of memory access to instrument
+ *
+ * @QEMU_PLUGIN_MEM_R: loads
+ * @QEMU_PLUGIN_MEM_W: stores
+ * @QEMU_PLUGIN_MEM_RW: loads and stores
+ * @QEMU_PLUGIN_MEM_CAP_R: capability loads only
+ * @QEMU_PLUGIN_MEM_CAP_W: capability stores only
+ * @QEMU_PLUGIN_MEM_CAP_RW: capability loads and stores only
+ *
+ * The QEMU_PLUGIN_MEM_CAP_* variants only match the capability-sized
+ * accesses made by CHERI capability loads and stores, see
+ * qemu_plugin_mem_is_cap(). They never match on targets without CHERI.
+ */
 enum qemu_plugin_mem_rw {
     QEMU_PLUGIN_MEM_R = 1,
     QEMU_PLUGIN_MEM_W,
     QEMU_PLUGIN_MEM_RW,
+    QEMU_PLUGIN_MEM_CAP_R = 5,
+    QEMU_PLUGIN_MEM_CAP_W,
+    QEMU_PLUGIN_MEM_CAP_RW,
 };
 
 /**
@@ -293,7 +310,8 @@ enum qemu_plugin_op {
  * memory.
  *
  * Note: ops are not atomic so in multi-threaded/multi-smp situations
- * you will get inexact results.
+ * you will get inexact results. Use
+ * qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu() to count exactly.
  */
 void qemu_plugin_register_vcpu_tb_exec_inline(struct qemu_plugin_tb *tb,
                                               enum qemu_plugin_op op,
@@ -327,6 +345,208 @@ void qemu_plugin_register_vcpu_insn_exec_inline(struct qemu_plugin_insn *insn,
                                                 enum qemu_plugin_op op,
                                                 void *ptr, uint64_t imm);
 
+/**
+ * struct qemu_plugin_scoreboard - Opaque handle for a per-vCPU scoreboard
+ *
+ * A scoreboard holds one element of a plugin-defined size for every
+ * vCPU. Each vCPU's element sits on its own cache lines, so vCPUs
+ * updating their elements do not slow each other down, and inline ops
+ * on a scoreboard are exact even with several vCPUs running in parallel.
+ * Scoreboards grow automatically as vCPUs are created.
+ */
+struct qemu_plugin_scoreboard;
+
+/**
+ * typedef qemu_plugin_u64 - a uint64_t member of a scoreboard element
+ * @score: the scoreboard
+ * @offset: offset of the uint64_t in the element
+ *
+ * Use qemu_plugin_scoreboard_u64() or
+ * qemu_plugin_scoreboard_u64_in_struct() to build one.
+ */
+typedef struct {
+    struct qemu_plugin_scoreboard *score;
+    size_t offset;
+} qemu_plugin_u64;
+
+/**
+ * qemu_plugin_scoreboard_new() - allocate a new scoreboard
+ * @element_size: size of the element kept for each vCPU
+ *
+ * All elements are zero-initialized.
+ *
+ * Returns: the scoreboard, to be freed with qemu_plugin_scoreboard_free()
+ */
+struct qemu_plugin_scoreboard *qemu_plugin_scoreboard_new(size_t element_size);
+
+/**
+ * qemu_plugin_scoreboard_free() - free a scoreboard
+ * @score: scoreboard to free
+ *
+ * Translated code refers to the scoreboards of the inline ops it was
+ * instrumented with, so only free a scoreboard once those can no longer
+ * run, e.g. from the atexit callback.
+ */
+void qemu_plugin_scoreboard_free(struct qemu_plugin_scoreboard *score);
+
+/**
+ * qemu_plugin_scoreboard_find() - get the element of a vCPU
+ * @score: scoreboard to query
+ * @vcpu_index: vCPU whose element to return
+ *
+ * The pointer is only valid until the next vCPU is created, since the
+ * scoreboard may move when it grows.
+ *
+ * Returns: pointer to the element of @vcpu_index
+ */
+void *qemu_plugin_scoreboard_find(struct qemu_plugin_scoreboard *score,
+                                  unsigned int vcpu_index);
+
+/* build a qemu_plugin_u64 for a scoreboard of uint64_t */
+#define qemu_plugin_scoreboard_u64(score) \
+    ((qemu_plugin_u64) {score, 0})
+
+/* build a qemu_plugin_u64 for a uint64_t member of a scoreboard of structs */
+#define qemu_plugin_scoreboard_u64_in_struct(score, type, member) \
+    ((qemu_plugin_u64) {score, offsetof(type, member)})
+
+/**
+ * qemu_plugin_u64_add() - add to the value of a vCPU
+ * @entry: scoreboard entry
+ * @vcpu_index: vCPU whose value to update
+ * @added: value to add
+ */
+void qemu_plugin_u64_add(qemu_plugin_u64 entry, unsigned int vcpu_index,
+                         uint64_t added);
+
+/**
+ * qemu_plugin_u64_get() - get the value of a vCPU
+ * @entry: scoreboard entry
+ * @vcpu_index: vCPU whose value to return
+ */
+uint64_t qemu_plugin_u64_get(qemu_plugin_u64 entry, unsigned int vcpu_index);
+
+/**
+ * qemu_plugin_u64_set() - set the value of a vCPU
+ * @entry: scoreboard entry
+ * @vcpu_index: vCPU whose value to set
+ * @val: new value
+ */
+void qemu_plugin_u64_set(qemu_plugin_u64 entry, unsigned int vcpu_index,
+                         uint64_t val);
+
+/**
+ * qemu_plugin_u64_sum() - sum the values of all vCPUs
+ * @entry: scoreboard entry
+ *
+ * Typically called from the atexit callback to aggregate the counts.
+ *
+ * Returns: the sum over every vCPU created so far
+ */
+uint64_t qemu_plugin_u64_sum(qemu_plugin_u64 entry);
+
+/**
+ * qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu() - per-vCPU execution
+ * inline op
+ * @tb: the opaque qemu_plugin_tb handle for the translation
+ * @op: the type of qemu_plugin_op (e.g. ADD_U64)
+ * @entry: the scoreboard entry to update
+ * @imm: the op data (e.g. 1)
+ *
+ * Like qemu_plugin_register_vcpu_tb_exec_inline(), but the op applies to
+ * the element of the vCPU executing the block.
+ */
+void qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+    struct qemu_plugin_tb *tb, enum qemu_plugin_op op, qemu_plugin_u64 entry,
+    uint64_t imm);
+
+/**
+ * qemu_plugin_register_vcpu_insn_exec_inline_per_vcpu() - per-vCPU insn
+ * execution inline op
+ * @insn: the opaque qemu_plugin_insn handle for an instruction
+ * @op: the type of qemu_plugin_op (e.g. ADD_U64)
+ * @entry: the scoreboard entry to update
+ * @imm: the op data (e.g. 1)
+ *
+ * Like qemu_plugin_register_vcpu_insn_exec_inline(), but the op applies
+ * to the element of the vCPU executing the instruction.
+ */
+void qemu_plugin_register_vcpu_insn_exec_inline_per_vcpu(
+    struct qemu_plugin_insn *insn, enum qemu_plugin_op op,
+    qemu_plugin_u64 entry, uint64_t imm);
+
+/**
+ * enum qemu_plugin_cond - condition of a conditional callback
+ *
+ * Compares the scoreboard value of the executing vCPU to an immediate.
+ * All comparisons are unsigned.
+ *
+ * @QEMU_PLUGIN_COND_NEVER: never call the callback
+ * @QEMU_PLUGIN_COND_ALWAYS: always call the callback
+ * @QEMU_PLUGIN_COND_EQ: value == immediate
+ * @QEMU_PLUGIN_COND_NE: value != immediate
+ * @QEMU_PLUGIN_COND_LT: value < immediate
+ * @QEMU_PLUGIN_COND_LE: value <= immediate
+ * @QEMU_PLUGIN_COND_GT: value > immediate
+ * @QEMU_PLUGIN_COND_GE: value >= immediate
+ */
+enum qemu_plugin_cond {
+    QEMU_PLUGIN_COND_NEVER,
+    QEMU_PLUGIN_COND_ALWAYS,
+    QEMU_PLUGIN_COND_EQ,
+    QEMU_PLUGIN_COND_NE,
+    QEMU_PLUGIN_COND_LT,
+    QEMU_PLUGIN_COND_LE,
+    QEMU_PLUGIN_COND_GT,
+    QEMU_PLUGIN_COND_GE,
+};
+
+/**
+ * qemu_plugin_register_vcpu_tb_exec_cond_cb() - conditional execution cb
+ * @tb: the opaque qemu_plugin_tb handle for the translation
+ * @cb: callback function
+ * @flags: does the plugin read or write the CPU's registers?
+ * @cond: condition on the value of @entry
+ * @entry: the scoreboard entry to test
+ * @imm: the value @entry is compared to
+ * @userdata: any plugin data to pass to the @cb?
+ *
+ * Like qemu_plugin_register_vcpu_tb_exec_cb(), but the generated code
+ * only calls @cb when @cond holds for the value of @entry of the vCPU
+ * executing the block. The test is done inline, after the inline ops of
+ * the block have been applied, so that e.g. an inline counter together
+ * with QEMU_PLUGIN_COND_GE calls @cb once every @imm executions if @cb
+ * resets the counter, and QEMU_PLUGIN_COND_NE with a 0 @imm calls @cb
+ * only while a per-vCPU flag is set.
+ */
+void qemu_plugin_register_vcpu_tb_exec_cond_cb(struct qemu_plugin_tb *tb,
+                                               qemu_plugin_vcpu_udata_cb_t cb,
+                                               enum qemu_plugin_cb_flags flags,
+                                               enum qemu_plugin_cond cond,
+                                               qemu_plugin_u64 entry,
+                                               uint64_t imm, void *userdata);
+
+/**
+ * qemu_plugin_register_vcpu_insn_exec_cond_cb() - conditional insn
+ * execution cb
+ * @insn: the opaque qemu_plugin_insn handle for an instruction
+ * @cb: callback function
+ * @flags: does the plugin read or write the CPU's registers?
+ * @cond: condition on the value of @entry
+ * @entry: the scoreboard entry to test
+ * @imm: the value @entry is compared to
+ * @userdata: any plugin data to pass to the @cb?
+ *
+ * Like qemu_plugin_register_vcpu_tb_exec_cond_cb(), for the execution of
+ * an instruction. The test is done before the instruction executes, so
+ * counts of memory accesses only include those of the previous
+ * instructions.
+ */
+void qemu_plugin_register_vcpu_insn_exec_cond_cb(
+    struct qemu_plugin_insn *insn, qemu_plugin_vcpu_udata_cb_t cb,
+    enum qemu_plugin_cb_flags flags, enum qemu_plugin_cond cond,
+    qemu_plugin_u64 entry, uint64_t imm, void *userdata);
+
 /**
  * qemu_plugin_tb_n_insns() - query helper for number of insns in TB
  * @tb: opaque handle to TB passed to callback
@@ -432,6 +652,159 @@ bool qemu_plugin_mem_is_big_endian(qemu_plugin_meminfo_t info);
  */
 bool qemu_plugin_mem_is_store(qemu_plugin_meminfo_t info);
 
+/**
+ * struct qemu_plugin_cap - a CHERI capability
+ * @cursor: the address of the capability
+ * @pesbt: the compressed permissions, object type and bounds as held in
+ * a capability register (i.e. not XORed with the in-memory NULL mask)
+ * @tag: the validity tag
+ *
+ * The format of @pesbt depends on the target's capability encoding, use
+ * qemu_plugin_cap_decode() to extract the fields.
+ */
+struct qemu_plugin_cap {
+    uint64_t cursor;
+    uint64_t pesbt;
+    bool tag;
+};
+
+/**
+ * struct qemu_plugin_cap_fields - decoded fields of a capability
+ * @base: lower bound of the capability
+ * @top: upper bound (exclusive), saturated to the largest address for
+ * capabilities that cover the whole address space
+ * @perms: architectural permissions
+ * @uperms: software-defined permissions
+ * @otype: object type
+ */
+struct qemu_plugin_cap_fields {
+    uint64_t base;
+    uint64_t top;
+    uint32_t perms;
+    uint32_t uperms;
+    uint64_t otype;
+};
+
+/**
+ * qemu_plugin_mem_is_cap() - was the access a capability load or store
+ * @info: opaque memory transaction handle
+ *
+ * Capability loads and stores are reported as a single access of
+ * capability size, the tag included. When they have to go through the
+ * MMIO slow path the individual words are not reported separately.
+ *
+ * Returns: true if it was, otherwise false
+ */
+bool qemu_plugin_mem_is_cap(qemu_plugin_meminfo_t info);
+
+/**
+ * qemu_plugin_mem_get_cap() - get the capability loaded or stored
+ * @info: opaque memory transaction handle
+ * @cap: filled in with the capability
+ *
+ * For loads, @cap is the value written to the destination register, so
+ * its tag may have been cleared by the load. This can only be called
+ * from the memory callback that was passed @info.
+ *
+ * Returns: true if @info is a capability access, otherwise false and
+ * @cap is left untouched.
+ */
+bool qemu_plugin_mem_get_cap(qemu_plugin_meminfo_t info,
+                             struct qemu_plugin_cap *cap);
+
+/**
+ * qemu_plugin_mem_get_auth_cap() - get the capability authorising an access
+ * @info: opaque memory transaction handle
+ * @cap: filled in with the authorising capability
+ *
+ * This is the capability the address of a capability load or store was
+ * checked against: the base register or DDC. This can only be called
+ * from the memory callback that was passed @info.
+ *
+ * Returns: true if @info is a capability access, otherwise false and
+ * @cap is left untouched.
+ */
+bool qemu_plugin_mem_get_auth_cap(qemu_plugin_meminfo_t info,
+                                  struct qemu_plugin_cap *cap);
+
+/**
+ * qemu_plugin_cap_decode() - decode the fields of a capability
+ * @cap: capability from a callback
+ * @fields: filled in with the decoded fields
+ *
+ * Returns: true on success, false if the target has no capabilities.
+ */
+bool qemu_plugin_cap_decode(const struct qemu_plugin_cap *cap,
+                            struct qemu_plugin_cap_fields *fields);
+
+/**
+ * struct qemu_plugin_register - Opaque handle for a guest register
+ *
+ * Look registers up once, e.g. from qemu_plugin_install(), and keep the
+ * handle: accesses through a handle do not look the name up again.
+ */
+struct qemu_plugin_register;
+
+/**
+ * qemu_plugin_find_register() - look up a guest register by name
+ * @name: register name as used by the target's disassembler, e.g. "a0",
+ * "x10", "pc" or "mstatus" on RISC-V. CHERI targets also accept the
+ * capability register names, e.g. "ca0", "ddc" or "mtcc".
+ *
+ * If no vCPU has been created yet the name is only checked on the first
+ * access, which then fails for unknown names.
+ *
+ * Returns: a handle valid until QEMU exits, or NULL if the target has no
+ * register called @name.
+ */
+struct qemu_plugin_register *qemu_plugin_find_register(const char *name);
+
+/*
+ * The accessors below act on the vCPU running the current callback, and
+ * may only be called from vCPU callbacks. They return false if the
+ * register cannot be accessed that way. Callbacks registered with
+ * QEMU_PLUGIN_CB_NO_REGS may read stale values. Register writes need
+ * QEMU_PLUGIN_CB_RW_REGS.
+ *
+ * The PC is only updated between blocks. Instruction callbacks should use
+ * qemu_plugin_insn_vaddr() at translation time instead.
+ */
+
+/**
+ * qemu_plugin_read_register() - read the integer value of a register
+ * @reg: register handle
+ * @val: filled in with the value, zero-extended
+ *
+ * For capability registers this is the address (cursor) of the
+ * capability.
+ */
+bool qemu_plugin_read_register(struct qemu_plugin_register *reg,
+                               uint64_t *val);
+
+/**
+ * qemu_plugin_read_cap_register() - read a capability register
+ * @reg: register handle
+ * @cap: filled in with the capability
+ *
+ * Lazily decompressed registers are read in their compressed form, so no
+ * register state changes. Use qemu_plugin_cap_decode() for the bounds and
+ * permissions.
+ */
+bool qemu_plugin_read_cap_register(struct qemu_plugin_register *reg,
+                                   struct qemu_plugin_cap *cap);
+
+/**
+ * qemu_plugin_write_register() - write the integer value of a register
+ * @reg: register handle
+ * @val: new value, truncated to the register size
+ *
+ * Only general-purpose registers can be written; the PC, CSRs and
+ * special capability registers cannot. Writing a capability register
+ * stores an untagged integer, like an integer instruction writing it would.
+ */
+bool qemu_plugin_write_register(struct qemu_plugin_register *reg,
+                                uint64_t val);
+
 /**
  * qemu_plugin_get_hwaddr() - return handle for memory operation
  * @info: opaque memory info structure
@@ -496,7 +869,144 @@ void qemu_plugin_register_vcpu_mem_inline(struct qemu_plugin_insn *insn,
                                           enum qemu_plugin_op op, void *ptr,
                                           uint64_t imm);
 
+/**
+ * qemu_plugin_register_vcpu_mem_inline_per_vcpu() - per-vCPU memory
+ * access inline op
+ * @insn: the opaque qemu_plugin_insn handle for an instruction
+ * @rw: the type of accesses to instrument
+ * @op: the type of qemu_plugin_op (e.g. ADD_U64)
+ * @entry: the scoreboard entry to update
+ * @imm: the op data (e.g. 1)
+ *
+ * Like qemu_plugin_register_vcpu_mem_inline(), but the op applies to the
+ * element of the vCPU doing the access.
+ */
+void qemu_plugin_register_vcpu_mem_inline_per_vcpu(
+    struct qemu_plugin_insn *insn, enum qemu_plugin_mem_rw rw,
+    enum qemu_plugin_op op, qemu_plugin_u64 entry, uint64_t imm);
 
+/**
+ * struct qemu_plugin_mem_event - a buffered memory access
+ * @vaddr: virtual address of the access
+ * @userdata: the userdata passed at registration
+ * @info: access information, as passed to memory callbacks
+ *
+ * @info can be queried with the qemu_plugin_mem_*() functions, except
+ * qemu_plugin_mem_get_cap() and qemu_plugin_get_hwaddr(): their data is
+ * gone by the time the event is delivered.
+ */
+struct qemu_plugin_mem_event {
+    uint64_t vaddr;
+    void *userdata;
+    qemu_plugin_meminfo_t info;
+};
+
+/**
+ * typedef qemu_plugin_vcpu_mem_batch_cb_t - buffered memory access callback
+ * @vcpu_index: the vCPU that did the accesses
+ * @events: the accesses, oldest first
+ * @n: number of elements of @events
+ * @userdata: the userdata passed to qemu_plugin_mem_buffer_new()
+ *
+ * @events is only valid during the callback.
+ */
+typedef void
+(*qemu_plugin_vcpu_mem_batch_cb_t)(unsigned int vcpu_index,
+                                   const struct qemu_plugin_mem_event *events,
+                                   size_t n, void *userdata);
+
+/**
+ * struct qemu_plugin_mem_buffer - Opaque handle for a memory event buffer
+ */
+struct qemu_plugin_mem_buffer;
+
+/**
+ * qemu_plugin_mem_buffer_new() - allocate a memory event buffer
+ * @id: plugin ID
+ * @batch: number of events to collect before @cb is called
+ * @cb: callback receiving the events
+ * @userdata: passed to @cb
+ *
+ * Each vCPU appends the accesses it does to its own ring, without taking
+ * locks or calling out of the generated code. @cb is called on the vCPU
+ * thread with the events collected so far at the start of the first block
+ * executed after @batch events have been added, when an instruction using
+ * helpers fills the ring, and when the vCPU goes idle or exits. The
+ * remaining events are delivered at exit, before the atexit callbacks.
+ *
+ * Returns: a buffer valid until the plugin is uninstalled.
+ */
+struct qemu_plugin_mem_buffer *
+qemu_plugin_mem_buffer_new(qemu_plugin_id_t id, size_t batch,
+                           qemu_plugin_vcpu_mem_batch_cb_t cb,
+                           void *userdata);
+
+/**
+ * qemu_plugin_register_vcpu_mem_buffered() - buffer memory accesses
+ * @insn: the opaque qemu_plugin_insn handle for an instruction
+ * @rw: the type of accesses to instrument
+ * @buf: buffer from qemu_plugin_mem_buffer_new()
+ * @userdata: stored in the events of the accesses of @insn
+ *
+ * Like qemu_plugin_register_vcpu_mem_cb(), but the accesses are recorded
+ * in @buf and delivered in batches.
+ */
+void qemu_plugin_register_vcpu_mem_buffered(struct qemu_plugin_insn *insn,
+                                            enum qemu_plugin_mem_rw rw,
+                                            struct qemu_plugin_mem_buffer *buf,
+                                            void *userdata);
+
+/**
+ * typedef qemu_plugin_vcpu_cap_reg_cb_t - capability register write callback
+ * @id: unique plugin id
+ * @vcpu_index: the current vcpu context
+ * @regnum: the capability register that was written
+ * @cap: the new value of the register, only valid during the callback
+ */
+typedef void
+(*qemu_plugin_vcpu_cap_reg_cb_t)(qemu_plugin_id_t id, unsigned int vcpu_index,
+                                 unsigned int regnum,
+                                 const struct qemu_plugin_cap *cap);
+
+/**
+ * qemu_plugin_register_vcpu_cap_reg_write_cb() - register a capability
+ * register write callback
+ * @id: plugin ID
+ * @cb: callback function
+ *
+ * The @cb function is called every time a helper writes a capability to
+ * a general-purpose capability register. Writes of integer values and
+ * moves that are done in generated code are not reported.
+ */
+void
+qemu_plugin_register_vcpu_cap_reg_write_cb(qemu_plugin_id_t id,
+                                           qemu_plugin_vcpu_cap_reg_cb_t cb);
+
+/**
+ * typedef qemu_plugin_vcpu_cheri_excp_cb_t - CHERI exception callback
+ * @id: unique plugin id
+ * @vcpu_index: the current vcpu context
+ * @cause: the architectural capability exception cause
+ * @regnum: the capability register that caused the exception
+ * @vaddr: the faulting address, or 0 if the target does not report one
+ */
+typedef void
+(*qemu_plugin_vcpu_cheri_excp_cb_t)(qemu_plugin_id_t id,
+                                    unsigned int vcpu_index,
+                                    unsigned int cause, unsigned int regnum,
+                                    uint64_t vaddr);
+
+/**
+ * qemu_plugin_register_vcpu_cheri_exception_cb() - register a CHERI
+ * exception callback
+ * @id: plugin ID
+ * @cb: callback function
+ *
+ * The @cb function is called every time a capability check fails, just
+ * before the exception is raised.
+ */
+void qemu_plugin_register_vcpu_cheri_exception_cb(
+    qemu_plugin_id_t id, qemu_plugin_vcpu_cheri_excp_cb_t cb);
 
 typedef void
 (*qemu_plugin_vcpu_syscall_cb_t)(qemu_plugin_id_t id, unsigned int vcpu_index,
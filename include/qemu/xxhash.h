@@ -119,6 +119,61 @@ static inline uint32_t qemu_xxhash6(uint64_t ab, uint64_t cd, uint32_t e,
     return qemu_xxhash7(ab, cd, e, f, 0);
 }
 
+static inline uint32_t qemu_xxhash_round(uint32_t v, uint32_t input)
+{
+    v += input * PRIME32_2;
+    v = rol32(v, 13);
+    return v * PRIME32_1;
+}
+
+/*
+ * Same as qemu_xxhash7(), but with two 16-byte stripes and four trailing
+ * words (i.e. twelve 32-bit words in total).
+ */
+static inline uint32_t
+qemu_xxhash12(uint64_t ab, uint64_t cd, uint64_t ef, uint64_t gh,
+              uint32_t i, uint32_t j, uint32_t k, uint32_t l)
+{
+    uint32_t v1 = QEMU_XXHASH_SEED + PRIME32_1 + PRIME32_2;
+    uint32_t v2 = QEMU_XXHASH_SEED + PRIME32_2;
+    uint32_t v3 = QEMU_XXHASH_SEED + 0;
+    uint32_t v4 = QEMU_XXHASH_SEED - PRIME32_1;
+    uint32_t h32;
+
+    v1 = qemu_xxhash_round(v1, ab);
+    v2 = qemu_xxhash_round(v2, ab >> 32);
+    v3 = qemu_xxhash_round(v3, cd);
+    v4 = qemu_xxhash_round(v4, cd >> 32);
+
+    v1 = qemu_xxhash_round(v1, ef);
+    v2 = qemu_xxhash_round(v2, ef >> 32);
+    v3 = qemu_xxhash_round(v3, gh);
+    v4 = qemu_xxhash_round(v4, gh >> 32);
+
+    h32 = rol32(v1, 1) + rol32(v2, 7) + rol32(v3, 12) + rol32(v4, 18);
+    h32 += 48;
+
+    h32 += i * PRIME32_3;
+    h32  = rol32(h32, 17) * PRIME32_4;
+
+    h32 += j * PRIME32_3;
+    h32  = rol32(h32, 17) * PRIME32_4;
+
+    h32 += k * PRIME32_3;
+    h32  = rol32(h32, 17) * PRIME32_4;
+
+    h32 += l * PRIME32_3;
+    h32  = rol32(h32, 17) * PRIME32_4;
+
+    h32 ^= h32 >> 15;
+    h32 *= PRIME32_2;
+    h32 ^= h32 >> 13;
+    h32 *= PRIME32_3;
+    h32 ^= h32 >> 16;
+
+    return h32;
+}
+
 /*
  * Component parts of the XXH64 algorithm from
  * https://github.com/Cyan4973/xxHash/blob/v0.8.0/xxhash.h
@@ -835,6 +835,26 @@ void tcg_gen_goto_tb(unsigned idx);
  */
 void tcg_gen_lookup_and_goto_ptr(void);
 
+/**
+ * tcg_gen_lookup_and_goto_ptr_pred() - tcg_gen_lookup_and_goto_ptr() with an
+ * inline cache of recent targets
+ * @tb: the TB being translated
+ * @site_pc: guest address of the jump instruction
+ * @pc: guest address of the target TB, i.e. the new pc
+ * @aux: state other than pc that the jump changes and that is part of the
+ *       TB lookup key (e.g. the new PCC for a CHERI capability jump), or NULL
+ *
+ * The emitted code looks for the target in the vCPU's indirect branch target
+ * cache before calling helper_lookup_tb_ptr(). The cached TB is only checked
+ * against @pc and @aux, so the rest of the CPU state that is part of the TB
+ * lookup key must be the same every time this jump is executed, as is the
+ * case for tcg_gen_goto_tb(). Do not use this after an instruction that
+ * changes such state to a value that is not known at translation time.
+ */
+void tcg_gen_lookup_and_goto_ptr_pred(const TranslationBlock *tb,
+                                      target_ulong site_pc, TCGv pc,
+                                      TCGv_i64 aux);
+
 static inline void tcg_gen_plugin_cb_start(unsigned from, unsigned type,
                                            unsigned wr)
 {
@@ -1136,6 +1156,7 @@ void tcg_gen_stl_vec(TCGv_vec r, TCGv_ptr base, TCGArg offset, TCGType t);
 #define tcg_gen_extract2_tl tcg_gen_extract2_i64
 #define tcg_const_tl tcg_const_i64
 #define tcg_const_local_tl tcg_const_local_i64
+#define tcg_constant_tl tcg_constant_i64
 #define tcg_gen_movcond_tl tcg_gen_movcond_i64
 #define tcg_gen_add2_tl tcg_gen_add2_i64
 #define tcg_gen_sub2_tl tcg_gen_sub2_i64
@@ -1253,6 +1274,7 @@ void tcg_gen_stl_vec(TCGv_vec r, TCGv_ptr base, TCGArg offset, TCGType t);
 #define tcg_gen_extract2_tl tcg_gen_extract2_i32
 #define tcg_const_tl tcg_const_i32
 #define tcg_const_local_tl tcg_const_local_i32
+#define tcg_constant_tl tcg_constant_i32
 #define tcg_gen_movcond_tl tcg_gen_movcond_i32
 #define tcg_gen_add2_tl tcg_gen_add2_i32
 #define tcg_gen_sub2_tl tcg_gen_sub2_i32
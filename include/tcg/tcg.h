@@ -929,6 +929,7 @@ TranslationBlock *tcg_tb_alloc(TCGContext *s);
 void tcg_region_init(void);
 void tb_destroy(TranslationBlock *tb);
 void tcg_region_reset_all(void);
+int tcg_region_evict(GTraverseFunc evict, gpointer user_data);
 
 size_t tcg_code_size(void);
 size_t tcg_code_capacity(void);
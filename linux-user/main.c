@@ -40,6 +40,7 @@
 #include "qemu/plugin.h"
 #include "cpu.h"
 #include "exec/exec-all.h"
+#include "exec/translate-all.h"
 #include "tcg/tcg.h"
 #include "qemu/timer.h"
 #include "qemu/envlist.h"
@@ -64,6 +65,7 @@ static envlist_t *envlist;
 static const char *cpu_model;
 static const char *cpu_type;
 static const char *seed_optarg;
+static unsigned int tb_workers;
 unsigned long mmap_min_addr;
 uintptr_t guest_base;
 bool have_guest_base;
@@ -136,10 +138,12 @@ void fork_start(void)
     start_exclusive();
     mmap_fork_start();
     cpu_list_lock();
+    tb_spec_fork_start();
 }
 
 void fork_end(int child)
 {
+    tb_spec_fork_end(child);
     mmap_fork_end(child);
     if (child) {
         CPUState *cpu, *next_cpu;
@@ -382,6 +386,11 @@ static void handle_arg_singlestep(const char *arg)
     singlestep = 1;
 }
 
+static void handle_arg_tb_workers(const char *arg)
+{
+    tb_workers = atoi(arg);
+}
+
 static void handle_arg_strace(const char *arg)
 {
     enable_strace = true;
@@ -462,6 +471,8 @@ static const struct qemu_argument arg_table[] = {
      "",           "run in singlestep mode"},
     {"strace",     "QEMU_STRACE",      false, handle_arg_strace,
      "",           "log system calls"},
+    {"tb-workers", "QEMU_TB_WORKERS",  true,  handle_arg_tb_workers,
+     "n",          "translate code ahead of execution in 'n' threads"},
     {"seed",       "QEMU_RAND_SEED",   true,  handle_arg_seed,
      "",           "Seed for pseudo-random number generator"},
     {"trace",      "QEMU_TRACE",       true,  handle_arg_trace,
@@ -875,6 +886,7 @@ int main(int argc, char **argv, char **envp)
        the real value of GUEST_BASE into account.  */
     tcg_prologue_init(tcg_ctx);
     tcg_region_init();
+    tb_spec_init(cpu, tb_workers);
 
     target_cpu_copy_regs(env, regs);
 
@@ -5,6 +5,9 @@
 #include "cpu.h"
 #include "exec/exec-all.h"
 #include "exec/cpu_ldst.h"
+#ifdef TARGET_CHERI
+#include "cheri_tagmem.h"
+#endif
 
 #undef DEBUG_REMAP
 
@@ -647,7 +650,12 @@ void *lock_user(int type, abi_ulong guest_addr, ssize_t len, bool copy);
 static inline void unlock_user(void *host_ptr, abi_ulong guest_addr,
                                ssize_t len)
 {
-    /* no-op */
+#ifdef TARGET_CHERI
+    /* Data written by the host invalidates any capabilities stored there. */
+    if (host_ptr && len > 0) {
+        cheri_tag_user_invalidate(guest_addr, len);
+    }
+#endif
 }
 #else
 void unlock_user(void *host_ptr, abi_ulong guest_addr, ssize_t len);
@@ -25,6 +25,174 @@
 #include "elf.h"
 #include "semihosting/common-semi.h"
 
+#ifdef TARGET_CHERI
+/*
+ * CheriABI (pure-capability) processes pass pointers to the kernel as
+ * capabilities. do_syscall() only deals with integer addresses, so before
+ * dispatching we check that the capabilities passed for the pointer arguments
+ * of the common I/O syscalls actually authorise the access the kernel is about
+ * to perform on the process' behalf.
+ */
+typedef struct CheriABIPtrArg {
+    int num;
+    uint8_t ptr_arg;    /* argument index of the pointer */
+    int8_t len_arg;     /* argument index of the length (-1 if unknown) */
+    uint32_t perms;     /* permissions required on the pointer */
+} CheriABIPtrArg;
+
+static const CheriABIPtrArg cheriabi_ptr_args[] = {
+    { TARGET_NR_getcwd, 0, 1, CAP_PERM_STORE },
+    { TARGET_NR_openat, 1, -1, CAP_PERM_LOAD },
+    { TARGET_NR_read, 1, 2, CAP_PERM_STORE },
+    { TARGET_NR_write, 1, 2, CAP_PERM_LOAD },
+    { TARGET_NR_pread64, 1, 2, CAP_PERM_STORE },
+    { TARGET_NR_pwrite64, 1, 2, CAP_PERM_LOAD },
+    { TARGET_NR_readlinkat, 1, -1, CAP_PERM_LOAD },
+    { TARGET_NR_readlinkat, 2, 3, CAP_PERM_STORE },
+    { TARGET_NR_getrandom, 0, 1, CAP_PERM_STORE },
+};
+
+static abi_long cheriabi_check_syscall_args(CPURISCVState *env)
+{
+    target_ulong num = riscv_user_gpr(env, xA7);
+
+    for (int i = 0; i < ARRAY_SIZE(cheriabi_ptr_args); i++) {
+        const CheriABIPtrArg *arg = &cheriabi_ptr_args[i];
+        if (arg->num != num) {
+            continue;
+        }
+        const cap_register_t *cap = get_readonly_capreg(env, xA0 + arg->ptr_arg);
+        target_ulong len = arg->len_arg < 0 ?
+            1 : riscv_user_gpr(env, xA0 + arg->len_arg);
+        if (cap_get_cursor(cap) == 0 || len == 0) {
+            /* NULL pointers and empty buffers are handled by the syscall. */
+            continue;
+        }
+        if (!cap->cr_tag || !cap_is_unsealed(cap) ||
+            !cap_has_perms(cap, arg->perms) ||
+            !cap_is_in_bounds(cap, cap_get_cursor(cap), len)) {
+            return -TARGET_EFAULT;
+        }
+    }
+    return 0;
+}
+
+static void cheriabi_put_cap(abi_ulong addr, const cap_register_t *cap)
+{
+    put_user_ual(CAP_cc(compress_mem)(cap), addr + CHERI_MEM_OFFSET_METADATA);
+    put_user_ual(cap_get_cursor(cap), addr + CHERI_MEM_OFFSET_CURSOR);
+    /* Set the tag last since the data stores above clear it. */
+    if (cap->cr_tag) {
+        cheri_tag_user_set(addr);
+    }
+}
+
+static cap_register_t cheriabi_make_cap(abi_ulong base, abi_ulong len,
+                                        uint32_t perms)
+{
+    cap_register_t cap;
+    set_max_perms_capability(&cap, base);
+    CAP_cc(setbounds)(&cap, len);
+    CAP_cc(update_perms)(&cap, cap_get_perms(&cap) & perms);
+    return cap;
+}
+
+/* Convert a NULL-terminated array of integer pointers to strings. */
+static abi_ulong cheriabi_copy_string_vector(abi_ulong dst, abi_ulong src)
+{
+    abi_ulong str;
+    cap_register_t cap;
+
+    for (;; src += sizeof(abi_ulong), dst += CHERI_CAP_SIZE) {
+        get_user_ual(str, src);
+        if (str == 0) {
+            cheriabi_put_cap(dst, null_capability(&cap));
+            return dst + CHERI_CAP_SIZE;
+        }
+        cap = cheriabi_make_cap(str, target_strlen(str) + 1,
+                                CAP_PERM_GLOBAL | CAP_PERM_LOAD);
+        cheriabi_put_cap(dst, &cap);
+    }
+}
+
+static bool cheriabi_auxv_is_pointer(abi_ulong type)
+{
+    switch (type) {
+    case AT_PHDR:
+    case AT_BASE:
+    case AT_ENTRY:
+    case AT_RANDOM:
+    case AT_EXECFN:
+    case AT_PLATFORM:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/*
+ * Build the capability-bearing argument vectors for a CheriABI process below
+ * the integer ones created by create_elf_tables(): argv[], envp[] and the
+ * auxiliary vector are rewritten with capabilities in place of pointers, and
+ * the process is entered with argc in a0 and capabilities to the three arrays
+ * in ca1-ca3. The stack capability is bounded to the stack mapping and DDC is
+ * NULL, as for a purecap CheriBSD process.
+ */
+static void cheriabi_setup_initial_regs(CPURISCVState *env,
+                                        struct image_info *info, abi_ulong sp)
+{
+    const int n = sizeof(abi_ulong);
+    abi_ulong argc, envp, auxv, type, val;
+    abi_ulong u_argv, u_envp, u_auxv, dst;
+    size_t nauxv = info->auxv_len / (2 * n);
+    size_t envc = (info->saved_auxv - info->arg_end) / n - 2;
+    cap_register_t cap;
+
+    get_user_ual(argc, sp);
+    envp = info->arg_end + n;
+    auxv = info->saved_auxv;
+
+    /* argv + NULL, envp + NULL and (type, value) pairs for the auxv. */
+    dst = sp - ((argc + 1) + (envc + 1) + 2 * nauxv) * CHERI_CAP_SIZE;
+    dst = QEMU_ALIGN_DOWN(dst, 16);
+    u_argv = dst;
+    u_envp = cheriabi_copy_string_vector(u_argv, info->arg_start);
+    u_auxv = cheriabi_copy_string_vector(u_envp, envp);
+    for (size_t i = 0; i < nauxv; i++) {
+        get_user_ual(type, auxv + 2 * i * n);
+        get_user_ual(val, auxv + (2 * i + 1) * n);
+        cheriabi_put_cap(u_auxv + 2 * i * CHERI_CAP_SIZE,
+                         int_to_cap(type, &cap));
+        if (val != 0 && cheriabi_auxv_is_pointer(type)) {
+            set_max_perms_capability(&cap, val);
+        } else {
+            int_to_cap(val, &cap);
+        }
+        cheriabi_put_cap(u_auxv + (2 * i + 1) * CHERI_CAP_SIZE, &cap);
+    }
+
+    riscv_user_set_gpr(env, xA0, argc);
+    cap = cheriabi_make_cap(u_argv, (argc + 1) * CHERI_CAP_SIZE,
+                            CAP_PERM_GLOBAL | CAP_PERM_LOAD |
+                            CAP_PERM_LOAD_CAP);
+    update_capreg(env, xA1, &cap);
+    cap = cheriabi_make_cap(u_envp, (envc + 1) * CHERI_CAP_SIZE,
+                            CAP_PERM_GLOBAL | CAP_PERM_LOAD |
+                            CAP_PERM_LOAD_CAP);
+    update_capreg(env, xA2, &cap);
+    cap = cheriabi_make_cap(u_auxv, nauxv * 2 * CHERI_CAP_SIZE,
+                            CAP_PERM_GLOBAL | CAP_PERM_LOAD |
+                            CAP_PERM_LOAD_CAP);
+    update_capreg(env, xA3, &cap);
+
+    cap = cheriabi_make_cap(info->stack_limit, sp - info->stack_limit,
+                            CAP_PERMS_ALL & ~CAP_PERM_EXECUTE);
+    cap_set_cursor(&cap, dst);
+    update_capreg(env, xSP, &cap);
+    null_capability(&env->DDC);
+}
+#endif
+
 void cpu_loop(CPURISCVState *env)
 {
     CPUState *cs = env_cpu(env);
@@ -50,27 +218,40 @@ void cpu_loop(CPURISCVState *env)
             cpu_exec_step_atomic(cs);
             break;
         case RISCV_EXCP_U_ECALL:
-            env->pc += 4;
-            if (env->gpr[xA7] == TARGET_NR_arch_specific_syscall + 15) {
+            riscv_user_set_pc(env, riscv_user_pc(env) + 4);
+            if (riscv_user_gpr(env, xA7) ==
+                TARGET_NR_arch_specific_syscall + 15) {
                 /* riscv_flush_icache_syscall is a no-op in QEMU as
                    self-modifying code is automatically detected */
                 ret = 0;
             } else {
+#ifdef TARGET_CHERI
+                if (env->elf_flags & EF_RISCV_CHERIABI) {
+                    ret = cheriabi_check_syscall_args(env);
+                    if (ret != 0) {
+                        goto syscall_done;
+                    }
+                }
+#endif
                 ret = do_syscall(env,
-                                 env->gpr[(env->elf_flags & EF_RISCV_RVE)
-                                    ? xT0 : xA7],
-                                 env->gpr[xA0],
-                                 env->gpr[xA1],
-                                 env->gpr[xA2],
-                                 env->gpr[xA3],
-                                 env->gpr[xA4],
-                                 env->gpr[xA5],
+                                 riscv_user_gpr(env,
+                                     (env->elf_flags & EF_RISCV_RVE)
+                                        ? xT0 : xA7),
+                                 riscv_user_gpr(env, xA0),
+                                 riscv_user_gpr(env, xA1),
+                                 riscv_user_gpr(env, xA2),
+                                 riscv_user_gpr(env, xA3),
+                                 riscv_user_gpr(env, xA4),
+                                 riscv_user_gpr(env, xA5),
                                  0, 0);
             }
+#ifdef TARGET_CHERI
+        syscall_done:
+#endif
             if (ret == -TARGET_ERESTARTSYS) {
-                env->pc -= 4;
+                riscv_user_set_pc(env, riscv_user_pc(env) - 4);
             } else if (ret != -TARGET_QEMU_ESIGRETURN) {
-                env->gpr[xA0] = ret;
+                riscv_user_set_gpr(env, xA0, ret);
             }
             if (cs->singlestep_enabled) {
                 goto gdbstep;
@@ -83,7 +264,7 @@ void cpu_loop(CPURISCVState *env)
         case RISCV_EXCP_BREAKPOINT:
             signum = TARGET_SIGTRAP;
             sigcode = TARGET_TRAP_BRKPT;
-            sigaddr = env->pc;
+            sigaddr = riscv_user_pc(env);
             break;
         case RISCV_EXCP_INST_PAGE_FAULT:
         case RISCV_EXCP_LOAD_PAGE_FAULT:
@@ -93,8 +274,8 @@ void cpu_loop(CPURISCVState *env)
             sigaddr = env->badaddr;
             break;
         case RISCV_EXCP_SEMIHOST:
-            env->gpr[xA0] = do_common_semihosting(cs);
-            env->pc += 4;
+            riscv_user_set_gpr(env, xA0, do_common_semihosting(cs));
+            riscv_user_set_pc(env, riscv_user_pc(env) + 4);
             break;
         case EXCP_DEBUG:
         gdbstep:
@@ -127,9 +308,18 @@ void target_cpu_copy_regs(CPUArchState *env, struct target_pt_regs *regs)
     TaskState *ts = cpu->opaque;
     struct image_info *info = ts->info;
 
-    env->pc = regs->sepc;
-    env->gpr[xSP] = regs->sp;
+    riscv_user_set_pc(env, regs->sepc);
     env->elf_flags = info->elf_flags;
+#ifdef TARGET_CHERI
+    if (env->elf_flags & EF_RISCV_CHERIABI) {
+        cheriabi_setup_initial_regs(env, info, regs->sp);
+    } else {
+        /* Hybrid binaries run with an almighty DDC. */
+        riscv_user_set_gpr(env, xSP, regs->sp);
+    }
+#else
+    riscv_user_set_gpr(env, xSP, regs->sp);
+#endif
 
     if ((env->misa & RVE) && !(env->elf_flags & EF_RISCV_RVE)) {
         error_report("Incompatible ELF: RVE cpu requires RVE ABI binary");
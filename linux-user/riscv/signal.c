@@ -75,10 +75,10 @@ static void setup_sigcontext(struct target_sigcontext *sc, CPURISCVState *env)
 {
     int i;
 
-    __put_user(env->pc, &sc->pc);
+    __put_user(riscv_user_pc(env), &sc->pc);
 
     for (i = 1; i < 32; i++) {
-        __put_user(env->gpr[i], &sc->gpr[i - 1]);
+        __put_user(riscv_user_gpr(env, i), &sc->gpr[i - 1]);
     }
     for (i = 0; i < 32; i++) {
         __put_user(env->fpr[i], &sc->fpr[i]);
@@ -128,12 +128,15 @@ void setup_rt_frame(int sig, struct target_sigaction *ka,
     tswap_siginfo(&frame->info, info);
     install_sigtramp(frame->tramp);
 
-    env->pc = ka->_sa_handler;
-    env->gpr[xSP] = frame_addr;
-    env->gpr[xA0] = sig;
-    env->gpr[xA1] = frame_addr + offsetof(struct target_rt_sigframe, info);
-    env->gpr[xA2] = frame_addr + offsetof(struct target_rt_sigframe, uc);
-    env->gpr[xRA] = frame_addr + offsetof(struct target_rt_sigframe, tramp);
+    riscv_user_set_pc(env, ka->_sa_handler);
+    riscv_user_set_gpr(env, xSP, frame_addr);
+    riscv_user_set_gpr(env, xA0, sig);
+    riscv_user_set_gpr(env, xA1,
+                       frame_addr + offsetof(struct target_rt_sigframe, info));
+    riscv_user_set_gpr(env, xA2,
+                       frame_addr + offsetof(struct target_rt_sigframe, uc));
+    riscv_user_set_gpr(env, xRA,
+                       frame_addr + offsetof(struct target_rt_sigframe, tramp));
 
     return;
 
@@ -148,11 +151,14 @@ badframe:
 static void restore_sigcontext(CPURISCVState *env, struct target_sigcontext *sc)
 {
     int i;
+    abi_ulong val;
 
-    __get_user(env->pc, &sc->pc);
+    __get_user(val, &sc->pc);
+    riscv_user_set_pc(env, val);
 
     for (i = 1; i < 32; ++i) {
-        __get_user(env->gpr[i], &sc->gpr[i - 1]);
+        __get_user(val, &sc->gpr[i - 1]);
+        riscv_user_set_gpr(env, i, val);
     }
     for (i = 0; i < 32; ++i) {
         __get_user(env->fpr[i], &sc->fpr[i]);
@@ -185,7 +191,7 @@ long do_rt_sigreturn(CPURISCVState *env)
     struct target_rt_sigframe *frame;
     abi_ulong frame_addr;
 
-    frame_addr = env->gpr[xSP];
+    frame_addr = riscv_user_gpr(env, xSP);
     trace_user_do_sigreturn(env, frame_addr);
     if (!lock_user_struct(VERIFY_READ, frame, frame_addr, 1)) {
         goto badframe;
@@ -1,14 +1,62 @@
 #ifndef RISCV_TARGET_CPU_H
 #define RISCV_TARGET_CPU_H
 
+#ifdef TARGET_CHERI
+#include "cheri-lazy-capregs.h"
+#endif
+
+/*
+ * With CHERI the integer registers are the addresses of the general-purpose
+ * capability registers, so all user-mode register accesses go through these.
+ */
+static inline target_ulong riscv_user_gpr(CPURISCVState *env, unsigned reg)
+{
+#ifdef TARGET_CHERI
+    return get_capreg_cursor(env, reg);
+#else
+    return env->gpr[reg];
+#endif
+}
+
+static inline void riscv_user_set_gpr(CPURISCVState *env, unsigned reg,
+                                      target_ulong value)
+{
+#ifdef TARGET_CHERI
+    update_capreg_to_intval(env, reg, value);
+#else
+    env->gpr[reg] = value;
+#endif
+}
+
+static inline target_ulong riscv_user_pc(CPURISCVState *env)
+{
+#ifdef TARGET_CHERI
+    return PC_ADDR(env);
+#else
+    return env->pc;
+#endif
+}
+
+static inline void riscv_user_set_pc(CPURISCVState *env, target_ulong pc)
+{
+#ifdef TARGET_CHERI
+    cheri_update_pcc(&env->PCC, pc, /*can_be_unrepresentable=*/false);
+#else
+    env->pc = pc;
+#endif
+#ifdef CONFIG_DEBUG_TCG
+    env->_pc_is_current = true;
+#endif
+}
+
 static inline void cpu_clone_regs_child(CPURISCVState *env, target_ulong newsp,
                                         unsigned flags)
 {
     if (newsp) {
-        env->gpr[xSP] = newsp;
+        riscv_user_set_gpr(env, xSP, newsp);
     }
 
-    env->gpr[xA0] = 0;
+    riscv_user_set_gpr(env, xA0, 0);
 }
 
 static inline void cpu_clone_regs_parent(CPURISCVState *env, unsigned flags)
@@ -17,11 +65,11 @@ static inline void cpu_clone_regs_parent(CPURISCVState *env, unsigned flags)
 
 static inline void cpu_set_tls(CPURISCVState *env, target_ulong newtls)
 {
-    env->gpr[xTP] = newtls;
+    riscv_user_set_gpr(env, xTP, newtls);
 }
 
 static inline abi_ulong get_sp_from_cpustate(CPURISCVState *state)
 {
-   return state->gpr[xSP];
+   return riscv_user_gpr(state, xSP);
 }
 #endif
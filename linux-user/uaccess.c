@@ -31,6 +31,11 @@ void unlock_user(void *host_ptr, abi_ulong guest_addr, ssize_t len)
     if (!host_ptr) {
         return;
     }
+#ifdef TARGET_CHERI
+    if (len > 0) {
+        cheri_tag_user_invalidate(guest_addr, len);
+    }
+#endif
     host_ptr_conv = g2h(thread_cpu, guest_addr);
     if (host_ptr == host_ptr_conv) {
         return;
@@ -1894,6 +1894,45 @@ void hmp_info_iothreads(Monitor *mon, const QDict *qdict)
     qapi_free_IOThreadInfoList(info_list);
 }
 
+void hmp_info_tlb_stats(Monitor *mon, const QDict *qdict)
+{
+    TlbStatsInfoList *info_list, *info;
+    Error *err = NULL;
+
+    info_list = qmp_query_tlb_stats(&err);
+    if (err) {
+        hmp_handle_error(mon, err);
+        return;
+    }
+
+    monitor_printf(mon, "%3s %3s %8s %8s %10s %10s %10s %10s "
+                   "%8s %8s %8s %8s %6s %6s\n",
+                   "cpu", "mmu", "size", "used", "misses", "victim",
+                   "large", "fills", "flushes", "lp-flush", "rg-flush",
+                   "pg-flush", "grows", "shrink");
+    for (info = info_list; info; info = info->next) {
+        TlbStatsInfo *value = info->value;
+
+        if (value->misses == 0 && value->flushes == 0 &&
+            value->page_flushes == 0) {
+            /* Skip MMU indexes the guest never used */
+            continue;
+        }
+        monitor_printf(mon, "%3" PRId64 " %3" PRId64 " %8" PRId64
+                       " %8" PRId64 " %10" PRId64 " %10" PRId64
+                       " %10" PRId64 " %10" PRId64 " %8" PRId64
+                       " %8" PRId64 " %8" PRId64 " %8" PRId64
+                       " %6" PRId64 " %6" PRId64 "\n",
+                       value->cpu_index, value->mmu_index, value->entries,
+                       value->used_entries, value->misses, value->victim_hits,
+                       value->large_page_hits, value->fills, value->flushes,
+                       value->large_page_flushes, value->range_flushes,
+                       value->page_flushes, value->grows, value->shrinks);
+    }
+
+    qapi_free_TlbStatsInfoList(info_list);
+}
+
 void hmp_rocker(Monitor *mon, const QDict *qdict)
 {
     const char *name = qdict_get_str(qdict, "name");
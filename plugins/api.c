@@ -48,6 +48,9 @@
 #include "hw/boards.h"
 #endif
 #include "trace/mem.h"
+#ifdef TARGET_CHERI
+#include "cheri_utils.h"
+#endif
 
 /* Uninstall and Reset handlers */
 
@@ -96,7 +99,28 @@ void qemu_plugin_register_vcpu_tb_exec_inline(struct qemu_plugin_tb *tb,
                                               void *ptr, uint64_t imm)
 {
     if (!tb->mem_only) {
-        plugin_register_inline_op(&tb->cbs[PLUGIN_CB_INLINE], 0, op, ptr, imm);
+        plugin_register_inline_op(&tb->cbs[PLUGIN_CB_INLINE], 0, op, ptr,
+                                  0, imm);
+    }
+}
+
+/*
+ * Translation never runs concurrently with the growth of a scoreboard,
+ * which flushes the code cache, so its address can be baked in.
+ */
+static void *plugin_u64_base(qemu_plugin_u64 entry)
+{
+    return (char *)entry.score->data + entry.offset;
+}
+
+void qemu_plugin_register_vcpu_tb_exec_inline_per_vcpu(
+    struct qemu_plugin_tb *tb, enum qemu_plugin_op op, qemu_plugin_u64 entry,
+    uint64_t imm)
+{
+    if (!tb->mem_only) {
+        plugin_register_inline_op(&tb->cbs[PLUGIN_CB_INLINE], 0, op,
+                                  plugin_u64_base(entry), entry.score->stride,
+                                  imm);
     }
 }
 
@@ -111,13 +135,75 @@ void qemu_plugin_register_vcpu_insn_exec_cb(struct qemu_plugin_insn *insn,
     }
 }
 
+/*
+ * NEVER needs no code at all and ALWAYS is a plain callback; leave the
+ * comparisons to the generated code.
+ */
+static void plugin_register_cond_cb(GArray **cond_arr, GArray **regular_arr,
+                                    qemu_plugin_vcpu_udata_cb_t cb,
+                                    enum qemu_plugin_cb_flags flags,
+                                    enum qemu_plugin_cond cond,
+                                    qemu_plugin_u64 entry, uint64_t imm,
+                                    void *udata)
+{
+    switch (cond) {
+    case QEMU_PLUGIN_COND_NEVER:
+        return;
+    case QEMU_PLUGIN_COND_ALWAYS:
+        plugin_register_dyn_cb__udata(regular_arr, cb, flags, udata);
+        return;
+    default:
+        plugin_register_dyn_cb_cond__udata(cond_arr, cb, flags, cond,
+                                           plugin_u64_base(entry),
+                                           entry.score->stride, imm, udata);
+        return;
+    }
+}
+
+void qemu_plugin_register_vcpu_tb_exec_cond_cb(struct qemu_plugin_tb *tb,
+                                               qemu_plugin_vcpu_udata_cb_t cb,
+                                               enum qemu_plugin_cb_flags flags,
+                                               enum qemu_plugin_cond cond,
+                                               qemu_plugin_u64 entry,
+                                               uint64_t imm, void *userdata)
+{
+    if (!tb->mem_only) {
+        plugin_register_cond_cb(&tb->cbs[PLUGIN_CB_COND],
+                                &tb->cbs[PLUGIN_CB_REGULAR],
+                                cb, flags, cond, entry, imm, userdata);
+    }
+}
+
+void qemu_plugin_register_vcpu_insn_exec_cond_cb(
+    struct qemu_plugin_insn *insn, qemu_plugin_vcpu_udata_cb_t cb,
+    enum qemu_plugin_cb_flags flags, enum qemu_plugin_cond cond,
+    qemu_plugin_u64 entry, uint64_t imm, void *userdata)
+{
+    if (!insn->mem_only) {
+        plugin_register_cond_cb(&insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_COND],
+                                &insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_REGULAR],
+                                cb, flags, cond, entry, imm, userdata);
+    }
+}
+
 void qemu_plugin_register_vcpu_insn_exec_inline(struct qemu_plugin_insn *insn,
                                                 enum qemu_plugin_op op,
                                                 void *ptr, uint64_t imm)
 {
     if (!insn->mem_only) {
         plugin_register_inline_op(&insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_INLINE],
-                                  0, op, ptr, imm);
+                                  0, op, ptr, 0, imm);
+    }
+}
+
+void qemu_plugin_register_vcpu_insn_exec_inline_per_vcpu(
+    struct qemu_plugin_insn *insn, enum qemu_plugin_op op,
+    qemu_plugin_u64 entry, uint64_t imm)
+{
+    if (!insn->mem_only) {
+        plugin_register_inline_op(&insn->cbs[PLUGIN_CB_INSN][PLUGIN_CB_INLINE],
+                                  0, op, plugin_u64_base(entry),
+                                  entry.score->stride, imm);
     }
 }
 
@@ -142,7 +228,33 @@ void qemu_plugin_register_vcpu_mem_inline(struct qemu_plugin_insn *insn,
                                           uint64_t imm)
 {
     plugin_register_inline_op(&insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_INLINE],
-                              rw, op, ptr, imm);
+                              rw, op, ptr, 0, imm);
+}
+
+void qemu_plugin_register_vcpu_mem_inline_per_vcpu(
+    struct qemu_plugin_insn *insn, enum qemu_plugin_mem_rw rw,
+    enum qemu_plugin_op op, qemu_plugin_u64 entry, uint64_t imm)
+{
+    plugin_register_inline_op(&insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_INLINE],
+                              rw, op, plugin_u64_base(entry),
+                              entry.score->stride, imm);
+}
+
+struct qemu_plugin_mem_buffer *
+qemu_plugin_mem_buffer_new(qemu_plugin_id_t id, size_t batch,
+                           qemu_plugin_vcpu_mem_batch_cb_t cb,
+                           void *userdata)
+{
+    return plugin_mem_buffer_new(id, batch, cb, userdata);
+}
+
+void qemu_plugin_register_vcpu_mem_buffered(struct qemu_plugin_insn *insn,
+                                            enum qemu_plugin_mem_rw rw,
+                                            struct qemu_plugin_mem_buffer *buf,
+                                            void *userdata)
+{
+    plugin_register_vcpu_mem_buffered(
+        &insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_BUFFERED], rw, buf, userdata);
 }
 
 void qemu_plugin_register_vcpu_tb_trans_cb(qemu_plugin_id_t id,
@@ -164,6 +276,19 @@ qemu_plugin_register_vcpu_syscall_ret_cb(qemu_plugin_id_t id,
     plugin_register_cb(id, QEMU_PLUGIN_EV_VCPU_SYSCALL_RET, cb);
 }
 
+void
+qemu_plugin_register_vcpu_cap_reg_write_cb(qemu_plugin_id_t id,
+                                           qemu_plugin_vcpu_cap_reg_cb_t cb)
+{
+    plugin_register_cb(id, QEMU_PLUGIN_EV_VCPU_CAP_REG_WRITE, cb);
+}
+
+void qemu_plugin_register_vcpu_cheri_exception_cb(
+    qemu_plugin_id_t id, qemu_plugin_vcpu_cheri_excp_cb_t cb)
+{
+    plugin_register_cb(id, QEMU_PLUGIN_EV_VCPU_CHERI_EXCP, cb);
+}
+
 /*
  * Plugin Queries
  *
@@ -260,6 +385,131 @@ bool qemu_plugin_mem_is_store(qemu_plugin_meminfo_t info)
     return !!(info & TRACE_MEM_ST);
 }
 
+bool qemu_plugin_mem_is_cap(qemu_plugin_meminfo_t info)
+{
+    return !!(info & TRACE_MEM_CAP);
+}
+
+bool qemu_plugin_mem_get_cap(qemu_plugin_meminfo_t info,
+                             struct qemu_plugin_cap *cap)
+{
+    if (!(info & TRACE_MEM_CAP)) {
+        return false;
+    }
+    *cap = plugin_cap_access;
+    return true;
+}
+
+bool qemu_plugin_mem_get_auth_cap(qemu_plugin_meminfo_t info,
+                                  struct qemu_plugin_cap *cap)
+{
+    if (!(info & TRACE_MEM_CAP)) {
+        return false;
+    }
+    *cap = plugin_cap_auth;
+    return true;
+}
+
+bool qemu_plugin_cap_decode(const struct qemu_plugin_cap *cap,
+                            struct qemu_plugin_cap_fields *fields)
+{
+#ifdef TARGET_CHERI
+    cap_register_t c;
+
+    CAP_cc(decompress_raw)(cap->pesbt, cap->cursor, cap->tag, &c);
+    fields->base = cap_get_base(&c);
+    fields->top = cap_get_top(&c);
+    fields->perms = cap_get_perms(&c);
+    fields->uperms = cap_get_uperms(&c);
+    fields->otype = cap_get_otype_unsigned(&c);
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*
+ * Registers
+ */
+
+struct qemu_plugin_register {
+    char *name;
+    /* PLUGIN_REG_UNRESOLVED until looked up, then the CPUClass number */
+    int reg;
+    bool is_cap;
+};
+
+#define PLUGIN_REG_UNRESOLVED INT_MIN
+
+/*
+ * All vCPUs share the CPU class, so racing lookups of the same register
+ * store the same result.
+ */
+static bool plugin_reg_resolve(CPUState *cpu, struct qemu_plugin_register *r)
+{
+    int reg = qatomic_load_acquire(&r->reg);
+
+    if (unlikely(reg == PLUGIN_REG_UNRESOLVED)) {
+        CPUClass *cc = CPU_GET_CLASS(cpu);
+        bool is_cap = false;
+
+        reg = -1;
+        if (cc->plugin_reg_lookup) {
+            reg = cc->plugin_reg_lookup(cpu, r->name, &is_cap);
+        }
+        r->is_cap = is_cap;
+        qatomic_store_release(&r->reg, reg);
+    }
+    return reg >= 0;
+}
+
+struct qemu_plugin_register *qemu_plugin_find_register(const char *name)
+{
+    struct qemu_plugin_register *r = g_new0(struct qemu_plugin_register, 1);
+
+    r->name = g_strdup(name);
+    r->reg = PLUGIN_REG_UNRESOLVED;
+    if (first_cpu && !plugin_reg_resolve(first_cpu, r)) {
+        g_free(r->name);
+        g_free(r);
+        return NULL;
+    }
+    return r;
+}
+
+bool qemu_plugin_read_register(struct qemu_plugin_register *reg,
+                               uint64_t *val)
+{
+    CPUState *cpu = current_cpu;
+
+    if (!cpu || !plugin_reg_resolve(cpu, reg)) {
+        return false;
+    }
+    return CPU_GET_CLASS(cpu)->plugin_reg_read(cpu, reg->reg, val);
+}
+
+bool qemu_plugin_read_cap_register(struct qemu_plugin_register *reg,
+                                   struct qemu_plugin_cap *cap)
+{
+    CPUState *cpu = current_cpu;
+
+    if (!cpu || !plugin_reg_resolve(cpu, reg) || !reg->is_cap) {
+        return false;
+    }
+    return CPU_GET_CLASS(cpu)->plugin_cap_reg_read(cpu, reg->reg, cap);
+}
+
+bool qemu_plugin_write_register(struct qemu_plugin_register *reg,
+                                uint64_t val)
+{
+    CPUState *cpu = current_cpu;
+
+    if (!cpu || !plugin_reg_resolve(cpu, reg)) {
+        return false;
+    }
+    return CPU_GET_CLASS(cpu)->plugin_reg_write(cpu, reg->reg, val);
+}
+
 /*
  * Virtual Memory queries
  */
@@ -379,3 +629,59 @@ void qemu_plugin_outs(const char *string)
 {
     qemu_log_mask(CPU_LOG_PLUGIN, "%s", string);
 }
+
+/*
+ * Scoreboards
+ */
+struct qemu_plugin_scoreboard *qemu_plugin_scoreboard_new(size_t element_size)
+{
+    return plugin_scoreboard_new(element_size);
+}
+
+void qemu_plugin_scoreboard_free(struct qemu_plugin_scoreboard *score)
+{
+    plugin_scoreboard_free(score);
+}
+
+void *qemu_plugin_scoreboard_find(struct qemu_plugin_scoreboard *score,
+                                  unsigned int vcpu_index)
+{
+    return (char *)score->data + score->stride * vcpu_index;
+}
+
+static uint64_t *plugin_u64_address(qemu_plugin_u64 entry,
+                                    unsigned int vcpu_index)
+{
+    char *base = qemu_plugin_scoreboard_find(entry.score, vcpu_index);
+
+    return (uint64_t *)(base + entry.offset);
+}
+
+void qemu_plugin_u64_add(qemu_plugin_u64 entry, unsigned int vcpu_index,
+                         uint64_t added)
+{
+    *plugin_u64_address(entry, vcpu_index) += added;
+}
+
+uint64_t qemu_plugin_u64_get(qemu_plugin_u64 entry, unsigned int vcpu_index)
+{
+    return *plugin_u64_address(entry, vcpu_index);
+}
+
+void qemu_plugin_u64_set(qemu_plugin_u64 entry, unsigned int vcpu_index,
+                         uint64_t val)
+{
+    *plugin_u64_address(entry, vcpu_index) = val;
+}
+
+uint64_t qemu_plugin_u64_sum(qemu_plugin_u64 entry)
+{
+    uint64_t total = 0;
+    unsigned int n = plugin_num_vcpus();
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        total += qemu_plugin_u64_get(entry, i);
+    }
+    return total;
+}
@@ -20,6 +20,7 @@
 #include "qemu/rcu_queue.h"
 #include "qemu/xxhash.h"
 #include "qemu/rcu.h"
+#include "qemu/host-utils.h"
 #include "hw/core/cpu.h"
 #include "exec/cpu-common.h"
 
@@ -42,6 +43,9 @@ struct qemu_plugin_cb {
 
 struct qemu_plugin_state plugin;
 
+__thread struct qemu_plugin_cap plugin_cap_access;
+__thread struct qemu_plugin_cap plugin_cap_auth;
+
 struct qemu_plugin_ctx *plugin_id_to_ctx_locked(qemu_plugin_id_t id)
 {
     struct qemu_plugin_ctx *ctx;
@@ -213,8 +217,58 @@ plugin_register_cb_udata(qemu_plugin_id_t id, enum qemu_plugin_event ev,
     do_plugin_register_cb(id, ev, func, udata);
 }
 
+/* keep each vCPU's scoreboard element on its own cache lines */
+#define PLUGIN_SCOREBOARD_ALIGN 64
+
+static void *plugin_scoreboard_alloc(size_t stride, size_t n)
+{
+    void *data = qemu_memalign(PLUGIN_SCOREBOARD_ALIGN, stride * n);
+
+    memset(data, 0, stride * n);
+    return data;
+}
+
+static void plugin_grow_scoreboards__locked(size_t new_size)
+{
+    struct qemu_plugin_scoreboard *score;
+
+    if (new_size <= plugin.scoreboard_alloc_size) {
+        return;
+    }
+    QLIST_FOREACH(score, &plugin.scoreboards, entry) {
+        void *new_data = plugin_scoreboard_alloc(score->stride, new_size);
+
+        memcpy(new_data, score->data,
+               score->stride * plugin.scoreboard_alloc_size);
+        qemu_vfree(score->data);
+        score->data = new_data;
+    }
+    plugin.scoreboard_alloc_size = new_size;
+}
+
+/* only count @cpu once the scoreboards have room for it */
+static void plugin_add_vcpu__locked(CPUState *cpu)
+{
+    qatomic_set(&plugin.num_vcpus,
+                MAX(plugin.num_vcpus, cpu->cpu_index + 1));
+}
+
+/* Runs with all vCPUs stopped, so that no code uses the old scoreboards */
+static void plugin_vcpu_init__safe(CPUState *cpu, run_on_cpu_data data)
+{
+    qemu_rec_mutex_lock(&plugin.lock);
+    plugin_grow_scoreboards__locked(data.host_ulong);
+    plugin_add_vcpu__locked(cpu);
+    qemu_rec_mutex_unlock(&plugin.lock);
+
+    /* translated code has the addresses of the old scoreboards baked in */
+    tb_flush(cpu);
+    plugin_vcpu_cb__simple(cpu, QEMU_PLUGIN_EV_VCPU_INIT);
+}
+
 void qemu_plugin_vcpu_init_hook(CPUState *cpu)
 {
+    size_t new_size;
     bool success;
 
     qemu_rec_mutex_lock(&plugin.lock);
@@ -222,15 +276,216 @@ void qemu_plugin_vcpu_init_hook(CPUState *cpu)
     success = g_hash_table_insert(plugin.cpu_ht, &cpu->cpu_index,
                                   &cpu->cpu_index);
     g_assert(success);
+
+    new_size = plugin.scoreboard_alloc_size;
+    while (cpu->cpu_index >= new_size) {
+        new_size *= 2;
+    }
+    if (new_size > plugin.scoreboard_alloc_size &&
+        !QLIST_EMPTY(&plugin.scoreboards)) {
+        /*
+         * Other vCPUs may be running code that updates the scoreboards.
+         * @cpu runs the work before executing any guest code, and the
+         * plugins' init callbacks then see the grown scoreboards.
+         */
+        async_safe_run_on_cpu(cpu, plugin_vcpu_init__safe,
+                              RUN_ON_CPU_HOST_ULONG(new_size));
+        qemu_rec_mutex_unlock(&plugin.lock);
+        return;
+    }
+    plugin.scoreboard_alloc_size = MAX(plugin.scoreboard_alloc_size,
+                                       new_size);
+    plugin_add_vcpu__locked(cpu);
     qemu_rec_mutex_unlock(&plugin.lock);
 
     plugin_vcpu_cb__simple(cpu, QEMU_PLUGIN_EV_VCPU_INIT);
 }
 
+/*
+ * Rings are only checked against the batch size when a block starts, so
+ * leave room for the events added by one block on top of it.
+ */
+#define PLUGIN_MEM_BUFFER_SLACK (4 * TCG_MAX_INSNS)
+#define PLUGIN_MEM_BUFFER_MAX_BATCH (1 << 24)
+
+struct qemu_plugin_mem_buffer *
+plugin_mem_buffer_new(qemu_plugin_id_t id, size_t batch,
+                      qemu_plugin_vcpu_mem_batch_cb_t cb, void *userdata)
+{
+    struct qemu_plugin_mem_buffer *buf;
+
+    buf = g_new0(struct qemu_plugin_mem_buffer, 1);
+    buf->batch = MIN(MAX(batch, 1), PLUGIN_MEM_BUFFER_MAX_BATCH);
+    buf->size = pow2ceil(buf->batch + PLUGIN_MEM_BUFFER_SLACK);
+    buf->cb = cb;
+    buf->userdata = userdata;
+    buf->score = plugin_scoreboard_new(sizeof(struct plugin_mem_buffer_ring) +
+                                       buf->size *
+                                       sizeof(struct qemu_plugin_mem_event));
+
+    QEMU_LOCK_GUARD(&plugin.lock);
+    buf->ctx = plugin_id_to_ctx_locked(id);
+    QLIST_INSERT_HEAD_RCU(&plugin.mem_buffers, buf, entry);
+    return buf;
+}
+
+static struct plugin_mem_buffer_ring *
+plugin_mem_buffer_ring(struct qemu_plugin_mem_buffer *buf,
+                       unsigned int cpu_index)
+{
+    return (struct plugin_mem_buffer_ring *)((char *)buf->score->data +
+                                             buf->score->stride * cpu_index);
+}
+
+/*
+ * Must run on the thread of vCPU @cpu_index, or with it stopped.
+ *
+ * Disable CFI checks.
+ * The callback function has been loaded from an external library so we do not
+ * have type information
+ */
+QEMU_DISABLE_CFI
+static void plugin_mem_buffer_deliver(struct qemu_plugin_mem_buffer *buf,
+                                      unsigned int cpu_index)
+{
+    struct plugin_mem_buffer_ring *ring = plugin_mem_buffer_ring(buf,
+                                                                 cpu_index);
+    uint64_t n = MIN(ring->head, buf->size);
+    uint32_t start = (ring->head - n) & (buf->size - 1);
+
+    if (n == 0) {
+        return;
+    }
+    if (ring->head > buf->size) {
+        /* a block added more than PLUGIN_MEM_BUFFER_SLACK events */
+        warn_report_once("plugin: buffered memory accesses were dropped");
+    }
+    if (start + n > buf->size) {
+        buf->cb(cpu_index, &ring->events[start], buf->size - start,
+                buf->userdata);
+        n -= buf->size - start;
+        start = 0;
+    }
+    buf->cb(cpu_index, &ring->events[start], n, buf->userdata);
+    ring->head = 0;
+}
+
+/* called from the checks added by plugin_mem_buffers_add_checks() */
+static void plugin_mem_buffer_batch_cb(unsigned int cpu_index, void *udata)
+{
+    plugin_mem_buffer_deliver(udata, cpu_index);
+}
+
+/* the events added from helpers, which may do any number of accesses */
+static void plugin_mem_buffer_append(struct qemu_plugin_dyn_cb *cb,
+                                     unsigned int cpu_index, uint64_t vaddr,
+                                     uint32_t info)
+{
+    struct qemu_plugin_mem_buffer *buf = cb->mem_buffer.buf;
+    struct plugin_mem_buffer_ring *ring = plugin_mem_buffer_ring(buf,
+                                                                 cpu_index);
+    struct qemu_plugin_mem_event *ev;
+
+    ev = &ring->events[ring->head & (buf->size - 1)];
+    ev->vaddr = vaddr;
+    ev->userdata = cb->userp;
+    ev->info = info;
+    if (++ring->head >= buf->size) {
+        plugin_mem_buffer_deliver(buf, cpu_index);
+    }
+}
+
+static void plugin_mem_buffers_deliver_vcpu(unsigned int cpu_index)
+{
+    struct qemu_plugin_mem_buffer *buf;
+
+    if (cpu_index >= plugin_num_vcpus()) {
+        return;
+    }
+    QLIST_FOREACH_RCU(buf, &plugin.mem_buffers, entry) {
+        plugin_mem_buffer_deliver(buf, cpu_index);
+    }
+}
+
+/*
+ * Deliver the pending events of @ctx's buffers and, on uninstall, free
+ * them. Runs with all vCPUs stopped and the code cache flushed.
+ */
+void plugin_mem_buffers_release__locked(struct qemu_plugin_ctx *ctx,
+                                        bool uninstall)
+{
+    struct qemu_plugin_mem_buffer *buf, *next;
+    unsigned int i;
+
+    QLIST_FOREACH_SAFE(buf, &plugin.mem_buffers, entry, next) {
+        if (buf->ctx != ctx) {
+            continue;
+        }
+        for (i = 0; i < plugin.num_vcpus; i++) {
+            plugin_mem_buffer_deliver(buf, i);
+        }
+        if (uninstall) {
+            QLIST_REMOVE_RCU(buf, entry);
+            plugin_scoreboard_free(buf->score);
+            g_free(buf);
+        }
+    }
+}
+
+static bool plugin_tb_checks_buffer(struct qemu_plugin_tb *tb,
+                                    struct qemu_plugin_mem_buffer *buf)
+{
+    GArray *cbs = tb->cbs[PLUGIN_CB_COND];
+    size_t i;
+
+    for (i = 0; cbs && i < cbs->len; i++) {
+        struct qemu_plugin_dyn_cb *cb =
+            &g_array_index(cbs, struct qemu_plugin_dyn_cb, i);
+
+        if (cb->f.vcpu_udata == plugin_mem_buffer_batch_cb &&
+            cb->userp == buf) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Deliver the events of the buffers used by @tb when it starts, once a
+ * batch has been collected. The ring then has room for the events added
+ * by @tb, without any test in the code of the accesses.
+ */
+static void plugin_mem_buffers_add_checks(struct qemu_plugin_tb *tb)
+{
+    size_t i, j;
+
+    for (i = 0; i < tb->n; i++) {
+        struct qemu_plugin_insn *insn = g_ptr_array_index(tb->insns, i);
+        GArray *cbs = insn->cbs[PLUGIN_CB_MEM][PLUGIN_CB_BUFFERED];
+
+        for (j = 0; j < cbs->len; j++) {
+            struct qemu_plugin_dyn_cb *cb =
+                &g_array_index(cbs, struct qemu_plugin_dyn_cb, j);
+            struct qemu_plugin_mem_buffer *buf = cb->mem_buffer.buf;
+
+            if (plugin_tb_checks_buffer(tb, buf)) {
+                continue;
+            }
+            plugin_register_dyn_cb_cond__udata(
+                &tb->cbs[PLUGIN_CB_COND], plugin_mem_buffer_batch_cb,
+                QEMU_PLUGIN_CB_NO_REGS, QEMU_PLUGIN_COND_GE,
+                (char *)buf->score->data +
+                offsetof(struct plugin_mem_buffer_ring, head),
+                buf->score->stride, buf->batch, buf);
+        }
+    }
+}
+
 void qemu_plugin_vcpu_exit_hook(CPUState *cpu)
 {
     bool success;
 
+    plugin_mem_buffers_deliver_vcpu(cpu->cpu_index);
     plugin_vcpu_cb__simple(cpu, QEMU_PLUGIN_EV_VCPU_EXIT);
 
     qemu_rec_mutex_lock(&plugin.lock);
@@ -285,7 +540,7 @@ static struct qemu_plugin_dyn_cb *plugin_get_dyn_cb(GArray **arr)
 void plugin_register_inline_op(GArray **arr,
                                enum qemu_plugin_mem_rw rw,
                                enum qemu_plugin_op op, void *ptr,
-                               uint64_t imm)
+                               uint32_t stride, uint64_t imm)
 {
     struct qemu_plugin_dyn_cb *dyn_cb;
 
@@ -295,6 +550,37 @@ void plugin_register_inline_op(GArray **arr,
     dyn_cb->rw = rw;
     dyn_cb->inline_insn.op = op;
     dyn_cb->inline_insn.imm = imm;
+    dyn_cb->inline_insn.stride = stride;
+}
+
+struct qemu_plugin_scoreboard *plugin_scoreboard_new(size_t element_size)
+{
+    struct qemu_plugin_scoreboard *score;
+
+    score = g_new0(struct qemu_plugin_scoreboard, 1);
+    score->element_size = element_size;
+    score->stride = ROUND_UP(MAX(element_size, 1), PLUGIN_SCOREBOARD_ALIGN);
+
+    QEMU_LOCK_GUARD(&plugin.lock);
+    score->data = plugin_scoreboard_alloc(score->stride,
+                                          plugin.scoreboard_alloc_size);
+    QLIST_INSERT_HEAD(&plugin.scoreboards, score, entry);
+    return score;
+}
+
+void plugin_scoreboard_free(struct qemu_plugin_scoreboard *score)
+{
+    qemu_rec_mutex_lock(&plugin.lock);
+    QLIST_REMOVE(score, entry);
+    qemu_rec_mutex_unlock(&plugin.lock);
+
+    qemu_vfree(score->data);
+    g_free(score);
+}
+
+unsigned int plugin_num_vcpus(void)
+{
+    return qatomic_read(&plugin.num_vcpus);
 }
 
 static inline uint32_t cb_to_tcg_flags(enum qemu_plugin_cb_flags flags)
@@ -328,6 +614,26 @@ plugin_register_dyn_cb__udata(GArray **arr,
     dyn_cb->type = PLUGIN_CB_REGULAR;
 }
 
+void
+plugin_register_dyn_cb_cond__udata(GArray **arr,
+                                   qemu_plugin_vcpu_udata_cb_t cb,
+                                   enum qemu_plugin_cb_flags flags,
+                                   enum qemu_plugin_cond cond, void *ptr,
+                                   uint32_t stride, uint64_t imm,
+                                   void *udata)
+{
+    struct qemu_plugin_dyn_cb *dyn_cb = plugin_get_dyn_cb(arr);
+
+    dyn_cb->userp = udata;
+    dyn_cb->tcg_flags = cb_to_tcg_flags(flags);
+    dyn_cb->f.vcpu_udata = cb;
+    dyn_cb->type = PLUGIN_CB_COND;
+    dyn_cb->cond.cond = cond;
+    dyn_cb->cond.ptr = ptr;
+    dyn_cb->cond.stride = stride;
+    dyn_cb->cond.imm = imm;
+}
+
 void plugin_register_vcpu_mem_cb(GArray **arr,
                                  void *cb,
                                  enum qemu_plugin_cb_flags flags,
@@ -344,6 +650,24 @@ void plugin_register_vcpu_mem_cb(GArray **arr,
     dyn_cb->f.generic = cb;
 }
 
+void plugin_register_vcpu_mem_buffered(GArray **arr,
+                                       enum qemu_plugin_mem_rw rw,
+                                       struct qemu_plugin_mem_buffer *buf,
+                                       void *udata)
+{
+    struct qemu_plugin_dyn_cb *dyn_cb;
+
+    dyn_cb = plugin_get_dyn_cb(arr);
+    dyn_cb->userp = udata;
+    dyn_cb->type = PLUGIN_CB_BUFFERED;
+    dyn_cb->rw = rw;
+    dyn_cb->mem_buffer.buf = buf;
+    /* the scoreboard does not move while translated code uses it */
+    dyn_cb->mem_buffer.ptr = buf->score->data;
+    dyn_cb->mem_buffer.stride = buf->score->stride;
+    dyn_cb->mem_buffer.mask = buf->size - 1;
+}
+
 /*
  * Disable CFI checks.
  * The callback function has been loaded from an external library so we do not
@@ -362,6 +686,11 @@ void qemu_plugin_tb_trans_cb(CPUState *cpu, struct qemu_plugin_tb *tb)
 
         func(cb->ctx->id, tb);
     }
+
+    /* mem-only blocks are short; the next full block does the check */
+    if (!tb->mem_only) {
+        plugin_mem_buffers_add_checks(tb);
+    }
 }
 
 /*
@@ -411,8 +740,58 @@ void qemu_plugin_vcpu_syscall_ret(CPUState *cpu, int64_t num, int64_t ret)
     }
 }
 
+/*
+ * Disable CFI checks.
+ * The callback function has been loaded from an external library so we do not
+ * have type information
+ */
+QEMU_DISABLE_CFI
+void qemu_plugin_vcpu_cap_reg_write(CPUState *cpu, unsigned int regnum,
+                                    uint64_t pesbt, bool tag, uint64_t cursor)
+{
+    struct qemu_plugin_cb *cb, *next;
+    enum qemu_plugin_event ev = QEMU_PLUGIN_EV_VCPU_CAP_REG_WRITE;
+    struct qemu_plugin_cap cap = {
+        .cursor = cursor,
+        .pesbt = pesbt,
+        .tag = tag,
+    };
+
+    /* no plugin_mask check here; caller should have checked */
+
+    QLIST_FOREACH_SAFE_RCU(cb, &plugin.cb_lists[ev], entry, next) {
+        qemu_plugin_vcpu_cap_reg_cb_t func = cb->f.vcpu_cap_reg;
+
+        func(cb->ctx->id, cpu->cpu_index, regnum, &cap);
+    }
+}
+
+/*
+ * Disable CFI checks.
+ * The callback function has been loaded from an external library so we do not
+ * have type information
+ */
+QEMU_DISABLE_CFI
+void qemu_plugin_vcpu_cheri_exception(CPUState *cpu, unsigned int cause,
+                                      unsigned int regnum, uint64_t vaddr)
+{
+    struct qemu_plugin_cb *cb, *next;
+    enum qemu_plugin_event ev = QEMU_PLUGIN_EV_VCPU_CHERI_EXCP;
+
+    if (!test_bit(ev, cpu->plugin_mask)) {
+        return;
+    }
+
+    QLIST_FOREACH_SAFE_RCU(cb, &plugin.cb_lists[ev], entry, next) {
+        qemu_plugin_vcpu_cheri_excp_cb_t func = cb->f.vcpu_cheri_excp;
+
+        func(cb->ctx->id, cpu->cpu_index, cause, regnum, vaddr);
+    }
+}
+
 void qemu_plugin_vcpu_idle_cb(CPUState *cpu)
 {
+    plugin_mem_buffers_deliver_vcpu(cpu->cpu_index);
     plugin_vcpu_cb__simple(cpu, QEMU_PLUGIN_EV_VCPU_IDLE);
 }
 
@@ -453,9 +832,10 @@ void qemu_plugin_flush_cb(void)
     plugin_cb__simple(QEMU_PLUGIN_EV_FLUSH);
 }
 
-void exec_inline_op(struct qemu_plugin_dyn_cb *cb)
+void exec_inline_op(struct qemu_plugin_dyn_cb *cb, int cpu_index)
 {
-    uint64_t *val = cb->userp;
+    uint64_t *val = (uint64_t *)((char *)cb->userp +
+                                 cb->inline_insn.stride * cpu_index);
 
     switch (cb->inline_insn.op) {
     case QEMU_PLUGIN_INLINE_ADD_U64:
@@ -480,14 +860,20 @@ void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr, uint32_t info)
         int w = !!(info & TRACE_MEM_ST) + 1;
 
         if (!(w & cb->rw)) {
-                break;
+            continue;
+        }
+        if ((cb->rw & QEMU_PLUGIN_MEM_CAP_ONLY) && !(info & TRACE_MEM_CAP)) {
+            continue;
         }
         switch (cb->type) {
         case PLUGIN_CB_REGULAR:
             cb->f.vcpu_mem(cpu->cpu_index, info, vaddr, cb->userp);
             break;
         case PLUGIN_CB_INLINE:
-            exec_inline_op(cb);
+            exec_inline_op(cb, cpu->cpu_index);
+            break;
+        case PLUGIN_CB_BUFFERED:
+            plugin_mem_buffer_append(cb, cpu->cpu_index, vaddr, info);
             break;
         default:
             g_assert_not_reached();
@@ -495,8 +881,37 @@ void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr, uint32_t info)
     }
 }
 
+/*
+ * Capability loads and stores are done by helpers with host accesses, so
+ * report them to the mem callbacks of the instruction as one access that
+ * plugins can query the transferred and the authorising capability of.
+ * The helpers do not report the individual words of the access, so inline
+ * ops and buffered records registered for the instruction run from here,
+ * i.e. from the helper rather than from generated code.
+ */
+void qemu_plugin_vcpu_cap_mem_cb(CPUState *cpu, uint64_t vaddr,
+                                 uint32_t info, uint64_t pesbt, bool tag,
+                                 uint64_t cursor,
+                                 const struct qemu_plugin_cap *auth)
+{
+    if (cpu->plugin_mem_cbs == NULL) {
+        return;
+    }
+    plugin_cap_access.cursor = cursor;
+    plugin_cap_access.pesbt = pesbt;
+    plugin_cap_access.tag = tag;
+    plugin_cap_auth = *auth;
+    qemu_plugin_vcpu_mem_cb(cpu, vaddr, info | TRACE_MEM_CAP);
+}
+
 void qemu_plugin_atexit_cb(void)
 {
+    unsigned int n = plugin_num_vcpus();
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        plugin_mem_buffers_deliver_vcpu(i);
+    }
     plugin_cb__udata(QEMU_PLUGIN_EV_ATEXIT);
 }
 
@@ -533,6 +948,9 @@ static void __attribute__((__constructor__)) plugin_init(void)
     plugin.id_ht = g_hash_table_new(g_int64_hash, g_int64_equal);
     plugin.cpu_ht = g_hash_table_new(g_int_hash, g_int_equal);
     QTAILQ_INIT(&plugin.ctxs);
+    QLIST_INIT(&plugin.scoreboards);
+    plugin.scoreboard_alloc_size = 1;
+    QLIST_INIT(&plugin.mem_buffers);
     qht_init(&plugin.dyn_cb_arr_ht, plugin_dyn_cb_arr_cmp, 16,
              QHT_MODE_AUTO_RESIZE);
     atexit(qemu_plugin_atexit_cb);
@@ -43,6 +43,37 @@ struct qemu_plugin_state {
      * the code cache is flushed.
      */
     struct qht dyn_cb_arr_ht;
+    /*
+     * Scoreboards have room for @scoreboard_alloc_size vCPUs. They are
+     * reallocated, and the code cache flushed, when a vCPU with a higher
+     * index is created.
+     */
+    QLIST_HEAD(, qemu_plugin_scoreboard) scoreboards;
+    size_t scoreboard_alloc_size;
+    /* highest index of the vCPUs created so far, plus one */
+    unsigned int num_vcpus;
+    /* read by vCPUs without @lock; only removed from with vCPUs stopped */
+    QLIST_HEAD(, qemu_plugin_mem_buffer) mem_buffers;
+};
+
+struct qemu_plugin_scoreboard {
+    void *data;
+    size_t element_size;
+    /* @element_size rounded up to a whole number of cache lines */
+    size_t stride;
+    QLIST_ENTRY(qemu_plugin_scoreboard) entry;
+};
+
+struct qemu_plugin_mem_buffer {
+    struct qemu_plugin_ctx *ctx;
+    /* of struct plugin_mem_buffer_ring */
+    struct qemu_plugin_scoreboard *score;
+    /* number of events in each ring; a power of two */
+    uint32_t size;
+    uint32_t batch;
+    qemu_plugin_vcpu_mem_batch_cb_t cb;
+    void *userdata;
+    QLIST_ENTRY(qemu_plugin_mem_buffer) entry;
 };
 
 
@@ -61,12 +92,23 @@ struct qemu_plugin_ctx {
     bool resetting;
 };
 
+/* capability being loaded or stored while mem callbacks run */
+extern __thread struct qemu_plugin_cap plugin_cap_access;
+/* capability that authorised that access */
+extern __thread struct qemu_plugin_cap plugin_cap_auth;
+
 struct qemu_plugin_ctx *plugin_id_to_ctx_locked(qemu_plugin_id_t id);
 
 void plugin_register_inline_op(GArray **arr,
                                enum qemu_plugin_mem_rw rw,
                                enum qemu_plugin_op op, void *ptr,
-                               uint64_t imm);
+                               uint32_t stride, uint64_t imm);
+
+struct qemu_plugin_scoreboard *plugin_scoreboard_new(size_t element_size);
+
+void plugin_scoreboard_free(struct qemu_plugin_scoreboard *score);
+
+unsigned int plugin_num_vcpus(void);
 
 void plugin_reset_uninstall(qemu_plugin_id_t id,
                             qemu_plugin_simple_cb_t cb,
@@ -87,6 +129,13 @@ plugin_register_dyn_cb__udata(GArray **arr,
                               qemu_plugin_vcpu_udata_cb_t cb,
                               enum qemu_plugin_cb_flags flags, void *udata);
 
+void
+plugin_register_dyn_cb_cond__udata(GArray **arr,
+                                   qemu_plugin_vcpu_udata_cb_t cb,
+                                   enum qemu_plugin_cb_flags flags,
+                                   enum qemu_plugin_cond cond, void *ptr,
+                                   uint32_t stride, uint64_t imm,
+                                   void *udata);
 
 void plugin_register_vcpu_mem_cb(GArray **arr,
                                  void *cb,
@@ -94,6 +143,18 @@ void plugin_register_vcpu_mem_cb(GArray **arr,
                                  enum qemu_plugin_mem_rw rw,
                                  void *udata);
 
-void exec_inline_op(struct qemu_plugin_dyn_cb *cb);
+void exec_inline_op(struct qemu_plugin_dyn_cb *cb, int cpu_index);
+
+struct qemu_plugin_mem_buffer *
+plugin_mem_buffer_new(qemu_plugin_id_t id, size_t batch,
+                      qemu_plugin_vcpu_mem_batch_cb_t cb, void *userdata);
+
+void plugin_register_vcpu_mem_buffered(GArray **arr,
+                                       enum qemu_plugin_mem_rw rw,
+                                       struct qemu_plugin_mem_buffer *buf,
+                                       void *udata);
+
+void plugin_mem_buffers_release__locked(struct qemu_plugin_ctx *ctx,
+                                        bool uninstall);
 
 #endif /* _PLUGIN_INTERNAL_H_ */
@@ -141,6 +141,9 @@ DEF("accel", HAS_ARG, QEMU_OPTION_accel,
     "                kvm-shadow-mem=size of KVM shadow MMU in bytes\n"
     "                split-wx=on|off (enable TCG split w^x mapping)\n"
     "                tb-size=n (TCG translation block cache size)\n"
+    "                jmp-cache-bits=n (log2 of TCG jump cache sets per vCPU)\n"
+    "                slow-path-profile=on|off (profile TCG softmmu slow path accesses)\n"
+    "                tlb-resize-window=n (TCG TLB resize window in ms)\n"
     "                thread=single|multi (enable multi-threaded TCG)\n", QEMU_ARCH_ALL)
 SRST
 ``-accel name[,prop=value[,...]]``
@@ -174,6 +177,25 @@ SRST
     ``tb-size=n``
         Controls the size (in MiB) of the TCG translation block cache.
 
+    ``jmp-cache-bits=n``
+        Sets the number of sets in each vCPU's TCG jump cache to 2^n
+        (8 to 16, default 12). Each set holds two translation blocks.
+
+    ``slow-path-profile=on|off``
+        Counts, per guest instruction, the loads and stores that miss the
+        inline TLB lookup of the TCG softmmu, such as MMIO accesses and
+        accesses that cross a page boundary. Instructions that do so
+        repeatedly are retranslated to call the slow path directly, and
+        are translated back once most of their accesses hit the TLB again.
+        Defaults to off.
+
+    ``tlb-resize-window=n``
+        Sets the time window, in milliseconds, over which the use rate of
+        each TCG softmmu TLB is tracked. A TLB is only shrunk when its use
+        rate stayed low for a whole window. Defaults to 100. The resulting
+        behaviour can be observed with the ``query-tlb-stats`` QMP command
+        and ``info tlb-stats``.
+
     ``thread=single|multi``
         Controls number of TCG threads. When the TCG is multi-threaded
         there will be one thread per vCPU therefore taking advantage of
@@ -2660,13 +2660,9 @@ MemoryRegion *get_system_io(void)
     return system_io;
 }
 
-static void invalidate_and_set_dirty(MemoryRegion *mr, hwaddr addr,
-                                     hwaddr length)
+static void set_dirty(MemoryRegion *mr, hwaddr addr, hwaddr length)
 {
     uint8_t dirty_log_mask = memory_region_get_dirty_log_mask(mr);
-#if defined(TARGET_CHERI)
-    ram_addr_t ram_offset = addr;
-#endif
     addr += memory_region_get_ram_addr(mr);
 
     /* No early return if dirty_log_mask is or becomes 0, because
@@ -2683,14 +2679,37 @@ static void invalidate_and_set_dirty(MemoryRegion *mr, hwaddr addr,
         dirty_log_mask &= ~(1 << DIRTY_MEMORY_CODE);
     }
     cpu_physical_memory_set_dirty_range(addr, length, dirty_log_mask);
+}
 
+static void invalidate_and_set_dirty(MemoryRegion *mr, hwaddr addr,
+                                     hwaddr length)
+{
+    set_dirty(mr, addr, length);
 #if defined(TARGET_CHERI)
     /* Invalidate the CHERI memory tags. */
     if (mr->ram_block) {
-        cheri_tag_phys_invalidate(NULL, mr->ram_block, ram_offset, length,
-                                  NULL);
+        cheri_tag_phys_invalidate(NULL, mr->ram_block, addr, length, NULL);
+    }
+#endif
+}
+
+/*
+ * Copy @buf to RAM at offset @addr in @mr and mark it dirty. For CHERI the
+ * tags are cleared atomically with the copy instead of after it, so that
+ * vCPUs can never observe the new data with a stale tag.
+ */
+static void write_and_set_dirty(MemoryRegion *mr, hwaddr addr, void *ram_ptr,
+                                const void *buf, hwaddr length)
+{
+#if defined(TARGET_CHERI)
+    if (mr->ram_block) {
+        cheri_tag_phys_write(mr->ram_block, addr, ram_ptr, buf, length);
+        set_dirty(mr, addr, length);
+        return;
     }
 #endif
+    memcpy(ram_ptr, buf, length);
+    invalidate_and_set_dirty(mr, addr, length);
 }
 
 void memory_region_flush_rom_device(MemoryRegion *mr, hwaddr addr, hwaddr size)
@@ -2773,8 +2792,7 @@ static MemTxResult flatview_write_continue(FlatView *fv, hwaddr addr,
         } else {
             /* RAM case */
             ram_ptr = qemu_ram_ptr_length(mr->ram_block, addr1, &l, false);
-            memcpy(ram_ptr, buf, l);
-            invalidate_and_set_dirty(mr, addr1, l);
+            write_and_set_dirty(mr, addr1, ram_ptr, buf, l);
         }
 
         if (release_lock) {
@@ -3038,8 +3056,7 @@ static inline MemTxResult address_space_write_rom_internal(AddressSpace *as,
             ram_ptr = qemu_map_ram_ptr(mr->ram_block, addr1);
             switch (type) {
             case WRITE_DATA:
-                memcpy(ram_ptr, buf, l);
-                invalidate_and_set_dirty(mr, addr1, l);
+                write_and_set_dirty(mr, addr1, ram_ptr, buf, l);
                 break;
             case FLUSH_CACHE:
                 flush_idcache_range((uintptr_t)ram_ptr, (uintptr_t)ram_ptr, l);
@@ -3283,6 +3300,15 @@ void *address_space_map(AddressSpace *as,
                                         l, is_write, attrs);
     fuzz_dma_read_cb(addr, *plen, mr);
     ptr = qemu_ram_ptr_length(mr->ram_block, xlat, plen, true);
+#if defined(TARGET_CHERI)
+    /*
+     * The caller writes to the mapping directly, so clear the tags before
+     * handing it out (and again in address_space_unmap()).
+     */
+    if (is_write) {
+        cheri_tag_phys_invalidate(NULL, mr->ram_block, xlat, *plen, NULL);
+    }
+#endif
 
     return ptr;
 }
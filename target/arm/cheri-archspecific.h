@@ -94,6 +94,8 @@ static inline void QEMU_NORETURN raise_cheri_exception_impl_if_wnr(
 {
     ARMFaultType arm_fault = cheri_cause_to_arm_fault(cause);
 
+    qemu_plugin_vcpu_cheri_exception(env_cpu(env), cause, regnum, addr);
+
     int target_el = exception_target_el_capability(env);
     int current_el = arm_current_el(env);
 
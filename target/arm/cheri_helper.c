@@ -68,7 +68,8 @@ void helper_store_cap_via_cap_mmu_idx(CPUArchState *env, uint32_t cd,
                          CHERI_CAP_SIZE, _host_return_address, cbp,
                          CHERI_CAP_SIZE, raise_unaligned_store_exception);
 
-    store_cap_to_memory_mmu_index(env, cd, addr, _host_return_address, mmu_idx);
+    store_cap_to_memory_mmu_index(env, cd, cbp, addr, _host_return_address,
+                                  mmu_idx);
 }
 
 void helper_load_cap_pair_via_cap(CPUArchState *env, uint32_t cd, uint32_t cd2,
@@ -105,12 +106,13 @@ void helper_store_cap_pair_via_cap(CPUArchState *env, uint32_t cd, uint32_t cd2,
     cap_check_common_reg(perms_for_store(env, cd), env, cb, addr,
                          CHERI_CAP_SIZE, _host_return_address, cbp,
                          CHERI_CAP_SIZE, raise_unaligned_store_exception);
-    store_cap_to_memory(env, cd, addr, _host_return_address);
+    store_cap_to_memory(env, cd, cbp, addr, _host_return_address);
     cap_check_common_reg(perms_for_store(env, cd2), env, cb,
                          addr + CHERI_CAP_SIZE, CHERI_CAP_SIZE,
                          _host_return_address, cbp, CHERI_CAP_SIZE,
                          raise_unaligned_store_exception);
-    store_cap_to_memory(env, cd2, addr + CHERI_CAP_SIZE, _host_return_address);
+    store_cap_to_memory(env, cd2, cbp, addr + CHERI_CAP_SIZE,
+                        _host_return_address);
 }
 
 void helper_load_exclusive_cap_via_cap(CPUArchState *env, uint32_t cd,
@@ -208,9 +210,12 @@ void helper_store_exclusive_cap_via_cap(CPUArchState *env, uint32_t rs,
     }
 
     if (success) {
-        store_cap_to_memory(env, cd, addr, _host_return_address);
+        // cbp had its permissions fudged above, report the real authority
+        const cap_register_t *auth = get_capreg_or_special(env, cb);
+
+        store_cap_to_memory(env, cd, auth, addr, _host_return_address);
         if (cd2 != REG_NONE)
-            store_cap_to_memory(env, cd2, addr + CHERI_CAP_SIZE,
+            store_cap_to_memory(env, cd2, auth, addr + CHERI_CAP_SIZE,
                                 _host_return_address);
     }
 
@@ -240,8 +245,8 @@ static void swap_cap_via_cap_impl(CPUArchState *env, uint32_t cd, uint32_t cs,
     int mmu_index = cpu_mmu_index(env, false);
 
     if (cd_tagged)
-        probe_cap_write(env, addr, CHERI_CAP_SIZE, mmu_index,
-                        _host_return_address);
+        cheri_tag_probe_cap_write(env, addr, CHERI_CAP_SIZE, mmu_index,
+                                  _host_return_address);
 
     // load (without modifying cs as we will need it for the comparison)
 
@@ -262,7 +267,7 @@ static void swap_cap_via_cap_impl(CPUArchState *env, uint32_t cd, uint32_t cs,
 
     // Store
     if (do_store) {
-        store_cap_to_memory(env, cd, addr, _host_return_address);
+        store_cap_to_memory(env, cd, cbp, addr, _host_return_address);
     } else {
         cd_tagged = get_without_decompress_tag(env, cd);
         // Even if there is no store, we possibly need an MMU permission fault
@@ -251,9 +251,11 @@ static inline const char* cheri_cause_str(CheriCapExcCause cause) {
     abort();
 }
 
-void store_cap_to_memory(CPUArchState *env, uint32_t cs, target_ulong vaddr,
+void store_cap_to_memory(CPUArchState *env, uint32_t cs,
+                         const cap_register_t *auth, target_ulong vaddr,
                          uintptr_t retpc);
 void store_cap_to_memory_mmu_index(CPUArchState *env, uint32_t cs,
+                                   const cap_register_t *auth,
                                    target_ulong vaddr, uintptr_t retpc,
                                    int mmu_idx);
 
@@ -286,6 +286,36 @@ static inline void rvfi_changed_capreg(CPUArchState *env, unsigned regnum,
 #endif
 }
 
+/*
+ * Report a capability register update to plugins. The check is done inline
+ * since register updates are far more frequent than plugins using them.
+ */
+static inline void plugin_changed_capreg_raw(CPUArchState *env,
+                                             unsigned regnum,
+                                             target_ulong pesbt, bool tag,
+                                             target_ulong cursor)
+{
+    CPUState *cpu = env_cpu(env);
+
+    if (unlikely(test_bit(QEMU_PLUGIN_EV_VCPU_CAP_REG_WRITE,
+                          cpu->plugin_mask))) {
+        qemu_plugin_vcpu_cap_reg_write(cpu, regnum, pesbt, tag, cursor);
+    }
+}
+
+static inline void plugin_changed_capreg(CPUArchState *env, unsigned regnum,
+                                         const cap_register_t *newval)
+{
+    CPUState *cpu = env_cpu(env);
+
+    if (unlikely(test_bit(QEMU_PLUGIN_EV_VCPU_CAP_REG_WRITE,
+                          cpu->plugin_mask))) {
+        qemu_plugin_vcpu_cap_reg_write(cpu, regnum,
+                                       CAP_cc(compress_raw)(newval),
+                                       newval->cr_tag, newval->_cr_cursor);
+    }
+}
+
 static inline void update_capreg(CPUArchState *env, unsigned regnum,
                                  const cap_register_t *newval)
 {
@@ -307,6 +337,8 @@ static inline void update_capreg(CPUArchState *env, unsigned regnum,
                        CREG_FULLY_DECOMPRESSED);
     sanity_check_capreg(gpcrs, regnum);
     rvfi_changed_capreg(env, regnum, newval->_cr_cursor);
+    plugin_changed_capreg_raw(env, regnum, target->cr_pesbt, target->cr_tag,
+                              target->_cr_cursor);
     cheri_log_instr_changed_gp_capreg(env, regnum, target);
 }
 
@@ -344,6 +376,7 @@ static inline void update_capreg_cursor_from(CPUArchState *env, unsigned regnum,
                        CREG_FULLY_DECOMPRESSED);
     sanity_check_capreg(gpcrs, regnum);
     rvfi_changed_capreg(env, regnum, target->_cr_cursor);
+    plugin_changed_capreg(env, regnum, target);
     cheri_log_instr_changed_gp_capreg(env, regnum, target);
 }
 
@@ -363,6 +396,7 @@ static inline void update_compressed_capreg(CPUArchState *env, unsigned regnum,
     cheri_debug_assert(get_capreg_state(gpcrs, regnum) == new_state);
     sanity_check_capreg(gpcrs, regnum);
     rvfi_changed_capreg(env, regnum, cursor);
+    plugin_changed_capreg_raw(env, regnum, pesbt, tag, cursor);
     if (qemu_log_instr_enabled(env)) {
         // Decompress and log value if instruction logging is on
         const cap_register_t *decompressed = get_readonly_capreg(env, regnum);
@@ -34,11 +34,17 @@
 #include "cheri_tagmem.h"
 #include "exec/exec-all.h"
 #include "exec/log.h"
+#ifdef CONFIG_USER_ONLY
+#include "exec/cpu_ldst.h"
+#else
 #include "exec/ramblock.h"
+#endif
 #include "cheri_defs.h"
 #include "cheri-helper-utils.h"
 // XXX: use hbitmap? Or a different data structure?
 #include "qemu/bitmap.h"
+#include "qemu/rcu.h"
+#include "qemu/seqlock.h"
 #include "glib/ghash.h"
 
 #if defined(TARGET_MIPS)
@@ -59,9 +65,10 @@
  * capability-sized word in physical memory.  This allows capabilities
  * to be safely loaded and stored in meory without loss of integrity.
  *
- * For emulation purposes the tag is stored in a two-level array containing
- * fixed size bitmaps. To reduce the amount of memory needed the tag flag array
- * is allocated sparsely, 4K tags at at time, and on demand.
+ * For emulation purposes the tag is stored in fixed size bitmaps that are
+ * found through a sparse directory shared by all RAMBlocks (see
+ * struct CheriTagMem below). To reduce the amount of memory needed the
+ * bitmaps are allocated sparsely, 4K tags at at time, and on demand.
  * This 4K number is arbitary and depending on the workload other sizes may be
  * better.
  *
@@ -69,25 +76,70 @@
  * easy to set or unset a tag without the need of locking or atomics.
  * This requires eight times the memory.
  *
- * As tag accesses are not atomic with regard to data writes/reads spurious
- * invalid capabilities could be created in a threaded context.
- * Therefore, we don't use atomic bitwise RMW operations and the one byte per
- * tag variant actually performs slightly worse due to increased memory usage.
+ * Tag bits are updated with atomic bitwise RMW operations, but that alone does
+ * not make a capability access atomic: the tag and the data words live in
+ * different places, so with MTTCG another vCPU could observe the new data
+ * with the old tag (or vice versa) and thereby forge a capability.
+ * We therefore protect each line of BITS_PER_LONG granules (i.e. the granules
+ * covered by one word of the tag bitmap) with one of a fixed number of striped
+ * seqlocks (see CheriTagLock below), indexed by the host address of the line
+ * so that all guest aliases share the same lock:
+ *
+ *  - Writers (CSC, and data stores/atomics from TBs translated with
+ *    CF_PARALLEL) first probe the target address so that any TLB fault is
+ *    taken without holding a lock, then update the data and the tag inside a
+ *    write-side critical section. Tag clearing for data stores happens inside
+ *    the same critical section as the store itself. Data stores and atomics
+ *    skip the probe and the lock if the TLB entry for the page says that it
+ *    has no tag block (see below).
+ *  - Readers (CLC) read the data words and the tag inside a seqlock read
+ *    section and retry if a writer raced with them, so a tagged result is
+ *    always exactly a capability that some vCPU stored.
  *
- * FIXME: find a solution to make tags safe (or just always disable multi-tcg)
+ * Any lock still held when a helper longjmps out of the TB (e.g. because the
+ * store hit self-modifying code) is dropped by cpu_exec() in the same place
+ * that it drops the iothread lock. Since the lock is only taken for RAM
+ * (i.e. when probe_write() returns a host address), device code never runs
+ * with a tag lock held. Data stores and atomics in TBs translated without
+ * CF_PARALLEL do not take the lock: they only ever clear tags and the vCPUs
+ * are not running concurrently. CSC always takes it since it can race with
+ * I/O threads writing to guest memory (see below).
+ *
+ * TLB entries cache the tag block pointer (or ALL_ZERO_TAGBLK) for a page and
+ * other vCPUs only flush those entries asynchronously. Tag blocks are
+ * allocated when a tag is first stored to a page, which flushes the TLBs of
+ * all vCPUs with tlb_flush_all_cpus_synced(). With MTTCG the storing
+ * instruction is then restarted (see cheri_tag_alloc_restart), so that the
+ * tag is only set once the safe work of the flush has run, i.e. once every
+ * other vCPU has left the TB it was executing and will drop its
+ * ALL_ZERO_TAGBLK entry before running guest code again. A vCPU executing a
+ * TB can therefore rely on a page that its TLB caches as ALL_ZERO_TAGBLK not
+ * gaining tags, which is what lets data stores to such pages skip the lock.
  *
  * XXX Should consider adding a reference count per tag block so that
  * blocks can be deallocated when no longer used maybe.
  *
  * FIXME: rewrite using somethign more like the upcoming MTE changes (https://github.com/rth7680/qemu/commits/tgt-arm-mte-user)
  *
- * XXX: I/O threads still exist even without MTTCG and need to have tag
- * clearing be atomic with their writes. Currently various places just write to
- * guest memory directly and then we tag clear in invalidate_and_set_dirty.
- * Well-behaved guests should not be touching memory handed off to DMA-capable
- * devices but a malicious guest could repeatedly DMA powerful capability bit
- * patterns on top of valid capabilities and try to race to read in between the
- * DMA write and the tag invalidate.
+ * I/O threads exist even without MTTCG and also need to have tag clearing be
+ * atomic with their writes: otherwise a malicious guest could repeatedly DMA
+ * powerful capability bit patterns on top of valid capabilities and try to
+ * race to read in between the DMA write and the tag invalidate.
+ * address_space_write() and friends therefore copy the data with
+ * cheri_tag_phys_write(), which takes the same line locks as the vCPUs (one
+ * per line, so bulk copies stay cheap) and does not need the BQL.
+ * For memory mapped with address_space_map() the device writes directly to
+ * guest memory, so the best we can do is to clear the tags both when the
+ * mapping is created (before any data is published) and again when it is
+ * unmapped. Only a guest that stores capabilities into a buffer while it is
+ * being DMA'd to can observe stale tags in that window.
+ *
+ * In user mode (linux-user) there is no RAMBlock or IOTLB to hang the tag
+ * blocks off. Instead, we keep one tag bitmap per guest page in the page's
+ * target data (the same mechanism that the Arm MTE user-mode implementation
+ * uses). The bitmap is allocated on the first tag write to a page and is freed
+ * by page_set_flags() when the page is unmapped or replaced by a new mapping,
+ * so fresh mappings always start out with all tags cleared.
  */
 
 #define CAP_TAGBLK_SHFT     12          // 2^12 or 4096 tags per block
@@ -113,22 +165,66 @@ _Static_assert(CAP_TAG_GET_MANY_SHFT <= 3, "");
 #define CAP_TAG_GET_MANY_MASK ((1 << (1UL << CAP_TAG_GET_MANY_SHFT)) - 1UL)
 #define CAP_TAG_MANY_DATA_SIZE (CHERI_CAP_SIZE << CAP_TAG_GET_MANY_SHFT)
 
-static inline size_t num_tagblocks(RAMBlock* ram)
-{
-    uint64_t memory_size = memory_region_size(ram->mr);
-    size_t result = DIV_ROUND_UP(memory_size, CHERI_CAP_SIZE * CAP_TAGBLK_SIZE);
-    assert(result == (memory_size / CHERI_CAP_SIZE) >> CAP_TAGBLK_SHFT);
-    return result;
-}
-
 typedef struct CheriTagBlock {
     DECLARE_BITMAP(tag_bitmap, CAP_TAGBLK_SIZE);
 } CheriTagBlock;
 
+#ifndef CONFIG_USER_ONLY
+/*
+ * The tag blocks of all RAMBlocks with tags live in a single sparse two-level
+ * directory indexed by ram_addr_t rather than guest physical address: the
+ * ram_addr_t space is dense even when the board's DRAM windows are scattered
+ * over the physical address space, and all aliases of a RAMBlock share it.
+ * Leaf tables and tag blocks are only allocated once they are needed, so
+ * cheri_tag_init() is O(1) and memory use is proportional to the amount of
+ * RAM that has actually held tags rather than to the configured RAM size.
+ */
+#define CAP_TAGDIR_L2_SHFT  10          // 2^10 tag block pointers per leaf
+#define CAP_TAGDIR_L2_SIZE  (1 << CAP_TAGDIR_L2_SHFT)
+#define CAP_TAGDIR_L2_MSK   (CAP_TAGDIR_L2_SIZE - 1)
+#define CAP_TAGDIR_L1_SIZE  (1 << 14)
+#define CAP_TAGDIR_LIMIT                                                       \
+    ((uint64_t)CAP_TAGDIR_L1_SIZE * CAP_TAGDIR_L2_SIZE * CAP_TAGBLK_SIZE *    \
+     CHERI_CAP_SIZE)
+
+struct CheriTagMem {
+    CheriTagBlock **leaves[CAP_TAGDIR_L1_SIZE];
+};
 
-static CheriTagBlock *cheri_tag_new_tagblk(RAMBlock *ram, uint64_t tagidx)
+static struct CheriTagMem cheri_tag_dir;
+
+static inline uint64_t ram_tag_index(RAMBlock *ram, ram_addr_t ram_offset)
+{
+    return (ram->offset + ram_offset) / CHERI_CAP_SIZE;
+}
+
+static CheriTagBlock **cheri_tag_new_leaf(size_t leaf_index)
+{
+    CheriTagBlock **leaf, **old;
+
+    leaf = g_new0(CheriTagBlock *, CAP_TAGDIR_L2_SIZE);
+    /* Possible race here so use atomic compare and swap. */
+    old = qatomic_cmpxchg(&cheri_tag_dir.leaves[leaf_index], NULL, leaf);
+    if (old != NULL) {
+        /* Lost the race, free. */
+        g_free(leaf);
+        return old;
+    }
+    return leaf;
+}
+
+static CheriTagBlock *cheri_tag_new_tagblk(uint64_t tagidx)
 {
     CheriTagBlock *tagblk, *old;
+    const uint64_t tagblock_index = tagidx >> CAP_TAGBLK_SHFT;
+    const size_t leaf_index = tagblock_index >> CAP_TAGDIR_L2_SHFT;
+
+    cheri_debug_assert(leaf_index < CAP_TAGDIR_L1_SIZE &&
+                       "Tag index out of bounds");
+    CheriTagBlock **leaf = qatomic_rcu_read(&cheri_tag_dir.leaves[leaf_index]);
+    if (leaf == NULL) {
+        leaf = cheri_tag_new_leaf(leaf_index);
+    }
 
     tagblk = g_malloc0(sizeof(CheriTagBlock));
     if (tagblk == NULL) {
@@ -136,12 +232,9 @@ static CheriTagBlock *cheri_tag_new_tagblk(RAMBlock *ram, uint64_t tagidx)
         exit(1);
     }
 
-    CheriTagBlock **tagmem = (CheriTagBlock **)ram->cheri_tags;
-    size_t tagblock_index = (tagidx >> CAP_TAGBLK_SHFT);
     /* Possible race here so use atomic compare and swap. */
-    cheri_debug_assert(tagblock_index < num_tagblocks(ram) &&
-                       "Tag index out of bounds");
-    old = qatomic_cmpxchg(&tagmem[tagblock_index], NULL, tagblk);
+    old = qatomic_cmpxchg(&leaf[tagblock_index & CAP_TAGDIR_L2_MSK], NULL,
+                          tagblk);
     if (old != NULL) {
         /* Lost the race, free. */
         g_free(tagblk);
@@ -151,14 +244,122 @@ static CheriTagBlock *cheri_tag_new_tagblk(RAMBlock *ram, uint64_t tagidx)
     }
 }
 
-static inline QEMU_ALWAYS_INLINE CheriTagBlock *cheri_tag_block(size_t tag_index,
-                                                                RAMBlock *ram)
+/* @tag_index is the ram_addr_t of the granule divided by CHERI_CAP_SIZE. */
+static inline QEMU_ALWAYS_INLINE CheriTagBlock *
+cheri_tag_block(uint64_t tag_index)
 {
-    const size_t tagbock_index = tag_index >> CAP_TAGBLK_SHFT;
-    cheri_debug_assert(ram->cheri_tags);
-    cheri_debug_assert(tagbock_index < num_tagblocks(ram));
-    CheriTagBlock **tagmem = (CheriTagBlock **)ram->cheri_tags;
-    return tagmem[tagbock_index];
+    const uint64_t tagblock_index = tag_index >> CAP_TAGBLK_SHFT;
+    const size_t leaf_index = tagblock_index >> CAP_TAGDIR_L2_SHFT;
+    cheri_debug_assert(leaf_index < CAP_TAGDIR_L1_SIZE);
+    CheriTagBlock **leaf = qatomic_rcu_read(&cheri_tag_dir.leaves[leaf_index]);
+    if (leaf == NULL) {
+        return NULL;
+    }
+    return qatomic_rcu_read(&leaf[tagblock_index & CAP_TAGDIR_L2_MSK]);
+}
+#else
+#define TAGS_PER_PAGE_BITMAP_SIZE                                              \
+    (BITS_TO_LONGS(TAGS_PER_PAGE) * sizeof(unsigned long))
+/*
+ * There is no IOTLB in user mode, but we re-use the same flags and magic
+ * constant so that the vaddr-based functions below can be shared.
+ */
+#define TLBENTRYCAP_FLAG_TRAP (uintptr_t)0x1
+#define TLBENTRYCAP_FLAG_TRAP_ANY (uintptr_t)0x4
+#define TLBENTRYCAP_FLAG_CLEAR (uintptr_t)0x2
+#define ALL_ZERO_TAGBLK ((void *)(uintptr_t)~(uintptr_t)0x7)
+#endif /* !CONFIG_USER_ONLY */
+
+/* Address to print in the instruction log for a tag access. */
+static inline ram_addr_t tag_log_addr(void *host_addr)
+{
+#ifdef CONFIG_USER_ONLY
+    return h2g(host_addr);
+#else
+    return qemu_ram_addr_from_host(host_addr);
+#endif
+}
+
+#define CHERI_TAG_LOCK_BITS 10
+#define CHERI_TAG_NUM_LOCKS (1 << CHERI_TAG_LOCK_BITS)
+/* One lock covers the granules of one word of the tag bitmap. */
+#define CHERI_TAG_LINE_SIZE (CHERI_CAP_SIZE * BITS_PER_LONG)
+
+typedef struct CheriTagLock {
+    QemuSeqLock seq;
+    QemuSpin spin;
+} QEMU_ALIGNED(64) CheriTagLock;
+
+/* Zero-initialized seqlocks and spinlocks are valid and unlocked. */
+static CheriTagLock cheri_tag_locks[CHERI_TAG_NUM_LOCKS];
+/*
+ * A single store can touch at most two lines (an unaligned store that
+ * crosses a line boundary), so at most two locks are held.
+ */
+static __thread CheriTagLock *cheri_tag_locks_held[2];
+
+#ifndef CONFIG_USER_ONLY
+/*
+ * Set when a TLB fill on this thread allocated a tag block with MTTCG. The
+ * instruction must be restarted before it sets any tags, see above.
+ */
+static __thread bool cheri_tag_alloc_restart;
+#endif
+
+static inline CheriTagLock *cheri_tag_lock_for_host(const void *host)
+{
+    uintptr_t line = (uintptr_t)host / CHERI_TAG_LINE_SIZE;
+    return &cheri_tag_locks[line & (CHERI_TAG_NUM_LOCKS - 1)];
+}
+
+static void cheri_tag_lock_host(const void *first, const void *last)
+{
+    CheriTagLock *a = first ? cheri_tag_lock_for_host(first) : NULL;
+    CheriTagLock *b = last ? cheri_tag_lock_for_host(last) : NULL;
+
+    cheri_debug_assert(!cheri_tag_locks_held[0] && !cheri_tag_locks_held[1]);
+    if (a == b) {
+        b = NULL;
+    } else if (a == NULL || (b != NULL && b < a)) {
+        /* Always lock in address order to avoid ABBA deadlocks. */
+        CheriTagLock *tmp = a;
+        a = b;
+        b = tmp;
+    }
+    if (a) {
+        seqlock_write_lock(&a->seq, &a->spin);
+        cheri_tag_locks_held[0] = a;
+    }
+    if (b) {
+        seqlock_write_lock(&b->seq, &b->spin);
+        cheri_tag_locks_held[1] = b;
+    }
+}
+
+void cheri_tag_unlock(void)
+{
+    for (int i = ARRAY_SIZE(cheri_tag_locks_held) - 1; i >= 0; i--) {
+        CheriTagLock *lock = cheri_tag_locks_held[i];
+        if (lock) {
+            cheri_tag_locks_held[i] = NULL;
+            seqlock_write_unlock(&lock->seq, &lock->spin);
+        }
+    }
+}
+
+bool cheri_tag_is_locked(void)
+{
+    return cheri_tag_locks_held[0] || cheri_tag_locks_held[1];
+}
+
+unsigned cheri_tag_read_begin(const void *host)
+{
+    return seqlock_read_begin(&cheri_tag_lock_for_host(host)->seq);
+}
+
+bool cheri_tag_read_retry(const void *host, unsigned start)
+{
+    return seqlock_read_retry(&cheri_tag_lock_for_host(host)->seq, start);
 }
 
 static inline QEMU_ALWAYS_INLINE bool tagblock_get_tag_tagmem(void *tagmem,
@@ -231,26 +432,35 @@ static inline QEMU_ALWAYS_INLINE void tagblock_clear_tag(CheriTagBlock *block,
     tagblock_clear_tag_tagmem(block->tag_bitmap, block_index);
 }
 
+#ifndef CONFIG_USER_ONLY
 void cheri_tag_init(MemoryRegion *mr, uint64_t memory_size)
 {
+    RAMBlock *ram = mr->ram_block;
+
     assert(memory_region_is_ram(mr));
     assert(memory_region_size(mr) == memory_size &&
            "Incorrect tag mem size passed?");
-    assert(mr->ram_block->cheri_tags == NULL && "Already initialized?");
+    assert(ram->cheri_tags == NULL && "Already initialized?");
 
-    size_t cheri_ntagblks = num_tagblocks(mr->ram_block);
-    mr->ram_block->cheri_tags =
-        g_malloc0(cheri_ntagblks * sizeof(CheriTagBlock *));
-    if (mr->ram_block->cheri_tags == NULL) {
-        error_report("%s: Can't allocated tag memory", __func__);
+    if (ram->offset + memory_size > CAP_TAGDIR_LIMIT) {
+        error_report("%s: Can't allocate tag memory for %s: RAM offset 0x%"
+                     PRIx64 " exceeds the tag directory limit", __func__,
+                     ram->idstr, (uint64_t)(ram->offset + memory_size));
         exit(-1);
     }
-    if (qemu_tcg_mttcg_enabled()) {
-        warn_report("The CHERI tagged memory implementation is not thread-safe "
-                    "and therefore not compatible with MTTCG. Capability tags "
-                    "may mysteriously appear/disappear. Run with \"--accel "
-                    "tcg,thread=single\" to fix.");
+    /*
+     * The ram_addr_t range may have belonged to a RAMBlock that has since
+     * been removed, so clear any tags that it left behind.
+     */
+    const uint64_t end = ram_tag_index(ram, memory_size);
+    for (uint64_t tag = ram_tag_index(ram, 0); tag < end;
+         tag = (tag | CAP_TAGBLK_MSK) + 1) {
+        CheriTagBlock *tagblk = cheri_tag_block(tag);
+        if (tagblk != NULL) {
+            bitmap_zero(tagblk->tag_bitmap, CAP_TAGBLK_SIZE);
+        }
     }
+    ram->cheri_tags = &cheri_tag_dir;
 }
 
 void *cheri_tagmem_for_addr(CPUArchState *env, target_ulong vaddr,
@@ -272,15 +482,15 @@ void *cheri_tagmem_for_addr(CPUArchState *env, target_ulong vaddr,
         return ALL_ZERO_TAGBLK;
     }
 
-    uint64_t tag = ram_offset / CHERI_CAP_SIZE;
+    uint64_t tag = ram_tag_index(ram, ram_offset);
 #ifndef TARGET_AARCH64
     // AArch64 seems to use different sizes. Might be worth looking into.
     cheri_debug_assert(size == TARGET_PAGE_SIZE && "Unexpected size");
 #endif
-    CheriTagBlock *tagblk = cheri_tag_block(tag, ram);
+    CheriTagBlock *tagblk = cheri_tag_block(tag);
 
     if (tag_write && !tagblk) {
-        cheri_tag_new_tagblk(ram, tag);
+        cheri_tag_new_tagblk(tag);
         CPUState *cpu = env_cpu(env);
         /*
          * A vaddr-based shootdown is insufficient as multiple mappings may
@@ -292,7 +502,15 @@ void *cheri_tagmem_for_addr(CPUArchState *env, target_ulong vaddr,
          * this instruction and THEN exit.
          */
         tlb_flush(cpu);
-        tagblk = cheri_tag_block(tag, ram);
+        /*
+         * With MTTCG other vCPUs may still be running with this page cached
+         * as tag-free, so the instruction must not complete until they have
+         * all been flushed.
+         */
+        if (qemu_tcg_mttcg_enabled()) {
+            cheri_tag_alloc_restart = true;
+        }
+        tagblk = cheri_tag_block(tag);
         cheri_debug_assert(tagblk);
     }
 
@@ -337,6 +555,81 @@ static inline void *get_tagmem_from_iotlb_entry(CPUArchState *env,
     }
 }
 
+static inline QEMU_ALWAYS_INLINE void *
+get_tagmem_for_vaddr(CPUArchState *env, target_ulong vaddr, int mmu_idx,
+                     bool isWrite, bool alloc, uintptr_t *flags_out)
+{
+    /*
+     * The preceding probe_cap_write() has already allocated the tag block (by
+     * triggering a TLB refill) if a tag is about to be written.
+     */
+    return get_tagmem_from_iotlb_entry(env, vaddr, mmu_idx, isWrite,
+                                       flags_out);
+}
+#else
+static inline QEMU_ALWAYS_INLINE void *
+get_tagmem_for_vaddr(CPUArchState *env, target_ulong vaddr, int mmu_idx,
+                     bool isWrite, bool alloc, uintptr_t *flags_out)
+{
+    /* There is no MMU to mark pages as tag-clearing or tag-trapping. */
+    *flags_out = 0;
+    void *tagmem = page_get_target_data(vaddr);
+    if (tagmem == NULL) {
+        if (!alloc) {
+            return ALL_ZERO_TAGBLK;
+        }
+        tagmem = page_alloc_target_data(vaddr, TAGS_PER_PAGE_BITMAP_SIZE);
+        if (tagmem == NULL) {
+            /* Unmapped by another thread: there is nowhere to store tags. */
+            *flags_out = TLBENTRYCAP_FLAG_CLEAR;
+            return ALL_ZERO_TAGBLK;
+        }
+    }
+    return tagmem;
+}
+
+/*
+ * The two functions below are called from syscall emulation, outside the
+ * RCU read-side critical section that cpu_exec() holds for the TCG helpers,
+ * so they take their own to keep the bitmap alive against a concurrent
+ * munmap().
+ */
+void cheri_tag_user_set(target_ulong vaddr)
+{
+    RCU_READ_LOCK_GUARD();
+    cheri_debug_assert(QEMU_IS_ALIGNED(vaddr, CHERI_CAP_SIZE));
+    void *tagmem = page_alloc_target_data(vaddr, TAGS_PER_PAGE_BITMAP_SIZE);
+    assert(tagmem != NULL && "Setting tag on unmapped page?");
+    tagblock_set_tag_tagmem(tagmem, (vaddr & ~TARGET_PAGE_MASK) /
+                                        CHERI_CAP_SIZE);
+}
+
+void cheri_tag_user_invalidate(target_ulong vaddr, target_ulong len)
+{
+    target_ulong start = QEMU_ALIGN_DOWN(vaddr, CHERI_CAP_SIZE);
+    target_ulong end = vaddr + len;
+
+    if (len == 0) {
+        return;
+    }
+    RCU_READ_LOCK_GUARD();
+    while (start < end) {
+        target_ulong page_end = (start & TARGET_PAGE_MASK) + TARGET_PAGE_SIZE;
+        target_ulong chunk_end = MIN(end, page_end);
+        void *tagmem = page_get_target_data(start);
+        if (tagmem) {
+            size_t first = (start & ~TARGET_PAGE_MASK) / CHERI_CAP_SIZE;
+            size_t ntags = DIV_ROUND_UP(chunk_end - start, CHERI_CAP_SIZE);
+            bitmap_test_and_clear_atomic(tagmem, first, ntags);
+        }
+        if (page_end == 0) {
+            break; /* Wrapped around at the end of the address space. */
+        }
+        start = page_end;
+    }
+}
+#endif /* !CONFIG_USER_ONLY */
+
 typedef struct TagOffset {
     target_ulong value;
 } TagOffset;
@@ -439,8 +732,8 @@ static void *cheri_tag_invalidate_one(CPUArchState *env, target_ulong vaddr,
     }
 
     uintptr_t tagmem_flags;
-    void *tagmem =
-        get_tagmem_from_iotlb_entry(env, vaddr, mmu_idx, true, &tagmem_flags);
+    void *tagmem = get_tagmem_for_vaddr(env, vaddr, mmu_idx, /*write=*/true,
+                                        /*alloc=*/false, &tagmem_flags);
 
     if (tagmem == ALL_ZERO_TAGBLK) {
         // All tags for this page are zero -> no need to invalidate. We also
@@ -462,53 +755,119 @@ static void *cheri_tag_invalidate_one(CPUArchState *env, target_ulong vaddr,
         qemu_log_instr_extra(
             env,
             "    Cap Tag Write [" TARGET_FMT_lx "/" RAM_ADDR_FMT "] %d -> 0\n",
-            vaddr, qemu_ram_addr_from_host(host_addr), old_value);
+            vaddr, tag_log_addr(host_addr), old_value);
     }
 
     tagblock_clear_tag_tagmem(tagmem, tag_offset);
     return host_addr;
 }
 
-void cheri_tag_phys_invalidate(CPUArchState *env, RAMBlock *ram,
-                               ram_addr_t ram_offset, ram_addr_t len,
-                               const target_ulong *vaddr)
+#ifndef CONFIG_USER_ONLY
+static void cheri_tag_phys_invalidate_logged(CPUArchState *env, RAMBlock *ram,
+                                             ram_addr_t ram_offset,
+                                             ram_addr_t len,
+                                             const target_ulong *vaddr)
 {
-    // Ignore tag clearing requests for ROM, etc.
-    if (!ram->cheri_tags) {
-        return;
-    }
-    cheri_debug_assert(!memory_region_is_rom(ram->mr) &&
-                       !memory_region_is_romd(ram->mr));
-
     ram_addr_t endaddr = (uint64_t)(ram_offset + len);
     ram_addr_t startaddr = QEMU_ALIGN_DOWN(ram_offset, CHERI_CAP_SIZE);
 
     for(ram_addr_t addr = startaddr; addr < endaddr; addr += CHERI_CAP_SIZE) {
-        uint64_t tag = addr / CHERI_CAP_SIZE;
-        CheriTagBlock *tagblk = cheri_tag_block(tag, ram);
+        uint64_t tag = ram_tag_index(ram, addr);
+        CheriTagBlock *tagblk = cheri_tag_block(tag);
         if (tagblk != NULL) {
             const size_t tagblk_index = CAP_TAGBLK_IDX(tag);
-            if (unlikely(env && vaddr && qemu_log_instr_enabled(env))) {
+            if (vaddr) {
                 target_ulong write_vaddr =
                     QEMU_ALIGN_DOWN(*vaddr, CHERI_CAP_SIZE) + (addr - startaddr);
                 qemu_log_instr_extra(env, "    Cap Tag Write [" TARGET_FMT_lx
                     "/" RAM_ADDR_FMT "] %d -> 0\n", write_vaddr, addr,
                     tagblock_get_tag(tagblk, tagblk_index));
-            } else if (unlikely(env && qemu_log_instr_enabled(env))) {
+            } else {
                 qemu_log_instr_extra(env, "    Cap Tag ramaddr Write ["
                     RAM_ADDR_FMT "] %d -> 0\n", addr,
                     tagblock_get_tag(tagblk, tagblk_index));
             }
-            // changed |= tagblock_get_tag(tagblk, tagblk_index);
             tagblock_clear_tag(tagblk, tagblk_index);
         }
     }
 }
 
+void cheri_tag_phys_invalidate(CPUArchState *env, RAMBlock *ram,
+                               ram_addr_t ram_offset, ram_addr_t len,
+                               const target_ulong *vaddr)
+{
+    // Ignore tag clearing requests for ROM, etc.
+    if (!ram->cheri_tags) {
+        return;
+    }
+    cheri_debug_assert(!memory_region_is_rom(ram->mr) &&
+                       !memory_region_is_romd(ram->mr));
+
+    if (unlikely(env && qemu_log_instr_enabled(env))) {
+        cheri_tag_phys_invalidate_logged(env, ram, ram_offset, len, vaddr);
+        return;
+    }
+
+    /* Clear whole words of the tag bitmap at a time. */
+    uint64_t tag = ram_tag_index(ram, ram_offset);
+    const uint64_t end = DIV_ROUND_UP(ram->offset + ram_offset + len,
+                                      CHERI_CAP_SIZE);
+    while (tag < end) {
+        const uint64_t block_end = MIN(end, (tag | CAP_TAGBLK_MSK) + 1);
+        CheriTagBlock *tagblk = cheri_tag_block(tag);
+        if (tagblk != NULL) {
+            bitmap_test_and_clear_atomic(tagblk->tag_bitmap,
+                                         CAP_TAGBLK_IDX(tag), block_end - tag);
+        }
+        tag = block_end;
+    }
+}
+
+void cheri_tag_phys_write(RAMBlock *ram, ram_addr_t ram_offset, void *host,
+                          const void *buf, size_t len)
+{
+    uint8_t *dst = host;
+    const uint8_t *src = buf;
+
+    if (!ram->cheri_tags) {
+        memcpy(dst, src, len);
+        return;
+    }
+    /*
+     * Copy one line at a time while holding the lock for that line, so that
+     * a CLC on a vCPU either sees the old data (with the old tag) or the new
+     * data with the tag cleared.
+     */
+    while (len > 0) {
+        size_t chunk = MIN(len, CHERI_TAG_LINE_SIZE -
+                                    (uintptr_t)dst % CHERI_TAG_LINE_SIZE);
+        CheriTagLock *lock = cheri_tag_lock_for_host(dst);
+
+        seqlock_write_lock(&lock->seq, &lock->spin);
+        cheri_tag_phys_invalidate(NULL, ram, ram_offset, chunk, NULL);
+        memcpy(dst, src, chunk);
+        seqlock_write_unlock(&lock->seq, &lock->spin);
+
+        dst += chunk;
+        src += chunk;
+        ram_offset += chunk;
+        len -= chunk;
+    }
+}
+#endif /* !CONFIG_USER_ONLY */
+
 /*
  * TODO: Basically nothing uses this physical address. Tag set probably should
  * not have to return it.
  */
+#ifdef CONFIG_USER_ONLY
+#define handle_paddr_return(rw)                                                \
+    do {                                                                       \
+        if (ret_paddr) {                                                       \
+            *ret_paddr = vaddr;                                                \
+        }                                                                      \
+    } while (0)
+#else
 #define handle_paddr_return(rw)                                                \
     do {                                                                       \
         if (ret_paddr) {                                                       \
@@ -517,6 +876,7 @@ void cheri_tag_phys_invalidate(CPUArchState *env, RAMBlock *ram,
                           TARGET_PAGE_MASK);                                   \
         }                                                                      \
     } while (0)
+#endif
 
 #ifdef TARGET_MIPS
 #define store_capcause_reg(env, reg) cpu_mips_store_capcause_reg(env, reg)
@@ -526,6 +886,21 @@ void cheri_tag_phys_invalidate(CPUArchState *env, RAMBlock *ram,
 #define clear_capcause_reg(env)
 #endif
 
+void *cheri_tag_probe_cap_write(CPUArchState *env, target_ulong vaddr,
+                                int size, int mmu_idx, uintptr_t pc)
+{
+    void *host_addr = probe_cap_write(env, vaddr, size, mmu_idx, pc);
+
+#ifndef CONFIG_USER_ONLY
+    if (unlikely(cheri_tag_alloc_restart)) {
+        cheri_tag_alloc_restart = false;
+        clear_capcause_reg(env);
+        cpu_loop_exit_restore(env_cpu(env), pc);
+    }
+#endif
+    return host_addr;
+}
+
 void *cheri_tag_set(CPUArchState *env, target_ulong vaddr, int reg,
                     hwaddr *ret_paddr, uintptr_t pc, int mmu_idx)
 {
@@ -536,7 +911,8 @@ void *cheri_tag_set(CPUArchState *env, target_ulong vaddr, int reg,
      */
     store_capcause_reg(env, reg);
     // Note: this probe will handle any store cap faults
-    void *host_addr = probe_cap_write(env, vaddr, CHERI_CAP_SIZE, mmu_idx, pc);
+    void *host_addr =
+        cheri_tag_probe_cap_write(env, vaddr, CHERI_CAP_SIZE, mmu_idx, pc);
     clear_capcause_reg(env);
 
     handle_paddr_return(write);
@@ -546,8 +922,8 @@ void *cheri_tag_set(CPUArchState *env, target_ulong vaddr, int reg,
     }
 
     uintptr_t tagmem_flags;
-    void *tagmem = get_tagmem_from_iotlb_entry(env, vaddr, mmu_idx,
-                                               /*write=*/true, &tagmem_flags);
+    void *tagmem = get_tagmem_for_vaddr(env, vaddr, mmu_idx, /*write=*/true,
+                                        /*alloc=*/true, &tagmem_flags);
 
     /* Clear + ALL_ZERO_TAGBLK means no tags can be stored here. */
     if ((tagmem_flags & TLBENTRYCAP_FLAG_CLEAR) &&
@@ -571,13 +947,81 @@ void *cheri_tag_set(CPUArchState *env, target_ulong vaddr, int reg,
 
     qemu_maybe_log_instr_extra(
         env, "    Cap Tag Write [" TARGET_FMT_lx "/" RAM_ADDR_FMT "] %d -> 1\n",
-        vaddr, qemu_ram_addr_from_host(host_addr),
+        vaddr, tag_log_addr(host_addr),
         tagblock_get_tag_tagmem(tagmem, tag_offset));
 
     tagblock_set_tag_tagmem(tagmem, tag_offset);
     return host_addr;
 }
 
+#ifndef CONFIG_USER_ONLY
+/*
+ * Does the TLB say that the page of a @size byte store to @vaddr has no tag
+ * block? No tag can then be set on it while this vCPU runs its current TB.
+ * Stores that miss in the TLB or cross a page are not checked.
+ */
+static inline bool cheri_tag_store_is_tag_free(CPUArchState *env,
+                                               target_ulong vaddr,
+                                               int32_t size, int mmu_idx)
+{
+    CPUTLBEntry *entry = tlb_entry(env, mmu_idx, vaddr);
+    uintptr_t tagmem;
+
+    if (((vaddr ^ (vaddr + size - 1)) & TARGET_PAGE_MASK) ||
+        !tlb_hit(tlb_addr_write(entry), vaddr)) {
+        return false;
+    }
+    tagmem = env_tlb(env)->d[mmu_idx].iotlb[tlb_index(env, mmu_idx, vaddr)]
+                 .tagmem_write;
+    return (tagmem & ~TLBENTRYCAP_MASK) == (uintptr_t)ALL_ZERO_TAGBLK;
+}
+#endif
+
+void cheri_tag_lock_store(CPUArchState *env, target_ulong vaddr, int32_t size,
+                          uintptr_t pc, int mmu_idx)
+{
+#ifndef CONFIG_USER_ONLY
+    /* Nothing to clear, so nothing a CLC could see half done. */
+    if (likely(cheri_tag_store_is_tag_free(env, vaddr, size, mmu_idx))) {
+        return;
+    }
+#endif
+    /* Bytes remaining in the first page: the store may cross a page. */
+    int32_t first_size = MIN(size, -(vaddr | TARGET_PAGE_MASK));
+    char *host_first = probe_write(env, vaddr, first_size, mmu_idx, pc);
+    char *host_last;
+
+    if (likely(first_size == size)) {
+        host_last = host_first ? host_first + size - 1 : NULL;
+    } else {
+        host_last = probe_write(env, vaddr + first_size, size - first_size,
+                                mmu_idx, pc);
+        if (host_last) {
+            host_last += size - first_size - 1;
+        }
+    }
+    cheri_tag_lock_host(host_first, host_last);
+}
+
+void *cheri_tag_lock_cap_store(CPUArchState *env, target_ulong vaddr, int reg,
+                               bool tagged, uintptr_t pc, int mmu_idx)
+{
+    void *host_addr;
+
+    cheri_debug_assert(QEMU_IS_ALIGNED(vaddr, CHERI_CAP_SIZE));
+    /* Take the same faults as cheri_tag_set()/cheri_tag_invalidate(). */
+    if (tagged) {
+        store_capcause_reg(env, reg);
+        host_addr =
+            cheri_tag_probe_cap_write(env, vaddr, CHERI_CAP_SIZE, mmu_idx, pc);
+        clear_capcause_reg(env);
+    } else {
+        host_addr = probe_write(env, vaddr, CHERI_CAP_SIZE, mmu_idx, pc);
+    }
+    cheri_tag_lock_host(host_addr, host_addr);
+    return host_addr;
+}
+
 bool cheri_tag_get(CPUArchState *env, target_ulong vaddr, int reg,
                    hwaddr *ret_paddr, int *prot, uintptr_t pc, int mmu_idx,
                    void *host_addr)
@@ -589,8 +1033,8 @@ bool cheri_tag_get(CPUArchState *env, target_ulong vaddr, int reg,
     handle_paddr_return(read);
 
     uintptr_t tagmem_flags;
-    void *tagmem = get_tagmem_from_iotlb_entry(env, vaddr, mmu_idx,
-                                               /*write=*/false, &tagmem_flags);
+    void *tagmem = get_tagmem_for_vaddr(env, vaddr, mmu_idx, /*write=*/false,
+                                        /*alloc=*/false, &tagmem_flags);
 
     if (prot) {
         *prot = 0;
@@ -614,10 +1058,10 @@ bool cheri_tag_get(CPUArchState *env, target_ulong vaddr, int reg,
             ? 0
             : tagblock_get_tag_tagmem(tagmem, page_vaddr_to_tag_offset(vaddr));
 
-    // XXX: Not atomic w.r.t. writes to tag memory
+    // Not atomic w.r.t. the data words, see cheri_tag_read_begin().
     qemu_maybe_log_instr_extra(
         env, "    Cap Tag Read [" TARGET_FMT_lx "/" RAM_ADDR_FMT "] -> %d\n",
-        vaddr, qemu_ram_addr_from_host(host_addr), result);
+        vaddr, tag_log_addr(host_addr), result);
     return result;
 }
 
@@ -630,8 +1074,8 @@ int cheri_tag_get_many(CPUArchState *env, target_ulong vaddr, int reg,
     handle_paddr_return(read);
 
     uintptr_t tagmem_flags;
-    void *tagmem = get_tagmem_from_iotlb_entry(env, vaddr, mmu_idx,
-                                               /*write=*/false, &tagmem_flags);
+    void *tagmem = get_tagmem_for_vaddr(env, vaddr, mmu_idx, /*write=*/false,
+                                        /*alloc=*/false, &tagmem_flags);
 
     int result =
         ((tagmem == ALL_ZERO_TAGBLK) || (tagmem_flags & TLBENTRYCAP_FLAG_CLEAR))
@@ -660,7 +1104,8 @@ void cheri_tag_set_many(CPUArchState *env, uint32_t tags, target_ulong vaddr,
      */
     if (tags) {
         // Note: this probe will handle any store cap faults
-        probe_cap_write(env, vaddr, CAP_TAG_MANY_DATA_SIZE, mmu_idx, pc);
+        cheri_tag_probe_cap_write(env, vaddr, CAP_TAG_MANY_DATA_SIZE, mmu_idx,
+                                  pc);
     } else {
         probe_write(env, vaddr, CAP_TAG_MANY_DATA_SIZE, mmu_idx, pc);
     }
@@ -669,8 +1114,8 @@ void cheri_tag_set_many(CPUArchState *env, uint32_t tags, target_ulong vaddr,
     handle_paddr_return(write);
 
     uintptr_t tagmem_flags;
-    void *tagmem =
-        get_tagmem_from_iotlb_entry(env, vaddr, mmu_idx, true, &tagmem_flags);
+    void *tagmem = get_tagmem_for_vaddr(env, vaddr, mmu_idx, /*write=*/true,
+                                        /*alloc=*/tags != 0, &tagmem_flags);
 
     if ((tagmem_flags & TLBENTRYCAP_FLAG_CLEAR) &&
         (tagmem == ALL_ZERO_TAGBLK)) {
@@ -695,6 +1140,7 @@ void cheri_tag_set_many(CPUArchState *env, uint32_t tags, target_ulong vaddr,
     tagblock_set_tag_many_tagmem(tagmem, page_vaddr_to_tag_offset(vaddr), tags);
 }
 
+#ifndef CONFIG_USER_ONLY
 bool cheri_tag_get_debug(RAMBlock *ram, ram_addr_t ram_offset)
 {
     /* Return zero tag for ROM, etc. */
@@ -707,8 +1153,9 @@ bool cheri_tag_get_debug(RAMBlock *ram, ram_addr_t ram_offset)
     cheri_debug_assert(QEMU_ALIGN_DOWN(ram_offset, CHERI_CAP_SIZE) ==
                        ram_offset);
 
-    uint64_t tag = ram_offset / CHERI_CAP_SIZE;
-    CheriTagBlock *tagblk = cheri_tag_block(tag, ram);
+    uint64_t tag = ram_tag_index(ram, ram_offset);
+    CheriTagBlock *tagblk = cheri_tag_block(tag);
     const size_t tagblk_index = CAP_TAGBLK_IDX(tag);
     return tagblock_get_tag(tagblk, tagblk_index);
 }
+#endif /* !CONFIG_USER_ONLY */
@@ -41,6 +41,14 @@
 void cheri_tag_phys_invalidate(CPUArchState *env, RAMBlock *ram,
                                ram_addr_t offset, size_t len,
                                const target_ulong *vaddr);
+/**
+ * Copy @p len bytes from @p buf to guest RAM at @p offset in @p ram (mapped at
+ * @p host) and clear the tags of all granules that are written to. The tag
+ * clear is atomic with the data write with respect to CLC on the vCPUs.
+ * Can be called from any thread; the BQL is not required.
+ */
+void cheri_tag_phys_write(RAMBlock *ram, ram_addr_t offset, void *host,
+                          const void *buf, size_t len);
 void cheri_tag_init(MemoryRegion* mr, uint64_t memory_size);
 /**
  * Generic tag invalidation function to be called for a *single* data store:
@@ -80,6 +88,50 @@ void cheri_tag_set_many(CPUArchState *env, uint32_t tags, target_ulong vaddr,
 void *cheri_tag_set(CPUArchState *env, target_ulong vaddr, int reg,
                     hwaddr *ret_paddr, uintptr_t pc, int mmu_idx);
 
+/*
+ * Tag/data atomicity for parallel (MTTCG) execution, see the comment at the
+ * top of cheri_tagmem.c.
+ */
+/**
+ * probe_cap_write() for a store that is about to set tags. If the TLB fill
+ * had to allocate a tag block with MTTCG, this restarts the instruction at
+ * @p pc so that no tag is set until all vCPUs have flushed their TLBs.
+ */
+void *cheri_tag_probe_cap_write(CPUArchState *env, target_ulong vaddr,
+                                int size, int mmu_idx, uintptr_t pc);
+/**
+ * Probe a @p size byte data store to @p vaddr (taking any TLB fault) and then
+ * lock the capability granule(s) that it touches against concurrent CLCs.
+ * The tags must be cleared before calling cheri_tag_unlock(). Nothing is
+ * locked if the TLB already says that the page has no tags, in which case
+ * there is nothing to clear either (see cheri_tag_is_locked()).
+ */
+void cheri_tag_lock_store(CPUArchState *env, target_ulong vaddr, int32_t size,
+                          uintptr_t pc, int mmu_idx);
+/**
+ * Like cheri_tag_lock_store(), but for a capability store to the aligned
+ * address @p vaddr. Takes the same faults as cheri_tag_set() if @p tagged.
+ * @return the host address as returned by probe_(cap_)write().
+ */
+void *cheri_tag_lock_cap_store(CPUArchState *env, target_ulong vaddr, int reg,
+                               bool tagged, uintptr_t pc, int mmu_idx);
+/**
+ * Release the locks taken by cheri_tag_lock_store()/cheri_tag_lock_cap_store()
+ * on this thread (if any).
+ */
+void cheri_tag_unlock(void);
+/**
+ * Does this thread hold any of the locks taken by cheri_tag_lock_store()?
+ */
+bool cheri_tag_is_locked(void);
+/**
+ * Seqlock read side for the granule at host address @p host: read the data
+ * words and the tag between these two calls and retry while
+ * cheri_tag_read_retry() returns true.
+ */
+unsigned cheri_tag_read_begin(const void *host);
+bool cheri_tag_read_retry(const void *host, unsigned start);
+
 void *cheri_tagmem_for_addr(CPUArchState *env, target_ulong vaddr,
                             RAMBlock *ram, ram_addr_t ram_offset, size_t size,
                             int *prot, bool tag_write);
@@ -89,4 +141,19 @@ void *cheri_tagmem_for_addr(CPUArchState *env, target_ulong vaddr,
  */
 bool cheri_tag_get_debug(RAMBlock *ram, ram_addr_t ram_offset);
 
+#ifdef CONFIG_USER_ONLY
+/**
+ * Clear all tags in the guest virtual address range [@vaddr, @vaddr + @len).
+ * Used by linux-user when the host writes to guest memory on behalf of the
+ * guest (e.g. for syscall results), since those writes bypass the TCG stores.
+ */
+void cheri_tag_user_invalidate(target_ulong vaddr, target_ulong len);
+/**
+ * Set the tag for the capability-aligned guest virtual address @vaddr. Used
+ * when linux-user stores capabilities on behalf of the guest (e.g. the
+ * CheriABI initial stack).
+ */
+void cheri_tag_user_set(target_ulong vaddr);
+#endif
+
 #endif /* TARGET_CHERI */
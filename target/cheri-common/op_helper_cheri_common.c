@@ -41,6 +41,7 @@
 #include "exec/exec-all.h"
 #include "exec/helper-proto.h"
 #include "exec/memop.h"
+#include "trace/mem.h"
 
 #include "cheri-helper-utils.h"
 #include "cheri_tagmem.h"
@@ -229,6 +230,30 @@ void CHERI_HELPER_IMPL(cheri_invalidate_tags_condition(
     }
 }
 
+void CHERI_HELPER_IMPL(cheri_store_begin(CPUArchState *env,
+                                         target_ulong vaddr, TCGMemOpIdx oi))
+{
+    cheri_tag_lock_store(env, vaddr, memop_size(get_memop(oi)), GETPC(),
+                         get_mmuidx(oi));
+}
+
+void CHERI_HELPER_IMPL(cheri_store_end(CPUArchState *env, target_ulong vaddr,
+                                       TCGMemOpIdx oi, uint32_t cond))
+{
+    /*
+     * cheri_store_begin() takes no lock for MMIO or for pages without tags,
+     * neither of which has tags to clear.
+     */
+    if (likely(!cheri_tag_is_locked())) {
+        return;
+    }
+    if (cond) {
+        cheri_tag_invalidate(env, vaddr, memop_size(get_memop(oi)), GETPC(),
+                             get_mmuidx(oi));
+    }
+    cheri_tag_unlock();
+}
+
 /// Implementations of individual instructions start here
 
 /// Two operand inspection instructions:
@@ -1333,19 +1358,20 @@ void CHERI_HELPER_IMPL(store_cap_via_cap(CPUArchState *env, uint32_t valreg,
                              CHERI_CAP_SIZE, _host_return_address, cbp,
                              CHERI_CAP_SIZE, raise_unaligned_store_exception);
 
-    store_cap_to_memory(env, valreg, checked_addr, _host_return_address);
+    store_cap_to_memory(env, valreg, cbp, checked_addr, _host_return_address);
 }
 
 void CHERI_HELPER_IMPL(store_cap_via_ddc(CPUArchState *env, uint32_t valreg,
                                          target_ulong intaddr))
 {
     GET_HOST_RETPC();
+    const cap_register_t *ddc = cheri_get_ddc(env);
     const target_ulong checked_addr = cap_check_common_reg(
         perms_for_store(env, valreg), env, CHERI_EXC_REGNUM_DDC,
         cheri_ddc_relative_addr(env, intaddr), CHERI_CAP_SIZE,
-        _host_return_address, cheri_get_ddc(env), CHERI_CAP_SIZE,
+        _host_return_address, ddc, CHERI_CAP_SIZE,
         raise_unaligned_store_exception);
-    store_cap_to_memory(env, valreg, checked_addr, _host_return_address);
+    store_cap_to_memory(env, valreg, ddc, checked_addr, _host_return_address);
 }
 
 static inline bool
@@ -1383,6 +1409,36 @@ void squash_mutable_permissions(CPUArchState *env, target_ulong *pesbt,
 #endif
 }
 
+/*
+ * Report a capability load or store to the mem callbacks of the current
+ * instruction, together with the capability that authorised it. The
+ * authorising capability is only compressed when a callback will see it.
+ */
+static inline void plugin_cap_mem_access(CPUArchState *env, target_ulong vaddr,
+                                         bool is_store, int mmu_idx,
+                                         target_ulong pesbt, bool tag,
+                                         target_ulong cursor,
+                                         const cap_register_t *auth)
+{
+#ifdef CONFIG_PLUGIN
+    CPUState *cpu = env_cpu(env);
+
+    if (likely(cpu->plugin_mem_cbs == NULL)) {
+        return;
+    }
+    struct qemu_plugin_cap auth_cap = {
+        .cursor = cap_get_cursor(auth),
+        .pesbt = CAP_cc(compress_raw)(auth),
+        .tag = auth->cr_tag,
+    };
+    qemu_plugin_vcpu_cap_mem_cb(
+        cpu, vaddr,
+        trace_mem_build_info(ctz32(CHERI_CAP_SIZE), false, MO_TE, is_store,
+                             mmu_idx),
+        pesbt, tag, cursor, &auth_cap);
+#endif
+}
+
 bool load_cap_from_memory_raw_tag_mmu_idx(
     CPUArchState *env, target_ulong *pesbt, target_ulong *cursor, uint32_t cb,
     const cap_register_t *source, target_ulong vaddr, uintptr_t retpc,
@@ -1397,6 +1453,8 @@ bool load_cap_from_memory_raw_tag_mmu_idx(
      */
     /* No TLB fault possible, should be safe to get a host pointer now */
     void *host = probe_read(env, vaddr, CHERI_CAP_SIZE, mmu_idx, retpc);
+    int prot;
+    bool tag;
     // When writing back pesbt we have to XOR with the NULL mask to ensure that
     // NULL capabilities have an all-zeroes representation.
     if (likely(host)) {
@@ -1408,9 +1466,20 @@ bool load_cap_from_memory_raw_tag_mmu_idx(
 #else
 #error "Unhandled target long width"
 #endif
-        *pesbt = ld_cap_word_p((char *)host + CHERI_MEM_OFFSET_METADATA) ^
-                CAP_NULL_XOR_MASK;
-        *cursor = ld_cap_word_p((char *)host + CHERI_MEM_OFFSET_CURSOR);
+        /*
+         * Read data and tag in a seqlock read section so that we never
+         * combine the tag of one capability store with the data of another
+         * one from a different vCPU.
+         */
+        unsigned seq;
+        do {
+            seq = cheri_tag_read_begin(host);
+            *pesbt = ld_cap_word_p((char *)host + CHERI_MEM_OFFSET_METADATA) ^
+                     CAP_NULL_XOR_MASK;
+            *cursor = ld_cap_word_p((char *)host + CHERI_MEM_OFFSET_CURSOR);
+            tag = cheri_tag_get(env, vaddr, cb, physaddr, &prot, retpc,
+                                mmu_idx, host);
+        } while (cheri_tag_read_retry(host, seq));
 #undef ld_cap_word_p
     } else {
         // Slow path for e.g. IO regions.
@@ -1419,10 +1488,9 @@ bool load_cap_from_memory_raw_tag_mmu_idx(
         *pesbt = cpu_ld_cap_word_ra(env, vaddr + CHERI_MEM_OFFSET_METADATA, retpc) ^
                 CAP_NULL_XOR_MASK;
         *cursor = cpu_ld_cap_word_ra(env, vaddr + CHERI_MEM_OFFSET_CURSOR, retpc);
+        tag = cheri_tag_get(env, vaddr, cb, physaddr, &prot, retpc, mmu_idx,
+                            host);
     }
-    int prot;
-    bool tag =
-        cheri_tag_get(env, vaddr, cb, physaddr, &prot, retpc, mmu_idx, host);
     if (raw_tag) {
         *raw_tag = tag;
     }
@@ -1435,6 +1503,9 @@ bool load_cap_from_memory_raw_tag_mmu_idx(
     if (tag)
         env->statcounters_cap_read_tagged++;
 
+    plugin_cap_mem_access(env, vaddr, false, mmu_idx, *pesbt, tag, *cursor,
+                          source);
+
 #if defined(TARGET_RISCV) && defined(CONFIG_RVFI_DII)
     env->rvfi_dii_trace.MEM.rvfi_mem_addr = vaddr;
     env->rvfi_dii_trace.MEM.rvfi_mem_rdata[0] = *cursor;
@@ -1506,6 +1577,7 @@ void load_cap_from_memory(CPUArchState *env, uint32_t cd, uint32_t cb,
 }
 
 void store_cap_to_memory_mmu_index(CPUArchState *env, uint32_t cs,
+                                   const cap_register_t *auth,
                                    target_ulong vaddr, uintptr_t retpc,
                                    int mmu_idx)
 {
@@ -1526,9 +1598,13 @@ void store_cap_to_memory_mmu_index(CPUArchState *env, uint32_t cs,
      * Touching the tags will take both the data write TLB fault and
      * capability write TLB fault before updating anything.  Thereafter, the
      * data stores will not take additional faults, so there is no risk of
-     * accidentally tagging a shorn data write.  This, like the rest of the
-     * tag logic, is not multi-TCG-thread safe.
+     * accidentally tagging a shorn data write.
+     * We take those faults up front and then update the tag and data while
+     * holding the lock for this granule, so that a concurrent CLC on another
+     * vCPU observes either the old or the new capability and a concurrent
+     * DMA write cannot be combined with our tag.
      */
+    cheri_tag_lock_cap_store(env, vaddr, cs, tag, retpc, mmu_idx);
 
     env->statcounters_cap_write++;
     void *host = NULL;
@@ -1561,6 +1637,10 @@ void store_cap_to_memory_mmu_index(CPUArchState *env, uint32_t cs,
         cpu_st_cap_word_ra(env, vaddr + CHERI_MEM_OFFSET_CURSOR, cursor,
                            retpc);
     }
+    cheri_tag_unlock();
+
+    plugin_cap_mem_access(env, vaddr, true, mmu_idx,
+                          pesbt_for_mem ^ CAP_NULL_XOR_MASK, tag, cursor, auth);
 #if defined(TARGET_RISCV) && defined(CONFIG_RVFI_DII)
     env->rvfi_dii_trace.MEM.rvfi_mem_addr = vaddr;
     env->rvfi_dii_trace.MEM.rvfi_mem_wdata[0] = cursor;
@@ -1586,10 +1666,11 @@ void store_cap_to_memory_mmu_index(CPUArchState *env, uint32_t cs,
 #endif
 }
 
-void store_cap_to_memory(CPUArchState *env, uint32_t cs, target_ulong vaddr,
+void store_cap_to_memory(CPUArchState *env, uint32_t cs,
+                         const cap_register_t *auth, target_ulong vaddr,
                          uintptr_t retpc)
 {
-    return store_cap_to_memory_mmu_index(env, cs, vaddr, retpc,
+    return store_cap_to_memory_mmu_index(env, cs, auth, vaddr, retpc,
                                          cpu_mmu_index(env, false));
 }
 
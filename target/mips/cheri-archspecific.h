@@ -55,6 +55,7 @@ static inline QEMU_NORETURN void do_raise_c2_exception_impl(CPUMIPSState *env,
     if (reg == CHERI_EXC_REGNUM_DDC) {
         reg = CHERI_TRUE_EXC_REGNUM_DDC;
     }
+    qemu_plugin_vcpu_cheri_exception(env_cpu(env), cause, reg, 0);
 
     if (qemu_log_instr_or_mask_enabled(env, CPU_LOG_INT)) {
         qemu_log_instr_or_mask_msg(env, CPU_LOG_INT,
@@ -43,6 +43,7 @@ static inline void QEMU_NORETURN raise_cheri_exception_impl(
 {
     env->last_cap_cause = cause;
     env->last_cap_index = regnum;
+    qemu_plugin_vcpu_cheri_exception(env_cpu(env), cause, regnum, addr);
     // Allow drop into debugger on first CHERI trap:
     // FIXME: allow c command to work by adding another boolean flag to skip
     // this breakpoint when GDB asks to continue
@@ -1005,6 +1005,25 @@ static const char *riscv_gdb_get_dynamic_xml(CPUState *cs, const char *xmlname)
 
 #include "hw/core/tcg-cpu-ops.h"
 
+#ifdef CONFIG_USER_ONLY
+static void riscv_cpu_snapshot_for_translation(CPUState *dst,
+                                               const CPUState *src)
+{
+    RISCVCPU *dcpu = RISCV_CPU(dst);
+    const RISCVCPU *scpu = RISCV_CPU(src);
+
+    dcpu->env.priv_ver = scpu->env.priv_ver;
+    dcpu->env.misa = scpu->env.misa;
+#ifdef TARGET_CHERI
+    /* Only for the PCC bounds assertion in translator_loop() */
+    dcpu->env.PCC = scpu->env.PCC;
+    dcpu->cfg.ext_cheri_v9 = scpu->cfg.ext_cheri_v9;
+#endif
+    dcpu->cfg.ext_ifencei = scpu->cfg.ext_ifencei;
+    dcpu->cfg.vlen = scpu->cfg.vlen;
+}
+#endif
+
 static struct TCGCPUOps riscv_tcg_ops = {
     .initialize = riscv_translate_init,
     .synchronize_from_tb = riscv_cpu_synchronize_from_tb,
@@ -1016,6 +1035,8 @@ static struct TCGCPUOps riscv_tcg_ops = {
     .do_interrupt = riscv_cpu_do_interrupt,
     .do_transaction_failed = riscv_cpu_do_transaction_failed,
     .do_unaligned_access = riscv_cpu_do_unaligned_access,
+#else
+    .snapshot_for_translation = riscv_cpu_snapshot_for_translation,
 #endif /* !CONFIG_USER_ONLY */
 };
 
@@ -1044,6 +1065,12 @@ static void riscv_cpu_class_init(ObjectClass *c, void *data)
 #endif
     cc->gdb_stop_before_watchpoint = true;
     cc->disas_set_info = riscv_cpu_disas_set_info;
+#ifdef CONFIG_PLUGIN
+    cc->plugin_reg_lookup = riscv_plugin_reg_lookup;
+    cc->plugin_reg_read = riscv_plugin_reg_read;
+    cc->plugin_reg_write = riscv_plugin_reg_write;
+    cc->plugin_cap_reg_read = riscv_plugin_cap_reg_read;
+#endif
 #ifndef CONFIG_USER_ONLY
     cc->get_phys_page_debug = riscv_cpu_get_phys_page_debug;
     /* For now, mark unmigratable: */
@@ -618,6 +618,11 @@ int riscv_cpu_write_elf32_note(WriteCoreDumpFunction f, CPUState *cs,
                                int cpuid, void *opaque);
 int riscv_cpu_gdb_read_register(CPUState *cpu, GByteArray *buf, int reg);
 int riscv_cpu_gdb_write_register(CPUState *cpu, uint8_t *buf, int reg);
+int riscv_plugin_reg_lookup(CPUState *cs, const char *name, bool *is_cap);
+bool riscv_plugin_reg_read(CPUState *cs, int reg, uint64_t *val);
+bool riscv_plugin_reg_write(CPUState *cs, int reg, uint64_t val);
+bool riscv_plugin_cap_reg_read(CPUState *cs, int reg,
+                               struct qemu_plugin_cap *cap);
 bool riscv_cpu_exec_interrupt(CPUState *cs, int interrupt_request);
 bool riscv_cpu_fp_enabled(CPURISCVState *env);
 bool riscv_cpu_virt_enabled(CPURISCVState *env);
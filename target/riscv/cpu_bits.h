@@ -506,6 +506,10 @@
 #define SATP_PPN            SATP64_PPN
 #endif
 
+/* Operands of SFENCE.VMA that are not x0, see helper_sfence_vma() */
+#define SFENCE_VMA_ADDR     1
+#define SFENCE_VMA_ASID     2
+
 /* VM modes (mstatus.vm) privileged ISA 1.9.1 */
 #define VM_1_09_MBARE       0
 #define VM_1_09_MBB         1
@@ -428,6 +428,8 @@ static int get_physical_address_pmp(CPURISCVState *env, int *prot,
  * @env: CPURISCVState
  * @physical: This will be set to the calculated physical address
  * @prot: The returned protection attributes
+ * @page_size: If not NULL, set to the size of the (super)page that maps
+ *             @addr on success. Left unchanged if paging is disabled.
  * @addr: The virtual address to be translated
  * @fault_pte_addr: If not NULL, this will be set to fault pte address
  *                  when a error occurs on pte address translation.
@@ -439,7 +441,8 @@ static int get_physical_address_pmp(CPURISCVState *env, int *prot,
  * @two_stage: Are we going to perform two stage translation
  */
 static int get_physical_address(CPURISCVState *env, hwaddr *physical,
-                                int *prot, target_ulong addr,
+                                int *prot, target_ulong *page_size,
+                                target_ulong addr,
                                 target_ulong *fault_pte_addr,
                                 int access_type, int mmu_idx,
                                 bool first_stage, bool two_stage)
@@ -584,7 +587,8 @@ restart:
 
             /* Do the second stage translation on the base PTE address. */
             int vbase_ret = get_physical_address(env, &vbase, &vbase_prot,
-                                                 base, NULL, MMU_DATA_LOAD,
+                                                 NULL, base, NULL,
+                                                 MMU_DATA_LOAD,
                                                  mmu_idx, false, true);
 
             if (vbase_ret != TRANSLATE_SUCCESS) {
@@ -790,6 +794,9 @@ restart:
             target_ulong vpn = addr >> PGSHIFT;
             *physical = ((ppn | (vpn & ((1L << ptshift) - 1))) << PGSHIFT) |
                         (addr & ~TARGET_PAGE_MASK);
+            if (page_size) {
+                *page_size = (target_ulong)1 << (PGSHIFT + ptshift);
+            }
 
             /* set permissions on the TLB entry */
             if ((pte & PTE_R) || ((pte & PTE_X) && mxr)) {
@@ -928,14 +935,14 @@ hwaddr riscv_cpu_get_phys_page_debug(CPUState *cs, vaddr addr)
     int prot;
     int mmu_idx = cpu_mmu_index(&cpu->env, false);
 
-    if (get_physical_address(env, &phys_addr, &prot, addr, NULL, 0, mmu_idx,
-                             true, riscv_cpu_virt_enabled(env))) {
+    if (get_physical_address(env, &phys_addr, &prot, NULL, addr, NULL, 0,
+                             mmu_idx, true, riscv_cpu_virt_enabled(env))) {
         return -1;
     }
 
     if (riscv_cpu_virt_enabled(env)) {
-        if (get_physical_address(env, &phys_addr, &prot, phys_addr, NULL,
-                                 0, mmu_idx, false, true)) {
+        if (get_physical_address(env, &phys_addr, &prot, NULL, phys_addr,
+                                 NULL, 0, mmu_idx, false, true)) {
             return -1;
         }
     }
@@ -1045,6 +1052,7 @@ bool riscv_cpu_tlb_fill(CPUState *cs, vaddr address, int size,
     int mode = mmu_idx;
     /* default TLB page size */
     target_ulong tlb_size = TARGET_PAGE_SIZE;
+    target_ulong page_size = TARGET_PAGE_SIZE;
 
 #if defined(TARGET_CHERI) && !defined(TARGET_RISCV32)
     prot_lc_preserve = PAGE_LC_TRAP | PAGE_LC_CLEAR;
@@ -1075,7 +1083,7 @@ bool riscv_cpu_tlb_fill(CPUState *cs, vaddr address, int size,
         ((riscv_cpu_two_stage_lookup(mmu_idx) || two_stage_lookup) &&
          access_type != MMU_INST_FETCH)) {
         /* Two stage lookup */
-        ret = get_physical_address(env, &pa, &prot, address,
+        ret = get_physical_address(env, &pa, &prot, NULL, address,
                                    &env->guest_phys_fault_addr, access_type,
                                    mmu_idx, true, true);
 
@@ -1099,8 +1107,9 @@ bool riscv_cpu_tlb_fill(CPUState *cs, vaddr address, int size,
             /* Second stage lookup */
             im_address = pa;
 
-            ret = get_physical_address(env, &pa, &prot2, im_address, NULL,
-                                       access_type, mmu_idx, false, true);
+            ret = get_physical_address(env, &pa, &prot2, NULL, im_address,
+                                       NULL, access_type, mmu_idx, false,
+                                       true);
 
             qemu_log_mask(CPU_LOG_MMU,
                     "%s 2nd-stage address=%" VADDR_PRIx " ret %d physical "
@@ -1160,8 +1169,8 @@ bool riscv_cpu_tlb_fill(CPUState *cs, vaddr address, int size,
         }
     } else {
         /* Single stage lookup */
-        ret = get_physical_address(env, &pa, &prot, address, NULL,
-                                   access_type, mmu_idx, true, false);
+        ret = get_physical_address(env, &pa, &prot, &page_size, address,
+                                   NULL, access_type, mmu_idx, true, false);
         ret = rvfi_dii_check_addr(env, ret, &pa, address, size, &prot, access_type);
 
         qemu_log_mask(CPU_LOG_MMU,
@@ -1181,6 +1190,19 @@ bool riscv_cpu_tlb_fill(CPUState *cs, vaddr address, int size,
             /* PMP has no CHERI permissions; preserve trap/clear */
             prot &= prot_pmp | prot_lc_preserve | prot_sc_preserve;
         }
+
+        /*
+         * Let the TLB cache a superpage as a whole if PMP treats all of it
+         * the same, so that touching its other pages doesn't walk the page
+         * table again.
+         */
+        if (ret == TRANSLATE_SUCCESS && page_size > TARGET_PAGE_SIZE &&
+            tlb_size == TARGET_PAGE_SIZE &&
+            (!riscv_feature(env, RISCV_FEATURE_PMP) ||
+             pmp_is_range_uniform(env, pa & ~(hwaddr)(page_size - 1),
+                                  page_size))) {
+            tlb_size = page_size;
+        }
     }
 
     if (ret == TRANSLATE_PMP_FAIL) {
@@ -1192,7 +1214,10 @@ bool riscv_cpu_tlb_fill(CPUState *cs, vaddr address, int size,
 #ifdef TARGET_CHERI
         attrs.tag_setting = access_type == MMU_DATA_CAP_STORE;
 #endif
-        tlb_set_page_with_attrs(cs, address & ~(tlb_size - 1), pa & ~(tlb_size - 1),
+        /* Only the page containing address is mapped, even for superpages */
+        hwaddr tlb_mask = tlb_size > TARGET_PAGE_SIZE ?
+                          (hwaddr)TARGET_PAGE_MASK : ~(hwaddr)(tlb_size - 1);
+        tlb_set_page_with_attrs(cs, address & tlb_mask, pa & tlb_mask,
                                 attrs, prot, mmu_idx, tlb_size);
         return true;
     } else if (probe) {
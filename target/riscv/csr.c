@@ -986,7 +986,12 @@ static int write_satp(CPURISCVState *env, int csrno, target_ulong val)
             return -RISCV_EXCP_ILLEGAL_INST;
         } else {
             if ((val ^ env->satp) & SATP_ASID) {
-                tlb_flush(env_cpu(env));
+                if (riscv_has_ext(env, RVH)) {
+                    /* VS and HS share the TLB and its current ASID */
+                    tlb_flush(env_cpu(env));
+                } else {
+                    tlb_set_asid(env_cpu(env), get_field(val, SATP_ASID));
+                }
             }
             env->satp = val;
         }
@@ -18,6 +18,7 @@
 
 #include "qemu/osdep.h"
 #include "cpu.h"
+#include "exec/exec-all.h"
 #include "qemu/error-report.h"
 #include "sysemu/kvm.h"
 #include "migration/cpu.h"
@@ -138,6 +139,16 @@ static const VMStateDescription vmstate_hyper = {
     }
 };
 
+static int riscv_cpu_post_load(void *opaque, int version_id)
+{
+    RISCVCPU *cpu = opaque;
+    CPURISCVState *env = &cpu->env;
+
+    /* The TLB keeps translations per ASID, resync it with the loaded satp */
+    tlb_reset_asid(CPU(cpu), get_field(env->satp, SATP_ASID));
+    return 0;
+}
+
 #ifdef TARGET_CHERI
 #pragma message("TODO: VMSTATE_CAP_ARRAY")
 #endif
@@ -145,6 +156,7 @@ const VMStateDescription vmstate_riscv_cpu = {
     .name = "cpu",
     .version_id = 1,
     .minimum_version_id = 1,
+    .post_load = riscv_cpu_post_load,
     .fields = (VMStateField[]) {
 #ifndef TARGET_CHERI
         VMSTATE_UINTTL_ARRAY(env.gpr, RISCVCPU, 32),
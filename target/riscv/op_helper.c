@@ -266,18 +266,48 @@ void helper_wfi(CPURISCVState *env)
     }
 }
 
-void helper_tlb_flush(CPURISCVState *env)
+static void check_sfence_vma(CPURISCVState *env, uintptr_t ra)
 {
-    CPUState *cs = env_cpu(env);
     if (!(env->priv >= PRV_S) ||
         (env->priv == PRV_S &&
          get_field(env->mstatus, MSTATUS_TVM))) {
-        riscv_raise_exception(env, RISCV_EXCP_ILLEGAL_INST, GETPC());
+        riscv_raise_exception(env, RISCV_EXCP_ILLEGAL_INST, ra);
     } else if (riscv_has_ext(env, RVH) && riscv_cpu_virt_enabled(env) &&
                get_field(env->hstatus, HSTATUS_VTVM)) {
-        riscv_raise_exception(env, RISCV_EXCP_VIRT_INSTRUCTION_FAULT, GETPC());
-    } else {
+        riscv_raise_exception(env, RISCV_EXCP_VIRT_INSTRUCTION_FAULT, ra);
+    }
+}
+
+void helper_tlb_flush(CPURISCVState *env)
+{
+    check_sfence_vma(env, GETPC());
+    tlb_flush(env_cpu(env));
+}
+
+/*
+ * SFENCE.VMA with rs1 and/or rs2 other than x0, as given by @scope.
+ * The ASID-scoped variants leave the translations kept for other ASIDs
+ * alone, see tlb_set_asid(). With the hypervisor extension the TLB is not
+ * switched by ASID, so fall back to flushing everything.
+ */
+void helper_sfence_vma(CPURISCVState *env, target_ulong addr,
+                       target_ulong asid, uint32_t scope)
+{
+    CPUState *cs = env_cpu(env);
+
+    check_sfence_vma(env, GETPC());
+
+    /* rs2 holds the ASID in its low bits */
+    asid &= get_field(SATP_ASID, SATP_ASID);
+    if (riscv_has_ext(env, RVH)) {
         tlb_flush(cs);
+    } else if (scope == (SFENCE_VMA_ADDR | SFENCE_VMA_ASID)) {
+        tlb_flush_page_asid(cs, addr, asid);
+    } else if (scope == SFENCE_VMA_ASID) {
+        tlb_flush_asid(cs, asid);
+    } else {
+        /* This also flushes global mappings, so all ASIDs are affected */
+        tlb_flush_page(cs, addr);
     }
 }
 
@@ -313,7 +313,7 @@ void HELPER(amoswap_cap)(CPUArchState *env, uint32_t dest_reg,
                                  cbp, addr, _host_return_address, NULL);
     // The store may still trap, so we must only update the dest register after
     // the store succeeded.
-    store_cap_to_memory(env, val_reg, addr, _host_return_address);
+    store_cap_to_memory(env, val_reg, cbp, addr, _host_return_address);
     // Store succeeded -> we can update cd
     update_compressed_capreg(env, dest_reg, loaded_pesbt, loaded_tag,
                              loaded_cursor);
@@ -453,7 +453,7 @@ static target_ulong sc_c_impl(CPUArchState *env, uint32_t addr_reg,
         goto sc_failed;
     }
     // This store may still trap, so we should update env->load_res before
-    store_cap_to_memory(env, val_reg, addr, _host_return_address);
+    store_cap_to_memory(env, val_reg, cbp, addr, _host_return_address);
     tcg_debug_assert(env->load_res == -1);
     return 0; // success
 sc_failed:
@@ -0,0 +1,201 @@
+/*
+ * RISC-V register access for TCG plugins
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2 or later, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "cpu.h"
+#include "helper_utils.h"
+#ifdef TARGET_CHERI
+#include "cheri-lazy-capregs.h"
+#endif
+
+/*
+ * Register numbers handed out by riscv_plugin_reg_lookup(): the GPRs keep
+ * their architectural number, CSRs and SCRs are offset by a base.
+ */
+#define RISCV_PLUGIN_REG_PC       32
+#define RISCV_PLUGIN_REG_CSR_BASE 0x1000
+#define RISCV_PLUGIN_REG_SCR_BASE 0x2000
+
+#ifdef TARGET_CHERI
+static const struct {
+    const char *name;
+    size_t offset;
+} riscv_plugin_scrs[] = {
+    { "pcc", offsetof(CPURISCVState, PCC) },
+    { "ddc", offsetof(CPURISCVState, DDC) },
+    { "utcc", offsetof(CPURISCVState, UTCC) },
+    { "utdc", offsetof(CPURISCVState, UTDC) },
+    { "uscratchc", offsetof(CPURISCVState, UScratchC) },
+    { "uepcc", offsetof(CPURISCVState, UEPCC) },
+    { "stcc", offsetof(CPURISCVState, STCC) },
+    { "stdc", offsetof(CPURISCVState, STDC) },
+    { "sscratchc", offsetof(CPURISCVState, SScratchC) },
+    { "sepcc", offsetof(CPURISCVState, SEPCC) },
+    { "mtcc", offsetof(CPURISCVState, MTCC) },
+    { "mtdc", offsetof(CPURISCVState, MTDC) },
+    { "mscratchc", offsetof(CPURISCVState, MScratchC) },
+    { "mepcc", offsetof(CPURISCVState, MEPCC) },
+    { "vstcc", offsetof(CPURISCVState, VSTCC) },
+    { "vstdc", offsetof(CPURISCVState, VSTDC) },
+    { "vsscratchc", offsetof(CPURISCVState, VSScratchC) },
+    { "vsepcc", offsetof(CPURISCVState, VSEPCC) },
+};
+
+static const cap_register_t *riscv_plugin_scr(CPURISCVState *env, int reg)
+{
+    return (const cap_register_t *)((char *)env +
+        riscv_plugin_scrs[reg - RISCV_PLUGIN_REG_SCR_BASE].offset);
+}
+
+static bool riscv_plugin_reg_is_scr(int reg)
+{
+    return reg >= RISCV_PLUGIN_REG_SCR_BASE &&
+           reg < RISCV_PLUGIN_REG_SCR_BASE + ARRAY_SIZE(riscv_plugin_scrs);
+}
+#endif
+
+static bool riscv_plugin_reg_is_csr(int reg)
+{
+    return reg >= RISCV_PLUGIN_REG_CSR_BASE &&
+           reg < RISCV_PLUGIN_REG_CSR_BASE + CSR_TABLE_SIZE;
+}
+
+/* @regnames entries are of the form "x10/a0" */
+static int riscv_plugin_find_regname(const char * const *regnames,
+                                     const char *name)
+{
+    size_t len = strlen(name);
+    int i;
+
+    for (i = 0; i < 32; i++) {
+        const char *alias = strchr(regnames[i], '/');
+
+        if ((alias - regnames[i] == len &&
+             !strncmp(regnames[i], name, len)) ||
+            !strcmp(alias + 1, name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int riscv_plugin_reg_lookup(CPUState *cs, const char *name, bool *is_cap)
+{
+    int i;
+
+    i = riscv_plugin_find_regname(riscv_int_regnames, name);
+#ifdef TARGET_CHERI
+    if (i < 0) {
+        i = riscv_plugin_find_regname(cheri_gp_regnames, name);
+    }
+    /* integer and capability names refer to the same merged register */
+    *is_cap = true;
+#endif
+    if (i >= 0) {
+        return i;
+    }
+    *is_cap = false;
+
+    if (!strcmp(name, "pc")) {
+        return RISCV_PLUGIN_REG_PC;
+    }
+    for (i = 0; i < CSR_TABLE_SIZE; i++) {
+        if (csr_ops[i].name && !strcmp(csr_ops[i].name, name)) {
+            return RISCV_PLUGIN_REG_CSR_BASE + i;
+        }
+    }
+#ifdef TARGET_CHERI
+    for (i = 0; i < ARRAY_SIZE(riscv_plugin_scrs); i++) {
+        if (!g_ascii_strcasecmp(riscv_plugin_scrs[i].name, name)) {
+            *is_cap = true;
+            return RISCV_PLUGIN_REG_SCR_BASE + i;
+        }
+    }
+#endif
+    return -1;
+}
+
+bool riscv_plugin_reg_read(CPUState *cs, int reg, uint64_t *val)
+{
+    CPURISCVState *env = &RISCV_CPU(cs)->env;
+    target_ulong csr_val;
+
+    if (reg < 32) {
+        /* reads the cursor only, even for lazily decompressed registers */
+        *val = gpr_int_value(env, reg);
+        return true;
+    }
+    if (reg == RISCV_PLUGIN_REG_PC) {
+        *val = cpu_get_recent_pc(env);
+        return true;
+    }
+    if (riscv_plugin_reg_is_csr(reg)) {
+        if (riscv_csrrw_debug(env, reg - RISCV_PLUGIN_REG_CSR_BASE, &csr_val,
+                              0, 0) < 0) {
+            return false;
+        }
+        *val = csr_val;
+        return true;
+    }
+#ifdef TARGET_CHERI
+    if (riscv_plugin_reg_is_scr(reg)) {
+        *val = cap_get_cursor(riscv_plugin_scr(env, reg));
+        return true;
+    }
+#endif
+    return false;
+}
+
+/*
+ * Only GPRs can be written. CSRs such as misa, mstatus or satp change how
+ * the current TB was translated or the privilege it runs with, which a
+ * callback in the middle of a TB must not do. Writing capabilities from
+ * plugins would allow forging them.
+ */
+bool riscv_plugin_reg_write(CPUState *cs, int reg, uint64_t val)
+{
+    CPURISCVState *env = &RISCV_CPU(cs)->env;
+
+    if (reg > 0 && reg < 32) {
+        gpr_set_int_value(env, reg, val);
+        return true;
+    }
+    return false;
+}
+
+bool riscv_plugin_cap_reg_read(CPUState *cs, int reg,
+                               struct qemu_plugin_cap *cap)
+{
+#ifdef TARGET_CHERI
+    CPURISCVState *env = &RISCV_CPU(cs)->env;
+
+    if (reg < 32) {
+        cap->cursor = get_without_decompress_cursor(env, reg);
+        cap->pesbt = get_without_decompress_pesbt(env, reg);
+        cap->tag = get_without_decompress_tag(env, reg);
+        return true;
+    }
+    if (riscv_plugin_reg_is_scr(reg)) {
+        const cap_register_t *scr = riscv_plugin_scr(env, reg);
+
+        cap->cursor = scr->_cr_cursor;
+        cap->pesbt = CAP_cc(compress_raw)(scr);
+        cap->tag = scr->cr_tag;
+        return true;
+    }
+#endif
+    return false;
+}
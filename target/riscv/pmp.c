@@ -465,6 +465,36 @@ bool pmp_is_range_in_tlb(CPURISCVState *env, hwaddr tlb_sa,
     return false;
 }
 
+/*
+ * Check that no active PMP entry starts or ends within [sa, sa + size), so
+ * that every byte of the range gets the same privileges. This allows a
+ * superpage to be cached as a whole in the TLB.
+ */
+bool pmp_is_range_uniform(CPURISCVState *env, hwaddr sa, target_ulong size)
+{
+    hwaddr ea = sa + size - 1;
+    int i;
+
+    for (i = 0; i < MAX_RISCV_PMPS; i++) {
+        target_ulong pmp_sa = env->pmp_state.addr[i].sa;
+        target_ulong pmp_ea = env->pmp_state.addr[i].ea;
+
+        if (pmp_get_a_field(env->pmp_state.pmp[i].cfg_reg) ==
+            PMP_AMATCH_OFF) {
+            continue;
+        }
+        if (pmp_ea < sa || pmp_sa > ea) {
+            continue;
+        }
+        if (pmp_sa <= sa && pmp_ea >= ea) {
+            continue;
+        }
+        return false;
+    }
+
+    return true;
+}
+
 /*
  * Convert PMP privilege to TLB page privilege.
  */
@@ -182,6 +182,21 @@ static void lookup_and_goto_ptr(DisasContext *ctx)
     }
 }
 
+/*
+ * Like lookup_and_goto_ptr(), but predicts the target TB inline. Only valid
+ * for jumps that change pc and, if @aux is not NULL, the state identified by
+ * @aux but nothing else that is part of the TB flags.
+ */
+static void lookup_and_goto_ptr_pred(DisasContext *ctx, TCGv_i64 aux)
+{
+    if (ctx->base.singlestep_enabled) {
+        gen_exception_debug();
+    } else {
+        tcg_gen_lookup_and_goto_ptr_pred(ctx->base.tb, ctx->base.pc_next,
+                                         cpu_pc, aux);
+    }
+}
+
 static void gen_exception_illegal(DisasContext *ctx)
 {
     generate_exception(ctx, RISCV_EXCP_ILLEGAL_INST);
@@ -349,6 +364,27 @@ static void gen_goto_tb(DisasContext *ctx, int n, target_ulong dest,
     }
 }
 
+/*
+ * Instead of ending the TB at a direct jump, continue translating at its
+ * target if that is further ahead in the same page. The jump and its
+ * successor then form one block, so the TCG optimizer and register allocator
+ * work across both and we save a TB exit and lookup. Only forward jumps are
+ * followed: pc_next must never decrease within a TB so that tb->size covers
+ * all translated instructions (see also gen_check_pcc_bounds_next_inst()).
+ * Returns true if the jump was followed and the caller must not end the TB.
+ */
+static bool gen_follow_jump(DisasContext *ctx, target_ulong dest)
+{
+    target_ulong page_start = ctx->base.pc_first & TARGET_PAGE_MASK;
+
+    if (ctx->base.is_jmp != DISAS_NEXT || dest < ctx->pc_succ_insn ||
+        dest - page_start >= TARGET_PAGE_SIZE) {
+        return false;
+    }
+    ctx->pc_succ_insn = dest;
+    return true;
+}
+
 static void gen_mulhsu(TCGv ret, TCGv arg1, TCGv arg2)
 {
     TCGv rl = tcg_temp_new();
@@ -489,6 +525,9 @@ static void gen_jal(DisasContext *ctx, int rd, target_ulong imm)
     /* For CHERI ISAv8 the result is an offset relative to PCC.base */
     gen_set_gpr_const(rd, ctx->pc_succ_insn - pcc_reloc(ctx));
 
+    if (gen_follow_jump(ctx, next_pc)) {
+        return;
+    }
     gen_goto_tb(ctx, 0, ctx->base.pc_next + imm, /*bounds_check=*/true); /* must use this for safety */
     ctx->base.is_jmp = DISAS_NORETURN;
 }
@@ -519,7 +558,7 @@ static void gen_jalr(DisasContext *ctx, int rd, int rs1, target_ulong imm)
 
     /* For CHERI ISAv8 the result is an offset relative to PCC.base */
     gen_set_gpr_const(rd, ctx->pc_succ_insn - pcc_reloc(ctx));
-    lookup_and_goto_ptr(ctx);
+    lookup_and_goto_ptr_pred(ctx, NULL);
 
     if (misaligned) {
         gen_set_label(misaligned);
@@ -905,10 +905,16 @@ RVVCALL(OPIVV2, vsub_vv_h, OP_SSS_H, H2, H2, H2, DO_SUB)
 RVVCALL(OPIVV2, vsub_vv_w, OP_SSS_W, H4, H4, H4, DO_SUB)
 RVVCALL(OPIVV2, vsub_vv_d, OP_SSS_D, H8, H8, H8, DO_SUB)
 
-static void do_vext_vv(void *vd, void *v0, void *vs1, void *vs2,
-                       CPURISCVState *env, uint32_t desc,
-                       uint32_t esz, uint32_t dsz,
-                       opivv2_fn *fn, clear_fn *clearfn)
+/*
+ * Always inlined into the helpers, so that FN is a direct call that can be
+ * inlined in turn: the unmasked loop is then simple enough for the host
+ * compiler to vectorize.
+ */
+static inline QEMU_ALWAYS_INLINE void
+do_vext_vv(void *vd, void *v0, void *vs1, void *vs2,
+           CPURISCVState *env, uint32_t desc,
+           uint32_t esz, uint32_t dsz,
+           opivv2_fn *fn, clear_fn *clearfn)
 {
     uint32_t vlmax = vext_maxsz(desc) / esz;
     uint32_t mlen = vext_mlen(desc);
@@ -916,11 +922,16 @@ static void do_vext_vv(void *vd, void *v0, void *vs1, void *vs2,
     uint32_t vl = env->vl;
     uint32_t i;
 
-    for (i = 0; i < vl; i++) {
-        if (!vm && !vext_elem_mask(v0, mlen, i)) {
-            continue;
+    if (vm) {
+        for (i = 0; i < vl; i++) {
+            fn(vd, vs1, vs2, i);
+        }
+    } else {
+        for (i = 0; i < vl; i++) {
+            if (vext_elem_mask(v0, mlen, i)) {
+                fn(vd, vs1, vs2, i);
+            }
         }
-        fn(vd, vs1, vs2, i);
     }
     clearfn(vd, vl, vl * dsz,  vlmax * dsz);
 }
@@ -970,10 +981,12 @@ RVVCALL(OPIVX2, vrsub_vx_h, OP_SSS_H, H2, H2, DO_RSUB)
 RVVCALL(OPIVX2, vrsub_vx_w, OP_SSS_W, H4, H4, DO_RSUB)
 RVVCALL(OPIVX2, vrsub_vx_d, OP_SSS_D, H8, H8, DO_RSUB)
 
-static void do_vext_vx(void *vd, void *v0, target_long s1, void *vs2,
-                       CPURISCVState *env, uint32_t desc,
-                       uint32_t esz, uint32_t dsz,
-                       opivx2_fn fn, clear_fn *clearfn)
+/* As do_vext_vv, always inlined so that the unmasked loop vectorizes. */
+static inline QEMU_ALWAYS_INLINE void
+do_vext_vx(void *vd, void *v0, target_long s1, void *vs2,
+           CPURISCVState *env, uint32_t desc,
+           uint32_t esz, uint32_t dsz,
+           opivx2_fn fn, clear_fn *clearfn)
 {
     uint32_t vlmax = vext_maxsz(desc) / esz;
     uint32_t mlen = vext_mlen(desc);
@@ -981,11 +994,16 @@ static void do_vext_vx(void *vd, void *v0, target_long s1, void *vs2,
     uint32_t vl = env->vl;
     uint32_t i;
 
-    for (i = 0; i < vl; i++) {
-        if (!vm && !vext_elem_mask(v0, mlen, i)) {
-            continue;
+    if (vm) {
+        for (i = 0; i < vl; i++) {
+            fn(vd, s1, vs2, i);
+        }
+    } else {
+        for (i = 0; i < vl; i++) {
+            if (vext_elem_mask(v0, mlen, i)) {
+                fn(vd, s1, vs2, i);
+            }
         }
-        fn(vd, s1, vs2, i);
     }
     clearfn(vd, vl, vl * dsz,  vlmax * dsz);
 }
@@ -1627,6 +1645,34 @@ GEN_VEXT_VX(vmax_vx_h, 2, 2, clearh)
 GEN_VEXT_VX(vmax_vx_w, 4, 4, clearl)
 GEN_VEXT_VX(vmax_vx_d, 8, 8, clearq)
 
+#define GEN_VEC_MINMAXS(NAME, TYPE, OP)                          \
+void HELPER(NAME)(void *d, void *a, uint64_t b, uint32_t desc)  \
+{                                                               \
+    intptr_t oprsz = simd_oprsz(desc);                          \
+    intptr_t i;                                                 \
+                                                                \
+    for (i = 0; i < oprsz; i += sizeof(TYPE)) {                 \
+        *(TYPE *)(d + i) = OP(*(TYPE *)(a + i), (TYPE)b);       \
+    }                                                           \
+}
+
+GEN_VEC_MINMAXS(vec_smins8, int8_t, DO_MIN)
+GEN_VEC_MINMAXS(vec_smins16, int16_t, DO_MIN)
+GEN_VEC_MINMAXS(vec_smins32, int32_t, DO_MIN)
+GEN_VEC_MINMAXS(vec_smins64, int64_t, DO_MIN)
+GEN_VEC_MINMAXS(vec_umins8, uint8_t, DO_MIN)
+GEN_VEC_MINMAXS(vec_umins16, uint16_t, DO_MIN)
+GEN_VEC_MINMAXS(vec_umins32, uint32_t, DO_MIN)
+GEN_VEC_MINMAXS(vec_umins64, uint64_t, DO_MIN)
+GEN_VEC_MINMAXS(vec_smaxs8, int8_t, DO_MAX)
+GEN_VEC_MINMAXS(vec_smaxs16, int16_t, DO_MAX)
+GEN_VEC_MINMAXS(vec_smaxs32, int32_t, DO_MAX)
+GEN_VEC_MINMAXS(vec_smaxs64, int64_t, DO_MAX)
+GEN_VEC_MINMAXS(vec_umaxs8, uint8_t, DO_MAX)
+GEN_VEC_MINMAXS(vec_umaxs16, uint16_t, DO_MAX)
+GEN_VEC_MINMAXS(vec_umaxs32, uint32_t, DO_MAX)
+GEN_VEC_MINMAXS(vec_umaxs64, uint64_t, DO_MAX)
+
 /* Vector Single-Width Integer Multiply Instructions */
 #define DO_MUL(N, M) (N * M)
 RVVCALL(OPIVV2, vmul_vv_b, OP_SSS_B, H1, H1, H1, DO_MUL)
@@ -3193,11 +3239,16 @@ void HELPER(NAME)(void *vd, void *v0, void *vs1,          \
     uint32_t vl = env->vl;                                \
     uint32_t i;                                           \
                                                           \
-    for (i = 0; i < vl; i++) {                            \
-        if (!vm && !vext_elem_mask(v0, mlen, i)) {        \
-            continue;                                     \
+    if (vm) {                                             \
+        for (i = 0; i < vl; i++) {                        \
+            do_##NAME(vd, vs1, vs2, i, env);              \
+        }                                                 \
+    } else {                                              \
+        for (i = 0; i < vl; i++) {                        \
+            if (vext_elem_mask(v0, mlen, i)) {            \
+                do_##NAME(vd, vs1, vs2, i, env);          \
+            }                                             \
         }                                                 \
-        do_##NAME(vd, vs1, vs2, i, env);                  \
     }                                                     \
     CLEAR_FN(vd, vl, vl * DSZ,  vlmax * DSZ);             \
 }
@@ -3228,11 +3279,16 @@ void HELPER(NAME)(void *vd, void *v0, uint64_t s1,        \
     uint32_t vl = env->vl;                                \
     uint32_t i;                                           \
                                                           \
-    for (i = 0; i < vl; i++) {                            \
-        if (!vm && !vext_elem_mask(v0, mlen, i)) {        \
-            continue;                                     \
+    if (vm) {                                             \
+        for (i = 0; i < vl; i++) {                        \
+            do_##NAME(vd, s1, vs2, i, env);               \
+        }                                                 \
+    } else {                                              \
+        for (i = 0; i < vl; i++) {                        \
+            if (vext_elem_mask(v0, mlen, i)) {            \
+                do_##NAME(vd, s1, vs2, i, env);           \
+            }                                             \
         }                                                 \
-        do_##NAME(vd, s1, vs2, i, env);                   \
     }                                                     \
     CLEAR_FN(vd, vl, vl * DSZ,  vlmax * DSZ);             \
 }
@@ -597,6 +597,140 @@ static bool swap_commutative2(TCGArg *p1, TCGArg *p2)
     return false;
 }
 
+/* Number of bytes of env accessed by a host load or store, or 0.  */
+static int env_ldst_size(TCGOp *op)
+{
+    switch (op->opc) {
+    CASE_OP_32_64(ld8u):
+    CASE_OP_32_64(ld8s):
+    CASE_OP_32_64(st8):
+        return 1;
+    CASE_OP_32_64(ld16u):
+    CASE_OP_32_64(ld16s):
+    CASE_OP_32_64(st16):
+        return 2;
+    case INDEX_op_ld_i32:
+    case INDEX_op_st_i32:
+    case INDEX_op_ld32u_i64:
+    case INDEX_op_ld32s_i64:
+    case INDEX_op_st32_i64:
+        return 4;
+    case INDEX_op_ld_i64:
+    case INDEX_op_st_i64:
+        return 8;
+    case INDEX_op_ld_vec:
+    case INDEX_op_st_vec:
+    case INDEX_op_dupm_vec:
+        return 8 << TCGOP_VECL(op);
+    default:
+        return 0;
+    }
+}
+
+/* Does [ofs, ofs + size) of env overlap the canonical slot of a global?  */
+static bool env_range_has_global(TCGContext *s, TCGTemp *env,
+                                 intptr_t ofs, int size)
+{
+    int i;
+
+    for (i = 0; i < s->nb_globals; i++) {
+        TCGTemp *ts = &s->temps[i];
+        int ts_size = ts->type == TCG_TYPE_I32 ? 4 : 8;
+
+        if (ts->mem_base == env && ofs < ts->mem_offset + ts_size
+            && ts->mem_offset < ofs + size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#define MAX_DEAD_ENV_RANGES 16
+
+/*
+ * Remove host stores to env that are overwritten by a later store to the
+ * same bytes before anything can read them.  Front ends emit these when
+ * spilling state that is not held in a TCG global, e.g. the CHERI lazy
+ * capability register state byte, once per instruction.
+ *
+ * Walk the ops backwards, keeping the ranges of env that are known to be
+ * overwritten before they are read.  Helper calls, guest memory accesses
+ * (which may raise an exception) and the end of each basic block forget
+ * everything: stores that reach a TB exit are always kept, since the TB
+ * that runs next is not known at translation time.  Slots backing TCG
+ * globals are left alone, as are front ends with indirect globals, whose
+ * implicit loads are not visible as ops here.
+ */
+static void tcg_optimize_env_stores(TCGContext *s)
+{
+    struct {
+        intptr_t ofs;
+        int size;
+    } dead[MAX_DEAD_ENV_RANGES];
+    TCGTemp *env = tcgv_ptr_temp(cpu_env);
+    TCGOp *op, *op_prev;
+    int nb_dead = 0;
+
+    if (s->nb_indirects > 0) {
+        return;
+    }
+
+    QTAILQ_FOREACH_REVERSE_SAFE(op, &s->ops, link, op_prev) {
+        TCGOpcode opc = op->opc;
+        const TCGOpDef *def = &tcg_op_defs[opc];
+        int size = env_ldst_size(op);
+        intptr_t ofs;
+        int i;
+
+        if (size == 0) {
+            if (opc == INDEX_op_call || opc == INDEX_op_set_label
+                || (def->flags & (TCG_OPF_BB_END | TCG_OPF_SIDE_EFFECTS))) {
+                nb_dead = 0;
+            }
+            continue;
+        }
+
+        if (arg_temp(op->args[1]) != env) {
+            /* A load through another pointer may alias env.  */
+            if (def->nb_oargs) {
+                nb_dead = 0;
+            }
+            continue;
+        }
+
+        ofs = op->args[2];
+        if (def->nb_oargs) {
+            /* A load keeps alive any later store that it overlaps.  */
+            for (i = 0; i < nb_dead; ) {
+                if (ofs < dead[i].ofs + dead[i].size
+                    && dead[i].ofs < ofs + size) {
+                    dead[i] = dead[--nb_dead];
+                } else {
+                    i++;
+                }
+            }
+            continue;
+        }
+
+        if (env_range_has_global(s, env, ofs, size)) {
+            continue;
+        }
+        for (i = 0; i < nb_dead; i++) {
+            if (ofs >= dead[i].ofs
+                && ofs + size <= dead[i].ofs + dead[i].size) {
+                break;
+            }
+        }
+        if (i < nb_dead) {
+            tcg_op_remove(s, op);
+        } else if (nb_dead < MAX_DEAD_ENV_RANGES) {
+            dead[nb_dead].ofs = ofs;
+            dead[nb_dead].size = size;
+            nb_dead++;
+        }
+    }
+}
+
 /* Propagate constants and copies, fold constant expressions. */
 void tcg_optimize(TCGContext *s)
 {
@@ -1553,4 +1687,6 @@ void tcg_optimize(TCGContext *s)
             prev_mb = op;
         }
     }
+
+    tcg_optimize_env_stores(s);
 }
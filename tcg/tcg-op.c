@@ -2744,6 +2744,95 @@ void tcg_gen_lookup_and_goto_ptr(void)
     }
 }
 
+void tcg_gen_lookup_and_goto_ptr_pred(const TranslationBlock *tb,
+                                      target_ulong site_pc, TCGv pc,
+                                      TCGv_i64 aux)
+{
+    /*
+     * The site tag must identify the jump for as long as the cached entries
+     * may be used, i.e. until the TB is freed, which clears the cache.
+     */
+    uint64_t site = ((uint64_t)(uintptr_t)tb << 16) ^ (site_pc - tb->pc);
+    TCGLabel *miss;
+    TCGv_i32 idx, t32;
+    TCGv_ptr entry, dest;
+    TCGv_i64 key, t64;
+    TCGv target, t;
+
+    if (!TCG_TARGET_HAS_goto_ptr || qemu_loglevel_mask(CPU_LOG_TB_NOCHAIN)) {
+        tcg_gen_exit_tb(NULL, 0);
+        return;
+    }
+    plugin_gen_disable_mem_helpers();
+
+    /* Values used after a branch must live in local temps */
+    miss = gen_new_label();
+    target = tcg_temp_local_new();
+    key = tcg_temp_local_new_i64();
+    idx = tcg_temp_local_new_i32();
+    entry = tcg_temp_local_new_ptr();
+    dest = tcg_temp_local_new_ptr();
+    tcg_gen_mov_tl(target, pc);
+    if (aux) {
+        tcg_gen_mov_i64(key, aux);
+    } else {
+        tcg_gen_movi_i64(key, 0);
+    }
+
+    /* entry = &cpu->tb_ibtc[hash(site, target)] */
+    t = tcg_temp_new();
+    tcg_gen_shri_tl(t, target, 1);
+    tcg_gen_trunc_tl_i32(idx, t);
+    tcg_temp_free(t);
+    tcg_gen_xori_i32(idx, idx, (uint32_t)(site_pc >> 1) * 0x9e3779b9u);
+    tcg_gen_andi_i32(idx, idx, TB_IBTC_SIZE - 1);
+    t32 = tcg_temp_new_i32();
+    tcg_gen_muli_i32(t32, idx, sizeof(CPUIBTCEntry));
+    tcg_gen_ext_i32_ptr(entry, t32);
+    tcg_temp_free_i32(t32);
+    tcg_gen_add_ptr(entry, entry, cpu_env);
+
+#define IBTC_OFFSET(field) \
+    (offsetof(ArchCPU, parent_obj) - offsetof(ArchCPU, env) + \
+     offsetof(CPUState, tb_ibtc[0].field))
+    t64 = tcg_temp_new_i64();
+    tcg_gen_ld_i64(t64, entry, IBTC_OFFSET(site));
+    tcg_gen_brcondi_i64(TCG_COND_NE, t64, site, miss);
+    tcg_temp_free_i64(t64);
+    if (aux) {
+        t64 = tcg_temp_new_i64();
+        tcg_gen_ld_i64(t64, entry, IBTC_OFFSET(aux));
+        tcg_gen_brcond_i64(TCG_COND_NE, t64, key, miss);
+        tcg_temp_free_i64(t64);
+    }
+    tcg_gen_ld_ptr(dest, entry, IBTC_OFFSET(tb));
+#undef IBTC_OFFSET
+
+    t = tcg_temp_new();
+    tcg_gen_ld_tl(t, dest, offsetof(TranslationBlock, pc));
+    tcg_gen_brcond_tl(TCG_COND_NE, t, target, miss);
+    tcg_temp_free(t);
+    /* This also rejects a TB that has been invalidated since it was cached */
+    t32 = tcg_temp_new_i32();
+    tcg_gen_ld_i32(t32, dest, offsetof(TranslationBlock, cflags));
+    tcg_gen_brcondi_i32(TCG_COND_NE, t32, tb_cflags(tb), miss);
+    tcg_temp_free_i32(t32);
+    tcg_gen_ld_ptr(dest, dest, offsetof(TranslationBlock, tc.ptr));
+    tcg_gen_op1i(INDEX_op_goto_ptr, tcgv_ptr_arg(dest));
+
+    gen_set_label(miss);
+    t64 = tcg_const_i64(site);
+    gen_helper_lookup_tb_ptr_pred(dest, cpu_env, idx, t64, key);
+    tcg_temp_free_i64(t64);
+    tcg_gen_op1i(INDEX_op_goto_ptr, tcgv_ptr_arg(dest));
+
+    tcg_temp_free(target);
+    tcg_temp_free_i64(key);
+    tcg_temp_free_i32(idx);
+    tcg_temp_free_ptr(entry);
+    tcg_temp_free_ptr(dest);
+}
+
 static inline MemOp tcg_canonicalize_memop(MemOp op, bool is64, bool st)
 {
     /* Trigger the asserts within as early as possible.  */
@@ -2772,10 +2861,78 @@ static inline MemOp tcg_canonicalize_memop(MemOp op, bool is64, bool st)
     return op;
 }
 
+#ifdef CONFIG_SOFTMMU
+/*
+ * Return true if the guest instruction being translated has taken the
+ * softmmu slow path for most of its accesses so far, see
+ * tlb_slow_path_preferred(). Its loads and stores then call the slow path
+ * helpers directly instead of first trying the inline TLB lookup; @pc is
+ * set to its address for the helpers' own accounting.
+ */
+static bool tcg_ldst_prefer_helper(target_ulong *pc)
+{
+    TCGOp *op;
+
+    if (likely(!tcg_slow_path_profile)) {
+        return false;
+    }
+    QTAILQ_FOREACH_REVERSE(op, &tcg_ctx->ops, link) {
+        if (op->opc == INDEX_op_insn_start) {
+            if (TARGET_LONG_BITS > TCG_TARGET_REG_BITS) {
+                *pc = deposit64(op->args[0], 32, 32, op->args[1]);
+            } else {
+                *pc = op->args[0];
+            }
+            return tlb_slow_path_preferred(*pc);
+        }
+    }
+    return false;
+}
+
+static void gen_ldst_helper_i32(TCGOpcode opc, TCGv_i32 val,
+                                TCGv_cap_checked_ptr addr, TCGMemOpIdx oi,
+                                target_ulong pc)
+{
+    TCGv_i64 t = tcg_temp_new_i64();
+
+    if (opc == INDEX_op_qemu_ld_i32) {
+        gen_helper_qemu_ld_direct(t, cpu_env, (TCGv)addr,
+                                  tcg_constant_i32(oi), tcg_constant_tl(pc));
+        tcg_gen_extrl_i64_i32(val, t);
+    } else {
+        tcg_gen_extu_i32_i64(t, val);
+        gen_helper_qemu_st_direct(cpu_env, (TCGv)addr, t,
+                                  tcg_constant_i32(oi), tcg_constant_tl(pc));
+    }
+    tcg_temp_free_i64(t);
+}
+
+static void gen_ldst_helper_i64(TCGOpcode opc, TCGv_i64 val,
+                                TCGv_cap_checked_ptr addr, TCGMemOpIdx oi,
+                                target_ulong pc)
+{
+    if (opc == INDEX_op_qemu_ld_i64) {
+        gen_helper_qemu_ld_direct(val, cpu_env, (TCGv)addr,
+                                  tcg_constant_i32(oi), tcg_constant_tl(pc));
+    } else {
+        gen_helper_qemu_st_direct(cpu_env, (TCGv)addr, val,
+                                  tcg_constant_i32(oi), tcg_constant_tl(pc));
+    }
+}
+#endif
+
 static void gen_ldst_i32(TCGOpcode opc, TCGv_i32 val, TCGv_cap_checked_ptr addr,
                          MemOp memop, TCGArg idx)
 {
     TCGMemOpIdx oi = make_memop_idx(memop, idx);
+#ifdef CONFIG_SOFTMMU
+    target_ulong pc;
+
+    if (tcg_ldst_prefer_helper(&pc)) {
+        gen_ldst_helper_i32(opc, val, addr, oi, pc);
+        return;
+    }
+#endif
 #if TARGET_LONG_BITS == 32
     tcg_gen_op3i_i32(opc, val, (TCGv)addr, oi);
 #else
@@ -2791,6 +2948,14 @@ static void gen_ldst_i64(TCGOpcode opc, TCGv_i64 val, TCGv_cap_checked_ptr addr,
                          MemOp memop, TCGArg idx)
 {
     TCGMemOpIdx oi = make_memop_idx(memop, idx);
+#ifdef CONFIG_SOFTMMU
+    target_ulong pc;
+
+    if (tcg_ldst_prefer_helper(&pc)) {
+        gen_ldst_helper_i64(opc, val, addr, oi, pc);
+        return;
+    }
+#endif
 #if TARGET_LONG_BITS == 32
     if (TCG_TARGET_REG_BITS == 32) {
         tcg_gen_op4i_i32(opc, TCGV_LOW(val), TCGV_HIGH(val), (TCGv)addr, oi);
@@ -2956,22 +3121,39 @@ static void tcg_gen_qemu_st_i32_with_checked_addr_cond_invalidate(
     }
 
     addr = plugin_prep_mem_callbacks(addr);
+#if defined(TARGET_CHERI) || defined(CONFIG_TCG_LOG_INSTR)
+    TCGv_i32 tcoi = tcg_const_i32(make_memop_idx(memop, idx));
+#endif
+#if defined(TARGET_CHERI)
+    /*
+     * In a parallel context the tag clear must be atomic with the data write
+     * with respect to CLC on other vCPUs, see cheri_tagmem.c.
+     */
+    const bool locked = invalidate && (tcg_ctx->tb_cflags & CF_PARALLEL);
+    if (locked) {
+        gen_helper_cheri_store_begin(cpu_env, addr, tcoi);
+    }
+#endif
     if (TCG_TARGET_HAS_qemu_st8_i32 && (memop & MO_SIZE) == MO_8) {
         gen_ldst_i32(INDEX_op_qemu_st8_i32, val, addr, memop, idx);
     } else {
         gen_ldst_i32(INDEX_op_qemu_st_i32, val, addr, memop, idx);
     }
+#if defined(TARGET_CHERI)
+    if (locked) {
+        gen_helper_cheri_store_end(cpu_env, addr, tcoi, tcg_constant_i32(1));
+    }
+#endif
     gen_rvfi_dii_set_mem_data_i32(w, addr, val, memop);
     plugin_gen_mem_callbacks(addr, info);
 #if defined(TARGET_CHERI) || defined(CONFIG_TCG_LOG_INSTR)
-    TCGv_i32 tcoi = tcg_const_i32(make_memop_idx(memop, idx));
 #if defined(CONFIG_TCG_LOG_INSTR)
     if (tcg_ctx_logging_enabled) {
         gen_helper_qemu_log_instr_store32(cpu_env, addr, val, tcoi);
     }
 #endif
 #if defined(TARGET_CHERI)
-    if (invalidate) {
+    if (invalidate && !locked) {
         gen_helper_cheri_invalidate_tags(cpu_env, addr, tcoi);
     }
 #endif
@@ -3114,19 +3296,33 @@ void tcg_gen_qemu_st_i64_with_checked_addr_cond_invalidate(
     }
 
     addr = plugin_prep_mem_callbacks(addr);
+#if defined(TARGET_CHERI) || defined(CONFIG_TCG_LOG_INSTR)
+    TCGv_i32 tcoi = tcg_const_i32(make_memop_idx(memop, idx));
+#endif
+#if defined(TARGET_CHERI)
+    /* See tcg_gen_qemu_st_i32_with_checked_addr_cond_invalidate(). */
+    const bool locked = invalidate && (tcg_ctx->tb_cflags & CF_PARALLEL);
+    if (locked) {
+        gen_helper_cheri_store_begin(cpu_env, addr, tcoi);
+    }
+#endif
     gen_ldst_i64(INDEX_op_qemu_st_i64, val, addr, memop, idx);
+#if defined(TARGET_CHERI)
+    if (locked) {
+        gen_helper_cheri_store_end(cpu_env, addr, tcoi, tcg_constant_i32(1));
+    }
+#endif
     gen_rvfi_dii_set_mem_data_i64(w, addr, val, memop);
 
     plugin_gen_mem_callbacks(addr, info);
 #if defined(TARGET_CHERI) || defined(CONFIG_TCG_LOG_INSTR)
-    TCGv_i32 tcoi = tcg_const_i32(make_memop_idx(memop, idx));
 #if defined(CONFIG_TCG_LOG_INSTR)
     if (tcg_ctx_logging_enabled) {
         gen_helper_qemu_log_instr_store64(cpu_env, addr, val, tcoi);
     }
 #endif
 #if defined(TARGET_CHERI)
-    if (invalidate) {
+    if (invalidate && !locked) {
         gen_helper_cheri_invalidate_tags(cpu_env, addr, tcoi);
     }
 #endif
@@ -3263,12 +3459,21 @@ void tcg_gen_atomic_cmpxchg_i32_with_checked_addr(
         }
         tcg_temp_free_i32(t1);
     } else {
-        ASSERT_IF_CHERI();
         gen_atomic_cx_i32 gen;
 
         gen = table_cmpxchg[memop & (MO_SIZE | MO_BSWAP)];
         tcg_debug_assert(gen != NULL);
 
+#ifdef TARGET_CHERI
+        /*
+         * Hold the tag lock across the cmpxchg and only clear the tag if the
+         * store happened (retv may alias cmpv, so extend it first).
+         */
+        TCGv_i32 tcoi = tcg_const_i32(make_memop_idx(memop, idx));
+        TCGv_i32 equal = tcg_temp_new_i32();
+        tcg_gen_ext_i32(equal, cmpv, memop & MO_SIZE);
+        gen_helper_cheri_store_begin(cpu_env, checked_addr, tcoi);
+#endif
 #ifdef CONFIG_SOFTMMU
         {
             TCGMemOpIdx oi = make_memop_idx(memop & ~MO_SIGN, idx);
@@ -3277,6 +3482,12 @@ void tcg_gen_atomic_cmpxchg_i32_with_checked_addr(
 #else
         gen(retv, cpu_env, addr, cmpv, newv);
 #endif
+#ifdef TARGET_CHERI
+        tcg_gen_setcond_i32(TCG_COND_EQ, equal, retv, equal);
+        gen_helper_cheri_store_end(cpu_env, checked_addr, tcoi, equal);
+        tcg_temp_free_i32(equal);
+        tcg_temp_free_i32(tcoi);
+#endif
 
         if (memop & MO_SIGN) {
             tcg_gen_ext_i32(retv, retv, memop);
@@ -3320,13 +3531,20 @@ void tcg_gen_atomic_cmpxchg_i64_with_checked_addr(
         }
         tcg_temp_free_i64(t1);
     } else if ((memop & MO_SIZE) == MO_64) {
-        ASSERT_IF_CHERI();
 #ifdef CONFIG_ATOMIC64
         gen_atomic_cx_i64 gen;
 
         gen = table_cmpxchg[memop & (MO_SIZE | MO_BSWAP)];
         tcg_debug_assert(gen != NULL);
 
+#ifdef TARGET_CHERI
+        /* See tcg_gen_atomic_cmpxchg_i32_with_checked_addr(). */
+        TCGv_i32 tcoi = tcg_const_i32(make_memop_idx(memop, idx));
+        TCGv_i64 cmp = tcg_temp_new_i64();
+        TCGv_i32 equal = tcg_temp_new_i32();
+        tcg_gen_mov_i64(cmp, cmpv);
+        gen_helper_cheri_store_begin(cpu_env, checked_addr, tcoi);
+#endif
 #ifdef CONFIG_SOFTMMU
         {
             TCGMemOpIdx oi = make_memop_idx(memop, idx);
@@ -3335,6 +3553,14 @@ void tcg_gen_atomic_cmpxchg_i64_with_checked_addr(
 #else
         gen(retv, cpu_env, (TCGv)checked_addr, cmpv, newv);
 #endif
+#ifdef TARGET_CHERI
+        tcg_gen_setcond_i64(TCG_COND_EQ, cmp, retv, cmp);
+        tcg_gen_extrl_i64_i32(equal, cmp);
+        gen_helper_cheri_store_end(cpu_env, checked_addr, tcoi, equal);
+        tcg_temp_free_i32(equal);
+        tcg_temp_free_i64(cmp);
+        tcg_temp_free_i32(tcoi);
+#endif
 #else
         gen_helper_exit_atomic(cpu_env);
         /* Produce a result, so that we have a well-formed opcode stream
@@ -3342,7 +3568,6 @@ void tcg_gen_atomic_cmpxchg_i64_with_checked_addr(
         tcg_gen_movi_i64(retv, 0);
 #endif /* CONFIG_ATOMIC64 */
     } else {
-        ASSERT_IF_CHERI();
         TCGv_i32 c32 = tcg_temp_new_i32();
         TCGv_i32 n32 = tcg_temp_new_i32();
         TCGv_i32 r32 = tcg_temp_new_i32();
@@ -3414,7 +3639,6 @@ static void do_atomic_op_i32(TCGv_i32 ret, TCGv_cap_checked_ptr checked_addr,
                              TCGv_i32 val, TCGArg idx, MemOp memop,
                              void *const table[])
 {
-    ASSERT_IF_CHERI();
     gen_atomic_op_i32 gen;
 
     memop = tcg_canonicalize_memop(memop, 0, 0);
@@ -3422,6 +3646,11 @@ static void do_atomic_op_i32(TCGv_i32 ret, TCGv_cap_checked_ptr checked_addr,
     gen = table[memop & (MO_SIZE | MO_BSWAP)];
     tcg_debug_assert(gen != NULL);
 
+#if defined(TARGET_CHERI)
+    /* Clear the tag atomically with the RMW, see cheri_tagmem.c. */
+    TCGv_i32 tcoi = tcg_const_i32(make_memop_idx(memop, idx));
+    gen_helper_cheri_store_begin(cpu_env, checked_addr, tcoi);
+#endif
 #ifdef CONFIG_SOFTMMU
     {
         TCGMemOpIdx oi = make_memop_idx(memop & ~MO_SIGN, idx);
@@ -3431,8 +3660,8 @@ static void do_atomic_op_i32(TCGv_i32 ret, TCGv_cap_checked_ptr checked_addr,
     gen(ret, cpu_env, addr, val);
 #endif
 #if defined(TARGET_CHERI)
-    TCGv_i32 tcoi = tcg_const_i32(make_memop_idx(memop, idx));
-    gen_helper_cheri_invalidate_tags(cpu_env, checked_addr, tcoi);
+    gen_helper_cheri_store_end(cpu_env, checked_addr, tcoi,
+                               tcg_constant_i32(1));
     tcg_temp_free_i32(tcoi);
 #endif
 #if defined(TARGET_MIPS) || defined(TARGET_RISCV)
@@ -3470,7 +3699,6 @@ static void do_atomic_op_i64(TCGv_i64 ret, TCGv_cap_checked_ptr checked_addr,
                              TCGv_i64 val, TCGArg idx, MemOp memop,
                              void *const table[])
 {
-    ASSERT_IF_CHERI();
     memop = tcg_canonicalize_memop(memop, 1, 0);
     if ((memop & MO_SIZE) == MO_64) {
 #ifdef CONFIG_ATOMIC64
@@ -3479,6 +3707,11 @@ static void do_atomic_op_i64(TCGv_i64 ret, TCGv_cap_checked_ptr checked_addr,
         gen = table[memop & (MO_SIZE | MO_BSWAP)];
         tcg_debug_assert(gen != NULL);
 
+#if defined(TARGET_CHERI)
+        /* Clear the tag atomically with the RMW, see cheri_tagmem.c. */
+        TCGv_i32 tcoi = tcg_const_i32(make_memop_idx(memop, idx));
+        gen_helper_cheri_store_begin(cpu_env, checked_addr, tcoi);
+#endif
 #ifdef CONFIG_SOFTMMU
         {
             TCGMemOpIdx oi = make_memop_idx(memop & ~MO_SIGN, idx);
@@ -3487,6 +3720,11 @@ static void do_atomic_op_i64(TCGv_i64 ret, TCGv_cap_checked_ptr checked_addr,
 #else
         gen(ret, cpu_env, (TCGv)checked_addr, val);
 #endif
+#if defined(TARGET_CHERI)
+        gen_helper_cheri_store_end(cpu_env, checked_addr, tcoi,
+                                   tcg_constant_i32(1));
+        tcg_temp_free_i32(tcoi);
+#endif
 #else
         gen_helper_exit_atomic(cpu_env);
         /* Produce a result, so that we have a well-formed opcode stream
@@ -3508,11 +3746,6 @@ static void do_atomic_op_i64(TCGv_i64 ret, TCGv_cap_checked_ptr checked_addr,
             tcg_gen_ext_i64(ret, ret, memop);
         }
     }
-#if defined(TARGET_CHERI)
-    TCGv_i32 tcoi = tcg_const_i32(make_memop_idx(memop, idx));
-    gen_helper_cheri_invalidate_tags(cpu_env, checked_addr, tcoi);
-    tcg_temp_free_i32(tcoi);
-#endif
 #if defined(TARGET_MIPS) || defined(TARGET_RISCV)
     gen_cheri_break_loadlink(checked_addr);
 #endif
@@ -199,7 +199,8 @@ struct tcg_region_state {
     size_t stride; /* .size + guard size */
 
     /* fields protected by the lock */
-    size_t current; /* current region index */
+    uint64_t *epoch; /* when each region was assigned; 0 if it is free */
+    uint64_t next_epoch;
     size_t agg_size_full; /* aggregate size of full regions */
 };
 
@@ -523,10 +524,23 @@ static void tcg_region_trees_init(void)
     }
 }
 
-static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
+/* @p must be a rw pointer into code_gen_buffer */
+static size_t tcg_region_index(const void *p)
 {
-    size_t region_idx;
+    if (p < region.start_aligned) {
+        return 0;
+    } else {
+        ptrdiff_t offset = p - region.start_aligned;
 
+        if (offset > region.stride * (region.n - 1)) {
+            return region.n - 1;
+        }
+        return offset / region.stride;
+    }
+}
+
+static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
+{
     /*
      * Like tcg_splitwx_to_rw, with no assert.  The pc may come from
      * a signal handler over which the caller has no control.
@@ -537,19 +551,7 @@ static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
             return NULL;
         }
     }
-
-    if (p < region.start_aligned) {
-        region_idx = 0;
-    } else {
-        ptrdiff_t offset = p - region.start_aligned;
-
-        if (offset > region.stride * (region.n - 1)) {
-            region_idx = region.n - 1;
-        } else {
-            region_idx = offset / region.stride;
-        }
-    }
-    return region_trees + region_idx * tree_size;
+    return region_trees + tcg_region_index(p) * tree_size;
 }
 
 void tcg_tb_insert(TranslationBlock *tb)
@@ -651,6 +653,15 @@ static gboolean tcg_region_tree_traverse(gpointer k, gpointer v, gpointer data)
     return FALSE;
 }
 
+/* Call with @rt->lock held */
+static void tcg_region_tree_reset(struct tcg_region_tree *rt)
+{
+    g_tree_foreach(rt->tree, tcg_region_tree_traverse, NULL);
+    /* Increment the refcount first so that destroy acts as a reset */
+    g_tree_ref(rt->tree);
+    g_tree_destroy(rt->tree);
+}
+
 static void tcg_region_tree_reset_all(void)
 {
     size_t i;
@@ -659,10 +670,7 @@ static void tcg_region_tree_reset_all(void)
     for (i = 0; i < region.n; i++) {
         struct tcg_region_tree *rt = region_trees + i * tree_size;
 
-        g_tree_foreach(rt->tree, tcg_region_tree_traverse, NULL);
-        /* Increment the refcount first so that destroy acts as a reset */
-        g_tree_ref(rt->tree);
-        g_tree_destroy(rt->tree);
+        tcg_region_tree_reset(rt);
     }
     tcg_region_tree_unlock_all();
 }
@@ -699,12 +707,16 @@ static void tcg_region_assign(TCGContext *s, size_t curr_region)
 
 static bool tcg_region_alloc__locked(TCGContext *s)
 {
-    if (region.current == region.n) {
-        return true;
+    size_t i;
+
+    for (i = 0; i < region.n; i++) {
+        if (region.epoch[i] == 0) {
+            tcg_region_assign(s, i);
+            region.epoch[i] = ++region.next_epoch;
+            return false;
+        }
     }
-    tcg_region_assign(s, region.current);
-    region.current++;
-    return false;
+    return true;
 }
 
 /*
@@ -742,7 +754,7 @@ void tcg_region_reset_all(void)
     unsigned int i;
 
     qemu_mutex_lock(&region.lock);
-    region.current = 0;
+    memset(region.epoch, 0, region.n * sizeof(*region.epoch));
     region.agg_size_full = 0;
 
     for (i = 0; i < n_ctxs; i++) {
@@ -756,6 +768,71 @@ void tcg_region_reset_all(void)
     tcg_region_tree_reset_all();
 }
 
+/*
+ * Reclaim the oldest full regions of code_gen_buffer instead of resetting all
+ * of them. Eviction is FIFO by the time a region was assigned; how often its
+ * TBs run is not tracked, so hot code in an old region is evicted as well and
+ * has to be retranslated. @evict is called on each TB in the reclaimed
+ * regions (with the region tree's lock held) and must unlink the TB from
+ * everything that can still reach it.
+ *
+ * Returns the number of regions that were reclaimed, 0 if a region was already
+ * free (e.g. because another vCPU got here first) or -1 if there are no
+ * regions that can be reclaimed, in which case the caller has to do a full
+ * flush.
+ *
+ * Call from a safe-work context.
+ */
+int tcg_region_evict(GTraverseFunc evict, gpointer user_data)
+{
+    unsigned int n_ctxs = qatomic_read(&n_tcg_ctxs);
+    g_autofree bool *busy = g_new0(bool, region.n);
+    size_t n_evict = MAX(region.n / 4, 1);
+    size_t i, n;
+
+    qemu_mutex_lock(&region.lock);
+    for (i = 0; i < region.n; i++) {
+        if (region.epoch[i] == 0) {
+            qemu_mutex_unlock(&region.lock);
+            return 0;
+        }
+    }
+    /* Regions that are still being filled by a TCG context are not full */
+    for (i = 0; i < n_ctxs; i++) {
+        const TCGContext *s = qatomic_read(&tcg_ctxs[i]);
+
+        busy[tcg_region_index(s->code_gen_buffer)] = true;
+    }
+
+    for (n = 0; n < n_evict; n++) {
+        struct tcg_region_tree *rt;
+        size_t oldest = region.n;
+        void *start, *end;
+
+        for (i = 0; i < region.n; i++) {
+            if (!busy[i] && region.epoch[i] != 0 &&
+                (oldest == region.n || region.epoch[i] < region.epoch[oldest])) {
+                oldest = i;
+            }
+        }
+        if (oldest == region.n) {
+            break;
+        }
+
+        rt = region_trees + oldest * tree_size;
+        qemu_mutex_lock(&rt->lock);
+        g_tree_foreach(rt->tree, evict, user_data);
+        tcg_region_tree_reset(rt);
+        qemu_mutex_unlock(&rt->lock);
+
+        tcg_region_bounds(oldest, &start, &end);
+        region.agg_size_full -= (end - start) - TCG_HIGHWATER;
+        region.epoch[oldest] = 0;
+    }
+    qemu_mutex_unlock(&region.lock);
+    return n ? n : -1;
+}
+
 #ifdef CONFIG_USER_ONLY
 static size_t tcg_n_regions(void)
 {
@@ -772,29 +849,30 @@ static size_t tcg_n_regions(void)
 {
     size_t i;
 
-    /* Use a single region if all we have is one vCPU thread */
 #if !defined(CONFIG_USER_ONLY)
     MachineState *ms = MACHINE(qdev_get_machine());
     unsigned int max_cpus = ms->smp.max_cpus;
 #endif
-    if (max_cpus == 1 || !qemu_tcg_mttcg_enabled()) {
-        return 1;
-    }
+    /*
+     * Without MTTCG there is a single TCG thread, but we still split the
+     * buffer so that tcg_region_evict() can reclaim part of it.
+     */
+    unsigned int n_threads = qemu_tcg_mttcg_enabled() ? max_cpus : 1;
 
-    /* Try to have more regions than max_cpus, with each region being >= 2 MB */
+    /* Try to have more regions than threads, with each region being >= 2 MB */
     for (i = 8; i > 0; i--) {
         size_t regions_per_thread = i;
         size_t region_size;
 
         region_size = tcg_init_ctx.code_gen_buffer_size;
-        region_size /= max_cpus * regions_per_thread;
+        region_size /= n_threads * regions_per_thread;
 
         if (region_size >= 2 * 1024u * 1024) {
-            return max_cpus * regions_per_thread;
+            return n_threads * regions_per_thread;
         }
     }
     /* If we can't, then just allocate one region per vCPU thread */
-    return max_cpus;
+    return n_threads;
 }
 #endif
 
@@ -809,7 +887,8 @@ static size_t tcg_n_regions(void)
  * code in parallel without synchronization.
  *
  * In softmmu the number of TCG threads is bounded by max_cpus, so we use at
- * least max_cpus regions in MTTCG. In !MTTCG we use a single region.
+ * least max_cpus regions in MTTCG. In !MTTCG the single TCG thread fills the
+ * regions one after the other.
  * Note that the TCG options from the command-line (i.e. -accel accel=tcg,[...])
  * must have been parsed before calling this function, since it calls
  * qemu_tcg_mttcg_enabled().
@@ -863,6 +942,7 @@ void tcg_region_init(void)
     region.end = QEMU_ALIGN_PTR_DOWN(buf + size, page_size);
     /* account for that last guard page */
     region.end -= page_size;
+    region.epoch = g_new0(uint64_t, region.n);
 
     /*
      * Set guard pages in the rw buffer, as that's the one into which
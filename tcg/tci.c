@@ -464,18 +464,37 @@ static bool tci_compare64(uint64_t u0, uint64_t u1, TCGCond condition)
 #define qemu_st_beq(X) \
     cpu_stq_be_mmuidx_ra(env, taddr, X, get_mmuidx(oi), (uintptr_t)tb_ptr)
 
+/*
+ * The code interpreting each operation starts at a label, and ends by
+ * jumping to the code of the next operation through tci_ops[] with
+ * TCI_NEXT(). Every operation thus has its own indirect jump, which
+ * host branch predictors handle much better than the single jump that
+ * all operations go through in a switch statement.
+ */
+#define TCI_OP(x) glue(tci_op_, x):
+#define TCI_OPS_ENTRY(x) [glue(INDEX_op_, x)] = &&glue(tci_op_, x),
+
 #if TCG_TARGET_REG_BITS == 64
-# define CASE_32_64(x) \
-        case glue(glue(INDEX_op_, x), _i64): \
-        case glue(glue(INDEX_op_, x), _i32):
-# define CASE_64(x) \
-        case glue(glue(INDEX_op_, x), _i64):
+# define TCI_OP_32_64(x) TCI_OP(glue(x, _i64)) TCI_OP(glue(x, _i32))
+# define TCI_OP_64(x) TCI_OP(glue(x, _i64))
+# define TCI_OPS_ENTRY_32_64(x) \
+    TCI_OPS_ENTRY(glue(x, _i64)) TCI_OPS_ENTRY(glue(x, _i32))
+# define TCI_OPS_ENTRY_64(x) TCI_OPS_ENTRY(glue(x, _i64))
 #else
-# define CASE_32_64(x) \
-        case glue(glue(INDEX_op_, x), _i32):
-# define CASE_64(x)
+# define TCI_OP_32_64(x) TCI_OP(glue(x, _i32))
+# define TCI_OP_64(x)
+# define TCI_OPS_ENTRY_32_64(x) TCI_OPS_ENTRY(glue(x, _i32))
+# define TCI_OPS_ENTRY_64(x)
 #endif
 
+/* Skip the opcode and size entry of the next operation, and run it. */
+#define TCI_NEXT()                      \
+    do {                                \
+        opc = tb_ptr[0];                \
+        tb_ptr += 2;                    \
+        goto *tci_ops[opc];             \
+    } while (0)
+
 /* Interpret pseudo code in tb. */
 /*
  * Disable CFI checks.
@@ -485,581 +504,688 @@ static bool tci_compare64(uint64_t u0, uint64_t u1, TCGCond condition)
 uintptr_t QEMU_DISABLE_CFI tcg_qemu_tb_exec(CPUArchState *env,
                                             const void *v_tb_ptr)
 {
+    /*
+     * Keep in sync with the TCI_OP() labels below: entries without a label
+     * fail to build, and labels without an entry trigger -Wunused-label.
+     */
+    static const void *const tci_ops[NB_OPS] = {
+        [0 ... NB_OPS - 1] = &&tci_op_unimplemented,
+        TCI_OPS_ENTRY(call)
+        TCI_OPS_ENTRY(br)
+        TCI_OPS_ENTRY(setcond_i32)
+#if TCG_TARGET_REG_BITS == 32
+        TCI_OPS_ENTRY(setcond2_i32)
+#elif TCG_TARGET_REG_BITS == 64
+        TCI_OPS_ENTRY(setcond_i64)
+#endif
+        TCI_OPS_ENTRY_32_64(mov)
+        TCI_OPS_ENTRY(tci_movi_i32)
+        TCI_OPS_ENTRY_32_64(ld8u)
+        TCI_OPS_ENTRY_32_64(ld8s)
+        TCI_OPS_ENTRY_32_64(ld16u)
+        TCI_OPS_ENTRY_32_64(ld16s)
+        TCI_OPS_ENTRY(ld_i32)
+        TCI_OPS_ENTRY_64(ld32u)
+        TCI_OPS_ENTRY_32_64(st8)
+        TCI_OPS_ENTRY_32_64(st16)
+        TCI_OPS_ENTRY(st_i32)
+        TCI_OPS_ENTRY_64(st32)
+        TCI_OPS_ENTRY_32_64(add)
+        TCI_OPS_ENTRY_32_64(sub)
+        TCI_OPS_ENTRY_32_64(mul)
+        TCI_OPS_ENTRY_32_64(and)
+        TCI_OPS_ENTRY_32_64(or)
+        TCI_OPS_ENTRY_32_64(xor)
+        TCI_OPS_ENTRY(div_i32)
+        TCI_OPS_ENTRY(divu_i32)
+        TCI_OPS_ENTRY(rem_i32)
+        TCI_OPS_ENTRY(remu_i32)
+        TCI_OPS_ENTRY(shl_i32)
+        TCI_OPS_ENTRY(shr_i32)
+        TCI_OPS_ENTRY(sar_i32)
+#if TCG_TARGET_HAS_rot_i32
+        TCI_OPS_ENTRY(rotl_i32)
+        TCI_OPS_ENTRY(rotr_i32)
+#endif
+#if TCG_TARGET_HAS_deposit_i32
+        TCI_OPS_ENTRY(deposit_i32)
+#endif
+        TCI_OPS_ENTRY(brcond_i32)
+#if TCG_TARGET_REG_BITS == 32
+        TCI_OPS_ENTRY(add2_i32)
+        TCI_OPS_ENTRY(sub2_i32)
+        TCI_OPS_ENTRY(brcond2_i32)
+        TCI_OPS_ENTRY(mulu2_i32)
+#endif /* TCG_TARGET_REG_BITS == 32 */
+#if TCG_TARGET_HAS_ext8s_i32 || TCG_TARGET_HAS_ext8s_i64
+        TCI_OPS_ENTRY_32_64(ext8s)
+#endif
+#if TCG_TARGET_HAS_ext16s_i32 || TCG_TARGET_HAS_ext16s_i64
+        TCI_OPS_ENTRY_32_64(ext16s)
+#endif
+#if TCG_TARGET_HAS_ext8u_i32 || TCG_TARGET_HAS_ext8u_i64
+        TCI_OPS_ENTRY_32_64(ext8u)
+#endif
+#if TCG_TARGET_HAS_ext16u_i32 || TCG_TARGET_HAS_ext16u_i64
+        TCI_OPS_ENTRY_32_64(ext16u)
+#endif
+#if TCG_TARGET_HAS_bswap16_i32 || TCG_TARGET_HAS_bswap16_i64
+        TCI_OPS_ENTRY_32_64(bswap16)
+#endif
+#if TCG_TARGET_HAS_bswap32_i32 || TCG_TARGET_HAS_bswap32_i64
+        TCI_OPS_ENTRY_32_64(bswap32)
+#endif
+#if TCG_TARGET_HAS_not_i32 || TCG_TARGET_HAS_not_i64
+        TCI_OPS_ENTRY_32_64(not)
+#endif
+#if TCG_TARGET_HAS_neg_i32 || TCG_TARGET_HAS_neg_i64
+        TCI_OPS_ENTRY_32_64(neg)
+#endif
+#if TCG_TARGET_REG_BITS == 64
+        TCI_OPS_ENTRY(tci_movi_i64)
+        TCI_OPS_ENTRY(ld32s_i64)
+        TCI_OPS_ENTRY(ld_i64)
+        TCI_OPS_ENTRY(st_i64)
+        TCI_OPS_ENTRY(div_i64)
+        TCI_OPS_ENTRY(divu_i64)
+        TCI_OPS_ENTRY(rem_i64)
+        TCI_OPS_ENTRY(remu_i64)
+        TCI_OPS_ENTRY(shl_i64)
+        TCI_OPS_ENTRY(shr_i64)
+        TCI_OPS_ENTRY(sar_i64)
+#if TCG_TARGET_HAS_rot_i64
+        TCI_OPS_ENTRY(rotl_i64)
+        TCI_OPS_ENTRY(rotr_i64)
+#endif
+#if TCG_TARGET_HAS_deposit_i64
+        TCI_OPS_ENTRY(deposit_i64)
+#endif
+        TCI_OPS_ENTRY(brcond_i64)
+        TCI_OPS_ENTRY(ext32s_i64)
+        TCI_OPS_ENTRY(ext_i32_i64)
+        TCI_OPS_ENTRY(ext32u_i64)
+        TCI_OPS_ENTRY(extu_i32_i64)
+#if TCG_TARGET_HAS_bswap64_i64
+        TCI_OPS_ENTRY(bswap64_i64)
+#endif
+#endif /* TCG_TARGET_REG_BITS == 64 */
+        TCI_OPS_ENTRY(exit_tb)
+        TCI_OPS_ENTRY(goto_tb)
+        TCI_OPS_ENTRY(qemu_ld_i32)
+        TCI_OPS_ENTRY(qemu_ld_i64)
+        TCI_OPS_ENTRY(qemu_st_i32)
+        TCI_OPS_ENTRY(qemu_st_i64)
+        TCI_OPS_ENTRY(mb)
+    };
     const uint8_t *tb_ptr = v_tb_ptr;
     tcg_target_ulong regs[TCG_TARGET_NB_REGS];
     long tcg_temps[CPU_TEMP_BUF_NLONGS];
     uintptr_t sp_value = (uintptr_t)(tcg_temps + CPU_TEMP_BUF_NLONGS);
+    TCGOpcode opc;
+    TCGReg r0, r1, r2, r3;
+    tcg_target_ulong t1;
+    TCGCond condition;
+    target_ulong taddr;
+    uint8_t pos, len;
+    uint32_t tmp32;
+    uint64_t tmp64;
+#if TCG_TARGET_REG_BITS == 32
+    TCGReg r4, r5;
+    uint64_t T1, T2;
+#endif
+    TCGMemOpIdx oi;
+    int32_t ofs;
+    void *ptr;
 
     regs[TCG_AREG0] = (tcg_target_ulong)env;
     regs[TCG_REG_CALL_STACK] = sp_value;
     tci_assert(tb_ptr);
 
-    for (;;) {
-        TCGOpcode opc = tb_ptr[0];
-        TCGReg r0, r1, r2, r3;
-        tcg_target_ulong t1;
-        TCGCond condition;
-        target_ulong taddr;
-        uint8_t pos, len;
-        uint32_t tmp32;
-        uint64_t tmp64;
-#if TCG_TARGET_REG_BITS == 32
-        TCGReg r4, r5;
-        uint64_t T1, T2;
-#endif
-        TCGMemOpIdx oi;
-        int32_t ofs;
-        void *ptr;
-
-        /* Skip opcode and size entry. */
-        tb_ptr += 2;
+    TCI_NEXT();
 
-        switch (opc) {
-        case INDEX_op_call:
-            tci_args_l(&tb_ptr, &ptr);
-            tci_tb_ptr = (uintptr_t)tb_ptr;
+    TCI_OP(call)
+        tci_args_l(&tb_ptr, &ptr);
+        tci_tb_ptr = (uintptr_t)tb_ptr;
 #if TCG_TARGET_REG_BITS == 32
-            tmp64 = ((helper_function)ptr)(tci_read_reg(regs, TCG_REG_R0),
-                                           tci_read_reg(regs, TCG_REG_R1),
-                                           tci_read_reg(regs, TCG_REG_R2),
-                                           tci_read_reg(regs, TCG_REG_R3),
-                                           tci_read_reg(regs, TCG_REG_R4),
-                                           tci_read_reg(regs, TCG_REG_R5),
-                                           tci_read_reg(regs, TCG_REG_R6),
-                                           tci_read_reg(regs, TCG_REG_R7),
-                                           tci_read_reg(regs, TCG_REG_R8),
-                                           tci_read_reg(regs, TCG_REG_R9),
-                                           tci_read_reg(regs, TCG_REG_R10),
-                                           tci_read_reg(regs, TCG_REG_R11));
-            tci_write_reg(regs, TCG_REG_R0, tmp64);
-            tci_write_reg(regs, TCG_REG_R1, tmp64 >> 32);
+        tmp64 = ((helper_function)ptr)(tci_read_reg(regs, TCG_REG_R0),
+                                       tci_read_reg(regs, TCG_REG_R1),
+                                       tci_read_reg(regs, TCG_REG_R2),
+                                       tci_read_reg(regs, TCG_REG_R3),
+                                       tci_read_reg(regs, TCG_REG_R4),
+                                       tci_read_reg(regs, TCG_REG_R5),
+                                       tci_read_reg(regs, TCG_REG_R6),
+                                       tci_read_reg(regs, TCG_REG_R7),
+                                       tci_read_reg(regs, TCG_REG_R8),
+                                       tci_read_reg(regs, TCG_REG_R9),
+                                       tci_read_reg(regs, TCG_REG_R10),
+                                       tci_read_reg(regs, TCG_REG_R11));
+        tci_write_reg(regs, TCG_REG_R0, tmp64);
+        tci_write_reg(regs, TCG_REG_R1, tmp64 >> 32);
 #else
-            tmp64 = ((helper_function)ptr)(tci_read_reg(regs, TCG_REG_R0),
-                                           tci_read_reg(regs, TCG_REG_R1),
-                                           tci_read_reg(regs, TCG_REG_R2),
-                                           tci_read_reg(regs, TCG_REG_R3),
-                                           tci_read_reg(regs, TCG_REG_R4),
-                                           tci_read_reg(regs, TCG_REG_R5));
-            tci_write_reg(regs, TCG_REG_R0, tmp64);
+        tmp64 = ((helper_function)ptr)(tci_read_reg(regs, TCG_REG_R0),
+                                       tci_read_reg(regs, TCG_REG_R1),
+                                       tci_read_reg(regs, TCG_REG_R2),
+                                       tci_read_reg(regs, TCG_REG_R3),
+                                       tci_read_reg(regs, TCG_REG_R4),
+                                       tci_read_reg(regs, TCG_REG_R5));
+        tci_write_reg(regs, TCG_REG_R0, tmp64);
 #endif
-            break;
-        case INDEX_op_br:
-            tci_args_l(&tb_ptr, &ptr);
-            tb_ptr = ptr;
-            continue;
-        case INDEX_op_setcond_i32:
-            tci_args_rrrc(&tb_ptr, &r0, &r1, &r2, &condition);
-            regs[r0] = tci_compare32(regs[r1], regs[r2], condition);
-            break;
+        TCI_NEXT();
+    TCI_OP(br)
+        tci_args_l(&tb_ptr, &ptr);
+        tb_ptr = ptr;
+        TCI_NEXT();
+    TCI_OP(setcond_i32)
+        tci_args_rrrc(&tb_ptr, &r0, &r1, &r2, &condition);
+        regs[r0] = tci_compare32(regs[r1], regs[r2], condition);
+        TCI_NEXT();
 #if TCG_TARGET_REG_BITS == 32
-        case INDEX_op_setcond2_i32:
-            tci_args_rrrrrc(&tb_ptr, &r0, &r1, &r2, &r3, &r4, &condition);
-            T1 = tci_uint64(regs[r2], regs[r1]);
-            T2 = tci_uint64(regs[r4], regs[r3]);
-            regs[r0] = tci_compare64(T1, T2, condition);
-            break;
+    TCI_OP(setcond2_i32)
+        tci_args_rrrrrc(&tb_ptr, &r0, &r1, &r2, &r3, &r4, &condition);
+        T1 = tci_uint64(regs[r2], regs[r1]);
+        T2 = tci_uint64(regs[r4], regs[r3]);
+        regs[r0] = tci_compare64(T1, T2, condition);
+        TCI_NEXT();
 #elif TCG_TARGET_REG_BITS == 64
-        case INDEX_op_setcond_i64:
-            tci_args_rrrc(&tb_ptr, &r0, &r1, &r2, &condition);
-            regs[r0] = tci_compare64(regs[r1], regs[r2], condition);
-            break;
+    TCI_OP(setcond_i64)
+        tci_args_rrrc(&tb_ptr, &r0, &r1, &r2, &condition);
+        regs[r0] = tci_compare64(regs[r1], regs[r2], condition);
+        TCI_NEXT();
 #endif
-        CASE_32_64(mov)
-            tci_args_rr(&tb_ptr, &r0, &r1);
-            regs[r0] = regs[r1];
-            break;
-        case INDEX_op_tci_movi_i32:
-            tci_args_ri(&tb_ptr, &r0, &t1);
-            regs[r0] = t1;
-            break;
-
-            /* Load/store operations (32 bit). */
-
-        CASE_32_64(ld8u)
-            tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(uint8_t *)ptr;
-            break;
-        CASE_32_64(ld8s)
-            tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(int8_t *)ptr;
-            break;
-        CASE_32_64(ld16u)
-            tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(uint16_t *)ptr;
-            break;
-        CASE_32_64(ld16s)
-            tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(int16_t *)ptr;
-            break;
-        case INDEX_op_ld_i32:
-        CASE_64(ld32u)
-            tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(uint32_t *)ptr;
-            break;
-        CASE_32_64(st8)
-            tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            *(uint8_t *)ptr = regs[r0];
-            break;
-        CASE_32_64(st16)
-            tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            *(uint16_t *)ptr = regs[r0];
-            break;
-        case INDEX_op_st_i32:
-        CASE_64(st32)
-            tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            *(uint32_t *)ptr = regs[r0];
-            break;
-
-            /* Arithmetic operations (mixed 32/64 bit). */
-
-        CASE_32_64(add)
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = regs[r1] + regs[r2];
-            break;
-        CASE_32_64(sub)
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = regs[r1] - regs[r2];
-            break;
-        CASE_32_64(mul)
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = regs[r1] * regs[r2];
-            break;
-        CASE_32_64(and)
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = regs[r1] & regs[r2];
-            break;
-        CASE_32_64(or)
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = regs[r1] | regs[r2];
-            break;
-        CASE_32_64(xor)
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = regs[r1] ^ regs[r2];
-            break;
+    TCI_OP_32_64(mov)
+        tci_args_rr(&tb_ptr, &r0, &r1);
+        regs[r0] = regs[r1];
+        TCI_NEXT();
+    TCI_OP(tci_movi_i32)
+        tci_args_ri(&tb_ptr, &r0, &t1);
+        regs[r0] = t1;
+        TCI_NEXT();
+
+        /* Load/store operations (32 bit). */
+
+    TCI_OP_32_64(ld8u)
+        tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        regs[r0] = *(uint8_t *)ptr;
+        TCI_NEXT();
+    TCI_OP_32_64(ld8s)
+        tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        regs[r0] = *(int8_t *)ptr;
+        TCI_NEXT();
+    TCI_OP_32_64(ld16u)
+        tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        regs[r0] = *(uint16_t *)ptr;
+        TCI_NEXT();
+    TCI_OP_32_64(ld16s)
+        tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        regs[r0] = *(int16_t *)ptr;
+        TCI_NEXT();
+    TCI_OP(ld_i32)
+    TCI_OP_64(ld32u)
+        tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        regs[r0] = *(uint32_t *)ptr;
+        TCI_NEXT();
+    TCI_OP_32_64(st8)
+        tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        *(uint8_t *)ptr = regs[r0];
+        TCI_NEXT();
+    TCI_OP_32_64(st16)
+        tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        *(uint16_t *)ptr = regs[r0];
+        TCI_NEXT();
+    TCI_OP(st_i32)
+    TCI_OP_64(st32)
+        tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        *(uint32_t *)ptr = regs[r0];
+        TCI_NEXT();
+
+        /* Arithmetic operations (mixed 32/64 bit). */
+
+    TCI_OP_32_64(add)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = regs[r1] + regs[r2];
+        TCI_NEXT();
+    TCI_OP_32_64(sub)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = regs[r1] - regs[r2];
+        TCI_NEXT();
+    TCI_OP_32_64(mul)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = regs[r1] * regs[r2];
+        TCI_NEXT();
+    TCI_OP_32_64(and)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = regs[r1] & regs[r2];
+        TCI_NEXT();
+    TCI_OP_32_64(or)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = regs[r1] | regs[r2];
+        TCI_NEXT();
+    TCI_OP_32_64(xor)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = regs[r1] ^ regs[r2];
+        TCI_NEXT();
 
-            /* Arithmetic operations (32 bit). */
+        /* Arithmetic operations (32 bit). */
 
-        case INDEX_op_div_i32:
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = (int32_t)regs[r1] / (int32_t)regs[r2];
-            break;
-        case INDEX_op_divu_i32:
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = (uint32_t)regs[r1] / (uint32_t)regs[r2];
-            break;
-        case INDEX_op_rem_i32:
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = (int32_t)regs[r1] % (int32_t)regs[r2];
-            break;
-        case INDEX_op_remu_i32:
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = (uint32_t)regs[r1] % (uint32_t)regs[r2];
-            break;
+    TCI_OP(div_i32)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = (int32_t)regs[r1] / (int32_t)regs[r2];
+        TCI_NEXT();
+    TCI_OP(divu_i32)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = (uint32_t)regs[r1] / (uint32_t)regs[r2];
+        TCI_NEXT();
+    TCI_OP(rem_i32)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = (int32_t)regs[r1] % (int32_t)regs[r2];
+        TCI_NEXT();
+    TCI_OP(remu_i32)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = (uint32_t)regs[r1] % (uint32_t)regs[r2];
+        TCI_NEXT();
 
-            /* Shift/rotate operations (32 bit). */
+        /* Shift/rotate operations (32 bit). */
 
-        case INDEX_op_shl_i32:
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = (uint32_t)regs[r1] << (regs[r2] & 31);
-            break;
-        case INDEX_op_shr_i32:
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = (uint32_t)regs[r1] >> (regs[r2] & 31);
-            break;
-        case INDEX_op_sar_i32:
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = (int32_t)regs[r1] >> (regs[r2] & 31);
-            break;
+    TCI_OP(shl_i32)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = (uint32_t)regs[r1] << (regs[r2] & 31);
+        TCI_NEXT();
+    TCI_OP(shr_i32)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = (uint32_t)regs[r1] >> (regs[r2] & 31);
+        TCI_NEXT();
+    TCI_OP(sar_i32)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = (int32_t)regs[r1] >> (regs[r2] & 31);
+        TCI_NEXT();
 #if TCG_TARGET_HAS_rot_i32
-        case INDEX_op_rotl_i32:
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = rol32(regs[r1], regs[r2] & 31);
-            break;
-        case INDEX_op_rotr_i32:
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = ror32(regs[r1], regs[r2] & 31);
-            break;
+    TCI_OP(rotl_i32)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = rol32(regs[r1], regs[r2] & 31);
+        TCI_NEXT();
+    TCI_OP(rotr_i32)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = ror32(regs[r1], regs[r2] & 31);
+        TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_deposit_i32
-        case INDEX_op_deposit_i32:
-            tci_args_rrrbb(&tb_ptr, &r0, &r1, &r2, &pos, &len);
-            regs[r0] = deposit32(regs[r1], pos, len, regs[r2]);
-            break;
+    TCI_OP(deposit_i32)
+        tci_args_rrrbb(&tb_ptr, &r0, &r1, &r2, &pos, &len);
+        regs[r0] = deposit32(regs[r1], pos, len, regs[r2]);
+        TCI_NEXT();
 #endif
-        case INDEX_op_brcond_i32:
-            tci_args_rrcl(&tb_ptr, &r0, &r1, &condition, &ptr);
-            if (tci_compare32(regs[r0], regs[r1], condition)) {
-                tb_ptr = ptr;
-            }
-            break;
+    TCI_OP(brcond_i32)
+        tci_args_rrcl(&tb_ptr, &r0, &r1, &condition, &ptr);
+        if (tci_compare32(regs[r0], regs[r1], condition)) {
+            tb_ptr = ptr;
+        }
+        TCI_NEXT();
 #if TCG_TARGET_REG_BITS == 32
-        case INDEX_op_add2_i32:
-            tci_args_rrrrrr(&tb_ptr, &r0, &r1, &r2, &r3, &r4, &r5);
-            T1 = tci_uint64(regs[r3], regs[r2]);
-            T2 = tci_uint64(regs[r5], regs[r4]);
-            tci_write_reg64(regs, r1, r0, T1 + T2);
-            break;
-        case INDEX_op_sub2_i32:
-            tci_args_rrrrrr(&tb_ptr, &r0, &r1, &r2, &r3, &r4, &r5);
-            T1 = tci_uint64(regs[r3], regs[r2]);
-            T2 = tci_uint64(regs[r5], regs[r4]);
-            tci_write_reg64(regs, r1, r0, T1 - T2);
-            break;
-        case INDEX_op_brcond2_i32:
-            tci_args_rrrrcl(&tb_ptr, &r0, &r1, &r2, &r3, &condition, &ptr);
-            T1 = tci_uint64(regs[r1], regs[r0]);
-            T2 = tci_uint64(regs[r3], regs[r2]);
-            if (tci_compare64(T1, T2, condition)) {
-                tb_ptr = ptr;
-                continue;
-            }
-            break;
-        case INDEX_op_mulu2_i32:
-            tci_args_rrrr(&tb_ptr, &r0, &r1, &r2, &r3);
-            tci_write_reg64(regs, r1, r0, (uint64_t)regs[r2] * regs[r3]);
-            break;
+    TCI_OP(add2_i32)
+        tci_args_rrrrrr(&tb_ptr, &r0, &r1, &r2, &r3, &r4, &r5);
+        T1 = tci_uint64(regs[r3], regs[r2]);
+        T2 = tci_uint64(regs[r5], regs[r4]);
+        tci_write_reg64(regs, r1, r0, T1 + T2);
+        TCI_NEXT();
+    TCI_OP(sub2_i32)
+        tci_args_rrrrrr(&tb_ptr, &r0, &r1, &r2, &r3, &r4, &r5);
+        T1 = tci_uint64(regs[r3], regs[r2]);
+        T2 = tci_uint64(regs[r5], regs[r4]);
+        tci_write_reg64(regs, r1, r0, T1 - T2);
+        TCI_NEXT();
+    TCI_OP(brcond2_i32)
+        tci_args_rrrrcl(&tb_ptr, &r0, &r1, &r2, &r3, &condition, &ptr);
+        T1 = tci_uint64(regs[r1], regs[r0]);
+        T2 = tci_uint64(regs[r3], regs[r2]);
+        if (tci_compare64(T1, T2, condition)) {
+            tb_ptr = ptr;
+            TCI_NEXT();
+        }
+        TCI_NEXT();
+    TCI_OP(mulu2_i32)
+        tci_args_rrrr(&tb_ptr, &r0, &r1, &r2, &r3);
+        tci_write_reg64(regs, r1, r0, (uint64_t)regs[r2] * regs[r3]);
+        TCI_NEXT();
 #endif /* TCG_TARGET_REG_BITS == 32 */
 #if TCG_TARGET_HAS_ext8s_i32 || TCG_TARGET_HAS_ext8s_i64
-        CASE_32_64(ext8s)
-            tci_args_rr(&tb_ptr, &r0, &r1);
-            regs[r0] = (int8_t)regs[r1];
-            break;
+    TCI_OP_32_64(ext8s)
+        tci_args_rr(&tb_ptr, &r0, &r1);
+        regs[r0] = (int8_t)regs[r1];
+        TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_ext16s_i32 || TCG_TARGET_HAS_ext16s_i64
-        CASE_32_64(ext16s)
-            tci_args_rr(&tb_ptr, &r0, &r1);
-            regs[r0] = (int16_t)regs[r1];
-            break;
+    TCI_OP_32_64(ext16s)
+        tci_args_rr(&tb_ptr, &r0, &r1);
+        regs[r0] = (int16_t)regs[r1];
+        TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_ext8u_i32 || TCG_TARGET_HAS_ext8u_i64
-        CASE_32_64(ext8u)
-            tci_args_rr(&tb_ptr, &r0, &r1);
-            regs[r0] = (uint8_t)regs[r1];
-            break;
+    TCI_OP_32_64(ext8u)
+        tci_args_rr(&tb_ptr, &r0, &r1);
+        regs[r0] = (uint8_t)regs[r1];
+        TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_ext16u_i32 || TCG_TARGET_HAS_ext16u_i64
-        CASE_32_64(ext16u)
-            tci_args_rr(&tb_ptr, &r0, &r1);
-            regs[r0] = (uint16_t)regs[r1];
-            break;
+    TCI_OP_32_64(ext16u)
+        tci_args_rr(&tb_ptr, &r0, &r1);
+        regs[r0] = (uint16_t)regs[r1];
+        TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_bswap16_i32 || TCG_TARGET_HAS_bswap16_i64
-        CASE_32_64(bswap16)
-            tci_args_rr(&tb_ptr, &r0, &r1);
-            regs[r0] = bswap16(regs[r1]);
-            break;
+    TCI_OP_32_64(bswap16)
+        tci_args_rr(&tb_ptr, &r0, &r1);
+        regs[r0] = bswap16(regs[r1]);
+        TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_bswap32_i32 || TCG_TARGET_HAS_bswap32_i64
-        CASE_32_64(bswap32)
-            tci_args_rr(&tb_ptr, &r0, &r1);
-            regs[r0] = bswap32(regs[r1]);
-            break;
+    TCI_OP_32_64(bswap32)
+        tci_args_rr(&tb_ptr, &r0, &r1);
+        regs[r0] = bswap32(regs[r1]);
+        TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_not_i32 || TCG_TARGET_HAS_not_i64
-        CASE_32_64(not)
-            tci_args_rr(&tb_ptr, &r0, &r1);
-            regs[r0] = ~regs[r1];
-            break;
+    TCI_OP_32_64(not)
+        tci_args_rr(&tb_ptr, &r0, &r1);
+        regs[r0] = ~regs[r1];
+        TCI_NEXT();
 #endif
 #if TCG_TARGET_HAS_neg_i32 || TCG_TARGET_HAS_neg_i64
-        CASE_32_64(neg)
-            tci_args_rr(&tb_ptr, &r0, &r1);
-            regs[r0] = -regs[r1];
-            break;
+    TCI_OP_32_64(neg)
+        tci_args_rr(&tb_ptr, &r0, &r1);
+        regs[r0] = -regs[r1];
+        TCI_NEXT();
 #endif
 #if TCG_TARGET_REG_BITS == 64
-        case INDEX_op_tci_movi_i64:
-            tci_args_rI(&tb_ptr, &r0, &t1);
-            regs[r0] = t1;
-            break;
+    TCI_OP(tci_movi_i64)
+        tci_args_rI(&tb_ptr, &r0, &t1);
+        regs[r0] = t1;
+        TCI_NEXT();
+
+        /* Load/store operations (64 bit). */
+
+    TCI_OP(ld32s_i64)
+        tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        regs[r0] = *(int32_t *)ptr;
+        TCI_NEXT();
+    TCI_OP(ld_i64)
+        tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        regs[r0] = *(uint64_t *)ptr;
+        TCI_NEXT();
+    TCI_OP(st_i64)
+        tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
+        ptr = (void *)(regs[r1] + ofs);
+        *(uint64_t *)ptr = regs[r0];
+        TCI_NEXT();
+
+        /* Arithmetic operations (64 bit). */
+
+    TCI_OP(div_i64)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = (int64_t)regs[r1] / (int64_t)regs[r2];
+        TCI_NEXT();
+    TCI_OP(divu_i64)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = (uint64_t)regs[r1] / (uint64_t)regs[r2];
+        TCI_NEXT();
+    TCI_OP(rem_i64)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = (int64_t)regs[r1] % (int64_t)regs[r2];
+        TCI_NEXT();
+    TCI_OP(remu_i64)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = (uint64_t)regs[r1] % (uint64_t)regs[r2];
+        TCI_NEXT();
 
-            /* Load/store operations (64 bit). */
+        /* Shift/rotate operations (64 bit). */
 
-        case INDEX_op_ld32s_i64:
-            tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(int32_t *)ptr;
+    TCI_OP(shl_i64)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = regs[r1] << (regs[r2] & 63);
+        TCI_NEXT();
+    TCI_OP(shr_i64)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = regs[r1] >> (regs[r2] & 63);
+        TCI_NEXT();
+    TCI_OP(sar_i64)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = (int64_t)regs[r1] >> (regs[r2] & 63);
+        TCI_NEXT();
+#if TCG_TARGET_HAS_rot_i64
+    TCI_OP(rotl_i64)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = rol64(regs[r1], regs[r2] & 63);
+        TCI_NEXT();
+    TCI_OP(rotr_i64)
+        tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
+        regs[r0] = ror64(regs[r1], regs[r2] & 63);
+        TCI_NEXT();
+#endif
+#if TCG_TARGET_HAS_deposit_i64
+    TCI_OP(deposit_i64)
+        tci_args_rrrbb(&tb_ptr, &r0, &r1, &r2, &pos, &len);
+        regs[r0] = deposit64(regs[r1], pos, len, regs[r2]);
+        TCI_NEXT();
+#endif
+    TCI_OP(brcond_i64)
+        tci_args_rrcl(&tb_ptr, &r0, &r1, &condition, &ptr);
+        if (tci_compare64(regs[r0], regs[r1], condition)) {
+            tb_ptr = ptr;
+        }
+        TCI_NEXT();
+    TCI_OP(ext32s_i64)
+    TCI_OP(ext_i32_i64)
+        tci_args_rr(&tb_ptr, &r0, &r1);
+        regs[r0] = (int32_t)regs[r1];
+        TCI_NEXT();
+    TCI_OP(ext32u_i64)
+    TCI_OP(extu_i32_i64)
+        tci_args_rr(&tb_ptr, &r0, &r1);
+        regs[r0] = (uint32_t)regs[r1];
+        TCI_NEXT();
+#if TCG_TARGET_HAS_bswap64_i64
+    TCI_OP(bswap64_i64)
+        tci_args_rr(&tb_ptr, &r0, &r1);
+        regs[r0] = bswap64(regs[r1]);
+        TCI_NEXT();
+#endif
+#endif /* TCG_TARGET_REG_BITS == 64 */
+
+        /* QEMU specific operations. */
+
+    TCI_OP(exit_tb)
+        tci_args_l(&tb_ptr, &ptr);
+        return (uintptr_t)ptr;
+
+    TCI_OP(goto_tb)
+        tci_args_l(&tb_ptr, &ptr);
+        tb_ptr = *(void **)ptr;
+        TCI_NEXT();
+
+    TCI_OP(qemu_ld_i32)
+        if (TARGET_LONG_BITS <= TCG_TARGET_REG_BITS) {
+            tci_args_rrm(&tb_ptr, &r0, &r1, &oi);
+            taddr = regs[r1];
+        } else {
+            tci_args_rrrm(&tb_ptr, &r0, &r1, &r2, &oi);
+            taddr = tci_uint64(regs[r2], regs[r1]);
+        }
+        switch (get_memop(oi) & (MO_BSWAP | MO_SSIZE)) {
+        case MO_UB:
+            tmp32 = qemu_ld_ub;
             break;
-        case INDEX_op_ld_i64:
-            tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            regs[r0] = *(uint64_t *)ptr;
+        case MO_SB:
+            tmp32 = (int8_t)qemu_ld_ub;
             break;
-        case INDEX_op_st_i64:
-            tci_args_rrs(&tb_ptr, &r0, &r1, &ofs);
-            ptr = (void *)(regs[r1] + ofs);
-            *(uint64_t *)ptr = regs[r0];
+        case MO_LEUW:
+            tmp32 = qemu_ld_leuw;
             break;
-
-            /* Arithmetic operations (64 bit). */
-
-        case INDEX_op_div_i64:
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = (int64_t)regs[r1] / (int64_t)regs[r2];
+        case MO_LESW:
+            tmp32 = (int16_t)qemu_ld_leuw;
             break;
-        case INDEX_op_divu_i64:
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = (uint64_t)regs[r1] / (uint64_t)regs[r2];
+        case MO_LEUL:
+            tmp32 = qemu_ld_leul;
             break;
-        case INDEX_op_rem_i64:
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = (int64_t)regs[r1] % (int64_t)regs[r2];
+        case MO_BEUW:
+            tmp32 = qemu_ld_beuw;
             break;
-        case INDEX_op_remu_i64:
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = (uint64_t)regs[r1] % (uint64_t)regs[r2];
+        case MO_BESW:
+            tmp32 = (int16_t)qemu_ld_beuw;
             break;
+        case MO_BEUL:
+            tmp32 = qemu_ld_beul;
+            break;
+        default:
+            g_assert_not_reached();
+        }
+        regs[r0] = tmp32;
+        TCI_NEXT();
 
-            /* Shift/rotate operations (64 bit). */
-
-        case INDEX_op_shl_i64:
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = regs[r1] << (regs[r2] & 63);
+    TCI_OP(qemu_ld_i64)
+        if (TCG_TARGET_REG_BITS == 64) {
+            tci_args_rrm(&tb_ptr, &r0, &r1, &oi);
+            taddr = regs[r1];
+        } else if (TARGET_LONG_BITS <= TCG_TARGET_REG_BITS) {
+            tci_args_rrrm(&tb_ptr, &r0, &r1, &r2, &oi);
+            taddr = regs[r2];
+        } else {
+            tci_args_rrrrm(&tb_ptr, &r0, &r1, &r2, &r3, &oi);
+            taddr = tci_uint64(regs[r3], regs[r2]);
+        }
+        switch (get_memop(oi) & (MO_BSWAP | MO_SSIZE)) {
+        case MO_UB:
+            tmp64 = qemu_ld_ub;
             break;
-        case INDEX_op_shr_i64:
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = regs[r1] >> (regs[r2] & 63);
+        case MO_SB:
+            tmp64 = (int8_t)qemu_ld_ub;
             break;
-        case INDEX_op_sar_i64:
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = (int64_t)regs[r1] >> (regs[r2] & 63);
+        case MO_LEUW:
+            tmp64 = qemu_ld_leuw;
             break;
-#if TCG_TARGET_HAS_rot_i64
-        case INDEX_op_rotl_i64:
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = rol64(regs[r1], regs[r2] & 63);
+        case MO_LESW:
+            tmp64 = (int16_t)qemu_ld_leuw;
             break;
-        case INDEX_op_rotr_i64:
-            tci_args_rrr(&tb_ptr, &r0, &r1, &r2);
-            regs[r0] = ror64(regs[r1], regs[r2] & 63);
+        case MO_LEUL:
+            tmp64 = qemu_ld_leul;
             break;
-#endif
-#if TCG_TARGET_HAS_deposit_i64
-        case INDEX_op_deposit_i64:
-            tci_args_rrrbb(&tb_ptr, &r0, &r1, &r2, &pos, &len);
-            regs[r0] = deposit64(regs[r1], pos, len, regs[r2]);
+        case MO_LESL:
+            tmp64 = (int32_t)qemu_ld_leul;
             break;
-#endif
-        case INDEX_op_brcond_i64:
-            tci_args_rrcl(&tb_ptr, &r0, &r1, &condition, &ptr);
-            if (tci_compare64(regs[r0], regs[r1], condition)) {
-                tb_ptr = ptr;
-            }
+        case MO_LEQ:
+            tmp64 = qemu_ld_leq;
             break;
-        case INDEX_op_ext32s_i64:
-        case INDEX_op_ext_i32_i64:
-            tci_args_rr(&tb_ptr, &r0, &r1);
-            regs[r0] = (int32_t)regs[r1];
+        case MO_BEUW:
+            tmp64 = qemu_ld_beuw;
             break;
-        case INDEX_op_ext32u_i64:
-        case INDEX_op_extu_i32_i64:
-            tci_args_rr(&tb_ptr, &r0, &r1);
-            regs[r0] = (uint32_t)regs[r1];
+        case MO_BESW:
+            tmp64 = (int16_t)qemu_ld_beuw;
             break;
-#if TCG_TARGET_HAS_bswap64_i64
-        case INDEX_op_bswap64_i64:
-            tci_args_rr(&tb_ptr, &r0, &r1);
-            regs[r0] = bswap64(regs[r1]);
+        case MO_BEUL:
+            tmp64 = qemu_ld_beul;
             break;
-#endif
-#endif /* TCG_TARGET_REG_BITS == 64 */
-
-            /* QEMU specific operations. */
-
-        case INDEX_op_exit_tb:
-            tci_args_l(&tb_ptr, &ptr);
-            return (uintptr_t)ptr;
-
-        case INDEX_op_goto_tb:
-            tci_args_l(&tb_ptr, &ptr);
-            tb_ptr = *(void **)ptr;
+        case MO_BESL:
+            tmp64 = (int32_t)qemu_ld_beul;
+            break;
+        case MO_BEQ:
+            tmp64 = qemu_ld_beq;
             break;
+        default:
+            g_assert_not_reached();
+        }
+        if (TCG_TARGET_REG_BITS == 32) {
+            tci_write_reg64(regs, r1, r0, tmp64);
+        } else {
+            regs[r0] = tmp64;
+        }
+        TCI_NEXT();
 
-        case INDEX_op_qemu_ld_i32:
-            if (TARGET_LONG_BITS <= TCG_TARGET_REG_BITS) {
-                tci_args_rrm(&tb_ptr, &r0, &r1, &oi);
-                taddr = regs[r1];
-            } else {
-                tci_args_rrrm(&tb_ptr, &r0, &r1, &r2, &oi);
-                taddr = tci_uint64(regs[r2], regs[r1]);
-            }
-            switch (get_memop(oi) & (MO_BSWAP | MO_SSIZE)) {
-            case MO_UB:
-                tmp32 = qemu_ld_ub;
-                break;
-            case MO_SB:
-                tmp32 = (int8_t)qemu_ld_ub;
-                break;
-            case MO_LEUW:
-                tmp32 = qemu_ld_leuw;
-                break;
-            case MO_LESW:
-                tmp32 = (int16_t)qemu_ld_leuw;
-                break;
-            case MO_LEUL:
-                tmp32 = qemu_ld_leul;
-                break;
-            case MO_BEUW:
-                tmp32 = qemu_ld_beuw;
-                break;
-            case MO_BESW:
-                tmp32 = (int16_t)qemu_ld_beuw;
-                break;
-            case MO_BEUL:
-                tmp32 = qemu_ld_beul;
-                break;
-            default:
-                g_assert_not_reached();
-            }
-            regs[r0] = tmp32;
+    TCI_OP(qemu_st_i32)
+        if (TARGET_LONG_BITS <= TCG_TARGET_REG_BITS) {
+            tci_args_rrm(&tb_ptr, &r0, &r1, &oi);
+            taddr = regs[r1];
+        } else {
+            tci_args_rrrm(&tb_ptr, &r0, &r1, &r2, &oi);
+            taddr = tci_uint64(regs[r2], regs[r1]);
+        }
+        tmp32 = regs[r0];
+        switch (get_memop(oi) & (MO_BSWAP | MO_SIZE)) {
+        case MO_UB:
+            qemu_st_b(tmp32);
+            break;
+        case MO_LEUW:
+            qemu_st_lew(tmp32);
+            break;
+        case MO_LEUL:
+            qemu_st_lel(tmp32);
             break;
+        case MO_BEUW:
+            qemu_st_bew(tmp32);
+            break;
+        case MO_BEUL:
+            qemu_st_bel(tmp32);
+            break;
+        default:
+            g_assert_not_reached();
+        }
+        TCI_NEXT();
 
-        case INDEX_op_qemu_ld_i64:
-            if (TCG_TARGET_REG_BITS == 64) {
-                tci_args_rrm(&tb_ptr, &r0, &r1, &oi);
-                taddr = regs[r1];
-            } else if (TARGET_LONG_BITS <= TCG_TARGET_REG_BITS) {
+    TCI_OP(qemu_st_i64)
+        if (TCG_TARGET_REG_BITS == 64) {
+            tci_args_rrm(&tb_ptr, &r0, &r1, &oi);
+            taddr = regs[r1];
+            tmp64 = regs[r0];
+        } else {
+            if (TARGET_LONG_BITS <= TCG_TARGET_REG_BITS) {
                 tci_args_rrrm(&tb_ptr, &r0, &r1, &r2, &oi);
                 taddr = regs[r2];
             } else {
                 tci_args_rrrrm(&tb_ptr, &r0, &r1, &r2, &r3, &oi);
                 taddr = tci_uint64(regs[r3], regs[r2]);
             }
-            switch (get_memop(oi) & (MO_BSWAP | MO_SSIZE)) {
-            case MO_UB:
-                tmp64 = qemu_ld_ub;
-                break;
-            case MO_SB:
-                tmp64 = (int8_t)qemu_ld_ub;
-                break;
-            case MO_LEUW:
-                tmp64 = qemu_ld_leuw;
-                break;
-            case MO_LESW:
-                tmp64 = (int16_t)qemu_ld_leuw;
-                break;
-            case MO_LEUL:
-                tmp64 = qemu_ld_leul;
-                break;
-            case MO_LESL:
-                tmp64 = (int32_t)qemu_ld_leul;
-                break;
-            case MO_LEQ:
-                tmp64 = qemu_ld_leq;
-                break;
-            case MO_BEUW:
-                tmp64 = qemu_ld_beuw;
-                break;
-            case MO_BESW:
-                tmp64 = (int16_t)qemu_ld_beuw;
-                break;
-            case MO_BEUL:
-                tmp64 = qemu_ld_beul;
-                break;
-            case MO_BESL:
-                tmp64 = (int32_t)qemu_ld_beul;
-                break;
-            case MO_BEQ:
-                tmp64 = qemu_ld_beq;
-                break;
-            default:
-                g_assert_not_reached();
-            }
-            if (TCG_TARGET_REG_BITS == 32) {
-                tci_write_reg64(regs, r1, r0, tmp64);
-            } else {
-                regs[r0] = tmp64;
-            }
+            tmp64 = tci_uint64(regs[r1], regs[r0]);
+        }
+        switch (get_memop(oi) & (MO_BSWAP | MO_SIZE)) {
+        case MO_UB:
+            qemu_st_b(tmp64);
             break;
-
-        case INDEX_op_qemu_st_i32:
-            if (TARGET_LONG_BITS <= TCG_TARGET_REG_BITS) {
-                tci_args_rrm(&tb_ptr, &r0, &r1, &oi);
-                taddr = regs[r1];
-            } else {
-                tci_args_rrrm(&tb_ptr, &r0, &r1, &r2, &oi);
-                taddr = tci_uint64(regs[r2], regs[r1]);
-            }
-            tmp32 = regs[r0];
-            switch (get_memop(oi) & (MO_BSWAP | MO_SIZE)) {
-            case MO_UB:
-                qemu_st_b(tmp32);
-                break;
-            case MO_LEUW:
-                qemu_st_lew(tmp32);
-                break;
-            case MO_LEUL:
-                qemu_st_lel(tmp32);
-                break;
-            case MO_BEUW:
-                qemu_st_bew(tmp32);
-                break;
-            case MO_BEUL:
-                qemu_st_bel(tmp32);
-                break;
-            default:
-                g_assert_not_reached();
-            }
+        case MO_LEUW:
+            qemu_st_lew(tmp64);
             break;
-
-        case INDEX_op_qemu_st_i64:
-            if (TCG_TARGET_REG_BITS == 64) {
-                tci_args_rrm(&tb_ptr, &r0, &r1, &oi);
-                taddr = regs[r1];
-                tmp64 = regs[r0];
-            } else {
-                if (TARGET_LONG_BITS <= TCG_TARGET_REG_BITS) {
-                    tci_args_rrrm(&tb_ptr, &r0, &r1, &r2, &oi);
-                    taddr = regs[r2];
-                } else {
-                    tci_args_rrrrm(&tb_ptr, &r0, &r1, &r2, &r3, &oi);
-                    taddr = tci_uint64(regs[r3], regs[r2]);
-                }
-                tmp64 = tci_uint64(regs[r1], regs[r0]);
-            }
-            switch (get_memop(oi) & (MO_BSWAP | MO_SIZE)) {
-            case MO_UB:
-                qemu_st_b(tmp64);
-                break;
-            case MO_LEUW:
-                qemu_st_lew(tmp64);
-                break;
-            case MO_LEUL:
-                qemu_st_lel(tmp64);
-                break;
-            case MO_LEQ:
-                qemu_st_leq(tmp64);
-                break;
-            case MO_BEUW:
-                qemu_st_bew(tmp64);
-                break;
-            case MO_BEUL:
-                qemu_st_bel(tmp64);
-                break;
-            case MO_BEQ:
-                qemu_st_beq(tmp64);
-                break;
-            default:
-                g_assert_not_reached();
-            }
+        case MO_LEUL:
+            qemu_st_lel(tmp64);
             break;
-
-        case INDEX_op_mb:
-            /* Ensure ordering for all kinds */
-            smp_mb();
+        case MO_LEQ:
+            qemu_st_leq(tmp64);
+            break;
+        case MO_BEUW:
+            qemu_st_bew(tmp64);
+            break;
+        case MO_BEUL:
+            qemu_st_bel(tmp64);
+            break;
+        case MO_BEQ:
+            qemu_st_beq(tmp64);
             break;
         default:
             g_assert_not_reached();
         }
-    }
+        TCI_NEXT();
+
+    TCI_OP(mb)
+        /* Ensure ordering for all kinds */
+        smp_mb();
+        TCI_NEXT();
+    tci_op_unimplemented:
+        g_assert_not_reached();
 }
 
 /*
@@ -0,0 +1,260 @@
+/*
+ * Benchmark TB hash table lookups when the same code runs under many
+ * different PCC bounds (e.g. one copy of a library shared by several
+ * compartments).
+ *
+ * The table holds one entry per (pc, compartment) pair. With -o the hash
+ * only covers the fields of the upstream TB key, so all compartments'
+ * copies of a pc share one hash value and bucket chain, like they did
+ * before the PCC bounds were added to tb_hash_func().
+ *
+ * License: GNU GPL, version 2 or later.
+ *   See the COPYING file in the top-level directory.
+ */
+#include "qemu/osdep.h"
+#include "qemu/thread.h"
+#include "qemu/host-utils.h"
+#include "qemu/processor.h"
+#include "qemu/qht.h"
+#include "qemu/qdist.h"
+#include "qemu/rcu.h"
+#include "qemu/xxhash.h"
+
+struct tb_key {
+    uint64_t phys_pc;
+    uint64_t pc;
+    uint64_t cs_base;
+    uint64_t cs_top;
+    uint32_t cheri_flags;
+    uint32_t flags;
+    uint32_t cflags;
+    uint32_t trace_vcpu_dstate;
+};
+
+struct thread_info {
+    uint64_t r;
+    uint64_t lookups;
+    uint64_t misses;
+} QEMU_ALIGNED(64);
+
+static struct qht ht;
+static struct tb_key *keys;
+static QemuThread *threads;
+static struct thread_info *th_info;
+static unsigned int n_threads = 1;
+static unsigned int n_ready_threads;
+static unsigned int duration = 1;
+static unsigned int n_pcs = 4096;
+static unsigned int n_compartments = 16;
+static bool old_hash;
+static bool test_start;
+static bool test_stop;
+
+static const char commands_string[] =
+    " -d = duration in seconds\n"
+    " -n = number of threads\n"
+    " -p = number of distinct pcs\n"
+    " -c = number of compartments (PCC bounds) executing each pc\n"
+    " -o = leave the PCC bounds and CHERI flags out of the hash";
+
+static void usage_complete(char *argv[])
+{
+    fprintf(stderr, "Usage: %s [options]\n", argv[0]);
+    fprintf(stderr, "options:\n%s\n", commands_string);
+}
+
+/* See atomic64-bench.c */
+static uint64_t xorshift64star(uint64_t x)
+{
+    x ^= x >> 12; /* a */
+    x ^= x << 25; /* b */
+    x ^= x >> 27; /* c */
+    return x * UINT64_C(2685821657736338717);
+}
+
+static uint32_t key_hash(const struct tb_key *k)
+{
+    if (old_hash) {
+        return qemu_xxhash7(k->phys_pc, k->pc, k->flags, k->cflags,
+                            k->trace_vcpu_dstate);
+    }
+    return qemu_xxhash12(k->phys_pc, k->pc, k->cs_base, k->cs_top,
+                         k->cheri_flags, k->flags, k->cflags,
+                         k->trace_vcpu_dstate);
+}
+
+static bool key_cmp(const void *ap, const void *bp)
+{
+    const struct tb_key *a = ap;
+    const struct tb_key *b = bp;
+
+    return a->pc == b->pc && a->phys_pc == b->phys_pc &&
+           a->cs_base == b->cs_base && a->cs_top == b->cs_top &&
+           a->cheri_flags == b->cheri_flags && a->flags == b->flags &&
+           a->trace_vcpu_dstate == b->trace_vcpu_dstate &&
+           a->cflags == b->cflags;
+}
+
+static void *thread_func(void *arg)
+{
+    struct thread_info *info = arg;
+    size_t n_keys = (size_t)n_pcs * n_compartments;
+
+    rcu_register_thread();
+
+    qatomic_inc(&n_ready_threads);
+    while (!qatomic_read(&test_start)) {
+        cpu_relax();
+    }
+
+    rcu_read_lock();
+    while (!qatomic_read(&test_stop)) {
+        const struct tb_key *k;
+
+        info->r = xorshift64star(info->r);
+        k = &keys[info->r % n_keys];
+        if (qht_lookup(&ht, k, key_hash(k)) == NULL) {
+            info->misses++;
+        }
+        info->lookups++;
+    }
+    rcu_read_unlock();
+
+    rcu_unregister_thread();
+    return NULL;
+}
+
+static void populate(void)
+{
+    size_t n_keys = (size_t)n_pcs * n_compartments;
+    size_t i;
+
+    keys = g_new0(struct tb_key, n_keys);
+    qht_init(&ht, key_cmp, n_keys, QHT_MODE_AUTO_RESIZE);
+
+    for (i = 0; i < n_keys; i++) {
+        struct tb_key *k = &keys[i];
+        unsigned int pc_idx = i % n_pcs;
+        unsigned int cpt = i / n_pcs;
+
+        /* Code shared by all compartments, each with its own PCC bounds */
+        k->pc = 0x40000000 + pc_idx * 64;
+        k->phys_pc = 0x80000000 + pc_idx * 64;
+        k->cs_base = 0x40000000 + cpt * 0x1000;
+        k->cs_top = 0x40000000 + n_pcs * 64 + cpt * 0x2000;
+        k->cheri_flags = cpt & 1;
+        qht_insert(&ht, k, key_hash(k), NULL);
+    }
+}
+
+static void run_test(void)
+{
+    unsigned int i;
+
+    while (qatomic_read(&n_ready_threads) != n_threads) {
+        cpu_relax();
+    }
+
+    qatomic_set(&test_start, true);
+    g_usleep(duration * G_USEC_PER_SEC);
+    qatomic_set(&test_stop, true);
+
+    for (i = 0; i < n_threads; i++) {
+        qemu_thread_join(&threads[i]);
+    }
+}
+
+static void create_threads(void)
+{
+    unsigned int i;
+
+    threads = g_new(QemuThread, n_threads);
+    th_info = g_new0(struct thread_info, n_threads);
+
+    for (i = 0; i < n_threads; i++) {
+        struct thread_info *info = &th_info[i];
+
+        info->r = (i + 1) ^ time(NULL);
+        qemu_thread_create(&threads[i], NULL, thread_func, info,
+                           QEMU_THREAD_JOINABLE);
+    }
+}
+
+static void pr_params(void)
+{
+    printf("Parameters:\n");
+    printf(" # of threads:      %u\n", n_threads);
+    printf(" duration:          %u\n", duration);
+    printf(" # of pcs:          %u\n", n_pcs);
+    printf(" # of compartments: %u\n", n_compartments);
+    printf(" hash:              %s\n",
+           old_hash ? "without PCC bounds" : "with PCC bounds");
+}
+
+static void pr_stats(void)
+{
+    struct qht_stats hst;
+    unsigned long long lookups = 0, misses = 0;
+    double tx;
+    unsigned int i;
+
+    for (i = 0; i < n_threads; i++) {
+        lookups += th_info[i].lookups;
+        misses += th_info[i].misses;
+    }
+    tx = lookups / duration / 1e6;
+
+    qht_statistics_init(&ht, &hst);
+    printf("Results:\n");
+    printf("Duration:            %u s\n", duration);
+    printf(" Throughput:         %.2f Mlookups/s\n", tx);
+    printf(" Throughput/thread:  %.2f Mlookups/s/thread\n", tx / n_threads);
+    printf(" Misses:             %llu\n", misses);
+    printf(" Used head buckets:  %zu/%zu\n", hst.used_head_buckets,
+           hst.head_buckets);
+    printf(" Avg chain length:   %.2f buckets\n", qdist_avg(&hst.chain));
+    qht_statistics_destroy(&hst);
+}
+
+static void parse_args(int argc, char *argv[])
+{
+    int c;
+
+    for (;;) {
+        c = getopt(argc, argv, "hd:n:p:c:o");
+        if (c < 0) {
+            break;
+        }
+        switch (c) {
+        case 'h':
+            usage_complete(argv);
+            exit(0);
+        case 'd':
+            duration = atoi(optarg);
+            break;
+        case 'n':
+            n_threads = atoi(optarg);
+            break;
+        case 'p':
+            n_pcs = MAX(atoi(optarg), 1);
+            break;
+        case 'c':
+            n_compartments = MAX(atoi(optarg), 1);
+            break;
+        case 'o':
+            old_hash = true;
+            break;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    parse_args(argc, argv);
+    pr_params();
+    populate();
+    create_threads();
+    run_test();
+    pr_stats();
+    return 0;
+}
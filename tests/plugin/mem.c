@@ -18,8 +18,10 @@ QEMU_PLUGIN_EXPORT int qemu_plugin_version = QEMU_PLUGIN_VERSION;
 
 static uint64_t inline_mem_count;
 static uint64_t cb_mem_count;
+static uint64_t buffered_mem_count;
 static uint64_t io_count;
-static bool do_inline, do_callback;
+static bool do_inline, do_callback, do_buffered;
+static struct qemu_plugin_mem_buffer *mem_buffer;
 static bool do_haddr;
 static enum qemu_plugin_mem_rw rw = QEMU_PLUGIN_MEM_RW;
 
@@ -33,6 +35,10 @@ static void plugin_exit(qemu_plugin_id_t id, void *p)
     if (do_callback) {
         g_string_append_printf(out, "callback mem accesses: %" PRIu64 "\n", cb_mem_count);
     }
+    if (do_buffered) {
+        g_string_append_printf(out, "buffered mem accesses: %" PRIu64 "\n",
+                               buffered_mem_count);
+    }
     if (do_haddr) {
         g_string_append_printf(out, "io accesses: %" PRIu64 "\n", io_count);
     }
@@ -55,6 +61,13 @@ static void vcpu_mem(unsigned int cpu_index, qemu_plugin_meminfo_t meminfo,
     }
 }
 
+static void vcpu_mem_batch(unsigned int cpu_index,
+                           const struct qemu_plugin_mem_event *events,
+                           size_t n, void *udata)
+{
+    __atomic_add_fetch(&buffered_mem_count, n, __ATOMIC_RELAXED);
+}
+
 static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
 {
     size_t n = qemu_plugin_tb_n_insns(tb);
@@ -73,6 +86,9 @@ static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
                                              QEMU_PLUGIN_CB_NO_REGS,
                                              rw, NULL);
         }
+        if (do_buffered) {
+            qemu_plugin_register_vcpu_mem_buffered(insn, rw, mem_buffer, NULL);
+        }
     }
 }
 
@@ -101,11 +117,18 @@ QEMU_PLUGIN_EXPORT int qemu_plugin_install(qemu_plugin_id_t id,
         } else if (!strcmp(argv[0], "both")) {
             do_inline = true;
             do_callback = true;
+        } else if (!strcmp(argv[0], "buffered")) {
+            do_buffered = true;
+            do_callback = false;
         } else {
             do_callback = true;
         }
     }
 
+    if (do_buffered) {
+        mem_buffer = qemu_plugin_mem_buffer_new(id, 1024, vcpu_mem_batch,
+                                                NULL);
+    }
     qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
     qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
     return 0;
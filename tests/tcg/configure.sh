@@ -64,6 +64,7 @@ fi
 : ${cross_cc_ppc64="powerpc64-linux-gnu-gcc"}
 : ${cross_cc_ppc64le="powerpc64le-linux-gnu-gcc"}
 : $(cross_cc_riscv64="riscv64-linux-gnu-gcc")
+: ${cross_cc_cflags_riscv64cheri="-march=rv64imafdcxcheri -mabi=lp64d"}
 : ${cross_cc_s390x="s390x-linux-gnu-gcc"}
 : $(cross_cc_sh4="sh4-linux-gnu-gcc")
 : ${cross_cc_cflags_sparc="-m32 -mv8plus -mcpu=ultrasparc"}
@@ -96,7 +97,7 @@ for target in $target_list; do
     xtensa|xtensaeb)
       arches=xtensa
       ;;
-    alpha|cris|hexagon|hppa|i386|lm32|microblaze|microblazeel|m68k|openrisc|riscv64|s390x|sh4|sparc64)
+    alpha|cris|hexagon|hppa|i386|lm32|microblaze|microblazeel|m68k|openrisc|riscv64|riscv64cheri|s390x|sh4|sparc64)
       arches=$target
       ;;
     *)
@@ -0,0 +1,59 @@
+/*
+ * Translation burst
+ *
+ * Call a few thousand small functions once each, in address order, the
+ * way program startup or a freshly loaded library runs a lot of code
+ * that has never been translated. Most of the run time under
+ * linux-user is spent translating, which makes this a useful test (and
+ * benchmark) for translating ahead of execution with "-tb-workers".
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FN(d)                                                   \
+    static unsigned long __attribute__((noinline))              \
+    f_##d(unsigned long x)                                      \
+    {                                                           \
+        return x * (2 * 0##d + 1) + 0##d;                       \
+    }
+#define FN1(d) FN(d##0) FN(d##1) FN(d##2) FN(d##3) \
+               FN(d##4) FN(d##5) FN(d##6) FN(d##7)
+#define FN2(d) FN1(d##0) FN1(d##1) FN1(d##2) FN1(d##3) \
+               FN1(d##4) FN1(d##5) FN1(d##6) FN1(d##7)
+#define FN3(d) FN2(d##0) FN2(d##1) FN2(d##2) FN2(d##3) \
+               FN2(d##4) FN2(d##5) FN2(d##6) FN2(d##7)
+
+#define PTR(d) f_##d,
+#define PTR1(d) PTR(d##0) PTR(d##1) PTR(d##2) PTR(d##3) \
+                PTR(d##4) PTR(d##5) PTR(d##6) PTR(d##7)
+#define PTR2(d) PTR1(d##0) PTR1(d##1) PTR1(d##2) PTR1(d##3) \
+                PTR1(d##4) PTR1(d##5) PTR1(d##6) PTR1(d##7)
+#define PTR3(d) PTR2(d##0) PTR2(d##1) PTR2(d##2) PTR2(d##3) \
+                PTR2(d##4) PTR2(d##5) PTR2(d##6) PTR2(d##7)
+
+FN3(0) FN3(1) FN3(2) FN3(3) FN3(4) FN3(5) FN3(6) FN3(7)
+
+static unsigned long (*const fns[])(unsigned long) = {
+    PTR3(0) PTR3(1) PTR3(2) PTR3(3) PTR3(4) PTR3(5) PTR3(6) PTR3(7)
+};
+
+#define N_FNS (sizeof(fns) / sizeof(fns[0]))
+
+int main(void)
+{
+    unsigned long got = 0, expected = 0, i;
+
+    for (i = 0; i < N_FNS; i++) {
+        got += fns[i](i);
+        expected += i * (2 * i + 1) + i;
+    }
+    printf("%lu functions, sum %lu\n", (unsigned long)N_FNS, got);
+    if (got != expected) {
+        printf("FAIL: expected %lu\n", expected);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+/*
+ * RVV vadd.vx/vmin.vx timing
+ *
+ * Runs each op in a tight loop and prints the time per instruction, for:
+ *  - unmasked with vl == VLMAX, which is expanded inline with gvec,
+ *  - unmasked with vl < VLMAX and masked, which are done by the helpers.
+ * This is a benchmark rather than a test: it only fails if it cannot run.
+ *
+ * Usage: rvv-bench [iterations]
+ * Run with "-cpu rv64,x-v=true,...".
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "rvv071.h"
+
+/* Enough for VLEN=512 */
+#define VREG_BYTES 64
+
+typedef void loop_fn(uint64_t vtype, uint64_t vl, const void *vs2,
+                     const void *mask, uint64_t iters);
+
+/*
+ * With vl = VLMAX, load v8 from @vs2 and v0 from @mask; then set vl and
+ * do "op v16, v8, a6[, v0.t]" @iters times.
+ */
+#define DEFINE_LOOP(NAME, FUNCT6, VM)                                   \
+static void NAME(uint64_t vtype, uint64_t vl, const void *vs2,          \
+                 const void *mask, uint64_t iters)                      \
+{                                                                       \
+    register uint64_t avl_max asm("a0") = -1;                           \
+    register uint64_t type asm("a1") = vtype;                           \
+    register uint64_t n asm("a2") = iters;                              \
+    register const void *s2 asm("a3") = vs2;                            \
+    register const void *m asm("a4") = mask;                            \
+    register uint64_t avl asm("a5") = vl;                               \
+    register uint64_t s1 asm("a6") = 42;                                \
+                                                                        \
+    asm volatile(".word %[setmax]\n\t"                                  \
+                 ".word %[lds2]\n\t"                                    \
+                 ".word %[ldm]\n\t"                                     \
+                 ".word %[setvl]\n"                                     \
+                 "1:\n\t"                                               \
+                 ".word %[op]\n\t"                                      \
+                 "addi %[n], %[n], -1\n\t"                              \
+                 "bnez %[n], 1b\n\t"                                    \
+                 : [n] "+r"(n)                                          \
+                 : "r"(avl_max), "r"(type), "r"(s2), "r"(m), "r"(avl),  \
+                   "r"(s1),                                             \
+                   [setmax] "i"(RVV_VSETVL(5, 10, 11)),                 \
+                   [setvl] "i"(RVV_VSETVL(5, 15, 11)),                  \
+                   [lds2] "i"(RVV_VLE(8, 13)),                          \
+                   [ldm] "i"(RVV_VLE(0, 14)),                           \
+                   [op] "i"(RVV_OPIVX(FUNCT6, VM, 16, 8, 16))           \
+                 : "t0", "memory");                                     \
+}
+
+DEFINE_LOOP(vadd_vx, RVV_VADD, 1)
+DEFINE_LOOP(vadd_vx_m, RVV_VADD, 0)
+DEFINE_LOOP(vmin_vx, RVV_VMIN, 1)
+DEFINE_LOOP(vmin_vx_m, RVV_VMIN, 0)
+
+static const struct {
+    const char *name;
+    loop_fn *fn, *fn_masked;
+} ops[] = {
+    { "vadd.vx", vadd_vx, vadd_vx_m },
+    { "vmin.vx", vmin_vx, vmin_vx_m },
+};
+
+static uint64_t vtype_vlmax(uint64_t vtype)
+{
+    register uint64_t vl asm("t0");
+    register uint64_t avl_max asm("a0") = -1;
+    register uint64_t type asm("a1") = vtype;
+
+    asm volatile(".word %[setmax]"
+                 : "=r"(vl)
+                 : "r"(avl_max), "r"(type),
+                   [setmax] "i"(RVV_VSETVL(5, 10, 11)));
+    return vl;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t iters = argc > 1 ? strtoull(argv[1], NULL, 0) : 200000;
+    uint8_t src[VREG_BYTES], mask[VREG_BYTES];
+
+    if (iters == 0) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < VREG_BYTES; i++) {
+        src[i] = i * 37;
+    }
+
+    for (int sew = 0; sew < 4; sew++) {
+        uint64_t vtype = RVV_VTYPE(sew);
+        uint64_t vlmax = vtype_vlmax(vtype);
+
+        if (vlmax == 0 || (vlmax << sew) > VREG_BYTES) {
+            fprintf(stderr, "FAIL: VLMAX %u at SEW=%d\n",
+                    (unsigned)vlmax, 8 << sew);
+            return EXIT_FAILURE;
+        }
+        /* Every other element is active: bit 0 of odd elements is set */
+        for (int i = 0; i < VREG_BYTES; i++) {
+            mask[i] = (i >> sew) & 1;
+        }
+        for (int op = 0; op < sizeof(ops) / sizeof(ops[0]); op++) {
+            static const char *const cases[] = {
+                "vl=VLMAX", "vl=VLMAX-1", "masked",
+            };
+
+            for (int c = 0; c < 3; c++) {
+                uint64_t vl = c == 1 ? vlmax - 1 : vlmax;
+                double t = now();
+
+                (c == 2 ? ops[op].fn_masked : ops[op].fn)(
+                    vtype, vl, src, mask, iters);
+                t = now() - t;
+                printf("%s SEW=%-2d %-10s %8.2f ns/insn\n", ops[op].name,
+                       8 << sew, cases[c], t * 1e9 / iters);
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
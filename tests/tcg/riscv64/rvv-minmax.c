@@ -0,0 +1,225 @@
+/*
+ * RVV vmin/vminu/vmax/vmaxu.vx
+ *
+ * Checks each op against a C reference at every SEW, both unmasked with
+ * vl == VLMAX (expanded inline with gvec) and masked or with a shorter vl
+ * (done by the helpers). Masked-off elements must be left alone and tail
+ * elements zeroed, as v0.7.1 specifies.
+ *
+ * rs1 is truncated to SEW bits for SEW < 64 and used whole at SEW=64,
+ * where a negative rs1 has to compare as negative for vmin/vmax and as a
+ * large unsigned value for vminu/vmaxu. Some rs1 values differ in sign
+ * between their low 32 bits and all 64, to catch an operand that is
+ * sign-extended or truncated at the wrong width.
+ *
+ * Run with "-cpu rv64,x-v=true,...".
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rvv071.h"
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+/* Enough for VLEN=512 */
+#define VREG_BYTES 64
+
+typedef void vx_fn(uint64_t vtype, uint64_t vl, void *vd, const void *vs2,
+                   const void *mask, uint64_t rs1);
+
+/*
+ * With vl = VLMAX, load v16 from @vd, v8 from @vs2 and v0 from @mask;
+ * then set vl and do "op v16, v8, a6[, v0.t]"; then store all of v16.
+ */
+#define DEFINE_VX(NAME, FUNCT6, VM)                                     \
+static void NAME(uint64_t vtype, uint64_t vl, void *vd, const void *vs2, \
+                 const void *mask, uint64_t rs1)                        \
+{                                                                       \
+    register uint64_t avl_max asm("a0") = -1;                           \
+    register uint64_t type asm("a1") = vtype;                           \
+    register void *d asm("a2") = vd;                                    \
+    register const void *s2 asm("a3") = vs2;                            \
+    register const void *m asm("a4") = mask;                            \
+    register uint64_t avl asm("a5") = vl;                               \
+    register uint64_t s1 asm("a6") = rs1;                               \
+                                                                        \
+    asm volatile(".word %[setmax]\n\t"                                  \
+                 ".word %[ldd]\n\t"                                     \
+                 ".word %[lds2]\n\t"                                    \
+                 ".word %[ldm]\n\t"                                     \
+                 ".word %[setvl]\n\t"                                   \
+                 ".word %[op]\n\t"                                      \
+                 ".word %[setmax]\n\t"                                  \
+                 ".word %[std]\n\t"                                     \
+                 : : "r"(avl_max), "r"(type), "r"(d), "r"(s2), "r"(m),  \
+                     "r"(avl), "r"(s1),                                 \
+                     [setmax] "i"(RVV_VSETVL(5, 10, 11)),               \
+                     [setvl] "i"(RVV_VSETVL(5, 15, 11)),                \
+                     [ldd] "i"(RVV_VLE(16, 12)),                        \
+                     [lds2] "i"(RVV_VLE(8, 13)),                        \
+                     [ldm] "i"(RVV_VLE(0, 14)),                         \
+                     [op] "i"(RVV_OPIVX(FUNCT6, VM, 16, 8, 16)),        \
+                     [std] "i"(RVV_VSE(16, 12))                         \
+                 : "t0", "memory");                                     \
+}
+
+DEFINE_VX(vminu_vx, RVV_VMINU, 1)
+DEFINE_VX(vminu_vx_m, RVV_VMINU, 0)
+DEFINE_VX(vmin_vx, RVV_VMIN, 1)
+DEFINE_VX(vmin_vx_m, RVV_VMIN, 0)
+DEFINE_VX(vmaxu_vx, RVV_VMAXU, 1)
+DEFINE_VX(vmaxu_vx_m, RVV_VMAXU, 0)
+DEFINE_VX(vmax_vx, RVV_VMAX, 1)
+DEFINE_VX(vmax_vx_m, RVV_VMAX, 0)
+
+static const struct {
+    const char *name;
+    vx_fn *fn, *fn_masked;
+    bool is_signed, is_max;
+} ops[] = {
+    { "vminu.vx", vminu_vx, vminu_vx_m, false, false },
+    { "vmin.vx",  vmin_vx,  vmin_vx_m,  true,  false },
+    { "vmaxu.vx", vmaxu_vx, vmaxu_vx_m, false, true },
+    { "vmax.vx",  vmax_vx,  vmax_vx_m,  true,  true },
+};
+
+static const uint64_t rs1_values[] = {
+    0,
+    1,
+    -1,
+    0x7f,
+    0x80,
+    0x8000,
+    0x80000000,
+    0xffffffff7fffffffull,
+    0x000000007fffffffull,
+    0x123456789abcdef0ull,
+    INT64_MIN,
+    INT64_MAX,
+};
+
+static const uint64_t elem_values[] = {
+    0, 1, -1, 0x7f, 0x80, 0x7fff, 0x8000, 0x7fffffff, 0x80000000,
+    INT64_MIN, INT64_MAX, 0x0123456789abcdefull, 0xfedcba9876543210ull,
+};
+
+static uint64_t vtype_vlmax(uint64_t vtype)
+{
+    register uint64_t vl asm("t0");
+    register uint64_t avl_max asm("a0") = -1;
+    register uint64_t type asm("a1") = vtype;
+
+    asm volatile(".word %[setmax]"
+                 : "=r"(vl)
+                 : "r"(avl_max), "r"(type),
+                   [setmax] "i"(RVV_VSETVL(5, 10, 11)));
+    return vl;
+}
+
+static uint64_t get_elem(const uint8_t *v, int sew, unsigned i)
+{
+    uint64_t x = 0;
+
+    memcpy(&x, v + (i << sew), 1 << sew);
+    return x;
+}
+
+static void set_elem(uint8_t *v, int sew, unsigned i, uint64_t x)
+{
+    memcpy(v + (i << sew), &x, 1 << sew);
+}
+
+static uint64_t truncate_sew(uint64_t x, int bits)
+{
+    return bits == 64 ? x : x & ((1ull << bits) - 1);
+}
+
+static int64_t sextract(uint64_t x, int bits)
+{
+    return (int64_t)(x << (64 - bits)) >> (64 - bits);
+}
+
+static uint64_t reference(int op, int sew, uint64_t a, uint64_t rs1)
+{
+    int bits = 8 << sew;
+    uint64_t b = truncate_sew(rs1, bits);
+    bool a_first;
+
+    if (ops[op].is_signed) {
+        a_first = sextract(a, bits) < sextract(b, bits);
+    } else {
+        a_first = a < b;
+    }
+    return a_first != ops[op].is_max ? a : b;
+}
+
+int main(void)
+{
+    uint8_t src[VREG_BYTES], dst[VREG_BYTES], old[VREG_BYTES];
+    uint8_t mask[VREG_BYTES];
+    int failures = 0;
+
+    for (int sew = 0; sew < 4; sew++) {
+        uint64_t vtype = RVV_VTYPE(sew);
+        unsigned vlmax = vtype_vlmax(vtype);
+
+        if (vlmax == 0 || (vlmax << sew) > VREG_BYTES) {
+            fprintf(stderr, "FAIL: VLMAX %u at SEW=%d\n", vlmax, 8 << sew);
+            return EXIT_FAILURE;
+        }
+        /* With LMUL=1 the mask bit for element i is bit 0 of element i */
+        for (unsigned i = 0; i < vlmax; i++) {
+            set_elem(src, sew, i,
+                     elem_values[i % ARRAY_SIZE(elem_values)] + i / 13);
+            set_elem(old, sew, i, 0xa5a5a5a5a5a5a5a5ull);
+            set_elem(mask, sew, i, i % 3 != 1);
+        }
+
+        for (int op = 0; op < ARRAY_SIZE(ops); op++) {
+            for (int r = 0; r < ARRAY_SIZE(rs1_values); r++) {
+                for (int c = 0; c < 4; c++) {
+                    /* Only the first case is expanded with gvec */
+                    unsigned vl = c & 2 ? vlmax - 1 : vlmax;
+                    bool masked = c & 1;
+                    uint64_t rs1 = rs1_values[r];
+
+                    memcpy(dst, old, sizeof(dst));
+                    (masked ? ops[op].fn_masked : ops[op].fn)(
+                        vtype, vl, dst, src, mask, rs1);
+
+                    for (unsigned i = 0; i < vlmax; i++) {
+                        uint64_t expect;
+
+                        if (i >= vl) {
+                            expect = 0;
+                        } else if (masked && !get_elem(mask, sew, i)) {
+                            expect = get_elem(old, sew, i);
+                        } else {
+                            expect = reference(op, sew, get_elem(src, sew, i),
+                                               rs1);
+                        }
+                        if (get_elem(dst, sew, i) != expect) {
+                            fprintf(stderr, "FAIL: %s SEW=%d vl=%u%s "
+                                    "rs1=0x%016llx element %u: "
+                                    "got 0x%llx, expected 0x%llx\n",
+                                    ops[op].name, 8 << sew, vl,
+                                    masked ? " masked" : "",
+                                    (unsigned long long)rs1, i,
+                                    (unsigned long long)get_elem(dst, sew, i),
+                                    (unsigned long long)expect);
+                            failures++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,40 @@
+/*
+ * RISC-V vector extension v0.7.1 encodings
+ *
+ * QEMU implements v0.7.1 of the vector extension, which released
+ * toolchains do not assemble, so the tests emit the instructions they
+ * need with .word. Operands are register numbers; pass the result as an
+ * "i" asm operand.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef RVV071_H
+#define RVV071_H
+
+/* vtype for LMUL=1 and SEW = 8 << sew */
+#define RVV_VTYPE(sew)          ((sew) << 2)
+
+/* vsetvl rd, rs1, rs2 */
+#define RVV_VSETVL(rd, rs1, rs2)                                        \
+    ((0x40u << 25) | ((rs2) << 20) | ((rs1) << 15) | (7 << 12) |        \
+     ((rd) << 7) | 0x57)
+
+/* vle.v vd, (rs1) and vse.v vs3, (rs1): unit-stride, SEW-wide, unmasked */
+#define RVV_VLE(vd, rs1)                                                \
+    ((1 << 25) | ((rs1) << 15) | (7 << 12) | ((vd) << 7) | 0x07)
+#define RVV_VSE(vs3, rs1)                                               \
+    ((1 << 25) | ((rs1) << 15) | (7 << 12) | ((vs3) << 7) | 0x27)
+
+/* OPIVX: op.vx vd, vs2, rs1[, v0.t] */
+#define RVV_OPIVX(funct6, vm, vd, vs2, rs1)                             \
+    (((unsigned)(funct6) << 26) | ((vm) << 25) | ((vs2) << 20) |        \
+     ((rs1) << 15) | (4 << 12) | ((vd) << 7) | 0x57)
+
+#define RVV_VADD                0x00
+#define RVV_VMINU               0x04
+#define RVV_VMIN                0x05
+#define RVV_VMAXU               0x06
+#define RVV_VMAX                0x07
+
+#endif
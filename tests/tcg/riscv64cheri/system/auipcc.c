@@ -0,0 +1,95 @@
+/*
+ * AUIPCC in capability mode
+ *
+ * auipcc_probe runs in capability mode with PCC bounded to just its own
+ * code. Its first AUIPCC targets an address within those bounds, which is
+ * translated inline; the second targets an address far outside them, which
+ * goes through helper_auipcc() and must lose its tag. The integer view of
+ * the inline result is read back with an integer instruction to check that
+ * the cursor seen by integer code matches the capability.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <stdint.h>
+#include <minilib.h>
+
+typedef void * __capability cap_t;
+
+/* Must match the immediate of the second AUIPCC in auipcc_probe */
+#define FAR_IMM 0x7ffff
+
+struct results {
+    cap_t in_bounds;
+    cap_t out_of_bounds;
+    uint64_t in_bounds_int;
+} __attribute__((aligned(16)));
+
+/* Called with ca2 = capability to struct results */
+extern char auipcc_probe[], auipcc_probe_end[];
+asm(".text\n"
+    ".align 4\n"
+    ".option push\n"
+    ".option capmode\n"
+    "auipcc_probe:\n"
+    "    auipcc ca0, 0\n"
+    "    auipcc ca1, 0x7ffff\n"
+    "    mv a3, a0\n"
+    "    csc ca0, 0(ca2)\n"
+    "    csc ca1, 16(ca2)\n"
+    "    csd a3, 32(ca2)\n"
+    "    cret\n"
+    "auipcc_probe_end:\n"
+    ".option pop\n");
+
+static struct results res;
+static int failures;
+
+static void check(int cond, const char *what)
+{
+    if (!cond) {
+        ml_printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+int main(void)
+{
+    uintptr_t probe = (uintptr_t)auipcc_probe;
+    uintptr_t len = auipcc_probe_end - auipcc_probe;
+    cap_t fn, out;
+
+    fn = __builtin_cheri_address_set(__builtin_cheri_program_counter_get(),
+                                     probe);
+    fn = __builtin_cheri_bounds_set_exact(fn, len);
+    fn = __builtin_cheri_flags_set(fn, 1); /* capability mode */
+    out = __builtin_cheri_address_set(__builtin_cheri_global_data_get(),
+                                      (uintptr_t)&res);
+    out = __builtin_cheri_bounds_set_exact(out, sizeof(res));
+
+    /* Run it twice so the second run comes from the translated TB */
+    for (int i = 0; i < 2; i++) {
+        asm volatile("cmove ca2, %1\n\t"
+                     "cjalr cra, %0"
+                     : : "C"(fn), "C"(out)
+                     : "ra", "a0", "a1", "a2", "a3", "memory");
+
+        check(__builtin_cheri_tag_get(res.in_bounds),
+              "in-bounds result is tagged");
+        check(__builtin_cheri_address_get(res.in_bounds) == probe,
+              "in-bounds result has the PC as address");
+        check(__builtin_cheri_base_get(res.in_bounds) == probe &&
+              __builtin_cheri_length_get(res.in_bounds) == len,
+              "in-bounds result has the PCC bounds");
+        check(res.in_bounds_int == probe,
+              "integer view of the in-bounds result");
+        check(!__builtin_cheri_tag_get(res.out_of_bounds),
+              "far out-of-bounds result is untagged");
+        check(__builtin_cheri_address_get(res.out_of_bounds) ==
+              probe + 4 + ((uint64_t)FAR_IMM << 12),
+              "out-of-bounds result has the target address");
+    }
+
+    ml_printf("%s\n", failures ? "FAIL" : "PASS");
+    return failures != 0;
+}
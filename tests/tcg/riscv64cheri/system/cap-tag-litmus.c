@@ -0,0 +1,234 @@
+/*
+ * CHERI tag/data atomicity litmus tests
+ *
+ * These are meant to be run with MTTCG and several harts. One or two harts
+ * repeatedly store to a shared capability-sized slot (with CSC, plain data
+ * stores or atomics) while the remaining harts load the slot with CLC. Any
+ * tagged capability that is loaded must be exactly one of the capabilities
+ * that were stored: a tagged value that mixes bits of a capability with bits
+ * of another store means the tag and data updates were not atomic, which
+ * would allow a guest to forge capabilities.
+ *
+ * The tests use hybrid mode (integer pointers are dereferenced via DDC) so
+ * that only the capability slots themselves need to be capabilities.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <minilib.h>
+
+#define NR_HARTS 4
+#define ITERATIONS 100000
+
+typedef void * __capability cap_t;
+
+/* Two adjacent capability granules for the unaligned store test */
+static cap_t slots[2] __attribute__((aligned(16)));
+static char object_a[64], object_b[256];
+static cap_t cap_a, cap_b;
+
+static volatile unsigned barrier_count, barrier_generation;
+static volatile unsigned failures;
+static volatile bool stop;
+
+static void barrier(void)
+{
+    unsigned gen = __atomic_load_n(&barrier_generation, __ATOMIC_ACQUIRE);
+
+    if (__atomic_add_fetch(&barrier_count, 1, __ATOMIC_ACQ_REL) == NR_HARTS) {
+        barrier_count = 0;
+        __atomic_store_n(&barrier_generation, gen + 1, __ATOMIC_RELEASE);
+    } else {
+        while (__atomic_load_n(&barrier_generation, __ATOMIC_ACQUIRE) == gen) {
+            /* spin */
+        }
+    }
+}
+
+static cap_t make_cap(void *obj, unsigned long len)
+{
+    cap_t root = __builtin_cheri_global_data_get();
+    cap_t cap = __builtin_cheri_address_set(root, (uintptr_t)obj);
+
+    return __builtin_cheri_bounds_set(cap, len);
+}
+
+static void check(cap_t value)
+{
+    if (__builtin_cheri_tag_get(value) &&
+        !__builtin_cheri_equal_exact(value, cap_a) &&
+        !__builtin_cheri_equal_exact(value, cap_b)) {
+        __atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void reader(volatile cap_t *slot)
+{
+    while (!__atomic_load_n(&stop, __ATOMIC_ACQUIRE)) {
+        check(*slot);
+    }
+}
+
+static void store_caps(volatile cap_t *slot, cap_t cap)
+{
+    for (int i = 0; i < ITERATIONS; i++) {
+        *slot = cap;
+    }
+    __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+}
+
+static volatile uint64_t *slot_word(volatile cap_t *slot, int i)
+{
+    return (volatile uint64_t *)slot + (i & 1);
+}
+
+/* CSC racing with plain data stores to either half of the slot */
+static void test_csc_vs_store(int hart)
+{
+    switch (hart) {
+    case 1:
+        for (int i = 0; i < ITERATIONS; i++) {
+            slots[0] = cap_a;
+            *slot_word(&slots[0], i) = (uintptr_t)object_b;
+        }
+        __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+        break;
+    default:
+        reader(&slots[0]);
+        break;
+    }
+}
+
+/* Two harts storing different capabilities to the same slot */
+static void test_csc_vs_csc(int hart)
+{
+    switch (hart) {
+    case 1:
+        store_caps(&slots[0], cap_a);
+        break;
+    case 2:
+        while (!__atomic_load_n(&stop, __ATOMIC_ACQUIRE)) {
+            slots[0] = cap_b;
+        }
+        break;
+    default:
+        reader(&slots[0]);
+        break;
+    }
+}
+
+/* CSC racing with AMOs on either half of the slot */
+static void test_csc_vs_amo(int hart)
+{
+    switch (hart) {
+    case 1:
+        store_caps(&slots[0], cap_a);
+        break;
+    case 2:
+        for (int i = 0; !__atomic_load_n(&stop, __ATOMIC_ACQUIRE); i++) {
+            __atomic_fetch_add(slot_word(&slots[0], i), 16, __ATOMIC_RELAXED);
+        }
+        break;
+    default:
+        reader(&slots[0]);
+        break;
+    }
+}
+
+/* CSC racing with successful and failing LR/SC sequences */
+static void test_csc_vs_cmpxchg(int hart)
+{
+    switch (hart) {
+    case 1:
+        store_caps(&slots[0], cap_a);
+        break;
+    case 2:
+        for (int i = 0; !__atomic_load_n(&stop, __ATOMIC_ACQUIRE); i++) {
+            uint64_t expected = *slot_word(&slots[0], i);
+            __atomic_compare_exchange_n(slot_word(&slots[0], i), &expected,
+                                        expected + 16, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        }
+        break;
+    default:
+        reader(&slots[0]);
+        break;
+    }
+}
+
+/* CSC racing with an unaligned store that spans two granules */
+static void test_csc_vs_unaligned(int hart)
+{
+    uintptr_t addr = (uintptr_t)&slots[1] - 4;
+
+    switch (hart) {
+    case 1:
+        store_caps(&slots[1], cap_a);
+        break;
+    case 2:
+        while (!__atomic_load_n(&stop, __ATOMIC_ACQUIRE)) {
+            asm volatile("sd %0, 0(%1)"
+                         : : "r"((uintptr_t)object_b), "r"(addr) : "memory");
+        }
+        break;
+    default:
+        reader(&slots[1]);
+        break;
+    }
+}
+
+static const struct {
+    const char *name;
+    void (*fn)(int hart);
+} tests[] = {
+    { "csc-vs-store", test_csc_vs_store },
+    { "csc-vs-csc", test_csc_vs_csc },
+    { "csc-vs-amo", test_csc_vs_amo },
+    { "csc-vs-cmpxchg", test_csc_vs_cmpxchg },
+    { "csc-vs-unaligned", test_csc_vs_unaligned },
+};
+
+static int hart_id(void)
+{
+    uintptr_t id;
+
+    /* boot.S leaves mhartid in tp */
+    asm("mv %0, tp" : "=r"(id));
+    return id;
+}
+
+int main(void)
+{
+    int hart = hart_id();
+    int total = 0;
+
+    if (hart >= NR_HARTS) {
+        return 0;
+    }
+    if (hart == 0) {
+        cap_a = make_cap(object_a, sizeof(object_a));
+        cap_b = make_cap(object_b, sizeof(object_b));
+    }
+
+    for (int i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        if (hart == 0) {
+            slots[0] = slots[1] = (cap_t)0;
+            failures = 0;
+            stop = false;
+        }
+        barrier();
+        tests[i].fn(hart);
+        barrier();
+        if (hart == 0) {
+            ml_printf("%s: %d torn capabilities\n", tests[i].name, failures);
+            total += failures;
+        }
+    }
+
+    if (hart == 0) {
+        ml_printf("%s\n", total ? "FAIL" : "PASS");
+    }
+    return total != 0;
+}
@@ -14,6 +14,7 @@
 #define TRACE_MEM_SE (1ULL << 4)    /* sign extended (y/n) */
 #define TRACE_MEM_BE (1ULL << 5)    /* big endian (y/n) */
 #define TRACE_MEM_ST (1ULL << 6)    /* store (y/n) */
+#define TRACE_MEM_CAP (1ULL << 7)   /* CHERI capability access (y/n) */
 #define TRACE_MEM_MMU_SHIFT 8       /* mmu idx */
 
 static inline uint16_t trace_mem_build_info(